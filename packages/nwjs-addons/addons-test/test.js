@@ -60,6 +60,74 @@ function setOutput(id, text) {
   }
 }
 
+// ============================================
+// Check Helpers
+// ============================================
+
+/**
+ * Run a group of behavior checks and report them
+ * body(check) calls check(label, ok, detail) once per case and may return
+ * a promise for async cases; a throw or rejection counts as a failure.
+ */
+function runChecks(name, outputId, body) {
+  var lines = [];
+  var failed = 0;
+
+  function check(label, ok, detail) {
+    if (!ok) failed++;
+    lines.push((ok ? 'PASS ' : 'FAIL ') + label + (!ok && detail ? ' (' + detail + ')' : ''));
+  }
+
+  function finish(err) {
+    if (err) {
+      failed++;
+      lines.push('FAIL threw: ' + (err && err.message || err));
+    }
+    log(name + ': ' + (lines.length - failed) + '/' + lines.length + ' checks passed', failed ? 'error' : 'success');
+    setOutput(outputId, name + '\n\n' + lines.join('\n'));
+  }
+
+  var result;
+  try {
+    result = body(check);
+  } catch (err) {
+    finish(err);
+    return;
+  }
+
+  if (result && typeof result.then === 'function') {
+    result.then(function() { finish(null); }, finish);
+  } else {
+    finish(null);
+  }
+}
+
+// Check that two row lists match, naming the first difference if not
+function checkRows(check, label, actual, expected) {
+  var diff = diffRows(actual, expected);
+  check(label, diff === null, diff);
+}
+
+// First difference between two row lists, or null when they match
+function diffRows(actual, expected) {
+  if (!actual || actual.length !== expected.length) {
+    return 'got ' + (actual ? actual.length : actual) + ' rows, expected ' + expected.length;
+  }
+  for (var i = 0; i < expected.length; i++) {
+    var a = JSON.stringify(actual[i]);
+    var e = JSON.stringify(expected[i]);
+    if (a !== e) {
+      return 'row ' + i + ': got ' + a + ', expected ' + e;
+    }
+  }
+  return null;
+}
+
+// Scratch file path in the OS temp directory
+function tempPath(name) {
+  return require('path').join(require('os').tmpdir(), 'nwjs-addons-test-' + name);
+}
+
 // ============================================
 // Initialization
 // ============================================
@@ -669,6 +737,705 @@ function csvStringify() {
   }
 }
 
+/**
+ * createReader() over a file laid out so that quotes, doubled quotes and
+ * CRLF pairs straddle the reader's 64 KB block boundaries
+ */
+function csvReaderChecks() {
+  if (!addons.csvParser) {
+    log('CSV Parser addon not available', 'error');
+    return;
+  }
+
+  var fs = require('fs');
+  var BLOCK = 64 * 1024;
+  var text = '';
+  var expected = [];
+
+  function encode(field) {
+    return /[",\r\n]/.test(field) ? '"' + field.replace(/"/g, '""') + '"' : field;
+  }
+
+  function addRow(fields) {
+    text += fields.map(encode).join(',') + '\r\n';
+    expected.push(fields);
+  }
+
+  // Pad with filler rows so the next byte written lands at offset target
+  function padTo(target) {
+    while (text.length < target) {
+      var gap = target - text.length;
+      var n = gap > 1004 ? 500 : gap - 4;
+      addRow(['p', new Array(n + 1).join('x')]);
+    }
+  }
+
+  // Each case puts a block boundary split bytes into the row it adds
+  var cases = [
+    { row: ['a"b', 'tail'], split: 3 },         // between the two quotes of ""
+    { row: ['open', 'x'], split: 7 },           // between CR and LF
+    { row: ['line1\r\nline2', 'y'], split: 7 }, // inside a quoted CRLF
+    { row: ['q, r', 'z'], split: 1 },           // right after an opening quote
+    { row: ['s', 'closed"'], split: 11 }        // between a closing "" and the closing quote
+  ];
+
+  runChecks('CSV reader', 'csv-output', function(check) {
+    var placed = 0;
+    cases.forEach(function(c, i) {
+      padTo((i + 1) * BLOCK - c.split);
+      if (text.length === (i + 1) * BLOCK - c.split) placed++;
+      addRow(c.row);
+    });
+    check('every case straddles a block boundary', placed === cases.length, placed + '/' + cases.length);
+    addRow(['last', 'row']);
+
+    var file = tempPath('reader.csv');
+    fs.writeFileSync(file, text);
+
+    try {
+      checkRows(check, 'parse() matches the generated rows', addons.csvParser.parse(text, { headers: false }), expected);
+
+      [1, 7, 1000].forEach(function(batchSize) {
+        var reader = addons.csvParser.createReader(file, { headers: false });
+        var rows = [];
+        var batch;
+        while ((batch = reader.next(batchSize)) !== null) {
+          if (batch.length > batchSize) {
+            check('batch of ' + batchSize + ' stays within size', false, batch.length + ' rows');
+          }
+          rows = rows.concat(batch);
+        }
+        checkRows(check, 'reader in batches of ' + batchSize + ' matches across block boundaries', rows, expected);
+        check('reader is done after batches of ' + batchSize, reader.done && reader.next(batchSize) === null);
+        reader.close();
+      });
+
+      fs.writeFileSync(file, 'name,age\r\nAlice,30\r\nBob,"2""5"');
+      var reader = addons.csvParser.createReader(file);
+      var first = reader.next(1);
+      var second = reader.next(1);
+      check('header row is consumed as the column list', JSON.stringify(first) === '[{"name":"Alice","age":"30"}]',
+            JSON.stringify(first));
+      check('last row without a trailing newline is returned', JSON.stringify(second) === '[{"name":"Bob","age":"2\\"5"}]',
+            JSON.stringify(second));
+      check('next() returns null when exhausted', reader.next(1) === null);
+      reader.close();
+
+      fs.writeFileSync(file, '');
+      reader = addons.csvParser.createReader(file);
+      check('empty file returns null at once', reader.next() === null && reader.done);
+      reader.close();
+    } finally {
+      fs.unlinkSync(file);
+    }
+  });
+}
+
+/**
+ * parse() over fields long enough to span several scanner blocks, with
+ * delimiters, quotes and line breaks at every offset within a block
+ */
+function csvScannerChecks() {
+  if (!addons.csvParser) {
+    log('CSV Parser addon not available', 'error');
+    return;
+  }
+
+  runChecks('CSV scanner', 'csv-output', function(check) {
+    var seed = 12345;
+    function random(n) {
+      seed = (seed * 1103515245 + 12345) % 2147483648;
+      return seed % n;
+    }
+
+    [',', ';', '\t', '|'].forEach(function(delimiter) {
+      var specials = [delimiter, '"', '\r\n', '\n', ' '];
+      var rows = [];
+
+      // One special character at each offset 0..129 of a field
+      for (var pos = 0; pos < 130; pos++) {
+        var row = [];
+        for (var col = 0; col < 4; col++) {
+          var field = new Array(pos + 1).join(String.fromCharCode(97 + col));
+          field += specials[(pos + col) % specials.length];
+          field += new Array(random(80) + 1).join('z');
+          row.push(field);
+        }
+        rows.push(row);
+      }
+
+      // Plain fields of every length, so unquoted runs end anywhere
+      for (var len = 0; len < 140; len++) {
+        rows.push(['k' + len, new Array(len + 1).join('v'), String(len)]);
+      }
+
+      var text = addons.csvParser.stringify(rows, { delimiter: delimiter, headers: false });
+      var parsed = addons.csvParser.parse(text, { delimiter: delimiter, headers: false, skipEmptyLines: false });
+      checkRows(check, 'round-trip with delimiter ' + JSON.stringify(delimiter), parsed, rows);
+    });
+
+    var quoted = '"' + new Array(200).join('x') + '""' + new Array(70).join('y') + '",end\n';
+    var result = addons.csvParser.parse(quoted, { headers: false });
+    check('doubled quote deep inside a long field', result.length === 1 && result[0][0].length === 269 &&
+          result[0][0].charAt(199) === '"' && result[0][1] === 'end', JSON.stringify(result).slice(0, 80));
+
+    var bare = new Array(100).join('a,') + 'a\r\n' + new Array(100).join('b,') + 'b';
+    result = addons.csvParser.parse(bare, { headers: false });
+    check('100 one-byte fields per row', result.length === 2 && result[0].length === 100 && result[1][99] === 'b',
+          result.length + ' rows');
+  });
+}
+
+/**
+ * parse() fields that are copied out of the input (escaped, trimmed,
+ * multi-byte) next to plain fields returned straight from their spans
+ */
+function csvFieldChecks() {
+  if (!addons.csvParser) {
+    log('CSV Parser addon not available', 'error');
+    return;
+  }
+
+  runChecks('CSV fields', 'csv-output', function(check) {
+    var csv = addons.csvParser;
+
+    checkRows(check, 'doubled quotes are unescaped, plain fields kept',
+              csv.parse('plain,"say ""hi""",""""\n', { headers: false }),
+              [['plain', 'say "hi"', '"']]);
+
+    checkRows(check, 'empty and quoted empty fields',
+              csv.parse(',"",x,\n', { headers: false }),
+              [['', '', 'x', '']]);
+
+    checkRows(check, 'multi-byte UTF-8 fields',
+              csv.parse('caf\u00e9,"\u65e5\u672c, \u8a9e",\ud83d\ude00\n', { headers: false }),
+              [['caf\u00e9', '\u65e5\u672c, \u8a9e', '\ud83d\ude00']]);
+
+    checkRows(check, 'trim strips padding from plain and quoted fields',
+              csv.parse('  a  ," b ",c  \n', { headers: false, trim: true }),
+              [['a', 'b', 'c']]);
+
+    checkRows(check, 'backslash escapes a quote and nothing else',
+              csv.parse('"a\\"b","c\\d"\n', { headers: false, escape: '\\' }),
+              [['a"b', 'c\\d']]);
+
+    checkRows(check, 'header names are unescaped too',
+              csv.parse('"a ""x""",b\n1,2\n'),
+              [{ 'a "x"': '1', b: '2' }]);
+
+    var many = [];
+    for (var i = 0; i < 2000; i++) {
+      many.push([String(i), i % 3 ? 'v' + i : 'q"' + i]);
+    }
+    checkRows(check, 'escaped and plain fields mixed over many rows',
+              csv.parse(csv.stringify(many, { headers: false }), { headers: false }), many);
+  });
+}
+
+/**
+ * parse() with threads against the single-threaded result, on inputs big
+ * enough to split into several slices. Escaped quotes and stray quotes in
+ * unquoted fields fool the quote-parity split, so those slices must be
+ * redone in order.
+ */
+function csvParallelChecks() {
+  if (!addons.csvParser) {
+    log('CSV Parser addon not available', 'error');
+    return;
+  }
+
+  // Rows of about 50 bytes from makeRow(i) until the text passes size
+  function build(size, makeRow) {
+    var parts = ['id,name,value,note\n'];
+    var length = parts[0].length;
+    for (var i = 0; length < size; i++) {
+      var row = makeRow(i) + '\n';
+      parts.push(row);
+      length += row.length;
+    }
+    return parts.join('');
+  }
+
+  runChecks('CSV parallel', 'csv-output', function(check) {
+    var csv = addons.csvParser;
+    var MB = 1024 * 1024;
+
+    var inputs = [
+      { name: 'plain rows', options: {}, text: build(5 * MB, function(i) {
+        return i + ',name' + i + ',' + (i * 7 % 1000) + ',"note, ' + i + '"';
+      }) },
+      { name: 'quoted newlines', options: {}, text: build(5 * MB, function(i) {
+        return i + ',"multi\nline ' + i + '",' + (i % 10) + ',"a ""b"" c"';
+      }) },
+      { name: 'backslash-escaped quotes', options: { escape: '\\' }, text: build(5 * MB, function(i) {
+        return i + ',"say \\"' + i + '\nmore",' + (i % 10) + ',x';
+      }) },
+      { name: 'stray quotes in plain fields', options: {}, text: build(5 * MB, function(i) {
+        return i + ',in' + (i % 3 ? '' : '"') + 'ch,' + (i % 10) + ',"q\n' + i + '"';
+      }) }
+    ];
+
+    inputs.forEach(function(input) {
+      var single = csv.parse(input.text, mergeInto({ threads: 1 }, input.options));
+      check(input.name + ': single-threaded parse is sane', single.length > 50000 && single[0].id === '0',
+            single.length + ' rows');
+
+      [4, 0].forEach(function(threads) {
+        var parallel = csv.parse(input.text, mergeInto({ threads: threads }, input.options));
+        checkRows(check, input.name + ': threads ' + threads + ' matches threads 1', parallel, single);
+      });
+    });
+
+    var text = inputs[1].text;
+    var options = { select: ['value', 'id'], where: { value: { min: 3, max: 5 } } };
+    checkRows(check, 'select and where with threads 4 match threads 1',
+              csv.parse(text, mergeInto({ threads: 4 }, options)),
+              csv.parse(text, mergeInto({ threads: 1 }, options)));
+
+    var small = build(MB, function(i) { return i + ',a,b,c'; });
+    checkRows(check, 'input below the slice minimum', csv.parse(small, { threads: 8 }), csv.parse(small));
+  });
+}
+
+/**
+ * Async parse/stringify/write against their synchronous versions, with
+ * several calls in flight at once
+ */
+function csvAsyncChecks() {
+  if (!addons.csvParser) {
+    log('CSV Parser addon not available', 'error');
+    return;
+  }
+
+  var fs = require('fs');
+  var csv = addons.csvParser;
+  var files = [tempPath('async-in.csv'), tempPath('async-out.csv')];
+
+  runChecks('CSV async', 'csv-output', function(check) {
+    var data = [];
+    for (var i = 0; i < 20000; i++) {
+      data.push({ id: String(i), name: 'n"' + i, note: i % 2 ? 'line\nbreak' : '' });
+    }
+    var text = csv.stringify(data);
+    fs.writeFileSync(files[0], text);
+    var expected = csv.parseFile(files[0]);
+
+    function rejects(promise) {
+      return promise.then(function() { return false; }, function() { return true; });
+    }
+
+    return Promise.all([
+      csv.parseFileAsync(files[0]),
+      csv.parseFileAsync(files[0], { select: ['name'], where: { id: ['5', '7'] } }),
+      csv.stringifyAsync(data),
+      csv.writeFileAsync(files[1], data),
+      rejects(csv.parseFileAsync(tempPath('missing.csv'))),
+      csv.parseFileAsync(files[0], { threads: 4 })
+    ]).then(function(results) {
+      checkRows(check, 'parseFileAsync matches parseFile', results[0], expected);
+      checkRows(check, 'parseFileAsync applies select and where', results[1], [{ name: 'n"5' }, { name: 'n"7' }]);
+      check('stringifyAsync matches stringify', results[2] === text);
+      check('writeFileAsync writes what stringify returns', results[3] === true && fs.readFileSync(files[1], 'utf8') === text);
+      check('parseFileAsync rejects a missing file', results[4] === true);
+      checkRows(check, 'parseFileAsync with threads matches parseFile', results[5], expected);
+    }).then(cleanup, function(err) {
+      cleanup();
+      throw err;
+    });
+  });
+
+  function cleanup() {
+    files.forEach(function(file) {
+      if (fs.existsSync(file)) fs.unlinkSync(file);
+    });
+  }
+}
+
+/**
+ * parseColumns() types: inference and widening, explicit schemas, dates,
+ * string dictionaries, and the file and async variants
+ */
+function csvColumnsChecks() {
+  if (!addons.csvParser) {
+    log('CSV Parser addon not available', 'error');
+    return;
+  }
+
+  var fs = require('fs');
+  var csv = addons.csvParser;
+  var file = tempPath('columns.csv');
+
+  // Column as 'type:ArrayType:[values]' (NaN shows as null)
+  function describe(column) {
+    return column.type + ':' + column.values.constructor.name + ':' +
+           JSON.stringify(Array.prototype.slice.call(column.values));
+  }
+
+  runChecks('CSV columns', 'csv-output', function(check) {
+    var text = 'i,f,s,d,gap,late\n' +
+               '1,1.5,a,2020-01-02,1,1\n' +
+               '-3,2,b,2020-01-02T03:04:05Z,,2.5\n' +
+               '2147483647,1e3,a,2021-06-01T00:00:00+02:00,3,x\n';
+    var table = csv.parseColumns(text, { inferRows: 2 });
+    var byName = {};
+    table.columns.forEach(function(column) { byName[column.name] = column; });
+
+    check('row count', table.rowCount === 3, table.rowCount);
+    check('integers infer int32', describe(byName.i) === 'int32:Int32Array:[1,-3,2147483647]', describe(byName.i));
+    check('decimals infer float64', describe(byName.f) === 'float64:Float64Array:[1.5,2,1000]', describe(byName.f));
+    check('strings become a dictionary and indices',
+          describe(byName.s) === 'string:Uint32Array:[0,1,0]' && JSON.stringify(byName.s.dictionary) === '["a","b"]',
+          describe(byName.s));
+    check('dates are epoch ms in UTC unless an offset is given',
+          describe(byName.d) === 'date:Float64Array:[1577923200000,1577934245000,1622498400000]', describe(byName.d));
+    check('an empty cell widens int32 to float64 with NaN', describe(byName.gap) === 'float64:Float64Array:[1,null,3]',
+          describe(byName.gap));
+    check('a value past inferRows widens to string',
+          byName.late.type === 'string' && JSON.stringify(byName.late.dictionary) === '["1","2.5","x"]', describe(byName.late));
+
+    table = csv.parseColumns('a,b\n1,x\n,y\n2147483648,z\n', { schema: { a: 'int32', b: 'string' } });
+    check('explicit int32 stores 0 for empty or out-of-range cells', describe(table.columns[0]) === 'int32:Int32Array:[1,0,0]',
+          describe(table.columns[0]));
+
+    table = csv.parseColumns('1,2\n3,4\n', { headers: false, schema: ['float64'] });
+    check('positional schema without headers',
+          table.columns[0].name === '0' && describe(table.columns[0]) === 'float64:Float64Array:[1,3]' &&
+          describe(table.columns[1]) === 'int32:Int32Array:[2,4]', describe(table.columns[0]));
+
+    table = csv.parseColumns('a,b,c\n1,2,3\n4,5,6\n', { select: ['c', 'a'], where: { b: 5 } });
+    check('select and where apply before typing',
+          table.rowCount === 1 && table.columns.length === 2 && table.columns[0].name === 'c' &&
+          describe(table.columns[0]) === 'int32:Int32Array:[6]', table.rowCount + ' rows');
+
+    fs.writeFileSync(file, text);
+    var fromFile = csv.parseFileColumns(file, { inferRows: 2 });
+    check('parseFileColumns matches parseColumns',
+          JSON.stringify(fromFile.columns.map(describe)) === JSON.stringify(csv.parseColumns(text, { inferRows: 2 }).columns.map(describe)));
+
+    return csv.parseFileColumnsAsync(file, { inferRows: 2 }).then(function(result) {
+      check('parseFileColumnsAsync matches parseFileColumns',
+            JSON.stringify(result.columns.map(describe)) === JSON.stringify(fromFile.columns.map(describe)));
+      fs.unlinkSync(file);
+    }, function(err) {
+      fs.unlinkSync(file);
+      throw err;
+    });
+  });
+}
+
+/**
+ * parseFile() over mapped files: sizes ending exactly on a page, a quote
+ * as the very last byte, BOM, empty and missing files
+ */
+function csvFileChecks() {
+  if (!addons.csvParser) {
+    log('CSV Parser addon not available', 'error');
+    return;
+  }
+
+  var fs = require('fs');
+  var csv = addons.csvParser;
+  var file = tempPath('mapped.csv');
+
+  // CSV of exactly size bytes with no trailing newline; the last field
+  // is quoted when quoteLast is set
+  function sized(size, quoteLast) {
+    var text = 'a,b\n';
+    while (size - text.length > 40) {
+      text += text.length + ',row\n';
+    }
+    var pad = size - text.length - 2 - (quoteLast ? 2 : 0);
+    var last = new Array(pad + 1).join('z');
+    return text + 'e,' + (quoteLast ? '"' + last + '"' : last);
+  }
+
+  runChecks('CSV files', 'csv-output', function(check) {
+    try {
+      [4096, 65536, 65537].forEach(function(size) {
+        [false, true].forEach(function(quoteLast) {
+          var text = sized(size, quoteLast);
+          fs.writeFileSync(file, text);
+          var label = size + '-byte file' + (quoteLast ? ' ending in a quote' : '');
+          check(label + ' has the intended size', fs.statSync(file).size === size, fs.statSync(file).size);
+          checkRows(check, label + ' matches parse()', csv.parseFile(file), csv.parse(text));
+        });
+      });
+
+      var big = sized(3 * 1024 * 1024, true);
+      fs.writeFileSync(file, big);
+      checkRows(check, '3 MB file with threads matches parse()', csv.parseFile(file, { threads: 4 }), csv.parse(big));
+
+      fs.writeFileSync(file, new Buffer([0xEF, 0xBB, 0xBF, 0x61, 0x2C, 0x62, 0x0A, 0x31, 0x2C, 0x32]));
+      checkRows(check, 'UTF-8 BOM is skipped', csv.parseFile(file), [{ a: '1', b: '2' }]);
+
+      fs.writeFileSync(file, '');
+      checkRows(check, 'empty file parses to no rows', csv.parseFile(file), []);
+
+      var threw = false;
+      try {
+        csv.parseFile(tempPath('missing.csv'));
+      } catch (err) {
+        threw = true;
+      }
+      check('missing file throws', threw);
+    } finally {
+      fs.unlinkSync(file);
+    }
+  });
+}
+
+/**
+ * createWriter() output against stringify() of the same rows, and its
+ * buffering: nothing reaches the file until the 64 KB buffer fills or
+ * flush() is called
+ */
+function csvWriterChecks() {
+  if (!addons.csvParser) {
+    log('CSV Parser addon not available', 'error');
+    return;
+  }
+
+  var fs = require('fs');
+  var csv = addons.csvParser;
+  var file = tempPath('writer.csv');
+
+  runChecks('CSV writer', 'csv-output', function(check) {
+    try {
+      var data = [];
+      for (var i = 0; i < 5000; i++) {
+        data.push({ id: i, name: 'name "' + i + '"', note: i % 7 ? 'plain' : 'a,b\nc' });
+      }
+
+      var writer = csv.createWriter(file);
+      writer.write(data[0]);
+      check('small writes stay buffered', writer.bytesWritten === 0, writer.bytesWritten);
+      writer.flush();
+      check('flush() writes the buffer', writer.bytesWritten === fs.statSync(file).size && writer.bytesWritten > 0,
+            writer.bytesWritten);
+
+      for (i = 1; i < data.length; i += 100) {
+        writer.writeRows(data.slice(i, i + 100));
+      }
+      check('a full buffer is written without flush()', writer.bytesWritten >= 64 * 1024, writer.bytesWritten);
+      check('close() reports success', writer.close() === true);
+      check('file matches stringify()', fs.readFileSync(file, 'utf8') === csv.stringify(data));
+
+      var threw = false;
+      try {
+        writer.write(data[0]);
+      } catch (err) {
+        threw = true;
+      }
+      check('write after close throws', threw);
+
+      var options = { delimiter: ';', quoteAll: true, lineEnding: '\n', headers: false };
+      var rows = [['a', 'b'], ['c', 'd"e'], ['', 'f;g']];
+      writer = csv.createWriter(file, options);
+      writer.writeRows(rows);
+      writer.close();
+      check('delimiter, quoteAll and lineEnding match stringify()',
+            fs.readFileSync(file, 'utf8') === csv.stringify(rows, options), JSON.stringify(fs.readFileSync(file, 'utf8')));
+
+      writer = csv.createWriter(file);
+      writer.writeRows([{ x: '1', y: '2' }]);
+      writer.writeRows([{ y: '4', x: '3' }]);
+      writer.close();
+      checkRows(check, 'later objects use the first object\'s columns', csv.parseFile(file),
+                [{ x: '1', y: '2' }, { x: '3', y: '4' }]);
+    } finally {
+      if (fs.existsSync(file)) fs.unlinkSync(file);
+    }
+  });
+}
+
+/**
+ * select/where pushed into the parser against the same projection and
+ * filtering done in JS on the full result
+ */
+function csvPushdownChecks() {
+  if (!addons.csvParser) {
+    log('CSV Parser addon not available', 'error');
+    return;
+  }
+
+  var fs = require('fs');
+  var csv = addons.csvParser;
+  var file = tempPath('pushdown.csv');
+
+  runChecks('CSV pushdown', 'csv-output', function(check) {
+    var text = 'id,city,price,note\n';
+    var cities = ['Oslo', 'Rome', 'Lima', 'Kyiv'];
+    for (var i = 0; i < 3000; i++) {
+      text += i + ',' + cities[i % 4] + ',' + (i % 50) + '.5,"n, ' + i + '"\n';
+    }
+    var all = csv.parse(text);
+
+    function expect(filter, keys) {
+      return all.filter(filter).map(function(row) {
+        var out = {};
+        keys.forEach(function(key) { out[key] = row[key]; });
+        return out;
+      });
+    }
+
+    checkRows(check, 'select by name, in the given order',
+              csv.parse(text, { select: ['price', 'id'] }),
+              expect(function() { return true; }, ['price', 'id']));
+
+    checkRows(check, 'select by index',
+              csv.parse(text, { select: [3, 1] }),
+              expect(function() { return true; }, ['note', 'city']));
+
+    checkRows(check, 'where string equals',
+              csv.parse(text, { where: { city: 'Rome' } }),
+              expect(function(row) { return row.city === 'Rome'; }, ['id', 'city', 'price', 'note']));
+
+    checkRows(check, 'where in set, with select',
+              csv.parse(text, { select: ['id'], where: { city: ['Lima', 'Kyiv'] } }),
+              expect(function(row) { return row.city === 'Lima' || row.city === 'Kyiv'; }, ['id']));
+
+    checkRows(check, 'where numeric range on a column not selected',
+              csv.parse(text, { select: ['id'], where: { price: { min: 10, max: 12.5 } } }),
+              expect(function(row) { return +row.price >= 10 && +row.price <= 12.5; }, ['id']));
+
+    checkRows(check, 'where number equals compares numerically',
+              csv.parse('a\n5.0\n5\n05\nx\n', { where: { a: 5 } }),
+              [{ a: '5.0' }, { a: '5' }, { a: '05' }]);
+
+    checkRows(check, 'conditions on several columns must all match',
+              csv.parse(text, { where: { city: 'Oslo', price: { max: 4 } } }),
+              expect(function(row) { return row.city === 'Oslo' && +row.price <= 4; }, ['id', 'city', 'price', 'note']));
+
+    checkRows(check, 'a name missing from the header selects empty fields',
+              csv.parse('a,b\n1,2\n', { select: ['b', 'nope'] }),
+              [{ b: '2', nope: '' }]);
+
+    checkRows(check, 'where on a missing column drops every row',
+              csv.parse(text, { where: { nope: 'x' } }), []);
+
+    checkRows(check, 'select by position without headers',
+              csv.parse('a,b,c\n1,2,3\n', { headers: false, select: ['2', 0] }),
+              [['c', 'a'], ['3', '1']]);
+
+    fs.writeFileSync(file, text);
+    try {
+      var options = { select: ['city', 'id'], where: { price: { min: 40 } } };
+      var expected = csv.parse(text, options);
+      checkRows(check, 'parseFile applies select and where', csv.parseFile(file, options), expected);
+
+      var reader = csv.createReader(file, options);
+      var rows = [];
+      var batch;
+      while ((batch = reader.next(100)) !== null) {
+        rows = rows.concat(batch);
+      }
+      reader.close();
+      checkRows(check, 'createReader applies select and where', rows, expected);
+
+      var table = csv.parseFileColumns(file, { select: ['price', 'nope'], where: { city: 'Oslo' } });
+      check('parseFileColumns keeps selected names',
+            table.rowCount === 750 && table.columns[0].name === 'price' && table.columns[1].name === 'nope',
+            table.rowCount + ' rows, ' + table.columns.map(function(c) { return c.name; }).join(','));
+    } finally {
+      fs.unlinkSync(file);
+    }
+  });
+}
+
+/**
+ * Throughput of the parse paths over generated corpora; every path must
+ * return the same row count
+ */
+function csvBenchmark() {
+  if (!addons.csvParser) {
+    log('CSV Parser addon not available', 'error');
+    return;
+  }
+
+  var csv = addons.csvParser;
+  var seed = 42;
+  function random(n) {
+    seed = (seed * 1103515245 + 12345) % 2147483648;
+    return seed % n;
+  }
+
+  // About size bytes of rows from makeRow()
+  function corpus(size, makeRow) {
+    var parts = [];
+    var length = 0;
+    for (var i = 0; length < size; i++) {
+      var row = makeRow(i);
+      parts.push(row);
+      length += row.length;
+    }
+    return { text: parts.join(''), rows: i };
+  }
+
+  var corpora = [
+    { name: 'narrow', data: corpus(8 * 1024 * 1024, function(i) {
+      return i + ',' + random(100000) + ',' + (random(10000) / 100) + '\n';
+    }) },
+    { name: 'wide', data: corpus(8 * 1024 * 1024, function(i) {
+      var fields = [];
+      for (var j = 0; j < 20; j++) fields.push('w' + random(1000000));
+      return fields.join(',') + '\r\n';
+    }) },
+    { name: 'quoted', data: corpus(8 * 1024 * 1024, function(i) {
+      return '"' + i + '","a ""quoted"" value, ' + random(1000) + '","line\nbreak"\n';
+    }) }
+  ];
+
+  var paths = [
+    { name: 'parse', run: function(text) { return csv.parse(text, { headers: false }).length; } },
+    { name: 'parse threads', run: function(text) { return csv.parse(text, { headers: false, threads: 0 }).length; } },
+    { name: 'parseColumns', run: function(text) { return csv.parseColumns(text, { headers: false }).rowCount; } },
+    { name: 'parse + select', run: function(text) { return csv.parse(text, { headers: false, select: [0] }).length; } }
+  ];
+
+  try {
+    var lines = [];
+    var mismatches = 0;
+
+    corpora.forEach(function(c) {
+      var mb = c.data.text.length / (1024 * 1024);
+      lines.push(c.name + ' (' + mb.toFixed(1) + ' MB, ' + c.data.rows + ' rows):');
+
+      paths.forEach(function(p) {
+        var start = Date.now();
+        var rows = p.run(c.data.text);
+        var elapsed = Math.max(Date.now() - start, 1);
+        if (rows !== c.data.rows) mismatches++;
+        lines.push('  ' + p.name + ': ' + elapsed + 'ms, ' + (mb / elapsed * 1000).toFixed(1) + ' MB/s' +
+                   (rows !== c.data.rows ? ' (got ' + rows + ' rows)' : ''));
+      });
+
+      var data = csv.parse(c.data.text, { headers: false });
+      var start = Date.now();
+      var text = csv.stringify(data, { headers: false });
+      var elapsed = Math.max(Date.now() - start, 1);
+      lines.push('  stringify: ' + elapsed + 'ms, ' + (text.length / (1024 * 1024) / elapsed * 1000).toFixed(1) + ' MB/s');
+    });
+
+    lines.push('');
+    lines.push('Verified row counts: ' + (mismatches ? mismatches + ' mismatch(es)' : 'all match'));
+
+    log('CSV benchmark: ' + (mismatches ? mismatches + ' row count mismatch(es)' : 'done'), mismatches ? 'error' : 'success');
+    setOutput('csv-output', lines.join('\n'));
+  } catch (err) {
+    log('CSV benchmark failed: ' + err.message, 'error');
+    setOutput('csv-output', 'Error: ' + err.message);
+  }
+}
+
+// Copy of defaults with the keys of extra added
+function mergeInto(defaults, extra) {
+  var result = {};
+  var key;
+  for (key in defaults) result[key] = defaults[key];
+  for (key in extra) result[key] = extra[key];
+  return result;
+}
+
 function csvRoundTrip() {
   if (!addons.csvParser) {
     log('CSV Parser addon not available', 'error');
@@ -720,6 +1487,53 @@ function rssParse() {
   }
 }
 
+/**
+ * parseFile() over mapped files against parse() of the same XML
+ */
+function rssFileChecks() {
+  if (!addons.rssParser) {
+    log('RSS Parser addon not available', 'error');
+    return;
+  }
+
+  var fs = require('fs');
+  var file = tempPath('feed.xml');
+
+  runChecks('RSS files', 'rss-output', function(check) {
+    try {
+      var xml = document.getElementById('rss-input').value;
+      fs.writeFileSync(file, xml);
+      check('sample feed matches parse()',
+            JSON.stringify(addons.rssParser.parseFile(file)) === JSON.stringify(addons.rssParser.parse(xml)));
+
+      // Pad the feed with items until it ends exactly on a 4 KB page
+      var items = '';
+      for (var i = 0; items.length < 8000; i++) {
+        items += '<item><title>Item ' + i + '</title><link>http://example.com/' + i + '</link></item>';
+      }
+      var head = '<rss version="2.0"><channel><title>Big</title>';
+      var tail = '</channel></rss>';
+      var padding = 3 * 4096 - head.length - items.length - tail.length;
+      xml = head + items + new Array(padding + 1).join(' ') + tail;
+      fs.writeFileSync(file, xml);
+      var feed = addons.rssParser.parseFile(file);
+      check('page-sized feed matches parse()', fs.statSync(file).size === 3 * 4096 &&
+            JSON.stringify(feed) === JSON.stringify(addons.rssParser.parse(xml)), feed.items.length + ' items');
+      check('page-sized feed keeps every item', feed.items.length === i, feed.items.length + ' of ' + i);
+
+      var threw = false;
+      try {
+        addons.rssParser.parseFile(tempPath('missing.xml'));
+      } catch (err) {
+        threw = true;
+      }
+      check('missing file throws', threw);
+    } finally {
+      fs.unlinkSync(file);
+    }
+  });
+}
+
 // ============================================
 // SQLite3 Tests
 // ============================================
@@ -884,6 +1698,1484 @@ function sqlite3Benchmark() {
   }
 }
 
+/**
+ * Statement cache: hits and misses, reuse after finalize() with state
+ * cleared, re-preparing after a schema change, capacity changes
+ */
+function sqlite3CacheChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  runChecks('SQLite3 statement cache', 'sqlite3-output', function(check) {
+    var db = new addons.sqlite3(':memory:');
+    try {
+      db.exec('CREATE TABLE t (a, b)');
+      var before = db.cacheStats();
+
+      var first = db.prepare('SELECT ? AS v');
+      var second = db.prepare('SELECT ? AS v');
+      var stats = db.cacheStats();
+      check('a statement in use is not handed out twice', stats.misses === before.misses + 2 && stats.hits === before.hits,
+            JSON.stringify(stats));
+
+      check('first statement binds', first.get(5).v === 5);
+      first.finalize();
+      second.finalize();
+      var reused = db.prepare('SELECT ? AS v');
+      check('finalize() returns the statement to the cache', db.cacheStats().hits === before.hits + 1,
+            JSON.stringify(db.cacheStats()));
+      check('a reused statement starts with cleared bindings', reused.get().v === null);
+      reused.finalize();
+
+      db.exec('INSERT INTO t VALUES (1, 2), (3, 4), (5, 6)');
+      var stmt = db.prepare('SELECT a FROM t ORDER BY a');
+      var iter = stmt.batchSize(1).iterate();
+      iter.next();
+      stmt.finalize();
+      stats = db.cacheStats();
+      checkRows(check, 'a statement finalized mid-iteration is reset before reuse',
+                db.prepare('SELECT a FROM t ORDER BY a').all(), [{ a: 1 }, { a: 3 }, { a: 5 }]);
+      check('that query was served from the cache', db.cacheStats().hits === stats.hits + 1, JSON.stringify(db.cacheStats()));
+
+      stats = db.cacheStats();
+      db.query('INSERT INTO t VALUES (?, ?)', 7, 8);
+      db.query('INSERT INTO t VALUES (?, ?)', 9, 10);
+      check('query() goes through the cache', db.cacheStats().hits === stats.hits + 1, JSON.stringify(db.cacheStats()));
+
+      db.query('SELECT * FROM t WHERE a = 1');
+      db.exec('ALTER TABLE t ADD COLUMN c');
+      var rows = db.query('SELECT * FROM t WHERE a = 1');
+      check('a cached SELECT * sees a column added later', JSON.stringify(rows) === '[{"a":1,"b":2,"c":null}]',
+            JSON.stringify(rows));
+
+      db.setCacheSize(1);
+      stats = db.cacheStats();
+      check('shrinking evicts down to the new capacity', stats.capacity === 1 && stats.size <= 1, JSON.stringify(stats));
+
+      db.setCacheSize(0);
+      stats = db.cacheStats();
+      db.query('SELECT 1');
+      db.query('SELECT 1');
+      check('capacity 0 disables the cache', db.cacheStats().hits === stats.hits && db.cacheStats().size === 0,
+            JSON.stringify(db.cacheStats()));
+
+      var threw = false;
+      try {
+        first.all();
+      } catch (err) {
+        threw = true;
+      }
+      check('a finalized Statement throws', threw);
+    } finally {
+      db.close();
+    }
+  });
+}
+
+/**
+ * Row objects built from cached column keys: duplicate and expression
+ * names, wide rows, and keys following schema changes on one Statement
+ */
+function sqlite3RowChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  runChecks('SQLite3 row objects', 'sqlite3-output', function(check) {
+    var db = new addons.sqlite3(':memory:');
+    try {
+      db.exec('CREATE TABLE t (a, b); INSERT INTO t VALUES (1, 2), (3, 4)');
+
+      checkRows(check, 'a duplicate column name keeps the last value',
+                db.prepare('SELECT a, b AS a FROM t ORDER BY rowid').all(), [{ a: 2 }, { a: 4 }]);
+
+      checkRows(check, 'expressions are named by their text',
+                db.prepare('SELECT a + b, upper(\'x\') FROM t LIMIT 1').all(), [{ 'a + b': 3, "upper('x')": 'X' }]);
+
+      var row = db.prepare('SELECT 1 AS i, 1.5 AS f, \'s\' AS s, NULL AS n, x\'0102\' AS b').get();
+      check('value types', row.i === 1 && row.f === 1.5 && row.s === 's' && row.n === null &&
+            Buffer.isBuffer(row.b) && row.b.length === 2 && row.b[1] === 2, JSON.stringify(row));
+
+      var columns = [];
+      for (var i = 0; i < 40; i++) columns.push(i + ' AS c' + i);
+      row = db.prepare('SELECT ' + columns.join(', ')).get();
+      check('40 columns', Object.keys(row).length === 40 && row.c0 === 0 && row.c39 === 39, Object.keys(row).length);
+
+      var stmt = db.prepare('SELECT * FROM t ORDER BY rowid');
+      var first = stmt.all();
+      check('get() returns the first row of all()', JSON.stringify(stmt.get()) === JSON.stringify(first[0]));
+      var iterated = [];
+      var iter = stmt.iterate();
+      for (var step = iter.next(); !step.done; step = iter.next()) iterated.push(step.value);
+      checkRows(check, 'iterate() builds the same rows', iterated, first);
+
+      db.exec('ALTER TABLE t ADD COLUMN c DEFAULT 9');
+      checkRows(check, 'keys follow a column added after prepare', stmt.all(), [{ a: 1, b: 2, c: 9 }, { a: 3, b: 4, c: 9 }]);
+
+      db.exec('ALTER TABLE t RENAME COLUMN a TO z');
+      checkRows(check, 'keys follow a column renamed after prepare', stmt.all(), [{ z: 1, b: 2, c: 9 }, { z: 3, b: 4, c: 9 }]);
+    } finally {
+      db.close();
+    }
+  });
+}
+
+/**
+ * raw() arrays and columns() result sets against the row objects of the
+ * same query
+ */
+function sqlite3ResultModeChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  // Bit for row in a columns() null bitmap
+  function isNull(column, row) {
+    return (column.nulls[row >> 3] & (1 << (row & 7))) !== 0;
+  }
+
+  runChecks('SQLite3 result modes', 'sqlite3-output', function(check) {
+    var db = new addons.sqlite3(':memory:');
+    try {
+      db.exec('CREATE TABLE t (i INTEGER, f REAL, s TEXT, n, b BLOB)');
+      var insert = db.prepare('INSERT INTO t VALUES (?, ?, ?, ?, ?)');
+      for (var r = 0; r < 20; r++) {
+        insert.run(r, r + 0.5, 's' + r, r % 3 ? r : null, r % 4 ? null : new Buffer([r]));
+      }
+
+      var stmt = db.prepare('SELECT * FROM t ORDER BY i');
+      var objects = stmt.all();
+      var names = ['i', 'f', 's', 'n', 'b'];
+
+      var raw = stmt.raw().all();
+      checkRows(check, 'raw() rows hold the object values in column order', raw, objects.map(function(row) {
+        return names.map(function(name) { return row[name]; });
+      }));
+      check('raw() applies to get()', Array.isArray(stmt.get()) && stmt.get()[2] === 's0');
+      check('raw(false) restores objects', stmt.raw(false).get().s === 's0');
+
+      var result = stmt.columns().all();
+      var byName = {};
+      result.columns.forEach(function(column) { byName[column.name] = column; });
+      check('rowCount and column order', result.rowCount === 20 &&
+            result.columns.map(function(c) { return c.name; }).join() === names.join(), result.rowCount);
+
+      var ok = true;
+      objects.forEach(function(row, index) {
+        names.forEach(function(name) {
+          var column = byName[name];
+          var value = column.values[index];
+          if (isNull(column, index) !== (row[name] === null)) ok = false;
+          if (row[name] === null) {
+            if (column.values instanceof Float64Array ? !isNaN(value) : value !== null) ok = false;
+          } else if (Buffer.isBuffer(row[name])) {
+            if (!Buffer.isBuffer(value) || value[0] !== row[name][0]) ok = false;
+          } else if (value !== row[name]) {
+            ok = false;
+          }
+        });
+      });
+      check('every cell and null bit matches the row objects', ok);
+
+      check('numeric columns are Float64Array',
+            byName.i.type === 'integer' && byName.f.type === 'real' && byName.n.type === 'integer' &&
+            byName.i.values instanceof Float64Array && byName.n.values instanceof Float64Array,
+            byName.i.type + ',' + byName.f.type + ',' + byName.n.type);
+      check('text and blob columns are Arrays', byName.s.type === 'text' && byName.b.type === 'blob' &&
+            Array.isArray(byName.s.values) && Array.isArray(byName.b.values));
+
+      result = db.prepare('SELECT 1 AS v UNION ALL SELECT \'x\'').columns().all();
+      check('a mixed column is text with values as they are',
+            result.columns[0].type === 'text' && result.columns[0].values[0] === 1 && result.columns[0].values[1] === 'x',
+            JSON.stringify(result.columns[0]));
+
+      result = db.prepare('SELECT NULL AS v').columns().all();
+      check('an all-NULL column is type null', result.columns[0].type === 'null' && isNaN(result.columns[0].values[0]),
+            result.columns[0].type);
+
+      result = db.prepare('SELECT * FROM t WHERE 0').columns().all();
+      check('an empty result keeps its columns', result.rowCount === 0 && result.columns.length === 5, result.rowCount);
+
+      var threw = false;
+      try {
+        db.prepare('INSERT INTO t (i) VALUES (1)').raw();
+      } catch (err) {
+        threw = true;
+      }
+      check('raw() rejects a statement without result columns', threw);
+    } finally {
+      db.close();
+    }
+  });
+}
+
+/**
+ * iterate() against all() for several batch sizes, early return, raw
+ * rows, re-execution during iteration and the columns() rejection
+ */
+function sqlite3IterateChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  function drain(iter) {
+    var rows = [];
+    for (var step = iter.next(); !step.done; step = iter.next()) rows.push(step.value);
+    return rows;
+  }
+
+  runChecks('SQLite3 iterate', 'sqlite3-output', function(check) {
+    var db = new addons.sqlite3(':memory:');
+    try {
+      db.exec('CREATE TABLE t (a INTEGER, b TEXT)');
+      var insert = db.prepare('INSERT INTO t VALUES (?, ?)');
+      db.transaction(function() {
+        for (var i = 1; i <= 2500; i++) insert.run(i, 'b' + i);
+      })();
+
+      var stmt = db.prepare('SELECT * FROM t WHERE a > ? ORDER BY a');
+      var expected = stmt.all(10);
+
+      [1, 7, 1000, 5000].forEach(function(size) {
+        checkRows(check, 'batchSize ' + size + ' yields every row of all()', drain(stmt.batchSize(size).iterate(10)), expected);
+      });
+      checkRows(check, 'default batch size', drain(db.prepare('SELECT * FROM t WHERE a > ? ORDER BY a').iterate(10)), expected);
+      checkRows(check, 'no rows', drain(stmt.iterate(99999)), []);
+
+      var iter = stmt.batchSize(4).iterate(10);
+      var first = iter.next();
+      var done = iter.return();
+      check('return() ends the iteration', first.value.a === 11 && done.done === true && iter.next().done === true);
+      checkRows(check, 'the statement runs again after return()', stmt.all(2497), [{ a: 2498, b: 'b2498' }, { a: 2499, b: 'b2499' }, { a: 2500, b: 'b2500' }]);
+
+      checkRows(check, 'raw() rows', drain(stmt.raw().batchSize(2).iterate(2497)), [[2498, 'b2498'], [2499, 'b2499'], [2500, 'b2500']]);
+      stmt.raw(false);
+
+      if (typeof Symbol === 'function' && Symbol.iterator) {
+        iter = stmt.iterate(10);
+        check('the iterator is iterable', iter[Symbol.iterator]() === iter);
+        iter.return();
+      }
+
+      iter = stmt.batchSize(2).iterate(10);
+      iter.next();
+      stmt.get(1);
+      var threw = false;
+      try {
+        drain(iter);
+      } catch (err) {
+        threw = /executed again/.test(err.message);
+      }
+      check('running the statement again makes the iterator throw', threw);
+
+      threw = false;
+      try {
+        stmt.columns().iterate(10);
+      } catch (err) {
+        threw = err instanceof TypeError;
+      }
+      stmt.columns(false);
+      check('iterate() rejects columns() mode with a TypeError', threw);
+
+      threw = false;
+      try {
+        stmt.batchSize(0);
+      } catch (err) {
+        threw = true;
+      }
+      check('batchSize(0) throws', threw);
+    } finally {
+      db.close();
+    }
+  });
+}
+
+/**
+ * runBatch() and runColumns(): results against row-by-row run(), typed
+ * array binding, and all-or-nothing rollback inside and outside an open
+ * transaction
+ */
+function sqlite3BulkChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  runChecks('SQLite3 bulk insert', 'sqlite3-output', function(check) {
+    var db = new addons.sqlite3(':memory:');
+    try {
+      db.exec('CREATE TABLE p (id INTEGER PRIMARY KEY, x REAL, y INTEGER, s TEXT UNIQUE)');
+      var insert = db.prepare('INSERT INTO p (x, y, s) VALUES (?, ?, ?)');
+      var named = db.prepare('INSERT INTO p (x, y, s) VALUES (:x, :y, :s)');
+      var count = db.prepare('SELECT count(*) AS n FROM p');
+      var select = db.prepare('SELECT x, y, s FROM p ORDER BY id');
+
+      var rows = [];
+      for (var i = 0; i < 1000; i++) rows.push([i + 0.5, i, 'r' + i]);
+      var result = insert.runBatch(rows);
+      check('runBatch reports rows, changes and the last rowid',
+            result.rows === 1000 && result.changes === 1000 && result.lastInsertRowid === 1000, JSON.stringify(result));
+      checkRows(check, 'runBatch stores what run() would', select.raw().all(), rows);
+      select.raw(false);
+
+      result = named.runBatch([{ x: 1, y: 2, s: 'obj1' }, { x: 3, y: 4, s: 'obj2' }]);
+      check('runBatch takes named parameter objects', result.rows === 2 && count.get().n === 1002, JSON.stringify(result));
+
+      var threw = null;
+      try {
+        insert.runBatch([[1, 1, 'new1'], [1, 1, 'r5'], [1, 1, 'new2']]);
+      } catch (err) {
+        threw = err.message;
+      }
+      check('a failing row names itself', /^Row 1: UNIQUE/.test(threw), threw);
+      check('a failing batch is rolled back whole', count.get().n === 1002 && !db.inTransaction, count.get().n);
+
+      db.exec('BEGIN');
+      insert.run(0, 0, 'outer');
+      try {
+        insert.runBatch([[1, 1, 'inner'], [1, 1, 'outer']]);
+      } catch (err) {
+        // expected
+      }
+      check('inside a transaction only the batch is rolled back',
+            db.inTransaction && db.prepare('SELECT count(*) AS n FROM p WHERE s IN (\'outer\', \'inner\')').get().n === 1);
+      db.exec('ROLLBACK');
+
+      db.exec('DELETE FROM p');
+      var xs = new Float64Array([1.25, NaN, 3]);
+      var ys = new Int32Array([-1, 2, 2147483647]);
+      result = named.runColumns({ x: xs, y: ys, s: ['a', null, 'c'] });
+      checkRows(check, 'runColumns binds typed arrays and NaN as NULL', select.all(),
+                [{ x: 1.25, y: -1, s: 'a' }, { x: null, y: 2, s: null }, { x: 3, y: 2147483647, s: 'c' }]);
+      check('runColumns result', result.rows === 3 && result.changes === 3, JSON.stringify(result));
+
+      db.exec('DELETE FROM p');
+      insert.runColumns([new Float32Array([0.5, NaN]), new Uint8Array([200, 7]), ['u', 'v']]);
+      checkRows(check, 'positional columns, Float32Array and Uint8Array', select.all(),
+                [{ x: 0.5, y: 200, s: 'u' }, { x: null, y: 7, s: 'v' }]);
+
+      threw = null;
+      try {
+        insert.runColumns([new Float64Array(2), [1], ['a', 'b']]);
+      } catch (err) {
+        threw = err.message;
+      }
+      check('columns of different lengths throw', /same length/.test(threw), threw);
+
+      result = insert.runBatch([]);
+      check('an empty batch does nothing', result.rows === 0 && result.changes === 0, JSON.stringify(result));
+    } finally {
+      db.close();
+    }
+  });
+}
+
+/**
+ * db.transaction(): commit and rollback, savepoint nesting in both
+ * directions, arguments and return value, and the begin modes
+ */
+function sqlite3TransactionChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  // Error message of fn(), or null if it returns
+  function attempt(fn) {
+    try {
+      fn();
+      return null;
+    } catch (err) {
+      return err.message;
+    }
+  }
+
+  runChecks('SQLite3 transactions', 'sqlite3-output', function(check) {
+    var db = new addons.sqlite3(':memory:');
+    var values = function() {
+      return db.prepare('SELECT a FROM t ORDER BY a').raw().all().map(function(row) { return row[0]; }).join();
+    };
+
+    try {
+      db.exec('CREATE TABLE t (a UNIQUE)');
+      var insert = db.prepare('INSERT INTO t VALUES (?)');
+
+      var seen = null;
+      var add = db.transaction(function(x, y) {
+        seen = db.inTransaction;
+        insert.run(x);
+        insert.run(y);
+        return x + y;
+      });
+      check('arguments in, return value out, committed', add(1, 2) === 3 && seen === true && !db.inTransaction &&
+            values() === '1,2', values());
+
+      var error = attempt(function() { add(3, 1); });
+      check('a throw rolls back and rethrows', /UNIQUE/.test(error) && !db.inTransaction && values() === '1,2', error);
+
+      var inner = db.transaction(function(x) {
+        insert.run(x);
+        if (x > 100) throw new Error('inner failed');
+      });
+      var outer = db.transaction(function() {
+        insert.run(10);
+        var innerError = attempt(function() { inner(200); });
+        inner(20);
+        insert.run(11);
+        return innerError;
+      });
+      check('a failed nested call rolls back only its savepoint', outer() === 'inner failed' && values() === '1,2,10,11,20',
+            values());
+
+      error = attempt(db.transaction(function() {
+        inner(30);
+        throw new Error('outer failed');
+      }));
+      check('a failed outer call also undoes nested calls that succeeded', error === 'outer failed' &&
+            values() === '1,2,10,11,20', values());
+
+      var depth = 0;
+      var nest = db.transaction(function(n) {
+        depth = Math.max(depth, n);
+        insert.run(1000 + n);
+        if (n < 5) nest(n + 1);
+      });
+      nest(1);
+      check('five levels of nesting commit together', depth === 5 &&
+            db.prepare('SELECT count(*) AS n FROM t WHERE a > 1000').get().n === 5);
+
+      ['deferred', 'immediate', 'exclusive'].forEach(function(mode) {
+        var inside = db.transaction(function() { return db.inTransaction; })[mode]();
+        check(mode + ' mode runs in a transaction', inside === true && !db.inTransaction);
+      });
+
+      check('a non-function throws', attempt(function() { db.transaction(null); }) !== null);
+    } finally {
+      db.close();
+    }
+  });
+}
+
+// Delete a scratch database file with its journal files
+function removeDatabase(file) {
+  var fs = require('fs');
+  ['', '-wal', '-shm', '-journal'].forEach(function(suffix) {
+    if (fs.existsSync(file + suffix)) fs.unlinkSync(file + suffix);
+  });
+}
+
+/**
+ * Incremental blob I/O: chunked writes and reads against the stored
+ * value, range and mode errors, reopen(), and BLOB/TEXT values from
+ * async queries against the sync ones
+ */
+function sqlite3BlobChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  var file = tempPath('blob.db');
+  removeDatabase(file);
+  var db = new addons.sqlite3(file);
+
+  function throwsMessage(fn) {
+    try {
+      fn();
+    } catch (err) {
+      return err.message;
+    }
+    return null;
+  }
+
+  runChecks('SQLite3 blobs', 'sqlite3-output', function(check) {
+    var SIZE = 200000;
+    db.exec('CREATE TABLE f (id INTEGER PRIMARY KEY, data BLOB, note TEXT)');
+    db.prepare('INSERT INTO f (data, note) VALUES (zeroblob(?), ?)').run(SIZE, 'caf\u00e9 ' + new Array(5000).join('x'));
+    db.prepare('INSERT INTO f (data, note) VALUES (?, ?)').run(new Buffer([1, 2, 3]), 'small');
+
+    var blob = db.openBlob('f', 'data', 1, { writable: true });
+    check('size of a zeroblob', blob.size === SIZE && blob.open, blob.size);
+
+    var chunk = new Buffer(64 * 1024);
+    for (var offset = 0; offset < SIZE; offset += chunk.length) {
+      var length = Math.min(chunk.length, SIZE - offset);
+      for (var i = 0; i < length; i++) chunk[i] = (offset + i) % 251;
+      blob.write(length === chunk.length ? chunk : chunk.slice(0, length), offset);
+    }
+
+    var stored = db.prepare('SELECT data FROM f WHERE id = 1').get().data;
+    var ok = stored.length === SIZE;
+    for (i = 0; ok && i < SIZE; i++) ok = stored[i] === i % 251;
+    check('chunked writes land in the stored value', ok);
+
+    var read = blob.read(65530, 10);
+    check('read() at an offset', read.length === 10 && read[0] === 65530 % 251 && read[9] === 65539 % 251);
+
+    var into = new Buffer(64 * 1024);
+    var total = 0;
+    var n;
+    ok = true;
+    for (offset = 0; (n = blob.readInto(into, offset)) > 0; offset += n) {
+      for (i = 0; i < n; i++) ok = ok && into[i] === (offset + i) % 251;
+      total += n;
+    }
+    check('readInto() streams the whole blob', ok && total === SIZE, total);
+
+    check('a write past the end throws', /outside/.test(throwsMessage(function() { blob.write(new Buffer(10), SIZE - 5); })));
+    check('a read past the end throws', /outside/.test(throwsMessage(function() { blob.read(SIZE - 1, 5); })));
+
+    blob.reopen(2);
+    check('reopen() moves to another row', blob.size === 3 && blob.read()[2] === 3, blob.size);
+    blob.close();
+    check('close() clears the handle', blob.open === false && blob.size === null);
+
+    var readOnly = db.openBlob('f', 'data', 1);
+    check('a read-only handle rejects writes', /read-only/.test(throwsMessage(function() { readOnly.write(new Buffer(1)); })));
+    check('a missing row throws', /no such rowid/.test(throwsMessage(function() { db.openBlob('f', 'data', 99); })));
+
+    var sync = db.prepare('SELECT data, note FROM f ORDER BY id').all();
+    return db.prepare('SELECT data, note FROM f ORDER BY id').allAsync().then(function(rows) {
+      check('async BLOBs are Buffers equal to the sync ones', rows.length === 2 && Buffer.isBuffer(rows[0].data) &&
+            rows[0].data.toString('hex') === sync[0].data.toString('hex') &&
+            rows[1].data.toString('hex') === '010203');
+      check('async TEXT equals the sync text', rows[0].note === sync[0].note && rows[1].note === 'small');
+
+      rows[0].data[0] = 99;
+      check('changing an async Buffer leaves the database alone',
+            db.prepare('SELECT data FROM f WHERE id = 1').get().data[0] === 0);
+
+      db.close();
+      check('Database#close() closes open handles', readOnly.open === false);
+      removeDatabase(file);
+    }, function(err) {
+      db.close();
+      removeDatabase(file);
+      throw err;
+    });
+  });
+}
+
+/**
+ * Open options: the performance preset and per-pragma overrides, WAL
+ * readers alongside a writer, checkpoints and option errors
+ */
+function sqlite3PragmaChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  var file = tempPath('wal.db');
+  removeDatabase(file);
+
+  function attempt(fn) {
+    try {
+      fn();
+      return null;
+    } catch (err) {
+      return err.message;
+    }
+  }
+
+  runChecks('SQLite3 pragmas and WAL', 'sqlite3-output', function(check) {
+    var db = new addons.sqlite3(file, { preset: 'performance' });
+    var reader = null;
+    try {
+      var settings = {};
+      ['journal_mode', 'synchronous', 'cache_size', 'mmap_size', 'temp_store'].forEach(function(name) {
+        settings[name] = db.pragma(name, { simple: true });
+      });
+      check('performance preset', settings.journal_mode === 'wal' && settings.synchronous === 1 &&
+            settings.cache_size === -65536 && settings.mmap_size === 268435456 && settings.temp_store === 2,
+            JSON.stringify(settings));
+
+      db.exec('CREATE TABLE t (a); INSERT INTO t VALUES (1)');
+      reader = new addons.sqlite3(file, { readonly: true });
+      db.exec('BEGIN IMMEDIATE; INSERT INTO t VALUES (2)');
+      var during = attempt(function() { reader.prepare('SELECT count(*) AS n FROM t').get(); });
+      var seen = during === null ? reader.prepare('SELECT count(*) AS n FROM t').get().n : null;
+      check('a reader is not blocked by an open write transaction', during === null && seen === 1, during || seen);
+      db.exec('COMMIT');
+      check('the reader sees the commit', reader.prepare('SELECT count(*) AS n FROM t').get().n === 2);
+      reader.close();
+      reader = null;
+
+      var result = db.checkpoint();
+      check('checkpoint() reports WAL frames', result.logFrames > 0 && result.checkpointedFrames === result.logFrames,
+            JSON.stringify(result));
+      result = db.checkpoint('truncate');
+      check('a truncate checkpoint empties the WAL', result.logFrames === 0, JSON.stringify(result));
+
+      db.walAutocheckpoint(0);
+      check('walAutocheckpoint(0) turns automatic checkpoints off', db.pragma('wal_autocheckpoint', { simple: true }) === 0);
+      db.close();
+
+      db = new addons.sqlite3(file, { preset: 'performance', synchronous: 'full', walAutocheckpoint: 500 });
+      check('explicit options override the preset', db.pragma('synchronous', { simple: true }) === 2 &&
+            db.pragma('wal_autocheckpoint', { simple: true }) === 500);
+
+      var memory = new addons.sqlite3(':memory:', { journalMode: 'wal' });
+      check('in-memory databases keep the memory journal', memory.pragma('journal_mode', { simple: true }) === 'memory');
+      memory.close();
+
+      check('an unknown preset throws', /Unknown preset/.test(attempt(function() { new addons.sqlite3(':memory:', { preset: 'fast' }); })));
+      check('an unknown journal mode throws', /journal mode/.test(attempt(function() { new addons.sqlite3(':memory:', { journalMode: 'x' }); })));
+      check('an unknown checkpoint mode throws', /Checkpoint mode/.test(attempt(function() { db.checkpoint('x'); })));
+    } finally {
+      if (reader) reader.close();
+      db.close();
+      removeDatabase(file);
+    }
+  });
+}
+
+/**
+ * User-defined functions: JS scalars and aggregates, argument and result
+ * conversion, errors, the async stand-in, and C functions from tinycc
+ */
+function sqlite3FunctionChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  var file = tempPath('functions.db');
+  removeDatabase(file);
+  var db = new addons.sqlite3(file);
+  var compiler = null;
+
+  function attempt(fn) {
+    try {
+      fn();
+      return null;
+    } catch (err) {
+      return err.message;
+    }
+  }
+
+  function value(sql) {
+    return db.prepare(sql).raw().get()[0];
+  }
+
+  function cleanup() {
+    if (db.open) db.close();
+    if (compiler) compiler.release();
+    removeDatabase(file);
+  }
+
+  runChecks('SQLite3 functions', 'sqlite3-output', function(check) {
+    db.exec('CREATE TABLE t (g TEXT, a INTEGER)');
+    var insert = db.prepare('INSERT INTO t VALUES (?, ?)');
+    for (var i = 1; i <= 20; i++) {
+      insert.run(i % 2 ? 'odd' : 'even', i);
+    }
+
+    db.function('add2', function(a, b) { return a + b; });
+    check('a scalar function returns its result', value('SELECT add2(2, 3)') === 5);
+    checkRows(check, 'a scalar function runs for every row',
+              db.prepare('SELECT add2(a, 100) AS v FROM t WHERE a <= 3 ORDER BY a').all(),
+              [{ v: 101 }, { v: 102 }, { v: 103 }]);
+
+    db.function('types', function(a, b, c, d) {
+      return [typeof a, typeof b, Buffer.isBuffer(c) ? c.toString('hex') : typeof c, d === null].join(',');
+    });
+    var types = value("SELECT types(1.5, 'x', x'0102', NULL)");
+    check('arguments arrive as number, string, Buffer and null', types === 'number,string,0102,true', types);
+
+    db.function('echo', function(x) { return x; });
+    db.function('blob', function() { return new Buffer([1, 2, 3]); });
+    var row = db.prepare("SELECT echo(NULL) AS n, echo('s') AS s, typeof(blob()) AS kind, hex(blob()) AS hex").get();
+    check('results convert like bound parameters', row.n === null && row.s === 's' && row.kind === 'blob' &&
+          row.hex === '010203', JSON.stringify(row));
+
+    db.function('count_args', { varargs: true }, function() { return arguments.length; });
+    check('varargs accepts any number of arguments',
+          value('SELECT count_args()') === 0 && value('SELECT count_args(1, 2, 3)') === 3);
+    check('a wrong argument count is an SQL error',
+          /wrong number of arguments/.test(attempt(function() { value('SELECT add2(1)'); })));
+
+    db.function('boom', function() { throw new Error('boom from JS'); });
+    check('a thrown error fails the statement with its message',
+          /boom from JS/.test(attempt(function() { value('SELECT boom()'); })));
+
+    db.function('plain', function(x) { return x * 2; });
+    db.function('pure', { deterministic: true }, function(x) { return x * 2; });
+    check('non-deterministic functions are refused in indexes',
+          /non-deterministic/.test(attempt(function() { db.exec('CREATE INDEX t_plain ON t (plain(a))'); })));
+    check('deterministic functions can be indexed',
+          attempt(function() { db.exec('CREATE INDEX t_pure ON t (pure(a))'); }) === null);
+
+    db.aggregate('jsum', { start: 0, step: function(total, x) { return total + x; } });
+    check('an aggregate folds every row', value('SELECT jsum(a) FROM t') === value('SELECT sum(a) FROM t'));
+    check('an aggregate over no rows gives its start', value('SELECT jsum(a) FROM t WHERE 0') === 0);
+
+    db.aggregate('collect', {
+      start: function() { return []; },
+      step: function(list, x) { list.push(x); },
+      result: function(list) { return list.join('|'); }
+    });
+    checkRows(check, 'each group gets its own start and result',
+              db.prepare("SELECT g, collect(a) AS v FROM t WHERE a <= 4 GROUP BY g ORDER BY g").all(),
+              [{ g: 'even', v: '2|4' }, { g: 'odd', v: '1|3' }]);
+
+    db.aggregate('failing', { step: function(total, x) { throw new Error('step failed at ' + x); } });
+    var failed = attempt(function() { value('SELECT failing(a) FROM t'); });
+    check('a throwing step fails the statement', /step failed at 1/.test(failed), failed);
+
+    var asyncErrors = Promise.all([
+      db.queryAsync('SELECT add2(1, 2) AS v'),
+      db.queryAsync('SELECT jsum(a) AS v FROM t')
+    ].map(function(promise) {
+      return promise.then(function() { return null; }, function(err) { return err.message; });
+    }));
+
+    return asyncErrors.then(function(errors) {
+      check('async queries refuse JS functions by name',
+            errors[0] === 'add2() is a JS function and cannot run in async queries', errors[0]);
+      check('async queries refuse JS aggregates by name',
+            errors[1] === 'jsum() is a JS function and cannot run in async queries', errors[1]);
+
+      if (!addons.tinycc || !addons.tinycc.isAvailable()) {
+        log('TinyCC not available, native function checks skipped', 'info');
+        return null;
+      }
+
+      compiler = addons.tinycc.create();
+      var compiled = compiler.compile([
+        'double hyp2(double a, double b) { return a * a + b * b; }',
+        'long long twice(long long x) { return x * 2; }',
+        'int add3(int a, int b, int c) { return a + b + c; }'
+      ].join('\n'));
+      check('tinycc compiles the native functions', compiled, compiler.getError());
+      if (!compiled) return null;
+
+      var hyp2 = compiler.getSymbol('hyp2');
+      db.nativeFunction('hyp2', hyp2, { returns: 'double', args: ['double', 'double'], deterministic: true });
+      db.nativeFunction('twice', compiler.getSymbol('twice'), { returns: 'int64', args: ['int64'] });
+      db.nativeFunction('add3', compiler.getSymbol('add3'), { returns: 'int32', args: ['int32', 'int32', 'int32'] });
+
+      row = db.prepare('SELECT hyp2(3, 4) AS h, twice(4000000000) AS t, add3(1, 2, 3) AS s, hyp2(NULL, 1) AS n').get();
+      check('native functions run with their signatures', row.h === 25 && row.t === 8000000000 && row.s === 6 &&
+            row.n === null, JSON.stringify(row));
+      check('a native function runs for every row',
+            value('SELECT sum(add3(a, a, a)) FROM t') === 3 * value('SELECT sum(a) FROM t'));
+
+      check('an unknown return type throws', /Return type/.test(attempt(function() {
+        db.nativeFunction('bad', hyp2, { returns: 'float', args: ['double'] });
+      })));
+      check('mixed argument types throw', /same type/.test(attempt(function() {
+        db.nativeFunction('bad', hyp2, { args: ['double', 'int32'] });
+      })));
+      check('more than 4 arguments throws', /0 to 4/.test(attempt(function() {
+        db.nativeFunction('bad', hyp2, { args: ['double', 'double', 'double', 'double', 'double'] });
+      })));
+      check('a missing address throws', /function address/.test(attempt(function() {
+        db.nativeFunction('bad', compiler.getSymbol('missing'), {});
+      })));
+
+      return db.queryAsync('SELECT hyp2(a, 0) AS v FROM t WHERE a <= 2 ORDER BY a');
+    }).then(function(rows) {
+      if (rows) {
+        checkRows(check, 'native functions also run in async queries', rows, [{ v: 1 }, { v: 4 }]);
+      }
+      cleanup();
+    }, function(err) {
+      cleanup();
+      throw err;
+    });
+  });
+}
+
+/**
+ * Snapshots: stepwise backup to a file and to an open database, writes
+ * during a backup, the manual handle, and serialize/deserialize clones
+ */
+function sqlite3BackupChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  var source = tempPath('backup-source.db');
+  var copy = tempPath('backup-copy.db');
+  removeDatabase(source);
+  removeDatabase(copy);
+  var db = new addons.sqlite3(source);
+  var opened = [];
+
+  function open(path) {
+    var other = new addons.sqlite3(path || ':memory:');
+    opened.push(other);
+    return other;
+  }
+
+  function attempt(fn) {
+    try {
+      fn();
+      return null;
+    } catch (err) {
+      return err.message;
+    }
+  }
+
+  function rows(target) {
+    return target.prepare('SELECT id, hex(data) AS data FROM t ORDER BY id').all();
+  }
+
+  function cleanup() {
+    opened.concat([db]).forEach(function(other) {
+      if (other.open) other.close();
+    });
+    removeDatabase(source);
+    removeDatabase(copy);
+  }
+
+  runChecks('SQLite3 backup and serialize', 'sqlite3-output', function(check) {
+    db.exec('CREATE TABLE t (id INTEGER PRIMARY KEY, data BLOB)');
+    var insert = db.prepare('INSERT INTO t (data) VALUES (randomblob(?))');
+    db.transaction(function() {
+      for (var i = 0; i < 200; i++) {
+        insert.run(1000);
+      }
+    })();
+
+    var reports = [];
+    return db.backup(copy, {
+      pagesPerStep: 10,
+      progress: function(report) {
+        if (!reports.length) {
+          // Written through the source connection, so carried into the copy
+          db.prepare('INSERT INTO t (data) VALUES (x\'ff\')').run();
+        }
+        reports.push(report);
+      }
+    }).then(function(result) {
+      var pages = db.pragma('page_count', { simple: true });
+      check('backup() steps by pagesPerStep', reports.length >= Math.floor(pages / 10) - 1 &&
+            reports.every(function(report, index) {
+              return index === 0 || report.remainingPages < reports[index - 1].remainingPages;
+            }), reports.length + ' steps for ' + pages + ' pages');
+      check('backup() resolves with the page count', result.totalPages === pages, JSON.stringify(result));
+
+      var file = open(copy);
+      checkRows(check, 'the file copy matches the source, including writes made during it', rows(file), rows(db));
+      file.close();
+
+      var memory = open();
+      return db.backup(memory, { pagesPerStep: -1 }).then(function() {
+        checkRows(check, 'a backup into an open database', rows(memory), rows(db));
+      });
+    }).then(function() {
+      var target = open();
+      var handle = db.openBackup(target);
+      check('a new handle has not counted pages', handle.remaining === -1 && handle.pageCount === -1);
+      var first = handle.step(5);
+      check('a manual step copies part of the database', !first && handle.remaining === handle.pageCount - 5 &&
+            handle.open, handle.remaining + '/' + handle.pageCount);
+      check('step() without a count finishes and closes', handle.step() === true && !handle.open);
+
+      handle = db.openBackup(open());
+      handle.step(1);
+      opened[opened.length - 1].close();
+      check('closing the destination closes the handle', !handle.open);
+
+      check('an unknown schema throws', /unknown database/.test(attempt(function() {
+        db.openBackup(open(), { schema: 'nope' });
+      })));
+      return db.backup(open(), { schema: 'nope' }).then(function() { return null; }, function(err) {
+        return err.message;
+      });
+    }).then(function(error) {
+      check('backup() rejects on an unknown schema', /unknown database/.test(error), error);
+
+      var image = db.serialize();
+      check('serialize() returns the database file image', Buffer.isBuffer(image) &&
+            image.toString('binary', 0, 15) === 'SQLite format 3' &&
+            image.length === db.pragma('page_count', { simple: true }) * db.pragma('page_size', { simple: true }),
+            image.length);
+
+      var clone = open().deserialize(image);
+      checkRows(check, 'deserialize() loads the image', rows(clone), rows(db));
+      clone.exec('DELETE FROM t');
+      check('the clone is independent of the source', db.prepare('SELECT count(*) AS n FROM t').get().n === 201);
+
+      db.exec('CREATE TABLE m (v); INSERT INTO m VALUES (42)');
+      var memory = open();
+      memory.exec('CREATE TABLE m (v); INSERT INTO m VALUES (7)');
+      var second = open().deserialize(memory.serialize());
+      check('an in-memory database clones', second.prepare('SELECT v FROM m').get().v === 7);
+
+      var frozen = open().deserialize(image, { readonly: true });
+      check('a readonly image refuses writes', /readonly/.test(attempt(function() {
+        frozen.exec('DELETE FROM t');
+      })));
+
+      var reopened = open(source);
+      reopened.deserialize(memory.serialize());
+      reopened.exec('INSERT INTO m VALUES (8)');
+      check('deserialize() leaves the opened file alone', db.prepare('SELECT count(*) AS n FROM m').get().n === 1 &&
+            reopened.prepare('SELECT count(*) AS n FROM m').get().n === 2);
+
+      var garbage = open().deserialize(new Buffer('not a database'));
+      check('a bad image fails on first use', /not a database/.test(attempt(function() {
+        garbage.prepare('SELECT * FROM sqlite_master').all();
+      })));
+      cleanup();
+    }, function(err) {
+      cleanup();
+      throw err;
+    });
+  });
+}
+
+/**
+ * Profiling: Statement#stats counters and timing, explain() plans and
+ * bytecode, the profile() hook and query timeouts
+ */
+function sqlite3ProfileChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  function attempt(fn) {
+    try {
+      fn();
+      return null;
+    } catch (err) {
+      return err.message;
+    }
+  }
+
+  runChecks('SQLite3 profiling', 'sqlite3-output', function(check) {
+    var db = new addons.sqlite3(':memory:');
+    try {
+      db.exec('CREATE TABLE t (id INTEGER PRIMARY KEY, v INTEGER); CREATE INDEX t_v ON t (v)');
+      db.exec('CREATE TABLE u (x INTEGER)');
+      db.transaction(function() {
+        var insert = db.prepare('INSERT INTO t (v) VALUES (?)');
+        var other = db.prepare('INSERT INTO u VALUES (?)');
+        for (var i = 0; i < 100; i++) {
+          insert.run(i);
+          other.run(99 - i);
+        }
+      })();
+
+      var scan = db.prepare('SELECT x FROM u WHERE x % 2 = 0 ORDER BY x');
+      var stats = scan.stats();
+      check('a new statement has no executions', stats.executions === 0 && stats.rows === 0, JSON.stringify(stats));
+      scan.all();
+      scan.all();
+      stats = scan.stats();
+      check('executions and rows add up across runs', stats.executions === 2 && stats.rows === 100,
+            JSON.stringify(stats));
+      check('a table scan and sort are counted', stats.fullscanSteps > 0 && stats.sorts > 0 && stats.vmSteps > 0,
+            JSON.stringify(stats));
+      check('timing stays 0 while it is off', stats.totalTime === 0 && stats.maxStepTime === 0);
+
+      var join = db.prepare('SELECT count(*) AS n FROM u AS p JOIN u AS q ON p.x = q.x');
+      join.get();
+      check('an automatic index is counted', join.stats().autoindexes > 0, JSON.stringify(join.stats()));
+
+      db.setStatementTiming(true);
+      var slow = db.prepare('WITH RECURSIVE c(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM c WHERE n < 200000) ' +
+                            'SELECT count(*) AS n FROM c');
+      slow.get();
+      stats = slow.stats();
+      check('setStatementTiming() measures steps', stats.totalTime > 0 && stats.maxStepTime > 0 &&
+            stats.maxStepTime <= stats.totalTime, JSON.stringify(stats));
+      db.setStatementTiming(false);
+
+      var plan = db.prepare('SELECT * FROM t WHERE v = ?').explain();
+      check('explain() gives the query plan', plan.length === 1 && /SEARCH t USING (COVERING )?INDEX t_v/.test(plan[0].detail),
+            JSON.stringify(plan));
+      plan = scan.explain();
+      check('explain() shows a table scan', plan.some(function(step) { return /SCAN u/.test(step.detail); }),
+            JSON.stringify(plan));
+      var code = scan.explain(false);
+      check('explain(false) gives the bytecode', code.length > 1 && code[0].addr === 0 && code[0].opcode === 'Init',
+            JSON.stringify(code[0]));
+
+      var reports = [];
+      db.profile(function(sql, time) {
+        reports.push({ sql: sql, time: time });
+        db.prepare('SELECT 2').get();
+      });
+      db.exec('SELECT 1');
+      db.prepare('SELECT v FROM t WHERE id = ?').get(5);
+      db.prepare('SELECT * FROM t').all();
+      check('profile() reports each statement with its time', reports.length === 3 &&
+            reports[0].sql === 'SELECT 1' && reports[1].sql === 'SELECT v FROM t WHERE id = ?' &&
+            reports.every(function(report) { return typeof report.time === 'number' && report.time >= 0; }),
+            JSON.stringify(reports));
+
+      db.profile(null);
+      db.exec('SELECT 3');
+      check('profile(null) stops reporting', reports.length === 3);
+      check('profile() rejects a non-function', /Expected a function/.test(attempt(function() { db.profile(1); })));
+
+      var timeoutError = attempt(function() { db.setQueryTimeout(50); });
+      if (timeoutError) {
+        check('query timeouts name the build option they need', /NW_SQLITE3_PROGRESS/.test(timeoutError), timeoutError);
+      } else {
+        var endless = 'WITH RECURSIVE c(n) AS (SELECT 1 UNION ALL SELECT n + 1 FROM c WHERE n < 100000000) ' +
+                      'SELECT count(*) AS n FROM c';
+        var error = attempt(function() { db.prepare(endless).get(); });
+        check('a long query times out', /timed out/.test(error), error);
+        db.setQueryTimeout(0);
+        check('queries run again with the limit off', db.prepare('SELECT count(*) AS n FROM t').get().n === 100);
+      }
+    } finally {
+      db.close();
+    }
+  });
+}
+
+/**
+ * Named parameters: object binding for each prefix and entry point,
+ * reuse across runs, mixing with positional values, and the errors
+ */
+function sqlite3NamedParamChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  var file = tempPath('named.db');
+  removeDatabase(file);
+  var db = new addons.sqlite3(file);
+
+  function attempt(fn) {
+    try {
+      fn();
+      return null;
+    } catch (err) {
+      return err.message;
+    }
+  }
+
+  function cleanup() {
+    if (db.open) db.close();
+    removeDatabase(file);
+  }
+
+  runChecks('SQLite3 named parameters', 'sqlite3-output', function(check) {
+    db.exec('CREATE TABLE t (id INTEGER PRIMARY KEY, name TEXT, score REAL)');
+    var insert = db.prepare('INSERT INTO t VALUES (:id, @name, $score)');
+    insert.run({ id: 1, name: 'one', score: 1.5 });
+    insert.run({ id: 2, name: 'two', score: 2.5, unused: 'ignored' });
+    insert.run({ id: 3, name: 'three' });
+    checkRows(check, 'run() binds :, @ and $ names from one object, missing keys as NULL',
+              db.prepare('SELECT * FROM t ORDER BY id').all(),
+              [{ id: 1, name: 'one', score: 1.5 }, { id: 2, name: 'two', score: 2.5 },
+               { id: 3, name: 'three', score: null }]);
+
+    var byId = db.prepare('SELECT name FROM t WHERE id = :id');
+    var names = [1, 2, 3, 4].map(function(id) {
+      var row = byId.get({ id: id });
+      return row ? row.name : null;
+    });
+    checkRows(check, 'a reused statement binds each object afresh', names, ['one', 'two', 'three', null]);
+
+    checkRows(check, 'all() and iterate() take named parameters',
+              [db.prepare('SELECT id FROM t WHERE id BETWEEN :lo AND :hi').raw().all({ lo: 2, hi: 3 }),
+               Array.prototype.slice.call(db.prepare('SELECT id FROM t WHERE id >= :lo').raw().iterate({ lo: 3 }).next().value)],
+              [[[2], [3]], [3]]);
+
+    check('a repeated name binds every occurrence', db.prepare('SELECT :a + :a AS v').get({ a: 21 }).v === 42);
+
+    var mixed = db.prepare('SELECT ? AS p, :n AS n, ? AS q');
+    checkRows(check, 'other values fill the unnamed parameters in order',
+              [mixed.get(1, { n: 'x' }, 2), mixed.get({ n: 'y' }, 3), mixed.get({ n: 'z' })],
+              [{ p: 1, n: 'x', q: 2 }, { p: 3, n: 'y', q: null }, { p: null, n: 'z', q: null }]);
+
+    var blob = db.prepare('SELECT hex(?) AS h').get(new Buffer([0xab, 0xcd]));
+    check('a Buffer is a value, not an object of names', blob.h === 'ABCD', JSON.stringify(blob));
+
+    check('two objects throw', /Only one object/.test(attempt(function() {
+      mixed.get({ n: 1 }, { n: 2 });
+    })));
+    check('too many values throw', /Too many parameter values/.test(attempt(function() {
+      mixed.get(1, { n: 1 }, 2, 3);
+    })));
+
+    checkRows(check, 'db.query() takes named parameters', db.query('SELECT name FROM t WHERE id = :id OR id = ?', 1, { id: 3 }),
+              [{ name: 'one' }, { name: 'three' }]);
+
+    var result = db.prepare('UPDATE t SET score = :score WHERE id = :id').runBatch([
+      { id: 1, score: 10 }, { id: 2, score: 20 }, { id: 3, score: 30 }
+    ]);
+    check('runBatch() takes an object per row', result.changes === 3 &&
+          db.prepare('SELECT sum(score) AS s FROM t').get().s === 60, JSON.stringify(result));
+
+    return Promise.all([
+      db.prepare('SELECT name FROM t WHERE id = :id').getAsync({ id: 2 }),
+      db.queryAsync('SELECT count(*) AS n FROM t WHERE score > $min AND id < ?', { min: 15 }, 10),
+      db.queryAsync('SELECT ?', { a: 1 }, { b: 2 }).then(function() { return null; }, function(err) {
+        return err.message;
+      })
+    ]).then(function(rows) {
+      check('async queries take named parameters', rows[0].name === 'two' && rows[1][0].n === 2,
+            JSON.stringify(rows));
+      check('queryAsync() rejects two objects', /Only one object/.test(rows[2]), rows[2]);
+      cleanup();
+    }, function(err) {
+      cleanup();
+      throw err;
+    });
+  });
+}
+
+/**
+ * csv virtual table: queries against the CSV's own contents, quoting,
+ * options, rowid lookups with and without the row-offset index, errors
+ */
+function sqlite3CsvTableChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  var fs = require('fs');
+  var file = tempPath('table.csv');
+  var semicolons = tempPath('table-semicolons.csv');
+  var customIndex = tempPath('table-custom.idx');
+  var regions = ['north', 'south', 'east', 'west'];
+
+  // Row i: id, region, score i / 2, notes; every 50th note is quoted
+  // across lines, every 97th row stops before its notes
+  var lines = ['id,region,score,notes'];
+  var expected = {};
+  for (var i = 1; i <= 1000; i++) {
+    var region = regions[i % 4];
+    var line = i + ',' + region + ',' + (i / 2);
+    if (i % 97 !== 0) {
+      line += ',' + (i % 50 === 0 ? '"multi, ""line""\nnote ' + i + '"' : 'note ' + i);
+    }
+    lines.push(line);
+    expected[region] = expected[region] || { region: region, n: 0, total: 0 };
+    expected[region].n++;
+    expected[region].total += i / 2;
+  }
+  fs.writeFileSync(file, lines.join('\r\n') + '\r\n');
+  fs.writeFileSync(semicolons, 'a;b\n1;x\n2;y\n');
+
+  function attempt(fn) {
+    try {
+      fn();
+      return null;
+    } catch (err) {
+      return err.message;
+    }
+  }
+
+  function quote(path) {
+    return "'" + path.replace(/'/g, "''") + "'";
+  }
+
+  function cleanup() {
+    [file, semicolons, file + '.idx', customIndex].forEach(function(path) {
+      if (fs.existsSync(path)) fs.unlinkSync(path);
+    });
+  }
+
+  runChecks('SQLite3 csv table', 'sqlite3-output', function(check) {
+    var db = new addons.sqlite3(':memory:');
+    try {
+      db.exec('CREATE VIRTUAL TABLE sales USING csv(' + quote(file) + ')');
+      checkRows(check, 'columns come from the header',
+                db.prepare('PRAGMA table_info(sales)').all().map(function(column) { return column.name; }),
+                ['id', 'region', 'score', 'notes']);
+      check('every data row is read', db.prepare('SELECT count(*) AS n FROM sales').get().n === 1000);
+
+      checkRows(check, 'GROUP BY runs on the file in place',
+                db.prepare('SELECT region, count(*) AS n, sum(score) AS total FROM sales GROUP BY region ORDER BY region').all(),
+                Object.keys(expected).sort().map(function(region) { return expected[region]; }));
+
+      check('quoted fields keep delimiters, quotes and newlines',
+            db.prepare('SELECT notes FROM sales WHERE id = \'50\'').get().notes === 'multi, "line"\nnote 50');
+      check('missing fields read as empty text', db.prepare('SELECT notes FROM sales WHERE id = \'97\'').get().notes === '');
+
+      var row = db.prepare('SELECT rowid, id FROM sales WHERE rowid = 500').get();
+      check('rowid is the data row number', row.rowid === 500 && row.id === '500', JSON.stringify(row));
+      var plan = db.prepare('SELECT region FROM sales').explain();
+      check('only the used columns are parsed', /INDEX 0:1$/.test(plan[0].detail), plan[0].detail);
+
+      db.exec('CREATE VIRTUAL TABLE typed USING csv(' + quote(file) + ', affinity=numeric)');
+      row = db.prepare('SELECT typeof(id) AS id, typeof(score) AS score, typeof(notes) AS notes FROM typed WHERE rowid = 97').get();
+      check('affinity=numeric gives numbers and NULL for empty fields',
+            row.id === 'integer' && row.score === 'real' && row.notes === 'null', JSON.stringify(row));
+
+      db.exec('CREATE VIRTUAL TABLE raw USING csv(' + quote(file) + ', header=no, columns=5)');
+      row = db.prepare('SELECT * FROM raw WHERE rowid = 1').get();
+      check('header=no reads the header as data in columns c1, c2, ...', row.c1 === 'id' && row.c4 === 'notes' &&
+            row.c5 === '' && db.prepare('SELECT count(*) AS n FROM raw').get().n === 1001, JSON.stringify(row));
+
+      db.exec('CREATE VIRTUAL TABLE semi USING csv(' + quote(semicolons) + ', delimiter=\';\')');
+      checkRows(check, 'delimiter= splits on another character', db.prepare('SELECT a, b FROM semi').all(),
+                [{ a: '1', b: 'x' }, { a: '2', b: 'y' }]);
+
+      db.exec('CREATE VIRTUAL TABLE indexed USING csv(' + quote(file) + ', index=yes)');
+      check('index=yes writes the sidecar index', fs.existsSync(file + '.idx'));
+      var ids = db.prepare('SELECT id FROM indexed WHERE rowid IN (1, 33, 64, 999, 1000, 1001)').raw().all();
+      checkRows(check, 'indexed rowid lookups', ids, [['1'], ['33'], ['64'], ['999'], ['1000']]);
+      checkRows(check, 'indexed rowid ranges match a plain scan',
+                db.prepare('SELECT rowid, * FROM indexed WHERE rowid BETWEEN 95 AND 130').all(),
+                db.prepare('SELECT rowid, * FROM sales WHERE rowid BETWEEN 95 AND 130').all());
+
+      db.exec('CREATE VIRTUAL TABLE custom USING csv(' + quote(file) + ', index=' + quote(customIndex) + ')');
+      check('index= can name the index file', fs.existsSync(customIndex) &&
+            db.prepare('SELECT id FROM custom WHERE rowid = 777').get().id === '777');
+
+      fs.appendFileSync(file, '1001,north,500.5,appended\r\n');
+      db.exec('CREATE VIRTUAL TABLE changed USING csv(' + quote(file) + ', index=yes)');
+      check('a changed CSV rebuilds its index', db.prepare('SELECT id FROM changed WHERE rowid = 1001').get().id === '1001' &&
+            db.prepare('SELECT count(*) AS n FROM changed').get().n === 1001);
+
+      check('an unknown option is refused', /unknown option bogus/.test(attempt(function() {
+        db.exec('CREATE VIRTUAL TABLE bad USING csv(' + quote(file) + ', bogus=1)');
+      })));
+      check('a missing file is refused', /cannot open/.test(attempt(function() {
+        db.exec('CREATE VIRTUAL TABLE bad USING csv(' + quote(file + '.missing') + ')');
+      })));
+      check('a long delimiter is refused', /single character/.test(attempt(function() {
+        db.exec('CREATE VIRTUAL TABLE bad USING csv(' + quote(file) + ', delimiter=\'ab\')');
+      })));
+    } finally {
+      db.close();
+      cleanup();
+    }
+  });
+}
+
+/**
+ * db.importCsv(): batches and progress, inferred column types, quoting,
+ * options, ordering with async writes, and "Row N" failures
+ */
+function sqlite3ImportChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  var fs = require('fs');
+  var file = tempPath('import.db');
+  var csv = tempPath('import.csv');
+  var plain = tempPath('import-plain.csv');
+  var broken = tempPath('import-broken.csv');
+  removeDatabase(file);
+  var db = new addons.sqlite3(file);
+
+  // Row i: id, zip with leading zeros, price i / 4, name; every 100th
+  // name is quoted across lines and every 7th price is empty
+  var lines = ['id,zip,price,name'];
+  for (var i = 1; i <= 2500; i++) {
+    var name = i % 100 === 0 ? '"item, ""' + i + '""\nline two"' : 'item ' + i;
+    lines.push(i + ',' + ('0000' + (i % 1000)).slice(-5) + ',' + (i % 7 === 0 ? '' : i / 4) + ',' + name);
+  }
+  fs.writeFileSync(csv, lines.join('\n') + '\n');
+  fs.writeFileSync(plain, '1,a,\n2,b,x\n');
+  // Record 6 (header and the blank line counted) has a NULL id
+  fs.writeFileSync(broken, 'id,v\n1,a\n2,b\n\n3,c\n,d\n4,e\n');
+
+  function rejection(promise) {
+    return promise.then(function() { return null; }, function(err) { return err.message; });
+  }
+
+  function cleanup() {
+    if (db.open) db.close();
+    removeDatabase(file);
+    [csv, plain, broken].forEach(function(path) {
+      if (fs.existsSync(path)) fs.unlinkSync(path);
+    });
+  }
+
+  runChecks('SQLite3 CSV import', 'sqlite3-output', function(check) {
+    var reports = [];
+    return db.importCsv(csv, 'items', {
+      batchSize: 1000,
+      progress: function(report) { reports.push(report); }
+    }).then(function(result) {
+      checkRows(check, 'importCsv() resolves with the rows and columns', result,
+                { rows: 2500, columns: ['id', 'zip', 'price', 'name'] });
+      var last = reports[reports.length - 1];
+      check('progress is reported after each batch', reports.length === 3 &&
+            reports[0].rows === 1000 && reports[1].rows === 2000 && last.rows === 2500 &&
+            last.bytesRead === last.totalBytes && last.totalBytes === fs.statSync(csv).size,
+            JSON.stringify(reports));
+
+      var types = {};
+      db.prepare('PRAGMA table_info(items)').all().forEach(function(column) {
+        types[column.name] = column.type;
+      });
+      checkRows(check, 'column types are inferred from the sample', types,
+                { id: 'INTEGER', zip: 'TEXT', price: 'REAL', name: 'TEXT' });
+
+      var rows = db.prepare('SELECT * FROM items WHERE id IN (1, 7, 100) ORDER BY id').all();
+      checkRows(check, 'values keep their types, zeros and quoting', rows, [
+        { id: 1, zip: '00001', price: 0.25, name: 'item 1' },
+        { id: 7, zip: '00007', price: null, name: 'item 7' },
+        { id: 100, zip: '00100', price: 25, name: 'item, "100"\nline two' }
+      ]);
+      var totals = db.prepare('SELECT count(*) AS n, sum(id) AS s FROM items').get();
+      check('every row is inserted once', totals.n === 2500 && totals.s === 2500 * 2501 / 2, JSON.stringify(totals));
+
+      return Promise.all([
+        db.importCsv(plain, 'plain', { header: false }),
+        db.importCsv(plain, 'named', { header: false, columns: ['n', 'letter', 'extra'], emptyAsNull: false })
+      ]);
+    }).then(function() {
+      checkRows(check, 'header: false names columns c1, c2, ...', db.prepare('SELECT * FROM plain').all(),
+                [{ c1: 1, c2: 'a', c3: null }, { c1: 2, c2: 'b', c3: 'x' }]);
+      checkRows(check, 'columns names them and emptyAsNull: false keeps empty text',
+                db.prepare('SELECT * FROM named').all(),
+                [{ n: 1, letter: 'a', extra: '' }, { n: 2, letter: 'b', extra: 'x' }]);
+
+      // Queued behind the CREATE without waiting for it
+      db.execAsync('CREATE TABLE strict (id INTEGER NOT NULL, v TEXT)');
+      return rejection(db.importCsv(broken, 'strict', { create: false, batchSize: 2 }));
+    }).then(function(error) {
+      check('a failing row rejects with its CSV record number', /^Row 6: .*NOT NULL/.test(error), error);
+      checkRows(check, 'batches before the failing one stay', db.prepare('SELECT id FROM strict ORDER BY id').raw().all(),
+                [[1], [2]]);
+
+      var memory = new addons.sqlite3(':memory:');
+      return Promise.all([
+        db.importCsv(plain, 'after', { header: false }),
+        rejection(db.importCsv(csv + '.missing', 'missing')),
+        rejection(memory.importCsv(plain, 'memory')).then(function(message) {
+          memory.close();
+          return message;
+        })
+      ]);
+    }).then(function(results) {
+      check('the writer is usable after a failed import', results[0].rows === 2, JSON.stringify(results[0]));
+      check('a missing file rejects', /Cannot open CSV file/.test(results[1]), results[1]);
+      check('in-memory databases reject', /needs a database file/.test(results[2]), results[2]);
+      cleanup();
+    }, function(err) {
+      cleanup();
+      throw err;
+    });
+  });
+}
+
+/**
+ * Async queries on a file database: results against the sync calls,
+ * write ordering, reads next to writes, errors and number binding
+ */
+function sqlite3AsyncChecks() {
+  if (!addons.sqlite3 || !addons.sqlite3.isAvailable()) {
+    log('SQLite3 addon not available', 'error');
+    return;
+  }
+
+  var file = tempPath('async.db');
+  removeDatabase(file);
+  var db = new addons.sqlite3(file);
+
+  function rejection(promise) {
+    return promise.then(function() { return null; }, function(err) { return err.message; });
+  }
+
+  runChecks('SQLite3 async', 'sqlite3-output', function(check) {
+    db.exec('CREATE TABLE t (id INTEGER PRIMARY KEY, v INTEGER)');
+
+    // Queued without waiting: the writer must apply them in call order
+    var writes = [];
+    for (var i = 0; i < 100; i++) {
+      writes.push(db.queryAsync('INSERT INTO t (v) VALUES (?)', i));
+    }
+
+    return Promise.all(writes).then(function(results) {
+      check('every queued write reports its own rowid', results.every(function(r, index) {
+        return r.changes === 1 && r.lastInsertRowid === index + 1;
+      }), JSON.stringify(results[0]));
+      check('writes applied in call order',
+            db.prepare('SELECT count(*) AS n FROM t WHERE id <> v + 1').get().n === 0);
+
+      return Promise.all([
+        db.queryAsync('SELECT * FROM t ORDER BY id'),
+        db.queryAsync('WITH q AS (SELECT v FROM t WHERE v < ?) SELECT count(*) AS n FROM q', 10),
+        db.queryAsync('INSERT INTO t (v) VALUES (?) RETURNING id, v', 1000),
+        db.prepare('SELECT v FROM t WHERE id <= ?').raw().allAsync(3),
+        db.prepare('SELECT count(*) AS n FROM t').getAsync(),
+        db.queryAsync('SELECT ? AS big, ? AS unsafe, ? AS neg', 1e20, 9007199254740993, -5)
+      ]);
+    }).then(function(results) {
+      checkRows(check, 'queryAsync SELECT matches the sync result', results[0],
+                db.prepare('SELECT * FROM t WHERE id <= 100 ORDER BY id').all());
+      check('WITH ... SELECT runs as a read', results[1][0].n === 10, JSON.stringify(results[1]));
+      check('INSERT ... RETURNING returns its rows', results[2].length === 1 && results[2][0].v === 1000,
+            JSON.stringify(results[2]));
+      checkRows(check, 'allAsync honours raw()', results[3], [[0], [1], [2]]);
+      check('getAsync returns one row', results[4].n >= 100, JSON.stringify(results[4]));
+      check('numbers beyond int64 bind as reals, not wrapped integers', results[5][0].big === 1e20 &&
+            results[5][0].unsafe === 9007199254740992 && results[5][0].neg === -5, JSON.stringify(results[5]));
+
+      return db.execAsync('CREATE TABLE u (x); INSERT INTO u VALUES (1); INSERT INTO u VALUES (2)');
+    }).then(function() {
+      check('execAsync runs every statement of a script', db.prepare('SELECT count(*) AS n FROM u').get().n === 2);
+
+      // BEGIN and ROLLBACK have no result columns, so they must go to the
+      // writer: on a pooled reader the INSERT would commit on its own
+      return db.prepare('BEGIN').runAsync().then(function() {
+        return db.prepare('INSERT INTO u VALUES (3)').runAsync();
+      }).then(function() {
+        return db.prepare('ROLLBACK').runAsync();
+      });
+    }).then(function() {
+      check('BEGIN/ROLLBACK through runAsync() wrap the writer\'s statements',
+            db.prepare('SELECT count(*) AS n FROM u').get().n === 2);
+
+      // A transaction left open on a reader would hold its lock through the
+      // next read and block this connection's write
+      return db.prepare('BEGIN').runAsync().then(function() {
+        return db.queryAsync('SELECT count(*) AS n FROM u');
+      }).then(function() {
+        var error = null;
+        try {
+          db.exec('INSERT INTO u VALUES (4)');
+        } catch (err) {
+          error = err.message;
+        }
+        check('an async BEGIN leaves no reader locked', error === null, error);
+        return db.prepare('COMMIT').runAsync();
+      });
+    }).then(function() {
+      var memory = new addons.sqlite3(':memory:');
+      return Promise.all([
+        rejection(db.queryAsync('SELEC 1')),
+        rejection(db.queryAsync('INSERT INTO t (id, v) VALUES (1, 1)')),
+        rejection(memory.queryAsync('SELECT 1')).then(function(message) {
+          memory.close();
+          return message;
+        })
+      ]);
+    }).then(function(errors) {
+      check('a syntax error rejects', /syntax error/.test(errors[0]), errors[0]);
+      check('a constraint error rejects', /UNIQUE/.test(errors[1]), errors[1]);
+      check('in-memory databases reject async calls', errors[2] !== null, errors[2]);
+
+      db.close();
+      return rejection(db.queryAsync('SELECT 1'));
+    }).then(function(error) {
+      check('a closed database rejects', error !== null, error);
+      removeDatabase(file);
+    }, function(err) {
+      if (db.open) db.close();
+      removeDatabase(file);
+      throw err;
+    });
+  });
+}
+
 // ============================================
 // SDL2 Input Tests
 // ============================================
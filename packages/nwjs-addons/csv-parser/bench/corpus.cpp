@@ -0,0 +1,141 @@
+#include "corpus.h"
+#include <cstdio>
+
+namespace csvbench {
+
+const std::vector<CorpusSpec>& standardCorpora() {
+  //                               name      cols  crlf   bom    quoted% hostile multibyte
+  static const CorpusSpec specs[] = {
+    { "narrow", 6,    false, false, 2,      false,  false },
+    { "wide",   80,   true,  false, 2,      false,  false },
+    { "quoted", 12,   true,  false, 100,    true,   false },
+    { "bom",    6,    false, true,  2,      false,  false },
+    { "utf8",   8,    false, false, 10,     false,  true  }
+  };
+  static const std::vector<CorpusSpec> corpora(specs, specs + sizeof(specs) / sizeof(specs[0]));
+  return corpora;
+}
+
+namespace {
+
+class Random {
+public:
+  Random() : state_(12345) {}
+
+  unsigned next(unsigned range) {
+    state_ = state_ * 1103515245u + 12345u;
+    return (state_ >> 16) % range;
+  }
+
+private:
+  unsigned state_;
+};
+
+const char* const ASCII_WORDS[] = {
+  "alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel",
+  "india", "juliet", "kilo", "lima", "mike", "november", "oscar", "papa"
+};
+
+// 2-, 3- and 4-byte sequences (Latin-1 supplement, CJK, emoji)
+const char* const MULTIBYTE_WORDS[] = {
+  "caf\xC3\xA9", "na\xC3\xAFve", "\xC3\xBC" "ber", "\xE6\x97\xA5\xE6\x9C\xAC",
+  "\xE6\x9D\xB1\xE4\xBA\xAC", "\xED\x95\x9C\xEA\xB5\xAD", "\xF0\x9F\x93\x88",
+  "\xD0\xBC\xD0\xB8\xD1\x80", "\xCE\xB1\xCE\xB2\xCE\xB3", "\xE2\x82\xAC" "42"
+};
+
+const size_t WORD_COUNT = 16;
+const size_t MULTIBYTE_COUNT = 10;
+
+void appendWords(std::string& out, Random& random, const CorpusSpec& spec) {
+  unsigned words = 1 + random.next(3);
+  for (unsigned i = 0; i < words; i++) {
+    if (i > 0) {
+      out += ' ';
+    }
+    out += spec.multibyte && random.next(2) == 0
+      ? MULTIBYTE_WORDS[random.next(MULTIBYTE_COUNT)]
+      : ASCII_WORDS[random.next(WORD_COUNT)];
+  }
+}
+
+// Column kinds cycle int, decimal, text, date, so every corpus has
+// something for the columnar/typed paths to chew on
+void appendValue(std::string& out, Random& random, const CorpusSpec& spec, int column) {
+  char buffer[32];
+
+  switch (column % 4) {
+    case 0:
+      snprintf(buffer, sizeof(buffer), "%u", random.next(1000000));
+      out += buffer;
+      break;
+    case 1:
+      snprintf(buffer, sizeof(buffer), "%u.%02u", random.next(10000), random.next(100));
+      out += buffer;
+      break;
+    case 2:
+      appendWords(out, random, spec);
+      break;
+    default:
+      snprintf(buffer, sizeof(buffer), "20%02u-%02u-%02u",
+               random.next(30), 1 + random.next(12), 1 + random.next(28));
+      out += buffer;
+      break;
+  }
+}
+
+void appendField(std::string& out, Random& random, const CorpusSpec& spec, int column) {
+  bool quoted = static_cast<int>(random.next(100)) < spec.quotedPercent;
+  if (!quoted) {
+    appendValue(out, random, spec, column);
+    return;
+  }
+
+  out += '"';
+  appendValue(out, random, spec, column);
+  if (spec.hostile) {
+    switch (random.next(4)) {
+      case 0: out += ", with a comma"; break;
+      case 1: out += " \"\"quoted\"\" bit"; break;
+      case 2: out += spec.crlf ? "\r\nsecond line" : "\nsecond line"; break;
+      default: break;
+    }
+  }
+  out += '"';
+}
+
+} // namespace
+
+std::string generateCorpus(const CorpusSpec& spec, size_t targetBytes) {
+  const char* lineEnding = spec.crlf ? "\r\n" : "\n";
+  Random random;
+  std::string out;
+  out.reserve(targetBytes + 4096);
+
+  if (spec.bom) {
+    out += "\xEF\xBB\xBF";
+  }
+
+  for (int column = 0; column < spec.columns; column++) {
+    char name[16];
+    snprintf(name, sizeof(name), "col%d", column);
+    if (column > 0) {
+      out += ',';
+    }
+    out += name;
+  }
+  out += lineEnding;
+
+  while (out.size() < targetBytes) {
+    for (int column = 0; column < spec.columns; column++) {
+      if (column > 0) {
+        out += ',';
+      }
+      appendField(out, random, spec, column);
+    }
+    out += lineEnding;
+  }
+
+  return out;
+}
+
+} // namespace csvbench
@@ -0,0 +1,35 @@
+/*
+ * corpus.h — synthetic CSV corpora for the benchmarks
+ *
+ * Deterministic (fixed-seed) generators, so runs on different machines
+ * and builds measure the same bytes.
+ */
+
+#ifndef CSV_BENCH_CORPUS_H
+#define CSV_BENCH_CORPUS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace csvbench {
+
+struct CorpusSpec {
+  const char* name;
+  int columns;
+  bool crlf;
+  bool bom;
+  int quotedPercent;   // fields wrapped in quotes
+  bool hostile;        // quoted fields hold delimiters, "" and line breaks
+  bool multibyte;      // text columns use 2-4 byte UTF-8 sequences
+};
+
+// narrow, wide, quoted, bom, utf8
+const std::vector<CorpusSpec>& standardCorpora();
+
+// Header row plus data rows until at least targetBytes are produced
+std::string generateCorpus(const CorpusSpec& spec, size_t targetBytes);
+
+} // namespace csvbench
+
+#endif // CSV_BENCH_CORPUS_H
@@ -0,0 +1,339 @@
+/*
+ * csv_bench.cpp — end-to-end CSV benchmark suite
+ *
+ * Runs parse, parseTable, parseFile, stringify and CsvFileWriter over
+ * each synthetic corpus (corpus.h) and prints one JSON document to
+ * stdout: best-of-runs MB/s and rows/s plus the heap allocations made by
+ * one run, for tracking regressions between builds. Progress goes to
+ * stderr. Build with -DCSV_PARSER_BENCH=ON (see CMakeLists.txt).
+ *
+ *   csv_bench [--size MB] [--runs N] [--dir PATH] [--keep]
+ */
+
+#include "csv_parser.h"
+#include "csv_scanner.h"
+#include "corpus.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace csvparser;
+using namespace csvbench;
+
+// Every allocation in the process goes through these, so a run's
+// allocation count is the counter delta around it
+static std::atomic<uint64_t> g_allocations(0);
+static std::atomic<uint64_t> g_allocatedBytes(0);
+
+static void* countedAlloc(size_t size) {
+  g_allocations++;
+  g_allocatedBytes += size;
+  return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size) {
+  void* p = countedAlloc(size);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](size_t size) {
+  void* p = countedAlloc(size);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw() { return countedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) throw() { return countedAlloc(size); }
+void operator delete(void* p) throw() { free(p); }
+void operator delete[](void* p) throw() { free(p); }
+void operator delete(void* p, size_t) throw() { free(p); }
+void operator delete[](void* p, size_t) throw() { free(p); }
+void operator delete(void* p, const std::nothrow_t&) throw() { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) throw() { free(p); }
+
+typedef std::vector<std::vector<std::string>> Rows;
+
+struct Result {
+  std::string corpus;
+  std::string operation;
+  double seconds;
+  double bytes;
+  double rows;
+  uint64_t allocations;
+  uint64_t allocatedBytes;
+};
+
+struct Corpus {
+  const CorpusSpec* spec;
+  std::string text;
+  std::string path;
+  Rows rows;
+};
+
+// One timed run of an operation. run() does the work and reports the
+// bytes and rows it covered; anything it returns is freed afterwards,
+// outside the timed region.
+class Operation {
+public:
+  virtual ~Operation() {}
+  virtual const char* name() const = 0;
+  virtual void setUp(const Corpus&) {}
+  virtual void run(const Corpus& corpus, double& bytes, double& rows) = 0;
+  virtual void tearDown() {}
+};
+
+class ParseOperation : public Operation {
+public:
+  const char* name() const { return "parse"; }
+  void run(const Corpus& corpus, double& bytes, double& rows) {
+    result_ = parse(corpus.text, ParseOptions());
+    bytes = static_cast<double>(corpus.text.size());
+    rows = static_cast<double>(result_.size());
+  }
+  void tearDown() { Rows().swap(result_); }
+private:
+  Rows result_;
+};
+
+class ParseTableOperation : public Operation {
+public:
+  explicit ParseTableOperation(unsigned threads) : threads_(threads) {}
+  const char* name() const { return threads_ == 1 ? "parseTable" : "parseTableThreaded"; }
+  // The input is moved into the table, so the copy is made untimed
+  void setUp(const Corpus& corpus) { input_ = corpus.text; }
+  void run(const Corpus& corpus, double& bytes, double& rows) {
+    ParseOptions options;
+    options.threads = threads_;
+    table_ = parseTable(std::move(input_), options);
+    bytes = static_cast<double>(corpus.text.size());
+    rows = static_cast<double>(table_.rowCount());
+  }
+  void tearDown() { table_ = ParsedTable(); }
+private:
+  unsigned threads_;
+  std::string input_;
+  ParsedTable table_;
+};
+
+class ParseFileOperation : public Operation {
+public:
+  const char* name() const { return "parseFile"; }
+  void run(const Corpus& corpus, double& bytes, double& rows) {
+    result_ = parseFile(corpus.path, ParseOptions());
+    bytes = static_cast<double>(corpus.text.size());
+    rows = static_cast<double>(result_.size());
+  }
+  void tearDown() { Rows().swap(result_); }
+private:
+  Rows result_;
+};
+
+// What the addon's parseFile() does: map the file, parse spans over it
+class ParseFileTableOperation : public Operation {
+public:
+  const char* name() const { return "parseFileTable"; }
+  void run(const Corpus& corpus, double& bytes, double& rows) {
+    FileView view;
+    if (view.open(corpus.path)) {
+      table_ = parseTable(std::move(view), ParseOptions());
+    }
+    bytes = static_cast<double>(corpus.text.size());
+    rows = static_cast<double>(table_.rowCount());
+  }
+  void tearDown() { table_ = ParsedTable(); }
+private:
+  ParsedTable table_;
+};
+
+class StringifyOperation : public Operation {
+public:
+  const char* name() const { return "stringify"; }
+  void run(const Corpus& corpus, double& bytes, double& rows) {
+    output_ = stringify(corpus.rows, StringifyOptions());
+    bytes = static_cast<double>(output_.size());
+    rows = static_cast<double>(corpus.rows.size());
+  }
+  void tearDown() { std::string().swap(output_); }
+private:
+  std::string output_;
+};
+
+class WriterOperation : public Operation {
+public:
+  const char* name() const { return "writer"; }
+  void setUp(const Corpus& corpus) { path_ = corpus.path + ".out"; }
+  void run(const Corpus& corpus, double& bytes, double& rows) {
+    CsvFileWriter writer((StringifyOptions()));
+    bytes = 0;
+    rows = 0;
+    if (!writer.open(path_)) {
+      return;
+    }
+    for (size_t i = 0; i < corpus.rows.size(); i++) {
+      writer.writeRow(corpus.rows[i]);
+    }
+    writer.close();
+    bytes = static_cast<double>(writer.bytesWritten());
+    rows = static_cast<double>(corpus.rows.size());
+  }
+  void tearDown() { remove(path_.c_str()); }
+private:
+  std::string path_;
+};
+
+static Result measure(Operation& op, const Corpus& corpus, int runs) {
+  Result result;
+  result.corpus = corpus.spec->name;
+  result.operation = op.name();
+  result.seconds = 0;
+  result.bytes = 0;
+  result.rows = 0;
+  result.allocations = 0;
+  result.allocatedBytes = 0;
+
+  for (int run = 0; run < runs; run++) {
+    op.setUp(corpus);
+
+    uint64_t allocations = g_allocations;
+    uint64_t allocatedBytes = g_allocatedBytes;
+    double bytes = 0;
+    double rows = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    op.run(corpus, bytes, rows);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    // Counted as in the first run: later runs may reuse capacity
+    if (run == 0) {
+      result.allocations = g_allocations - allocations;
+      result.allocatedBytes = g_allocatedBytes - allocatedBytes;
+    }
+
+    op.tearDown();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    if (run == 0 || seconds < result.seconds) {
+      result.seconds = seconds;
+      result.bytes = bytes;
+      result.rows = rows;
+    }
+  }
+
+  return result;
+}
+
+static bool writeCorpusFile(const std::string& path, const std::string& text) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+  return fclose(file) == 0 && ok;
+}
+
+static void printJson(const std::vector<Result>& results, double megabytes, int runs) {
+  printf("{\n");
+  printf("  \"scanLevel\": \"%s\",\n", scanLevelName(activeScanLevel()));
+  printf("  \"sizeMB\": %g,\n", megabytes);
+  printf("  \"runs\": %d,\n", runs);
+  printf("  \"results\": [\n");
+
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    double seconds = r.seconds > 0 ? r.seconds : 1e-9;
+    printf("    {\"corpus\": \"%s\", \"operation\": \"%s\", \"seconds\": %.6f, "
+           "\"mbPerSec\": %.2f, \"rowsPerSec\": %.0f, \"rows\": %.0f, "
+           "\"allocations\": %llu, \"allocatedBytes\": %llu}%s\n",
+      r.corpus.c_str(), r.operation.c_str(), r.seconds,
+      r.bytes / (1024.0 * 1024.0) / seconds, r.rows / seconds, r.rows,
+      static_cast<unsigned long long>(r.allocations),
+      static_cast<unsigned long long>(r.allocatedBytes),
+      i + 1 < results.size() ? "," : "");
+  }
+
+  printf("  ]\n");
+  printf("}\n");
+}
+
+int main(int argc, char** argv) {
+  double megabytes = 8;
+  int runs = 3;
+  std::string dir = ".";
+  bool keep = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+      megabytes = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+      runs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+      dir = argv[++i];
+    } else if (strcmp(argv[i], "--keep") == 0) {
+      keep = true;
+    } else {
+      fprintf(stderr, "usage: %s [--size MB] [--runs N] [--dir PATH] [--keep]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (megabytes <= 0 || runs < 1) {
+    fprintf(stderr, "--size and --runs must be positive\n");
+    return 2;
+  }
+
+  ParseOperation parseOp;
+  ParseTableOperation parseTableOp(1);
+  ParseTableOperation threadedOp(0);
+  ParseFileOperation parseFileOp;
+  ParseFileTableOperation parseFileTableOp;
+  StringifyOperation stringifyOp;
+  WriterOperation writerOp;
+  Operation* operations[] = {
+    &parseOp, &parseTableOp, &threadedOp, &parseFileOp, &parseFileTableOp, &stringifyOp, &writerOp
+  };
+
+  const std::vector<CorpusSpec>& specs = standardCorpora();
+  std::vector<Result> results;
+
+  for (size_t s = 0; s < specs.size(); s++) {
+    Corpus corpus;
+    corpus.spec = &specs[s];
+    corpus.text = generateCorpus(specs[s], static_cast<size_t>(megabytes * 1024 * 1024));
+    corpus.path = dir + "/csv_bench_" + specs[s].name + ".csv";
+    corpus.rows = parse(corpus.text, ParseOptions());
+
+    if (!writeCorpusFile(corpus.path, corpus.text)) {
+      fprintf(stderr, "cannot write %s\n", corpus.path.c_str());
+      return 1;
+    }
+
+    fprintf(stderr, "%s: %.1f MB, %u rows\n", specs[s].name,
+      corpus.text.size() / (1024.0 * 1024.0), static_cast<unsigned>(corpus.rows.size()));
+
+    for (size_t o = 0; o < sizeof(operations) / sizeof(operations[0]); o++) {
+      Result result = measure(*operations[o], corpus, runs);
+      fprintf(stderr, "  %-18s %8.1f MB/s %12.0f rows/s %10llu allocs\n",
+        result.operation.c_str(),
+        result.bytes / (1024.0 * 1024.0) / (result.seconds > 0 ? result.seconds : 1e-9),
+        result.rows / (result.seconds > 0 ? result.seconds : 1e-9),
+        static_cast<unsigned long long>(result.allocations));
+      results.push_back(result);
+    }
+
+    if (!keep) {
+      remove(corpus.path.c_str());
+    }
+  }
+
+  printJson(results, megabytes, runs);
+  return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * scan_bench.cpp — structural scanner microbenchmark
+ *
+ * Parses a synthetic wide, mostly-unquoted CSV at every scan level the
+ * CPU supports and reports throughput relative to the bytewise state
+ * machine. Build with -DCSV_PARSER_BENCH=ON (see CMakeLists.txt).
+ */
+
+#include "csv_parser.h"
+#include "csv_scanner.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace csvparser;
+
+static std::string makeWideCsv(size_t targetBytes, int columns) {
+  static const char alnum[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+  std::string out;
+  out.reserve(targetBytes + 1024);
+
+  unsigned seed = 12345;
+  while (out.size() < targetBytes) {
+    for (int col = 0; col < columns; col++) {
+      if (col > 0) {
+        out += ',';
+      }
+
+      seed = seed * 1103515245 + 12345;
+      int length = 4 + static_cast<int>((seed >> 16) % 17);
+      bool quoted = ((seed >> 8) % 20) == 0;
+
+      if (quoted) {
+        out += '"';
+      }
+      for (int i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        out += alnum[(seed >> 16) % 36];
+      }
+      if (quoted) {
+        out += ", x\"";
+      }
+    }
+    out += "\r\n";
+  }
+
+  return out;
+}
+
+static double bestMegabytesPerSecond(const std::string& input, int runs, size_t* rowCount) {
+  ParseOptions options;
+  double best = 0;
+
+  for (int run = 0; run < runs; run++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::vector<std::string>> rows = parse(input, options);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double mbps = (input.size() / (1024.0 * 1024.0)) / seconds;
+    if (mbps > best) {
+      best = mbps;
+    }
+    *rowCount = rows.size();
+  }
+
+  return best;
+}
+
+int main(int argc, char** argv) {
+  size_t megabytes = argc > 1 ? static_cast<size_t>(atoi(argv[1])) : 64;
+  std::string input = makeWideCsv(megabytes * 1024 * 1024, 80);
+
+  ScanLevel best = detectScanLevel();
+  double baseline = 0;
+
+  printf("input: %.1f MB, 80 columns\n", input.size() / (1024.0 * 1024.0));
+
+  for (int level = SCAN_BYTEWISE; level <= best; level++) {
+    setScanLevel(static_cast<ScanLevel>(level));
+
+    size_t rows = 0;
+    double mbps = bestMegabytesPerSecond(input, 3, &rows);
+    if (level == SCAN_BYTEWISE) {
+      baseline = mbps;
+    }
+
+    printf("%-9s %8.1f MB/s  %5.2fx  (%u rows)\n",
+      scanLevelName(static_cast<ScanLevel>(level)), mbps, mbps / baseline,
+      static_cast<unsigned>(rows));
+  }
+
+  return 0;
+}
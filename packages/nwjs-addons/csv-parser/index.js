@@ -9,9 +9,22 @@ var DEFAULT_PARSE_OPTIONS = {
   headers: true,
   skipEmptyLines: true,
   trim: false,
-  columns: null
+  columns: null,
+  threads: 1,
+  select: null,
+  where: null
 }
 
+var DEFAULT_COLUMNAR_OPTIONS = {
+  schema: null,
+  inferRows: 1000
+}
+
+var COLUMN_TYPES = ['auto', 'string', 'int32', 'float64', 'number', 'date']
+
+// Rows converted to JS per tick by the async parsers
+var ASYNC_BATCH_ROWS = 5000
+
 var DEFAULT_STRINGIFY_OPTIONS = {
   delimiter: ',',
   quote: '"',
@@ -36,24 +49,264 @@ function validateDelimiter(value, name) {
   }
 }
 
+function rowToObject(row, columns) {
+  var obj = {}
+
+  for (var j = 0; j < columns.length; j++) {
+    var hasValue = j < row.length
+    obj[columns[j]] = hasValue ? row[j] : ''
+  }
+
+  return obj
+}
+
+/**
+ * Column names from the header row as parsed (projected by select)
+ * A column selected by name keeps that name even when the header lacks
+ * it; its fields are then empty.
+ * @param {Array} header - First parsed row
+ * @param {Array|null} select - The select option
+ * @returns {Array} Column names
+ */
+function headerColumns(header, select) {
+  if (!select) {
+    return header
+  }
+
+  var columns = header.slice()
+  for (var i = 0; i < select.length; i++) {
+    if (typeof select[i] === 'string') {
+      columns[i] = select[i]
+    }
+  }
+  return columns
+}
+
 function rowsToObjects(rows, columns) {
   var result = []
 
   for (var i = 0; i < rows.length; i++) {
-    var row = rows[i]
-    var obj = {}
+    result.push(rowToObject(rows[i], columns))
+  }
+
+  return result
+}
+
+/**
+ * Column reference for the native side
+ * @param {string|number} key - Header name, or position (a number, or a
+ *   string of digits when there is no header row)
+ * @param {boolean} headers - Whether the first row names the columns
+ * @returns {Object} { name } or { index }
+ */
+function toNativeColumn(key, headers) {
+  if (typeof key === 'number' && key >= 0 && key % 1 === 0) {
+    return { index: key }
+  }
+  if (typeof key === 'string') {
+    if (headers) {
+      return { name: key }
+    }
+    if (/^\d+$/.test(key)) {
+      return { index: Number(key) }
+    }
+    throw new TypeError('Column "' + key + '" can only be selected by name with headers enabled')
+  }
+  throw new TypeError('Column must be a header name or a non-negative integer index')
+}
+
+/**
+ * Normalize a where clause for the native side
+ * Each key is a column; its value is a string (equals), a number
+ * (numeric equals), an array (in set) or { min, max } (numeric range,
+ * inclusive, either bound optional). Rows must match every entry.
+ * @param {Object|null} where - { column: condition }
+ * @param {boolean} headers - Whether the first row names the columns
+ * @returns {Array} [{ name | index, op, values, min, max }]
+ */
+function toNativeFilters(where, headers) {
+  var result = []
+  if (!where) {
+    return result
+  }
 
-    for (var j = 0; j < columns.length; j++) {
-      var hasValue = j < row.length
-      obj[columns[j]] = hasValue ? row[j] : ''
+  var keys = Object.keys(where)
+  for (var i = 0; i < keys.length; i++) {
+    var filter = toNativeColumn(keys[i], headers)
+    var condition = where[keys[i]]
+
+    if (typeof condition === 'string') {
+      filter.op = 'equals'
+      filter.values = [condition]
+    } else if (typeof condition === 'number') {
+      filter.op = 'range'
+      filter.min = condition
+      filter.max = condition
+    } else if (Array.isArray(condition)) {
+      filter.op = 'in'
+      filter.values = condition.map(String)
+    } else if (condition && typeof condition === 'object') {
+      filter.op = 'range'
+      if (typeof condition.min === 'number') {
+        filter.min = condition.min
+      }
+      if (typeof condition.max === 'number') {
+        filter.max = condition.max
+      }
+    } else {
+      throw new TypeError('Invalid where condition for column ' + keys[i])
     }
 
-    result.push(obj)
+    result.push(filter)
   }
 
   return result
 }
 
+/**
+ * Validate merged parse options and build the native options object
+ * @param {Object} opts - Merged parse options
+ * @returns {Object}
+ */
+function toNativeParseOptions(opts) {
+  validateDelimiter(opts.delimiter, 'delimiter')
+  validateDelimiter(opts.quote, 'quote')
+  validateDelimiter(opts.escape, 'escape')
+
+  if (opts.select && !Array.isArray(opts.select)) {
+    throw new TypeError('select must be an array')
+  }
+
+  var select = []
+  for (var i = 0; opts.select && i < opts.select.length; i++) {
+    select.push(toNativeColumn(opts.select[i], opts.headers))
+  }
+
+  return {
+    delimiter: opts.delimiter,
+    quote: opts.quote,
+    escape: opts.escape,
+    skipEmptyLines: opts.skipEmptyLines,
+    trim: opts.trim,
+    threads: opts.threads,
+    headers: opts.headers,
+    select: select,
+    filters: toNativeFilters(opts.where, opts.headers)
+  }
+}
+
+/**
+ * Normalize a column schema for the native side
+ * @param {Object|Array|null} schema - { name: type } or [type, ...] by position
+ * @returns {Array} [{ name | index, type }]
+ */
+function toNativeSchema(schema) {
+  var result = []
+  if (!schema) {
+    return result
+  }
+
+  var byPosition = Array.isArray(schema)
+  var keys = byPosition ? schema : Object.keys(schema)
+
+  for (var i = 0; i < keys.length; i++) {
+    var type = byPosition ? schema[i] : schema[keys[i]]
+    if (!type) {
+      continue
+    }
+    if (COLUMN_TYPES.indexOf(type) === -1) {
+      throw new TypeError('Unknown column type: ' + type)
+    }
+    result.push(byPosition ? { index: i, type: type } : { name: keys[i], type: type })
+  }
+
+  return result
+}
+
+/**
+ * Validate options for the columnar parsers
+ * @param {Object} [options] - Parse options plus schema / inferRows
+ * @returns {{opts: Object, nativeOpts: Object}}
+ */
+function prepareColumnar(options) {
+  var opts = mergeOptions(DEFAULT_PARSE_OPTIONS, options)
+  var columnarOpts = mergeOptions(DEFAULT_COLUMNAR_OPTIONS, options)
+
+  var nativeOpts = toNativeParseOptions(opts)
+  nativeOpts.inferRows = columnarOpts.inferRows
+  nativeOpts.schema = toNativeSchema(columnarOpts.schema)
+
+  return { opts: opts, nativeOpts: nativeOpts }
+}
+
+// options.columns renames the columns positionally, as in parse();
+// without it selected names are kept as in headerColumns()
+function applyColumnNames(result, opts) {
+  var columns = opts.columns
+  if (!columns && opts.headers && opts.select) {
+    var header = result.columns.map(function(column) { return column.name })
+    columns = headerColumns(header, opts.select)
+  }
+
+  if (columns) {
+    for (var i = 0; i < result.columns.length && i < columns.length; i++) {
+      result.columns[i].name = columns[i]
+    }
+  }
+  return result
+}
+
+/**
+ * Pull rows out of a native CsvTable one batch per tick
+ * Same header/columns handling as parse(); resolves with the full result.
+ * @param {Object} table - Native CsvTable handle
+ * @param {Object} opts - Merged parse options
+ */
+function drainTable(table, opts, resolve, reject) {
+  var result = []
+  var columns = opts.columns
+  var headerPending = opts.headers
+
+  function step() {
+    var rows
+    try {
+      rows = table.next(ASYNC_BATCH_ROWS)
+    } catch (err) {
+      reject(err)
+      return
+    }
+
+    var start = 0
+    if (headerPending && rows.length > 0) {
+      columns = columns || headerColumns(rows[0], opts.select)
+      headerPending = false
+      start = 1
+    }
+
+    for (var i = start; i < rows.length; i++) {
+      result.push(columns ? rowToObject(rows[i], columns) : rows[i])
+    }
+
+    if (table.done) {
+      resolve(result)
+    } else {
+      setImmediate(step)
+    }
+  }
+
+  step()
+}
+
+function objectToRow(obj, keys) {
+  var row = []
+  for (var j = 0; j < keys.length; j++) {
+    var val = obj[keys[j]]
+    var isNullOrUndefined = val === null || val === undefined
+    row.push(isNullOrUndefined ? '' : String(val))
+  }
+  return row
+}
+
 function objectsToRows(data, includeHeaders) {
   var rows = []
   var keys = Object.keys(data[0])
@@ -63,13 +316,7 @@ function objectsToRows(data, includeHeaders) {
   }
 
   for (var i = 0; i < data.length; i++) {
-    var row = []
-    for (var j = 0; j < keys.length; j++) {
-      var val = data[i][keys[j]]
-      var isNullOrUndefined = val === null || val === undefined
-      row.push(isNullOrUndefined ? '' : String(val))
-    }
-    rows.push(row)
+    rows.push(objectToRow(data[i], keys))
   }
 
   return rows
@@ -78,7 +325,11 @@ function objectsToRows(data, includeHeaders) {
 /**
  * Parse CSV string
  * @param {string} csvString - CSV content to parse
- * @param {Object} [options] - Parse options
+ * @param {Object} [options] - Parse options, including:
+ * @param {Array} [options.select] - Columns to keep, in order (header names
+ *   or indices); other fields are never converted to JS
+ * @param {Object} [options.where] - { column: condition }; rows failing any
+ *   condition are dropped natively (see toNativeFilters)
  * @returns {Array} Parsed data (array of arrays or array of objects)
  */
 function parse(csvString, options) {
@@ -87,22 +338,12 @@ function parse(csvString, options) {
   }
 
   var opts = mergeOptions(DEFAULT_PARSE_OPTIONS, options)
-  validateDelimiter(opts.delimiter, 'delimiter')
-  validateDelimiter(opts.quote, 'quote')
-  validateDelimiter(opts.escape, 'escape')
-
-  var nativeOpts = {
-    delimiter: opts.delimiter,
-    quote: opts.quote,
-    escape: opts.escape,
-    skipEmptyLines: opts.skipEmptyLines,
-    trim: opts.trim
-  }
+  var nativeOpts = toNativeParseOptions(opts)
 
   var rows = native.csvParse(csvString, nativeOpts)
 
   var useHeaders = opts.headers && rows.length > 0
-  var columns = opts.columns || (useHeaders ? rows[0] : null)
+  var columns = opts.columns || (useHeaders ? headerColumns(rows[0], opts.select) : null)
 
   if (!columns) {
     return rows
@@ -124,22 +365,12 @@ function parseFile(filePath, options) {
   }
 
   var opts = mergeOptions(DEFAULT_PARSE_OPTIONS, options)
-  validateDelimiter(opts.delimiter, 'delimiter')
-  validateDelimiter(opts.quote, 'quote')
-  validateDelimiter(opts.escape, 'escape')
-
-  var nativeOpts = {
-    delimiter: opts.delimiter,
-    quote: opts.quote,
-    escape: opts.escape,
-    skipEmptyLines: opts.skipEmptyLines,
-    trim: opts.trim
-  }
+  var nativeOpts = toNativeParseOptions(opts)
 
   var rows = native.csvParseFile(filePath, nativeOpts)
 
   var useHeaders = opts.headers && rows.length > 0
-  var columns = opts.columns || (useHeaders ? rows[0] : null)
+  var columns = opts.columns || (useHeaders ? headerColumns(rows[0], opts.select) : null)
 
   if (!columns) {
     return rows
@@ -149,6 +380,169 @@ function parseFile(filePath, options) {
   return rowsToObjects(dataRows, columns)
 }
 
+/**
+ * Parse CSV file without blocking the JS thread
+ * Reading and parsing run on the libuv thread pool; the rows are then
+ * converted to JS a batch per tick.
+ * @param {string} filePath - Path to CSV file
+ * @param {Object} [options] - Parse options (same as parseFile)
+ * @returns {Promise<Array>} Parsed data
+ */
+function parseFileAsync(filePath, options) {
+  return new Promise(function(resolve, reject) {
+    if (typeof filePath !== 'string') {
+      throw new TypeError('filePath must be a string')
+    }
+
+    var opts = mergeOptions(DEFAULT_PARSE_OPTIONS, options)
+    var nativeOpts = toNativeParseOptions(opts)
+
+    native.csvParseFileAsync(filePath, nativeOpts, function(err, table) {
+      if (err) {
+        reject(err)
+        return
+      }
+      drainTable(table, opts, resolve, reject)
+    })
+  })
+}
+
+/**
+ * Parse CSV string into typed columns
+ * Numeric columns become Int32Array / Float64Array, dates Float64Array of
+ * epoch milliseconds (UTC unless an offset is given) and strings a
+ * dictionary plus a Uint32Array of indices. Columns missing from the
+ * schema are inferred from their first inferRows non-empty values.
+ * @param {string} csvString - CSV content to parse
+ * @param {Object} [options] - Parse options, plus:
+ * @param {Object|Array} [options.schema] - { name: type } or [type, ...]; types
+ *   are 'auto', 'string', 'int32', 'float64' (or 'number') and 'date'
+ * @param {number} [options.inferRows=1000] - Values sampled per inferred column
+ * @returns {{rowCount: number, columns: Array}} Columns as { name, type, values, dictionary? }
+ */
+function parseColumns(csvString, options) {
+  if (typeof csvString !== 'string') {
+    throw new TypeError('csvString must be a string')
+  }
+
+  var prepared = prepareColumnar(options)
+  var result = native.csvParseColumns(csvString, prepared.nativeOpts)
+  return applyColumnNames(result, prepared.opts)
+}
+
+/**
+ * Parse CSV file into typed columns
+ * @param {string} filePath - Path to CSV file
+ * @param {Object} [options] - Same as parseColumns
+ * @returns {{rowCount: number, columns: Array}}
+ */
+function parseFileColumns(filePath, options) {
+  if (typeof filePath !== 'string') {
+    throw new TypeError('filePath must be a string')
+  }
+
+  var prepared = prepareColumnar(options)
+  var result = native.csvParseFileColumns(filePath, prepared.nativeOpts)
+  return applyColumnNames(result, prepared.opts)
+}
+
+/**
+ * Parse CSV file into typed columns off the JS thread
+ * @param {string} filePath - Path to CSV file
+ * @param {Object} [options] - Same as parseColumns
+ * @returns {Promise<{rowCount: number, columns: Array}>}
+ */
+function parseFileColumnsAsync(filePath, options) {
+  return new Promise(function(resolve, reject) {
+    if (typeof filePath !== 'string') {
+      throw new TypeError('filePath must be a string')
+    }
+
+    var prepared = prepareColumnar(options)
+
+    native.csvParseFileColumnsAsync(filePath, prepared.nativeOpts, function(err, result) {
+      if (err) {
+        reject(err)
+        return
+      }
+      resolve(applyColumnNames(result, prepared.opts))
+    })
+  })
+}
+
+/**
+ * Incremental CSV file reader
+ * Rows are parsed from fixed-size file blocks as they are requested, so
+ * memory stays bounded regardless of file size.
+ * @param {Object} nativeReader - Native CsvReader handle
+ * @param {Object} opts - Merged parse options
+ */
+function Reader(nativeReader, opts) {
+  this._native = nativeReader
+  this._useHeaders = opts.headers
+  this._select = opts.select
+  this.columns = opts.columns
+}
+
+/**
+ * True once every row has been returned
+ * @returns {boolean}
+ */
+Object.defineProperty(Reader.prototype, 'done', {
+  get: function() {
+    return this._native.done
+  }
+})
+
+/**
+ * Read the next batch of rows
+ * The header row (when headers is enabled) is consumed on the first call
+ * and used as the column list.
+ * @param {number} [batchSize=1000] - Maximum rows to return
+ * @returns {Array|null} Rows (arrays or objects), or null when exhausted
+ */
+Reader.prototype.next = function(batchSize) {
+  var rows = this._native.next(batchSize || 0)
+
+  if (this._useHeaders && !this.columns && rows.length > 0) {
+    this.columns = headerColumns(rows[0], this._select)
+    rows = rows.slice(1)
+    if (rows.length === 0 && !this._native.done) {
+      rows = this._native.next(batchSize || 0)
+    }
+  }
+
+  if (rows.length === 0 && this._native.done) {
+    return null
+  }
+
+  return this.columns ? rowsToObjects(rows, this.columns) : rows
+}
+
+/**
+ * Close the underlying file
+ */
+Reader.prototype.close = function() {
+  this._native.close()
+}
+
+/**
+ * Open a CSV file for incremental reading
+ * @param {string} filePath - Path to CSV file
+ * @param {Object} [options] - Parse options (same as parseFile)
+ * @returns {Reader}
+ */
+function createReader(filePath, options) {
+  if (typeof filePath !== 'string') {
+    throw new TypeError('filePath must be a string')
+  }
+
+  var opts = mergeOptions(DEFAULT_PARSE_OPTIONS, options)
+  var nativeOpts = toNativeParseOptions(opts)
+
+  return new Reader(native.csvOpenReader(filePath, nativeOpts), opts)
+}
+
 /**
  * Convert array to CSV string
  * @param {Array} data - Array of arrays or array of objects
@@ -156,22 +550,35 @@ function parseFile(filePath, options) {
  * @returns {string} CSV string
  */
 function stringify(data, options) {
-  if (!Array.isArray(data)) {
-    throw new TypeError('data must be an array')
+  var prepared = prepareStringify(data, options)
+  if (prepared.rows.length === 0) {
+    return ''
   }
 
-  if (data.length === 0) {
-    return ''
+  return native.csvStringify(prepared.rows, prepared.nativeOpts)
+}
+
+/**
+ * Validate stringify input and turn it into rows plus native options
+ * @param {Array} data - Array of arrays or array of objects
+ * @param {Object} [options] - Stringify options
+ * @returns {{rows: Array, nativeOpts: Object}}
+ */
+function prepareStringify(data, options) {
+  if (!Array.isArray(data)) {
+    throw new TypeError('data must be an array')
   }
 
   var opts = mergeOptions(DEFAULT_STRINGIFY_OPTIONS, options)
   validateDelimiter(opts.delimiter, 'delimiter')
   validateDelimiter(opts.quote, 'quote')
 
-  var firstItem = data[0]
-  var isObjectArray = typeof firstItem === 'object' && !Array.isArray(firstItem)
-
-  var rows = isObjectArray ? objectsToRows(data, opts.headers) : data
+  var rows = data
+  if (data.length > 0) {
+    var firstItem = data[0]
+    var isObjectArray = typeof firstItem === 'object' && !Array.isArray(firstItem)
+    rows = isObjectArray ? objectsToRows(data, opts.headers) : data
+  }
 
   var nativeOpts = {
     delimiter: opts.delimiter,
@@ -180,7 +587,33 @@ function stringify(data, options) {
     lineEnding: opts.lineEnding
   }
 
-  return native.csvStringify(rows, nativeOpts)
+  return { rows: rows, nativeOpts: nativeOpts }
+}
+
+/**
+ * Convert array to CSV string off the JS thread
+ * Field values are copied out of JS up front; the serialization runs on
+ * the libuv thread pool.
+ * @param {Array} data - Array of arrays or array of objects
+ * @param {Object} [options] - Stringify options
+ * @returns {Promise<string>} CSV string
+ */
+function stringifyAsync(data, options) {
+  return new Promise(function(resolve, reject) {
+    var prepared = prepareStringify(data, options)
+    if (prepared.rows.length === 0) {
+      resolve('')
+      return
+    }
+
+    native.csvStringifyAsync(prepared.rows, prepared.nativeOpts, function(err, csvString) {
+      if (err) {
+        reject(err)
+        return
+      }
+      resolve(csvString)
+    })
+  })
 }
 
 /**
@@ -199,9 +632,148 @@ function writeFile(filePath, data, options) {
   return native.csvWriteFile(filePath, csvString)
 }
 
+/**
+ * Streaming CSV file writer
+ * Rows are encoded into a fixed-size native buffer that is written to
+ * the file whenever it fills, so memory stays bounded however many rows
+ * are written.
+ * @param {Object} nativeWriter - Native CsvWriter handle
+ * @param {Object} opts - Merged stringify options
+ */
+function Writer(nativeWriter, opts) {
+  this._native = nativeWriter
+  this._useHeaders = opts.headers
+  this.columns = null
+}
+
+/**
+ * Bytes written to the file so far (not counting buffered output)
+ * @returns {number}
+ */
+Object.defineProperty(Writer.prototype, 'bytesWritten', {
+  get: function() {
+    return this._native.bytesWritten
+  }
+})
+
+/**
+ * Write one row
+ * @param {Array|Object} row - Array of strings, or an object (see writeRows)
+ */
+Writer.prototype.write = function(row) {
+  this.writeRows([row])
+}
+
+/**
+ * Write a batch of rows
+ * Object rows use the keys of the first object ever written as the
+ * column list; with headers enabled it is written as the first line.
+ * @param {Array} rows - Array of arrays or array of objects
+ */
+Writer.prototype.writeRows = function(rows) {
+  if (!Array.isArray(rows)) {
+    throw new TypeError('rows must be an array')
+  }
+  if (rows.length === 0) {
+    return
+  }
+
+  var firstItem = rows[0]
+  var isObjectArray = typeof firstItem === 'object' && !Array.isArray(firstItem)
+
+  if (isObjectArray) {
+    var isFirstBatch = !this.columns
+    if (isFirstBatch) {
+      this.columns = Object.keys(firstItem)
+    }
+
+    var converted = isFirstBatch && this._useHeaders ? [this.columns] : []
+    for (var i = 0; i < rows.length; i++) {
+      converted.push(objectToRow(rows[i], this.columns))
+    }
+    rows = converted
+  }
+
+  this._native.writeRows(rows)
+}
+
+/**
+ * Write buffered rows to the file now
+ */
+Writer.prototype.flush = function() {
+  this._native.flush()
+}
+
+/**
+ * Flush and close the file
+ * @returns {boolean} True if every write succeeded
+ */
+Writer.prototype.close = function() {
+  return this._native.close()
+}
+
+/**
+ * Open a CSV file for streaming output
+ * @param {string} filePath - Output file path
+ * @param {Object} [options] - Stringify options
+ * @returns {Writer}
+ */
+function createWriter(filePath, options) {
+  if (typeof filePath !== 'string') {
+    throw new TypeError('filePath must be a string')
+  }
+
+  var opts = mergeOptions(DEFAULT_STRINGIFY_OPTIONS, options)
+  validateDelimiter(opts.delimiter, 'delimiter')
+  validateDelimiter(opts.quote, 'quote')
+
+  var nativeOpts = {
+    delimiter: opts.delimiter,
+    quote: opts.quote,
+    quoteAll: opts.quoteAll,
+    lineEnding: opts.lineEnding
+  }
+
+  return new Writer(native.csvOpenWriter(filePath, nativeOpts), opts)
+}
+
+/**
+ * Write array to CSV file off the JS thread
+ * Serialization and the file write both run on the libuv thread pool.
+ * @param {string} filePath - Output file path
+ * @param {Array} data - Array of arrays or array of objects
+ * @param {Object} [options] - Stringify options
+ * @returns {Promise<boolean>} True if successful
+ */
+function writeFileAsync(filePath, data, options) {
+  return new Promise(function(resolve, reject) {
+    if (typeof filePath !== 'string') {
+      throw new TypeError('filePath must be a string')
+    }
+
+    var prepared = prepareStringify(data, options)
+
+    native.csvWriteFileAsync(filePath, prepared.rows, prepared.nativeOpts, function(err, success) {
+      if (err) {
+        reject(err)
+        return
+      }
+      resolve(success)
+    })
+  })
+}
+
 module.exports = {
   parse: parse,
   parseFile: parseFile,
+  parseFileAsync: parseFileAsync,
+  parseColumns: parseColumns,
+  parseFileColumns: parseFileColumns,
+  parseFileColumnsAsync: parseFileColumnsAsync,
+  createReader: createReader,
   stringify: stringify,
-  writeFile: writeFile
+  stringifyAsync: stringifyAsync,
+  createWriter: createWriter,
+  writeFile: writeFile,
+  writeFileAsync: writeFileAsync
 }
@@ -0,0 +1,417 @@
+#include "csv_columns.h"
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
+namespace csvparser {
+
+static const double NOT_A_NUMBER = std::numeric_limits<double>::quiet_NaN();
+
+static bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+bool parseInt32(const char* data, size_t length, int32_t& out) {
+  size_t i = 0;
+  bool negative = false;
+
+  if (length > 0 && (data[0] == '-' || data[0] == '+')) {
+    negative = data[0] == '-';
+    i = 1;
+  }
+  if (i == length || length - i > 10) {
+    return false;
+  }
+
+  int64_t value = 0;
+  for (; i < length; i++) {
+    if (!isDigit(data[i])) {
+      return false;
+    }
+    value = value * 10 + (data[i] - '0');
+  }
+
+  if (negative) {
+    value = -value;
+  }
+  if (value < INT32_MIN || value > INT32_MAX) {
+    return false;
+  }
+
+  out = static_cast<int32_t>(value);
+  return true;
+}
+
+bool parseFloat64(const char* data, size_t length, double& out) {
+  // strtod needs a terminated copy; anything longer is not a plain number
+  char buffer[64];
+  if (length == 0 || length >= sizeof(buffer)) {
+    return false;
+  }
+
+  // strtod also takes hex, "inf" and "nan", none of which JS parseFloat
+  // would return a number for
+  bool sawDigit = false;
+  for (size_t i = 0; i < length; i++) {
+    char c = data[i];
+    if (isDigit(c)) {
+      sawDigit = true;
+    } else if (c != '-' && c != '+' && c != '.' && c != 'e' && c != 'E') {
+      return false;
+    }
+  }
+  if (!sawDigit) {
+    return false;
+  }
+
+  memcpy(buffer, data, length);
+  buffer[length] = '\0';
+
+  char* end = NULL;
+  double value = strtod(buffer, &end);
+  if (end != buffer + length) {
+    return false;
+  }
+
+  out = value;
+  return true;
+}
+
+static bool readNumber(const char* data, size_t digits, int& out) {
+  out = 0;
+  for (size_t i = 0; i < digits; i++) {
+    if (!isDigit(data[i])) {
+      return false;
+    }
+    out = out * 10 + (data[i] - '0');
+  }
+  return true;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+static int64_t daysFromCivil(int year, int month, int day) {
+  year -= month <= 2 ? 1 : 0;
+  int64_t era = (year >= 0 ? year : year - 399) / 400;
+  int64_t yearOfEra = year - era * 400;
+  int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  return era * 146097 + dayOfEra - 719468;
+}
+
+static int daysInMonth(int year, int month) {
+  static const int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+  bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+  return (month == 2 && leap) ? 29 : days[month - 1];
+}
+
+// ISO 8601 subset: YYYY-MM-DD, optionally followed by T or a space,
+// HH:MM[:SS[.fraction]] and Z or +HH[:]MM / -HH[:]MM
+bool parseDate(const char* data, size_t length, double& out) {
+  int year, month, day;
+  if (length < 10 || data[4] != '-' || data[7] != '-' ||
+      !readNumber(data, 4, year) || !readNumber(data + 5, 2, month) ||
+      !readNumber(data + 8, 2, day)) {
+    return false;
+  }
+  if (month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month)) {
+    return false;
+  }
+
+  int64_t millis = daysFromCivil(year, month, day) * 86400000LL;
+  size_t pos = 10;
+
+  if (pos < length) {
+    int hour, minute;
+    if ((data[pos] != 'T' && data[pos] != ' ') || length < pos + 6 || data[pos + 3] != ':' ||
+        !readNumber(data + pos + 1, 2, hour) || !readNumber(data + pos + 4, 2, minute) ||
+        hour > 23 || minute > 59) {
+      return false;
+    }
+    millis += hour * 3600000LL + minute * 60000LL;
+    pos += 6;
+
+    if (pos < length && data[pos] == ':') {
+      int second;
+      if (length < pos + 3 || !readNumber(data + pos + 1, 2, second) || second > 59) {
+        return false;
+      }
+      millis += second * 1000LL;
+      pos += 3;
+
+      if (pos < length && data[pos] == '.') {
+        pos++;
+        int scale = 100;
+        size_t start = pos;
+        while (pos < length && isDigit(data[pos])) {
+          millis += (data[pos] - '0') * scale;
+          scale /= 10;
+          pos++;
+        }
+        if (pos == start) {
+          return false;
+        }
+      }
+    }
+
+    if (pos < length && data[pos] == 'Z') {
+      pos++;
+    } else if (pos < length && (data[pos] == '+' || data[pos] == '-')) {
+      int sign = data[pos] == '-' ? -1 : 1;
+      int offsetHours, offsetMinutes = 0;
+      if (length < pos + 3 || !readNumber(data + pos + 1, 2, offsetHours)) {
+        return false;
+      }
+      pos += 3;
+      if (pos < length && data[pos] == ':') {
+        pos++;
+      }
+      if (pos < length) {
+        if (length < pos + 2 || !readNumber(data + pos, 2, offsetMinutes)) {
+          return false;
+        }
+        pos += 2;
+      }
+      millis -= sign * (offsetHours * 3600000LL + offsetMinutes * 60000LL);
+    }
+  }
+
+  if (pos != length) {
+    return false;
+  }
+
+  out = static_cast<double>(millis);
+  return true;
+}
+
+bool columnTypeFromName(const std::string& name, ColumnType& type) {
+  if (name == "string") {
+    type = COLUMN_STRING;
+  } else if (name == "int32") {
+    type = COLUMN_INT32;
+  } else if (name == "float64" || name == "number") {
+    type = COLUMN_FLOAT64;
+  } else if (name == "date") {
+    type = COLUMN_DATE;
+  } else if (name == "auto") {
+    type = COLUMN_AUTO;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char* columnTypeName(ColumnType type) {
+  switch (type) {
+    case COLUMN_AUTO:    return "auto";
+    case COLUMN_STRING:  return "string";
+    case COLUMN_INT32:   return "int32";
+    case COLUMN_FLOAT64: return "float64";
+    case COLUMN_DATE:    return "date";
+  }
+  return "unknown";
+}
+
+// Cell text, pointing into the table buffer unless the field has to be
+// unescaped first (then into scratch)
+static void cellText(const ParsedTable& table, size_t row, size_t column,
+                     std::string& scratch, const char*& data, size_t& length) {
+  if (column >= table.rowWidth(row)) {
+    data = "";
+    length = 0;
+    return;
+  }
+
+  const FieldSpan& span = table.field(row, column);
+  if (span.needsUnescape) {
+    scratch = table.value(span);
+    data = scratch.data();
+    length = scratch.length();
+  } else {
+    data = table.data(span);
+    length = span.length;
+  }
+}
+
+static ColumnType inferColumnType(const ParsedTable& table, size_t column,
+                                  size_t firstRow, size_t inferRows) {
+  bool allInt = true;
+  bool allNumber = true;
+  bool allDate = true;
+  size_t seen = 0;
+  std::string scratch;
+
+  for (size_t row = firstRow; row < table.rowCount() && seen < inferRows; row++) {
+    const char* data;
+    size_t length;
+    cellText(table, row, column, scratch, data, length);
+    if (length == 0) {
+      continue;
+    }
+    seen++;
+
+    int32_t intValue;
+    double number;
+    if (allInt && !parseInt32(data, length, intValue)) {
+      allInt = false;
+    }
+    if (allNumber && !allInt && !parseFloat64(data, length, number)) {
+      allNumber = false;
+    }
+    if (allDate && !parseDate(data, length, number)) {
+      allDate = false;
+    }
+    if (!allNumber && !allDate) {
+      break;
+    }
+  }
+
+  if (seen == 0) {
+    return COLUMN_STRING;
+  }
+  if (allInt) {
+    return COLUMN_INT32;
+  }
+  if (allNumber) {
+    return COLUMN_FLOAT64;
+  }
+  return allDate ? COLUMN_DATE : COLUMN_STRING;
+}
+
+// @returns false if a cell did not fit and strict is off (caller widens)
+static bool fillInt32(const ParsedTable& table, size_t column, size_t firstRow,
+                      bool strict, ColumnData& out) {
+  std::string scratch;
+  out.ints.reserve(table.rowCount() - firstRow);
+
+  for (size_t row = firstRow; row < table.rowCount(); row++) {
+    const char* data;
+    size_t length;
+    cellText(table, row, column, scratch, data, length);
+
+    int32_t value = 0;
+    if (!parseInt32(data, length, value) && !strict) {
+      std::vector<int32_t>().swap(out.ints);
+      return false;
+    }
+    out.ints.push_back(value);
+  }
+
+  return true;
+}
+
+// Empty cells are NaN either way; only non-empty junk makes a
+// non-strict fill give up
+static bool fillNumbers(const ParsedTable& table, size_t column, size_t firstRow,
+                        ColumnType type, bool strict, ColumnData& out) {
+  std::string scratch;
+  out.numbers.reserve(table.rowCount() - firstRow);
+
+  for (size_t row = firstRow; row < table.rowCount(); row++) {
+    const char* data;
+    size_t length;
+    cellText(table, row, column, scratch, data, length);
+
+    double value = NOT_A_NUMBER;
+    if (length > 0) {
+      bool parsed = type == COLUMN_DATE
+        ? parseDate(data, length, value)
+        : parseFloat64(data, length, value);
+      if (!parsed) {
+        if (!strict) {
+          std::vector<double>().swap(out.numbers);
+          return false;
+        }
+        value = NOT_A_NUMBER;
+      }
+    }
+    out.numbers.push_back(value);
+  }
+
+  return true;
+}
+
+static void fillStrings(const ParsedTable& table, size_t column, size_t firstRow, ColumnData& out) {
+  std::unordered_map<std::string, uint32_t> lookup;
+  std::string scratch;
+  std::string key;
+  out.indices.reserve(table.rowCount() - firstRow);
+
+  for (size_t row = firstRow; row < table.rowCount(); row++) {
+    const char* data;
+    size_t length;
+    cellText(table, row, column, scratch, data, length);
+
+    // assign() reuses key's capacity, so lookups of known values do not
+    // allocate
+    key.assign(data, length);
+    std::unordered_map<std::string, uint32_t>::iterator it = lookup.find(key);
+    if (it == lookup.end()) {
+      uint32_t index = static_cast<uint32_t>(out.dictionary.size());
+      out.dictionary.push_back(key);
+      it = lookup.insert(std::make_pair(key, index)).first;
+    }
+    out.indices.push_back(it->second);
+  }
+}
+
+static ColumnType schemaType(const ColumnarOptions& options, const std::string& name, size_t index) {
+  for (size_t i = 0; i < options.schema.size(); i++) {
+    const ColumnSpec& spec = options.schema[i];
+    bool matches = spec.name.empty() ? spec.index == index : spec.name == name;
+    if (matches) {
+      return spec.type;
+    }
+  }
+  return COLUMN_AUTO;
+}
+
+ColumnarTable buildColumns(const ParsedTable& table, const ColumnarOptions& options) {
+  ColumnarTable result;
+  size_t rowCount = table.rowCount();
+  size_t firstRow = (options.headers && rowCount > 0) ? 1 : 0;
+  result.rowCount = rowCount - firstRow;
+
+  size_t width = 0;
+  if (firstRow == 1) {
+    width = table.rowWidth(0);
+  } else {
+    for (size_t row = 0; row < rowCount; row++) {
+      if (table.rowWidth(row) > width) {
+        width = table.rowWidth(row);
+      }
+    }
+  }
+
+  result.columns.resize(width);
+
+  for (size_t column = 0; column < width; column++) {
+    ColumnData& out = result.columns[column];
+    out.name = firstRow == 1 ? table.value(table.field(0, column)) : std::to_string(column);
+
+    ColumnType type = schemaType(options, out.name, column);
+    bool strict = type != COLUMN_AUTO;
+    if (!strict) {
+      type = inferColumnType(table, column, firstRow, options.inferRows);
+    }
+
+    // Inferred types only saw a sample; widen if the rest disagrees
+    if (type == COLUMN_INT32 && !fillInt32(table, column, firstRow, strict, out)) {
+      type = COLUMN_FLOAT64;
+    }
+    if ((type == COLUMN_FLOAT64 || type == COLUMN_DATE) &&
+        !fillNumbers(table, column, firstRow, type, strict, out)) {
+      type = COLUMN_STRING;
+    }
+    if (type == COLUMN_STRING) {
+      fillStrings(table, column, firstRow, out);
+    }
+
+    out.type = type;
+  }
+
+  return result;
+}
+
+} // namespace csvparser
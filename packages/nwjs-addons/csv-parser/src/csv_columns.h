@@ -0,0 +1,78 @@
+#ifndef CSV_COLUMNS_H
+#define CSV_COLUMNS_H
+
+#include "csv_parser.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace csvparser {
+
+enum ColumnType {
+  COLUMN_AUTO,     // inferred from the first inferRows values
+  COLUMN_STRING,   // dictionary + index per row
+  COLUMN_INT32,
+  COLUMN_FLOAT64,
+  COLUMN_DATE      // epoch milliseconds (UTC when no offset is given)
+};
+
+// Type for one column, matched by header name or, when name is empty,
+// by position
+struct ColumnSpec {
+  std::string name;
+  size_t index;
+  ColumnType type;
+
+  ColumnSpec() : index(0), type(COLUMN_AUTO) {}
+};
+
+struct ColumnarOptions {
+  bool headers;
+  size_t inferRows;
+  std::vector<ColumnSpec> schema;
+
+  ColumnarOptions() :
+    headers(true),
+    inferRows(1000) {}
+};
+
+// One output column. Only the vector matching type is filled:
+// ints (COLUMN_INT32), numbers (COLUMN_FLOAT64 / COLUMN_DATE) or
+// dictionary + indices (COLUMN_STRING).
+struct ColumnData {
+  std::string name;
+  ColumnType type;
+  std::vector<int32_t> ints;
+  std::vector<double> numbers;
+  std::vector<std::string> dictionary;
+  std::vector<uint32_t> indices;
+
+  ColumnData() : type(COLUMN_STRING) {}
+};
+
+struct ColumnarTable {
+  size_t rowCount;
+  std::vector<ColumnData> columns;
+
+  ColumnarTable() : rowCount(0) {}
+};
+
+// Convert a parsed table to typed columns. Missing cells count as empty.
+// Empty or unparsable cells become NaN in float64/date columns and 0 in
+// an explicit int32 column; an inferred column that meets such a value
+// is widened instead (int32 -> float64 -> string, date -> string).
+ColumnarTable buildColumns(const ParsedTable& table, const ColumnarOptions& options);
+
+// "string", "int32", "float64"/"number", "date", "auto"
+bool columnTypeFromName(const std::string& name, ColumnType& type);
+const char* columnTypeName(ColumnType type);
+
+// Cell parsers (exposed for reuse). Input is not NUL-terminated; the
+// whole span must match.
+bool parseInt32(const char* data, size_t length, int32_t& out);
+bool parseFloat64(const char* data, size_t length, double& out);
+bool parseDate(const char* data, size_t length, double& out);
+
+} // namespace csvparser
+
+#endif // CSV_COLUMNS_H
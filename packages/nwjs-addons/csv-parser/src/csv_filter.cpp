@@ -0,0 +1,128 @@
+#include "csv_filter.h"
+#include "csv_columns.h"
+#include <algorithm>
+#include <cstring>
+
+namespace csvparser {
+
+// A field's text as the parser has it: not NUL-terminated, not owned
+struct FieldText {
+  const char* data;
+  size_t length;
+};
+
+static bool lessThan(const std::string& value, const FieldText& field) {
+  size_t common = std::min(value.length(), field.length);
+  int order = memcmp(value.data(), field.data, common);
+  return order < 0 || (order == 0 && value.length() < field.length);
+}
+
+static bool equals(const std::string& value, const char* data, size_t length) {
+  return value.length() == length && memcmp(value.data(), data, length) == 0;
+}
+
+RowSelector::RowSelector() :
+  active_(false),
+  resolved_(true),
+  keepAll_(true) {}
+
+RowSelector::RowSelector(const std::vector<ColumnRef>& select, const std::vector<RowFilter>& filters) :
+  select_(select),
+  filters_(filters),
+  active_(!select.empty() || !filters.empty()),
+  resolved_(true),
+  keepAll_(select.empty()) {
+  for (size_t i = 0; i < select_.size(); i++) {
+    if (!select_[i].name.empty()) {
+      resolved_ = false;
+    }
+  }
+
+  for (size_t i = 0; i < filters_.size(); i++) {
+    if (!filters_[i].column.name.empty()) {
+      resolved_ = false;
+    }
+    // Sorted so test() can binary-search
+    if (filters_[i].op == FILTER_IN) {
+      std::sort(filters_[i].values.begin(), filters_[i].values.end());
+    }
+  }
+
+  update(std::vector<std::string>());
+}
+
+void RowSelector::resolve(const std::vector<std::string>& header) {
+  resolved_ = true;
+  update(header);
+}
+
+size_t RowSelector::lookup(const ColumnRef& ref, const std::vector<std::string>& header) const {
+  if (ref.name.empty()) {
+    return ref.index;
+  }
+
+  for (size_t i = 0; i < header.size(); i++) {
+    if (header[i] == ref.name) {
+      return i;
+    }
+  }
+  return NO_COLUMN;
+}
+
+void RowSelector::update(const std::vector<std::string>& header) {
+  selection_.clear();
+  filterColumns_.clear();
+  needed_.clear();
+
+  for (size_t i = 0; i < select_.size(); i++) {
+    selection_.push_back(lookup(select_[i], header));
+  }
+  for (size_t i = 0; i < filters_.size(); i++) {
+    filterColumns_.push_back(lookup(filters_[i].column, header));
+  }
+
+  for (size_t i = 0; i < selection_.size() + filterColumns_.size(); i++) {
+    size_t column = i < selection_.size() ? selection_[i] : filterColumns_[i - selection_.size()];
+    if (column == NO_COLUMN) {
+      continue;
+    }
+    if (column >= needed_.size()) {
+      needed_.resize(column + 1, 0);
+    }
+    needed_[column] = 1;
+  }
+
+  repeated_.assign(selection_.size(), 0);
+  for (size_t i = 0; i < selection_.size(); i++) {
+    for (size_t j = i + 1; j < selection_.size(); j++) {
+      if (selection_[j] == selection_[i]) {
+        repeated_[i] = 1;
+        break;
+      }
+    }
+  }
+}
+
+bool RowSelector::test(size_t i, const char* data, size_t length) const {
+  const RowFilter& filter = filters_[i];
+
+  switch (filter.op) {
+    case FILTER_EQUALS:
+      return filter.values.empty() ? length == 0 : equals(filter.values[0], data, length);
+
+    case FILTER_IN: {
+      FieldText field = { data, length };
+      std::vector<std::string>::const_iterator it =
+        std::lower_bound(filter.values.begin(), filter.values.end(), field, lessThan);
+      return it != filter.values.end() && equals(*it, data, length);
+    }
+
+    case FILTER_RANGE: {
+      double number;
+      return parseFloat64(data, length, number) && number >= filter.min && number <= filter.max;
+    }
+  }
+  return false;
+}
+
+} // namespace csvparser
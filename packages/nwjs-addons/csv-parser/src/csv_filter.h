@@ -0,0 +1,94 @@
+#ifndef CSV_FILTER_H
+#define CSV_FILTER_H
+
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace csvparser {
+
+// Column position that is not in the row (reads as an empty field)
+const size_t NO_COLUMN = static_cast<size_t>(-1);
+
+// A column by header name or, when name is empty, by position
+struct ColumnRef {
+  std::string name;
+  size_t index;
+
+  ColumnRef() : index(0) {}
+};
+
+enum FilterOp {
+  FILTER_EQUALS,  // field == values[0]
+  FILTER_IN,      // field is one of values
+  FILTER_RANGE    // min <= field <= max, as a number
+};
+
+struct RowFilter {
+  ColumnRef column;
+  FilterOp op;
+  std::vector<std::string> values;
+  double min;
+  double max;
+
+  RowFilter() :
+    op(FILTER_EQUALS),
+    min(-HUGE_VAL),
+    max(HUGE_VAL) {}
+};
+
+// ParseOptions::select / ::filters with header names resolved to column
+// positions. The parser asks it which fields to keep and whether a
+// finished row passes; rows are projected to selection() order.
+class RowSelector {
+public:
+  RowSelector();
+  RowSelector(const std::vector<ColumnRef>& select, const std::vector<RowFilter>& filters);
+
+  bool isActive() const { return active_; }
+
+  // True while some column is still known only by name
+  bool needsHeader() const { return !resolved_; }
+
+  // Look names up in the header row (first match wins). Names that are
+  // not there refer to no column.
+  void resolve(const std::vector<std::string>& header);
+
+  // Whether the text of this column is needed (selected or filtered on)
+  bool isNeeded(size_t column) const {
+    return keepAll_ || (column < needed_.size() && needed_[column]);
+  }
+
+  // Output field i is column selection()[i] (NO_COLUMN if unresolved).
+  // Empty when every column is kept.
+  const std::vector<size_t>& selection() const { return selection_; }
+
+  // True if output field i must be copied rather than moved, because a
+  // later output field takes the same column
+  bool isRepeated(size_t i) const { return repeated_[i] != 0; }
+
+  size_t filterCount() const { return filters_.size(); }
+  size_t filterColumn(size_t i) const { return filterColumns_[i]; }
+
+  // Does a field pass filter i?
+  bool test(size_t i, const char* data, size_t length) const;
+
+private:
+  size_t lookup(const ColumnRef& ref, const std::vector<std::string>& header) const;
+  void update(const std::vector<std::string>& header);
+
+  std::vector<ColumnRef> select_;
+  std::vector<RowFilter> filters_;
+  std::vector<size_t> selection_;
+  std::vector<size_t> filterColumns_;
+  std::vector<char> needed_;
+  std::vector<char> repeated_;
+  bool active_;
+  bool resolved_;
+  bool keepAll_;
+};
+
+} // namespace csvparser
+
+#endif // CSV_FILTER_H
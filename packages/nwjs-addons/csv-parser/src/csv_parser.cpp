@@ -1,16 +1,13 @@
 #include "csv_parser.h"
+#include "csv_scanner.h"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
-#include <sstream>
+#include <thread>
+#include <utility>
 
 namespace csvparser {
 
-enum ParserState {
-  STATE_FIELD_START,
-  STATE_UNQUOTED_FIELD,
-  STATE_QUOTED_FIELD,
-  STATE_QUOTE_IN_QUOTED
-};
-
 static std::string trimString(const std::string& str) {
   size_t start = 0;
   size_t end = str.length();
@@ -25,211 +22,913 @@ static std::string trimString(const std::string& str) {
   return str.substr(start, end - start);
 }
 
-static bool isRowEmpty(const std::vector<std::string>& row) {
-  if (row.empty()) {
+static void trimSpan(const char*& data, size_t& length) {
+  while (length > 0 && (data[0] == ' ' || data[0] == '\t')) {
+    data++;
+    length--;
+  }
+  while (length > 0 && (data[length - 1] == ' ' || data[length - 1] == '\t')) {
+    length--;
+  }
+}
+
+static bool isBom(const char* data) {
+  return (unsigned char)data[0] == 0xEF &&
+         (unsigned char)data[1] == 0xBB &&
+         (unsigned char)data[2] == 0xBF;
+}
+
+// Same dialect, without select/filters/header handling
+static ParseOptions plainOptions(const ParseOptions& options) {
+  ParseOptions plain = options;
+  plain.select.clear();
+  plain.filters.clear();
+  plain.headerRow = false;
+  return plain;
+}
+
+// Decode the raw extent of one quoted/escaped field. It holds exactly one
+// field, so running it back through the parser decodes it with the same
+// options.
+static std::string decodeRawField(const char* data, size_t length, const ParseOptions& options) {
+  ParseOptions fieldOptions = plainOptions(options);
+  fieldOptions.skipEmptyLines = false;
+
+  CsvStreamParser parser(fieldOptions);
+  parser.feed(data, length);
+  parser.finish();
+
+  std::vector<std::vector<std::string>> rows;
+  parser.next(rows, 1);
+  if (rows.empty() || rows[0].empty()) {
+    return std::string();
+  }
+  return rows[0][0];
+}
+
+std::string ParsedTable::value(const FieldSpan& span) const {
+  if (!span.needsUnescape) {
+    return std::string(data(span), span.length);
+  }
+  return decodeRawField(data(span), span.length, options);
+}
+
+CsvStreamParser::CsvStreamParser(const ParseOptions& options)
+  : options_(options)
+  , table_(NULL)
+  , base_(NULL)
+  , state_(STATE_FIELD_START)
+  , spanData_(NULL)
+  , spanLength_(0)
+  , fieldStart_(NULL)
+  , chunkEnd_(NULL)
+  , rowHasContent_(false)
+  , records_(0)
+  , bomChecked_(false)
+  , skipLineFeed_(false)
+  , finished_(false)
+  , selector_(options.select, options.filters)
+  , headerPending_(options.headerRow)
+{
+  // Without a header row, names cannot refer to anything
+  if (!headerPending_ && selector_.needsHeader()) {
+    selector_.resolve(std::vector<std::string>());
+  }
+}
+
+CsvStreamParser::CsvStreamParser(const ParseOptions& options, ParsedTable* table, const char* base)
+  : options_(options)
+  , table_(table)
+  , base_(base)
+  , state_(STATE_FIELD_START)
+  , spanData_(NULL)
+  , spanLength_(0)
+  , fieldStart_(NULL)
+  , chunkEnd_(NULL)
+  , rowHasContent_(false)
+  , records_(0)
+  , bomChecked_(false)
+  , skipLineFeed_(false)
+  , finished_(false)
+  , selector_(options.select, options.filters)
+  , headerPending_(options.headerRow)
+{
+  if (!headerPending_ && selector_.needsHeader()) {
+    selector_.resolve(std::vector<std::string>());
+  }
+}
+
+// Field content is tracked as a pending span of the current chunk and only
+// copied into currentField_ when it stops being contiguous (escaped quote,
+// chunk boundary). A field that is a single span is built in one step.
+void CsvStreamParser::appendSpan(const char* data, size_t length) {
+  if (spanLength_ > 0 && spanData_ + spanLength_ == data) {
+    spanLength_ += length;
+    return;
+  }
+
+  flushSpan();
+  spanData_ = data;
+  spanLength_ = length;
+}
+
+void CsvStreamParser::appendChar(char c) {
+  flushSpan();
+  currentField_ += c;
+}
+
+void CsvStreamParser::flushSpan() {
+  if (spanLength_ > 0) {
+    currentField_.append(spanData_, spanLength_);
+    spanLength_ = 0;
+  }
+}
+
+// rawEnd is one past the last raw byte of the field (its terminator or
+// the end of input); only table mode needs it
+void CsvStreamParser::endField(const char* rawEnd) {
+  if (currentField_.empty()) {
+    const char* data = spanData_;
+    size_t length = spanLength_;
+    spanLength_ = 0;
+
+    if (options_.trim) {
+      trimSpan(data, length);
+    }
+    if (length > 0) {
+      rowHasContent_ = true;
+    }
+
+    if (table_ != NULL) {
+      FieldSpan span;
+      span.offset = length > 0 ? static_cast<size_t>(data - base_) : 0;
+      span.length = length;
+      span.needsUnescape = false;
+      table_->fields.push_back(span);
+    } else if (skipsField()) {
+      currentRow_.push_back(std::string());
+    } else {
+      currentRow_.push_back(std::string(data, length));
+    }
+    return;
+  }
+
+  flushSpan();
+  if (options_.trim) {
+    currentField_ = trimString(currentField_);
+  }
+  if (!currentField_.empty()) {
+    rowHasContent_ = true;
+  }
+
+  if (table_ != NULL) {
+    // Content was not contiguous in the buffer; keep the raw extent and
+    // let ParsedTable::value() decode it on demand
+    FieldSpan span;
+    span.offset = static_cast<size_t>(fieldStart_ - base_);
+    span.length = static_cast<size_t>(rawEnd - fieldStart_);
+    span.needsUnescape = true;
+    table_->fields.push_back(span);
+  } else {
+    bool skip = skipsField();
+    currentRow_.push_back(std::string());
+    if (!skip) {
+      currentRow_.back().swap(currentField_);
+    }
+  }
+  currentField_.clear();
+}
+
+// Row mode: a field no select entry or filter refers to is stored empty
+// instead of being copied (the header row is always kept whole)
+bool CsvStreamParser::skipsField() const {
+  return selector_.isActive() && !headerPending_ && !selector_.isNeeded(currentRow_.size());
+}
+
+void CsvStreamParser::fieldText(const FieldSpan& span, std::string& scratch,
+                                const char*& data, size_t& length) const {
+  if (span.needsUnescape) {
+    scratch = decodeRawField(base_ + span.offset, span.length, options_);
+    data = scratch.data();
+    length = scratch.length();
+  } else {
+    data = base_ + span.offset;
+    length = span.length;
+  }
+}
+
+bool CsvStreamParser::selectTableRow(size_t start) {
+  if (!selector_.isActive()) {
     return true;
   }
 
-  for (size_t i = 0; i < row.size(); i++) {
-    if (!row[i].empty()) {
-      return false;
+  std::vector<FieldSpan>& fields = table_->fields;
+  size_t width = fields.size() - start;
+  std::string scratch;
+  const char* data;
+  size_t length;
+
+  if (headerPending_) {
+    headerPending_ = false;
+    if (selector_.needsHeader()) {
+      std::vector<std::string> header(width);
+      for (size_t column = 0; column < width; column++) {
+        fieldText(fields[start + column], scratch, data, length);
+        header[column].assign(data, length);
+      }
+      selector_.resolve(header);
+    }
+  } else {
+    for (size_t i = 0; i < selector_.filterCount(); i++) {
+      size_t column = selector_.filterColumn(i);
+      data = "";
+      length = 0;
+      if (column < width) {
+        fieldText(fields[start + column], scratch, data, length);
+      }
+      if (!selector_.test(i, data, length)) {
+        return false;
+      }
     }
   }
 
+  // Spans are three words, so projecting is a small copy within the row
+  const std::vector<size_t>& selection = selector_.selection();
+  if (!selection.empty()) {
+    projectedSpans_.clear();
+    for (size_t i = 0; i < selection.size(); i++) {
+      FieldSpan span = { 0, 0, false };
+      if (selection[i] < width) {
+        span = fields[start + selection[i]];
+      }
+      projectedSpans_.push_back(span);
+    }
+    fields.resize(start);
+    fields.insert(fields.end(), projectedSpans_.begin(), projectedSpans_.end());
+  }
   return true;
 }
 
-std::vector<std::vector<std::string>> parse(
-  const std::string& input,
-  const ParseOptions& options
-) {
-  std::vector<std::vector<std::string>> result;
-  std::vector<std::string> currentRow;
-  std::string currentField;
-  ParserState state = STATE_FIELD_START;
+bool CsvStreamParser::selectRow() {
+  if (!selector_.isActive()) {
+    return true;
+  }
 
-  size_t i = 0;
-  size_t len = input.length();
+  size_t width = currentRow_.size();
+
+  if (headerPending_) {
+    headerPending_ = false;
+    if (selector_.needsHeader()) {
+      selector_.resolve(currentRow_);
+    }
+  } else {
+    static const std::string empty;
+    for (size_t i = 0; i < selector_.filterCount(); i++) {
+      size_t column = selector_.filterColumn(i);
+      const std::string& field = column < width ? currentRow_[column] : empty;
+      if (!selector_.test(i, field.data(), field.length())) {
+        return false;
+      }
+    }
+  }
+
+  const std::vector<size_t>& selection = selector_.selection();
+  if (!selection.empty()) {
+    projectedRow_.clear();
+    projectedRow_.resize(selection.size());
+    for (size_t i = 0; i < selection.size(); i++) {
+      size_t column = selection[i];
+      if (column >= width) {
+        continue;
+      }
+      if (selector_.isRepeated(i)) {
+        projectedRow_[i] = currentRow_[column];
+      } else {
+        projectedRow_[i].swap(currentRow_[column]);
+      }
+    }
+    currentRow_.swap(projectedRow_);
+  }
+  return true;
+}
 
-  // Skip UTF-8 BOM if present
-  if (len >= 3 &&
-      (unsigned char)input[0] == 0xEF &&
-      (unsigned char)input[1] == 0xBB &&
-      (unsigned char)input[2] == 0xBF) {
-    i = 3;
+void CsvStreamParser::endRow(const char* rawEnd) {
+  endField(rawEnd);
+  bool skipRow = options_.skipEmptyLines && !rowHasContent_;
+  rowHasContent_ = false;
+  records_++;
+
+  if (table_ != NULL) {
+    size_t start = table_->rowOffsets.back();
+    if (skipRow || !selectTableRow(start)) {
+      table_->fields.resize(start);
+    } else {
+      table_->rowOffsets.push_back(table_->fields.size());
+    }
+    return;
+  }
+
+  if (!skipRow && selectRow()) {
+    // Rows are usually the same width, so size the next one up front
+    // instead of regrowing it field by field
+    size_t width = currentRow_.size();
+    rows_.push_back(std::vector<std::string>());
+    rows_.back().swap(currentRow_);
+    rowRecords_.push_back(records_);
+    currentRow_.reserve(width);
+  }
+  currentRow_.clear();
+}
+
+void CsvStreamParser::feed(const char* data, size_t length) {
+  if (finished_) {
+    return;
+  }
+
+  // Skip UTF-8 BOM if present. The first chunk may be shorter than the
+  // BOM itself, so hold bytes back until three have been seen. Table mode
+  // always has the whole input and must not parse out of a copy.
+  if (!bomChecked_ && bomProbe_.empty() && (length >= 3 || table_ != NULL)) {
+    bomChecked_ = true;
+    if (length >= 3 && isBom(data)) {
+      data += 3;
+      length -= 3;
+    }
   }
 
-  while (i < len) {
-    char c = input[i];
-    char nextChar = (i + 1 < len) ? input[i + 1] : '\0';
+  if (!bomChecked_) {
+    size_t take = 3 - bomProbe_.size();
+    if (take > length) {
+      take = length;
+    }
+    bomProbe_.append(data, take);
+    data += take;
+    length -= take;
+
+    if (bomProbe_.size() < 3) {
+      return;
+    }
+
+    bomChecked_ = true;
+    if (!isBom(bomProbe_.data())) {
+      consume(bomProbe_.data(), bomProbe_.size());
+    }
+    bomProbe_.clear();
+  }
+
+  consume(data, length);
+}
+
+void CsvStreamParser::consume(const char* data, size_t length) {
+  size_t i = 0;
+  chunkEnd_ = data + length;
+  bool useScanner = activeScanLevel() != SCAN_BYTEWISE;
+  StructuralScanner scanner(data, length, options_.delimiter, options_.quote, options_.escape);
+
+  while (i < length) {
+    // Second half of a CRLF pair, possibly delivered in the next chunk
+    if (skipLineFeed_) {
+      skipLineFeed_ = false;
+      if (data[i] == '\n') {
+        i++;
+        continue;
+      }
+    }
+
+    // A plain field starts here: take it with the run of unquoted fields
+    // below rather than one byte through the switch
+    if (useScanner && state_ == STATE_FIELD_START) {
+      char c = data[i];
+      if (c != options_.quote && c != options_.delimiter && c != '\r' && c != '\n') {
+        fieldStart_ = data + i;
+        state_ = STATE_UNQUOTED_FIELD;
+      }
+    }
+
+    // Unquoted fields, one after another: jump from delimiter to
+    // delimiter, ending each field in place. Short fields would otherwise
+    // cost a pass through the switch for every first byte and delimiter.
+    if (useScanner && state_ == STATE_UNQUOTED_FIELD) {
+      for (;;) {
+        size_t spanEnd = scanner.nextUnquoted(i);
+        if (spanEnd > i) {
+          appendSpan(data + i, spanEnd - i);
+          i = spanEnd;
+        }
+        if (i == length || data[i] != options_.delimiter) {
+          break;
+        }
+
+        endField(data + i);
+        i++;
+        char c = i < length ? data[i] : options_.delimiter;
+        if (c == options_.quote || c == options_.delimiter || c == '\r' || c == '\n') {
+          state_ = STATE_FIELD_START;
+          break;
+        }
+        fieldStart_ = data + i;
+      }
+      if (i == length) {
+        break;
+      }
+      if (state_ == STATE_FIELD_START) {
+        continue;
+      }
+    }
+
+    // Inside a quoted field, jump straight to the next quote or escape and
+    // append everything before it as one span
+    if (useScanner && state_ == STATE_QUOTED_FIELD) {
+      size_t spanEnd = scanner.nextQuoted(i);
+      if (spanEnd > i) {
+        appendSpan(data + i, spanEnd - i);
+        i = spanEnd;
+        if (i == length) {
+          break;
+        }
+      }
+    }
+
+    char c = data[i];
 
-    switch (state) {
+    switch (state_) {
       case STATE_FIELD_START:
-        if (c == options.quote) {
-          state = STATE_QUOTED_FIELD;
-          i++;
-        } else if (c == options.delimiter) {
-          std::string field = options.trim ? trimString(currentField) : currentField;
-          currentRow.push_back(field);
-          currentField.clear();
-          i++;
+        if (c == options_.quote) {
+          fieldStart_ = data + i;
+          state_ = STATE_QUOTED_FIELD;
+        } else if (c == options_.delimiter) {
+          endField(data + i);
         } else if (c == '\r') {
-          std::string field = options.trim ? trimString(currentField) : currentField;
-          currentRow.push_back(field);
-          bool skipRow = options.skipEmptyLines && isRowEmpty(currentRow);
-          if (!skipRow) {
-            result.push_back(currentRow);
-          }
-          currentRow.clear();
-          currentField.clear();
-          i++;
-          if (nextChar == '\n') {
-            i++;
-          }
+          endRow(data + i);
+          skipLineFeed_ = true;
         } else if (c == '\n') {
-          std::string field = options.trim ? trimString(currentField) : currentField;
-          currentRow.push_back(field);
-          bool skipRow = options.skipEmptyLines && isRowEmpty(currentRow);
-          if (!skipRow) {
-            result.push_back(currentRow);
-          }
-          currentRow.clear();
-          currentField.clear();
-          i++;
+          endRow(data + i);
         } else {
-          currentField += c;
-          state = STATE_UNQUOTED_FIELD;
-          i++;
+          fieldStart_ = data + i;
+          appendSpan(data + i, 1);
+          state_ = STATE_UNQUOTED_FIELD;
         }
+        i++;
         break;
 
       case STATE_UNQUOTED_FIELD:
-        if (c == options.delimiter) {
-          std::string field = options.trim ? trimString(currentField) : currentField;
-          currentRow.push_back(field);
-          currentField.clear();
-          state = STATE_FIELD_START;
-          i++;
+        if (c == options_.delimiter) {
+          endField(data + i);
+          state_ = STATE_FIELD_START;
         } else if (c == '\r') {
-          std::string field = options.trim ? trimString(currentField) : currentField;
-          currentRow.push_back(field);
-          bool skipRow = options.skipEmptyLines && isRowEmpty(currentRow);
-          if (!skipRow) {
-            result.push_back(currentRow);
-          }
-          currentRow.clear();
-          currentField.clear();
-          state = STATE_FIELD_START;
-          i++;
-          if (nextChar == '\n') {
-            i++;
-          }
+          endRow(data + i);
+          state_ = STATE_FIELD_START;
+          skipLineFeed_ = true;
         } else if (c == '\n') {
-          std::string field = options.trim ? trimString(currentField) : currentField;
-          currentRow.push_back(field);
-          bool skipRow = options.skipEmptyLines && isRowEmpty(currentRow);
-          if (!skipRow) {
-            result.push_back(currentRow);
-          }
-          currentRow.clear();
-          currentField.clear();
-          state = STATE_FIELD_START;
-          i++;
+          endRow(data + i);
+          state_ = STATE_FIELD_START;
         } else {
-          currentField += c;
-          i++;
+          appendSpan(data + i, 1);
         }
+        i++;
         break;
 
       case STATE_QUOTED_FIELD:
-        if (c == options.escape && nextChar == options.quote) {
-          currentField += options.quote;
-          i += 2;
-        } else if (c == options.quote) {
-          state = STATE_QUOTE_IN_QUOTED;
-          i++;
+        // A doubled quote is handled by STATE_QUOTE_IN_QUOTED, so a
+        // separate escape state is only needed for a distinct escape char
+        if (c == options_.escape && options_.escape != options_.quote) {
+          state_ = STATE_ESCAPE_IN_QUOTED;
+        } else if (c == options_.quote) {
+          state_ = STATE_QUOTE_IN_QUOTED;
         } else {
-          currentField += c;
+          appendSpan(data + i, 1);
+        }
+        i++;
+        break;
+
+      case STATE_ESCAPE_IN_QUOTED:
+        state_ = STATE_QUOTED_FIELD;
+        if (c == options_.quote) {
+          appendSpan(data + i, 1);
           i++;
+        } else {
+          // Not an escape sequence: keep the escape char literally and
+          // reprocess c as ordinary quoted content
+          appendChar(options_.escape);
         }
         break;
 
       case STATE_QUOTE_IN_QUOTED:
-        if (c == options.quote) {
-          currentField += options.quote;
-          state = STATE_QUOTED_FIELD;
-          i++;
-        } else if (c == options.delimiter) {
-          std::string field = options.trim ? trimString(currentField) : currentField;
-          currentRow.push_back(field);
-          currentField.clear();
-          state = STATE_FIELD_START;
-          i++;
+        if (c == options_.quote) {
+          appendSpan(data + i, 1);
+          state_ = STATE_QUOTED_FIELD;
+        } else if (c == options_.delimiter) {
+          endField(data + i);
+          state_ = STATE_FIELD_START;
         } else if (c == '\r') {
-          std::string field = options.trim ? trimString(currentField) : currentField;
-          currentRow.push_back(field);
-          bool skipRow = options.skipEmptyLines && isRowEmpty(currentRow);
-          if (!skipRow) {
-            result.push_back(currentRow);
-          }
-          currentRow.clear();
-          currentField.clear();
-          state = STATE_FIELD_START;
-          i++;
-          if (nextChar == '\n') {
-            i++;
-          }
+          endRow(data + i);
+          state_ = STATE_FIELD_START;
+          skipLineFeed_ = true;
         } else if (c == '\n') {
-          std::string field = options.trim ? trimString(currentField) : currentField;
-          currentRow.push_back(field);
-          bool skipRow = options.skipEmptyLines && isRowEmpty(currentRow);
-          if (!skipRow) {
-            result.push_back(currentRow);
-          }
-          currentRow.clear();
-          currentField.clear();
-          state = STATE_FIELD_START;
-          i++;
+          endRow(data + i);
+          state_ = STATE_FIELD_START;
         } else {
-          currentField += c;
-          state = STATE_UNQUOTED_FIELD;
-          i++;
+          appendSpan(data + i, 1);
+          state_ = STATE_UNQUOTED_FIELD;
         }
+        i++;
         break;
     }
   }
 
+  // The chunk is about to go away; keep any partial field. A table's
+  // buffer outlives the parse, so its pending span can stay a span.
+  if (table_ == NULL) {
+    flushSpan();
+  }
+}
+
+void CsvStreamParser::finish() {
+  if (finished_) {
+    return;
+  }
+
+  // Input shorter than a BOM never reached consume()
+  if (!bomChecked_) {
+    bomChecked_ = true;
+    consume(bomProbe_.data(), bomProbe_.size());
+    bomProbe_.clear();
+  }
+
+  if (state_ == STATE_ESCAPE_IN_QUOTED) {
+    appendChar(options_.escape);
+  }
+
   // Handle final field/row
-  bool hasContent = !currentField.empty() || !currentRow.empty();
+  bool rowStarted = table_ != NULL
+    ? table_->fields.size() > table_->rowOffsets.back()
+    : !currentRow_.empty();
+  bool hasContent = !currentField_.empty() || spanLength_ > 0 || rowStarted;
   if (hasContent) {
-    std::string field = options.trim ? trimString(currentField) : currentField;
-    currentRow.push_back(field);
-    bool skipRow = options.skipEmptyLines && isRowEmpty(currentRow);
-    if (!skipRow) {
-      result.push_back(currentRow);
+    endRow(chunkEnd_);
+  }
+
+  state_ = STATE_FIELD_START;
+  finished_ = true;
+}
+
+bool CsvStreamParser::parseSlice(const char* data, size_t length, bool first, bool last) {
+  if (first) {
+    feed(data, length);
+  } else {
+    bomChecked_ = true;
+    headerPending_ = false;
+    consume(data, length);
+  }
+
+  if (last) {
+    finish();
+    return true;
+  }
+
+  // Anything pending means the slice ended inside a field or row
+  return state_ == STATE_FIELD_START && !skipLineFeed_ &&
+         table_->fields.size() == table_->rowOffsets.back();
+}
+
+size_t CsvStreamParser::next(std::vector<std::vector<std::string>>& out, size_t maxRows,
+                             std::vector<uint64_t>* records) {
+  size_t count = 0;
+
+  while (count < maxRows && !rows_.empty()) {
+    out.push_back(std::vector<std::string>());
+    out.back().swap(rows_.front());
+    rows_.pop_front();
+    if (records != NULL) {
+      records->push_back(rowRecords_.front());
     }
+    rowRecords_.pop_front();
+    count++;
   }
 
+  return count;
+}
+
+CsvFileReader::CsvFileReader(const ParseOptions& options, size_t blockSize)
+  : parser_(options)
+  , offset_(0)
+  , blockSize_(blockSize > 0 ? blockSize : DEFAULT_BLOCK_SIZE)
+  , bytesRead_(0)
+  , fileSize_(0)
+{
+}
+
+bool CsvFileReader::open(const std::string& filePath, uint64_t offset) {
+  // Map only: a heap copy of the whole file would defeat the point of
+  // reading incrementally, so fall back to block reads instead
+  if (view_.open(filePath, false)) {
+    offset_ = offset < view_.size() ? static_cast<size_t>(offset) : view_.size();
+    bytesRead_ = offset_;
+    fileSize_ = view_.size();
+    return true;
+  }
+
+  file_.open(filePath.c_str(), std::ios::binary);
+  if (file_.is_open()) {
+    block_.resize(blockSize_);
+    file_.seekg(0, std::ios::end);
+    fileSize_ = static_cast<uint64_t>(file_.tellg());
+    bytesRead_ = std::min(offset, fileSize_);
+    file_.seekg(static_cast<std::streamoff>(bytesRead_));
+  }
+  return file_.is_open();
+}
+
+size_t CsvFileReader::next(std::vector<std::vector<std::string>>& out, size_t maxRows,
+                           std::vector<uint64_t>* records) {
+  while (parser_.pendingRows() < maxRows && !parser_.isFinished()) {
+    if (view_.isOpen()) {
+      size_t length = std::min(blockSize_, view_.size() - offset_);
+      if (length > 0) {
+        parser_.feed(view_.data() + offset_, length);
+        offset_ += length;
+        bytesRead_ = offset_;
+      }
+      if (offset_ == view_.size()) {
+        parser_.finish();
+        view_.close();
+      }
+      continue;
+    }
+
+    if (!file_.is_open()) {
+      parser_.finish();
+      break;
+    }
+
+    file_.read(&block_[0], static_cast<std::streamsize>(block_.size()));
+    size_t bytesRead = static_cast<size_t>(file_.gcount());
+
+    if (bytesRead > 0) {
+      parser_.feed(&block_[0], bytesRead);
+      bytesRead_ += bytesRead;
+    }
+
+    if (bytesRead < block_.size()) {
+      parser_.finish();
+      file_.close();
+    }
+  }
+
+  return parser_.next(out, maxRows, records);
+}
+
+bool CsvFileReader::isDone() const {
+  return parser_.isFinished() && parser_.pendingRows() == 0;
+}
+
+void CsvFileReader::close() {
+  view_.close();
+  if (file_.is_open()) {
+    file_.close();
+  }
+}
+
+std::vector<std::vector<std::string>> parse(
+  const std::string& input,
+  const ParseOptions& options
+) {
+  std::vector<std::vector<std::string>> result;
+
+  CsvStreamParser parser(options);
+  parser.feed(input.data(), input.length());
+  parser.finish();
+  parser.next(result, parser.pendingRows());
+
   return result;
 }
 
-std::string readFileContents(const std::string& filePath) {
-  std::ifstream file(filePath.c_str(), std::ios::binary);
-  if (!file.is_open()) {
-    return "";
+static unsigned sliceCountFor(const ParseOptions& options, size_t length) {
+  size_t count = options.threads;
+  if (count == 0) {
+    count = std::thread::hardware_concurrency();
+  }
+
+  size_t bySize = length / MIN_PARALLEL_SLICE;
+  if (count > bySize) {
+    count = bySize;
+  }
+  return count < 1 ? 1 : static_cast<unsigned>(count);
+}
+
+static size_t countQuotes(const char* data, size_t length, char quote) {
+  size_t count = 0;
+  for (size_t i = 0; i < length; i++) {
+    count += data[i] == quote;
+  }
+  return count;
+}
+
+// Speculative split into roughly equal slices. Quote counts per nominal
+// slice are gathered in parallel, which gives the quote parity at each
+// nominal boundary; the boundary then moves forward to just past the
+// first newline where the parity is even, i.e. outside any quoted field.
+// Escape characters and stray quotes in unquoted fields can fool this,
+// so parseTable() verifies every boundary after parsing.
+// @returns slice start offsets (the first is always 0)
+static std::vector<size_t> findSliceStarts(const char* data, size_t length,
+                                           unsigned slices, char quote) {
+  size_t step = length / slices;
+  std::vector<size_t> nominal(slices + 1);
+  for (unsigned k = 0; k < slices; k++) {
+    nominal[k] = step * k;
+  }
+  nominal[slices] = length;
+
+  std::vector<size_t> quotes(slices);
+  std::vector<std::thread> workers;
+  for (unsigned k = 1; k < slices; k++) {
+    workers.push_back(std::thread([&, k]() {
+      quotes[k] = countQuotes(data + nominal[k], nominal[k + 1] - nominal[k], quote);
+    }));
+  }
+  quotes[0] = countQuotes(data, nominal[1], quote);
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+
+  std::vector<size_t> starts(1, 0);
+  size_t quotesBefore = 0;
+
+  for (unsigned k = 1; k < slices; k++) {
+    quotesBefore += quotes[k - 1];
+    size_t parity = quotesBefore;
+
+    for (size_t pos = nominal[k]; pos < nominal[k + 1]; pos++) {
+      char c = data[pos];
+      if (c == quote) {
+        parity++;
+      } else if (c == '\n' && parity % 2 == 0) {
+        if (pos + 1 < length) {
+          starts.push_back(pos + 1);
+        }
+        break;
+      }
+    }
+    // No balanced newline in this slice: it merges into the previous one
+  }
+
+  return starts;
+}
+
+static void appendPart(ParsedTable& table, const ParsedTable& part) {
+  size_t fieldBase = table.fields.size();
+  table.fields.insert(table.fields.end(), part.fields.begin(), part.fields.end());
+  for (size_t r = 1; r < part.rowOffsets.size(); r++) {
+    table.rowOffsets.push_back(fieldBase + part.rowOffsets[r]);
+  }
+}
+
+ParsedTable parseTable(std::string input, const ParseOptions& options) {
+  ParsedTable table;
+  table.buffer.swap(input);
+  CsvStreamParser::parseInto(table, options);
+  return table;
+}
+
+ParsedTable parseTable(FileView file, const ParseOptions& options) {
+  ParsedTable table;
+  table.file = std::move(file);
+  CsvStreamParser::parseInto(table, options);
+  return table;
+}
+
+// First row (after skipped empty lines), parsed a block at a time so only
+// the start of the input is touched
+static std::vector<std::string> readHeaderRow(const char* data, size_t length, const ParseOptions& options) {
+  CsvStreamParser parser(plainOptions(options));
+  for (size_t pos = 0; pos < length && parser.pendingRows() == 0; pos += DEFAULT_BLOCK_SIZE) {
+    parser.feed(data + pos, std::min(DEFAULT_BLOCK_SIZE, length - pos));
+  }
+  parser.finish();
+
+  std::vector<std::vector<std::string>> rows;
+  parser.next(rows, 1);
+  return rows.empty() ? std::vector<std::string>() : rows[0];
+}
+
+void CsvStreamParser::parseInto(ParsedTable& table, const ParseOptions& options) {
+  table.options = options;
+  table.rowOffsets.push_back(0);
+
+  const char* data = table.bytes();
+  size_t length = table.byteLength();
+
+  unsigned slices = sliceCountFor(options, length);
+  std::vector<size_t> starts;
+  if (slices > 1) {
+    starts = findSliceStarts(data, length, slices, options.quote);
+  }
+
+  if (starts.size() < 2) {
+    CsvStreamParser parser(options, &table, data);
+    parser.feed(data, length);
+    parser.finish();
+    return;
+  }
+
+  size_t count = starts.size();
+  starts.push_back(length);
+
+  // Only the first slice sees the header row, so column names are
+  // resolved up front and every slice gets the same selector
+  RowSelector selector(options.select, options.filters);
+  if (selector.needsHeader()) {
+    selector.resolve(options.headerRow ? readHeaderRow(data, length, options) : std::vector<std::string>());
+  }
+
+  // Spans are relative to the shared buffer, so slices need no fix-up
+  // beyond renumbering row offsets. clean is char, not bool, so each
+  // thread writes its own byte.
+  std::vector<ParsedTable> parts(count);
+  std::vector<char> clean(count, 0);
+
+  auto parsePart = [&](size_t k) {
+    try {
+      parts[k].rowOffsets.push_back(0);
+      CsvStreamParser parser(options, &parts[k], data);
+      parser.selector_ = selector;
+      clean[k] = parser.parseSlice(data + starts[k], starts[k + 1] - starts[k],
+                                   k == 0, k + 1 == count) ? 1 : 0;
+    } catch (...) {
+      // Out of memory and the like: redone (and rethrown) on the caller's thread
+      parts[k] = ParsedTable();
+      clean[k] = 0;
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t k = 1; k < count; k++) {
+    workers.push_back(std::thread(parsePart, k));
+  }
+  parsePart(0);
+  for (size_t i = 0; i < workers.size(); i++) {
+    workers[i].join();
   }
 
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  return buffer.str();
+  size_t totalFields = 0;
+  size_t totalRows = 1;
+  for (size_t k = 0; k < count; k++) {
+    totalFields += parts[k].fields.size();
+    totalRows += parts[k].rowCount();
+  }
+  table.fields.reserve(totalFields);
+  table.rowOffsets.reserve(totalRows);
+
+  for (size_t k = 0; k < count; k++) {
+    if (!clean[k]) {
+      // Slice k starts on a real row boundary (slice k - 1 ended on one)
+      // but did not end on one, so every later slice started mid-row.
+      // Parse the rest in one go.
+      CsvStreamParser parser(options, &table, data);
+      parser.selector_ = selector;
+      parser.parseSlice(data + starts[k], length - starts[k], k == 0, true);
+      break;
+    }
+    appendPart(table, parts[k]);
+    parts[k] = ParsedTable();
+  }
+}
+
+std::string readFileContents(const std::string& filePath) {
+  std::string content;
+  readFileContents(filePath, content);
+  return content;
+}
+
+bool readFileContents(const std::string& filePath, std::string& content) {
+  content.clear();
+
+  FileView view;
+  if (!view.open(filePath)) {
+    return false;
+  }
+  content.assign(view.data(), view.size());
+  return true;
 }
 
 std::vector<std::vector<std::string>> parseFile(
   const std::string& filePath,
   const ParseOptions& options
 ) {
-  std::string content = readFileContents(filePath);
-  return parse(content, options);
+  std::vector<std::vector<std::string>> result;
+
+  CsvFileReader reader(options);
+  if (!reader.open(filePath)) {
+    return result;
+  }
+
+  const size_t batchRows = 1024;
+  while (!reader.isDone()) {
+    reader.next(result, batchRows);
+  }
+
+  return result;
 }
 
 static bool needsQuoting(const std::string& field, const StringifyOptions& options) {
@@ -309,4 +1008,158 @@ bool writeFile(
   return file.good();
 }
 
+// Fields at least this long are checked for quoting with the SIMD
+// scanner instead of the byte table
+static const size_t SCAN_QUOTING_MIN = 64;
+
+CsvFileWriter::CsvFileWriter(const StringifyOptions& options, size_t bufferSize)
+  : options_(options)
+  , file_(NULL)
+  , buffer_(bufferSize > 0 ? bufferSize : DEFAULT_BLOCK_SIZE)
+  , used_(0)
+  , rowStarted_(false)
+  , failed_(false)
+  , bytesWritten_(0)
+{
+  memset(special_, 0, sizeof(special_));
+  special_[(unsigned char)options.delimiter] = true;
+  special_[(unsigned char)options.quote] = true;
+  special_[(unsigned char)'\r'] = true;
+  special_[(unsigned char)'\n'] = true;
+}
+
+CsvFileWriter::~CsvFileWriter() {
+  close();
+}
+
+bool CsvFileWriter::open(const std::string& filePath) {
+  close();
+  used_ = 0;
+  rowStarted_ = false;
+  failed_ = false;
+  bytesWritten_ = 0;
+
+  file_ = fopen(filePath.c_str(), "wb");
+  if (file_ == NULL) {
+    return false;
+  }
+
+  // Output is already buffered here; let each flush go straight through
+  setvbuf(file_, NULL, _IONBF, 0);
+  return true;
+}
+
+bool CsvFileWriter::needsQuoting(const char* data, size_t length) const {
+  if (options_.quoteAll) {
+    return true;
+  }
+
+  if (length >= SCAN_QUOTING_MIN) {
+    StructuralScanner scanner(data, length, options_.delimiter, options_.quote, options_.quote);
+    return scanner.nextUnquoted(0) < length || scanner.nextQuoted(0) < length;
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    if (special_[(unsigned char)data[i]]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void CsvFileWriter::writeField(const char* data, size_t length) {
+  if (rowStarted_) {
+    appendChar(options_.delimiter);
+  }
+  rowStarted_ = true;
+
+  if (!needsQuoting(data, length)) {
+    append(data, length);
+    return;
+  }
+
+  // Copy the runs between quotes, doubling each quote on the way
+  appendChar(options_.quote);
+  const char* end = data + length;
+  while (data < end) {
+    const char* quote = static_cast<const char*>(memchr(data, options_.quote, end - data));
+    if (quote == NULL) {
+      append(data, end - data);
+      break;
+    }
+    append(data, quote - data + 1);
+    appendChar(options_.quote);
+    data = quote + 1;
+  }
+  appendChar(options_.quote);
+}
+
+void CsvFileWriter::endRow() {
+  append(options_.lineEnding.data(), options_.lineEnding.length());
+  rowStarted_ = false;
+}
+
+void CsvFileWriter::writeRow(const std::vector<std::string>& row) {
+  for (size_t i = 0; i < row.size(); i++) {
+    writeField(row[i].data(), row[i].length());
+  }
+  endRow();
+}
+
+void CsvFileWriter::append(const char* data, size_t length) {
+  if (length > buffer_.size() - used_) {
+    flush();
+
+    // Would not fit even in an empty buffer: write it straight out
+    if (length >= buffer_.size()) {
+      writeOut(data, length);
+      return;
+    }
+  }
+
+  memcpy(&buffer_[used_], data, length);
+  used_ += length;
+}
+
+void CsvFileWriter::appendChar(char c) {
+  if (used_ == buffer_.size()) {
+    flush();
+  }
+  buffer_[used_++] = c;
+}
+
+void CsvFileWriter::writeOut(const char* data, size_t length) {
+  if (file_ == NULL || failed_) {
+    failed_ = true;
+    return;
+  }
+
+  if (fwrite(data, 1, length, file_) != length) {
+    failed_ = true;
+    return;
+  }
+  bytesWritten_ += length;
+}
+
+bool CsvFileWriter::flush() {
+  if (used_ > 0) {
+    writeOut(&buffer_[0], used_);
+    used_ = 0;
+  }
+  return !failed_;
+}
+
+bool CsvFileWriter::close() {
+  if (file_ == NULL) {
+    return !failed_;
+  }
+
+  flush();
+  if (fclose(file_) != 0) {
+    failed_ = true;
+  }
+  file_ = NULL;
+  return !failed_;
+}
+
 } // namespace csvparser
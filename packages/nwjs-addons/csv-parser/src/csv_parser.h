@@ -1,24 +1,55 @@
 #ifndef CSV_PARSER_H
 #define CSV_PARSER_H
 
+#include <cstdint>
+#include <cstdio>
 #include <string>
 #include <vector>
+#include <deque>
+#include <fstream>
+#include "file_view.h"
+#include "csv_filter.h"
 
 namespace csvparser {
 
+enum ParserState {
+  STATE_FIELD_START,
+  STATE_UNQUOTED_FIELD,
+  STATE_QUOTED_FIELD,
+  STATE_QUOTE_IN_QUOTED,
+  STATE_ESCAPE_IN_QUOTED
+};
+
+// Block size used when reading files incrementally
+const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+// Smallest slice parseTable() hands to its own thread
+const size_t MIN_PARALLEL_SLICE = 1024 * 1024;
+
 struct ParseOptions {
   char delimiter;
   char quote;
   char escape;
   bool skipEmptyLines;
   bool trim;
+  unsigned threads;  // parseTable() worker threads; 0 = one per core
+
+  // Pushdown: keep only the select columns (in that order; all when
+  // empty) of rows passing every filter. Other fields are never copied
+  // out of the input. With headerRow the first row names the columns;
+  // it is projected but never filtered.
+  std::vector<ColumnRef> select;
+  std::vector<RowFilter> filters;
+  bool headerRow;
 
   ParseOptions() :
     delimiter(','),
     quote('"'),
     escape('"'),
     skipEmptyLines(true),
-    trim(false) {}
+    trim(false),
+    threads(1),
+    headerRow(false) {}
 };
 
 struct StringifyOptions {
@@ -34,12 +65,230 @@ struct StringifyOptions {
     lineEnding("\r\n") {}
 };
 
+// Location of one field inside ParsedTable::bytes(). When needsUnescape
+// is set the span covers the raw field (quotes and escapes included) and
+// ParsedTable::value() decodes it; otherwise it is the field content.
+// length is a full size_t: a mapped file can hold a field over 4 GiB.
+struct FieldSpan {
+  size_t offset;
+  size_t length;
+  bool needsUnescape;
+};
+
+// Result of parseTable(): the input (a string buffer or a mapped file)
+// plus one span per field.
+// Row r is fields[rowOffsets[r]] up to fields[rowOffsets[r + 1]].
+struct ParsedTable {
+  std::string buffer;
+  FileView file;
+  std::vector<FieldSpan> fields;
+  std::vector<size_t> rowOffsets;
+  ParseOptions options;
+
+  size_t rowCount() const { return rowOffsets.empty() ? 0 : rowOffsets.size() - 1; }
+  size_t rowWidth(size_t row) const { return rowOffsets[row + 1] - rowOffsets[row]; }
+  const FieldSpan& field(size_t row, size_t column) const { return fields[rowOffsets[row] + column]; }
+  const char* data(const FieldSpan& span) const { return bytes() + span.offset; }
+
+  // The parsed input: the file when one is open, otherwise buffer
+  const char* bytes() const { return file.isOpen() ? file.data() : buffer.data(); }
+  size_t byteLength() const { return file.isOpen() ? file.size() : buffer.length(); }
+
+  // Decoded copy of a field
+  std::string value(const FieldSpan& span) const;
+};
+
+// Resumable parser: input is fed in arbitrary chunks and completed rows
+// are queued until taken. Parser state (including a field or CRLF split
+// across two chunks) carries over between feed() calls.
+class CsvStreamParser {
+public:
+  explicit CsvStreamParser(const ParseOptions& options);
+
+  // Consume the next chunk of input
+  void feed(const char* data, size_t length);
+
+  // Flush the trailing field/row once the input is exhausted
+  void finish();
+
+  // Number of completed rows waiting to be taken
+  size_t pendingRows() const { return rows_.size(); }
+
+  // Move up to maxRows completed rows onto the end of out. With records,
+  // each row's record number is appended to it too: its 1-based position
+  // among all records parsed, blank lines and filtered-out rows included.
+  // @returns number of rows moved
+  size_t next(std::vector<std::vector<std::string>>& out, size_t maxRows,
+               std::vector<uint64_t>* records = NULL);
+
+  bool isFinished() const { return finished_; }
+
+private:
+  friend ParsedTable parseTable(std::string input, const ParseOptions& options);
+  friend ParsedTable parseTable(FileView file, const ParseOptions& options);
+
+  // Fill table (rowOffsets still empty) from table.bytes()
+  static void parseInto(ParsedTable& table, const ParseOptions& options);
+
+  // Table mode: fields are recorded as spans (relative to base) into
+  // table->fields, and the input must be fed in a single chunk
+  CsvStreamParser(const ParseOptions& options, ParsedTable* table, const char* base);
+
+  // Table mode over one slice of a larger buffer. Slices after the first
+  // start mid-input and have no BOM to look for.
+  // @returns true if the slice ended exactly on a row boundary
+  bool parseSlice(const char* data, size_t length, bool first, bool last);
+
+  void consume(const char* data, size_t length);
+  void appendSpan(const char* data, size_t length);
+  void appendChar(char c);
+  void flushSpan();
+  void endField(const char* rawEnd);
+  void endRow(const char* rawEnd);
+
+  // select/filters applied to the row just ended
+  // @returns false if the row is dropped
+  bool selectTableRow(size_t start);
+  bool selectRow();
+  bool skipsField() const;
+  void fieldText(const FieldSpan& span, std::string& scratch, const char*& data, size_t& length) const;
+
+  ParseOptions options_;
+  ParsedTable* table_;
+  const char* base_;
+  ParserState state_;
+  std::string currentField_;
+  const char* spanData_;
+  size_t spanLength_;
+  const char* fieldStart_;
+  const char* chunkEnd_;
+  bool rowHasContent_;
+  std::vector<std::string> currentRow_;
+  std::deque<std::vector<std::string>> rows_;
+  std::deque<uint64_t> rowRecords_;   // record number of each queued row
+  uint64_t records_;                  // records ended so far
+  std::string bomProbe_;
+  bool bomChecked_;
+  bool skipLineFeed_;
+  bool finished_;
+  RowSelector selector_;
+  bool headerPending_;
+  std::vector<FieldSpan> projectedSpans_;
+  std::vector<std::string> projectedRow_;
+};
+
+// Parses a CSV file in fixed-size blocks, only as far as needed to
+// satisfy each next() call. The file is memory-mapped and fed to the
+// parser in place; if it cannot be mapped it is read one block at a
+// time instead. Either way heap use is the rows not yet taken (plus one
+// block when reading).
+class CsvFileReader {
+public:
+  explicit CsvFileReader(const ParseOptions& options, size_t blockSize = DEFAULT_BLOCK_SIZE);
+
+  // Open the file; false if it cannot be read. Parsing starts offset
+  // bytes in, which must be the start of a row (or the file).
+  bool open(const std::string& filePath, uint64_t offset = 0);
+
+  // Read and parse until maxRows rows are available (or end of file),
+  // then move them onto the end of out (and their record numbers, counted
+  // from where parsing started, onto records; see CsvStreamParser::next)
+  // @returns number of rows moved (0 once the file is exhausted)
+  size_t next(std::vector<std::vector<std::string>>& out, size_t maxRows,
+              std::vector<uint64_t>* records = NULL);
+
+  // True once the file is fully read and every row has been taken
+  bool isDone() const;
+
+  // Bytes of the file handed to the parser so far, counting any open()
+  // offset, and the size of the whole file
+  uint64_t bytesRead() const { return bytesRead_; }
+  uint64_t fileSize() const { return fileSize_; }
+
+  void close();
+
+private:
+  CsvStreamParser parser_;
+  FileView view_;
+  size_t offset_;
+  size_t blockSize_;
+  uint64_t bytesRead_;
+  uint64_t fileSize_;
+  std::ifstream file_;
+  std::vector<char> block_;
+};
+
+// Serializes rows into a fixed-size buffer and writes the buffer to the
+// file each time it fills, so memory stays at one buffer however much
+// is written. Fields are quoted and escaped as stringify() does.
+class CsvFileWriter {
+public:
+  explicit CsvFileWriter(const StringifyOptions& options, size_t bufferSize = DEFAULT_BLOCK_SIZE);
+  ~CsvFileWriter();
+
+  // Create/truncate the file; false if it cannot be opened
+  bool open(const std::string& filePath);
+
+  // Append one field to the current row
+  void writeField(const char* data, size_t length);
+
+  // Terminate the current row
+  void endRow();
+
+  void writeRow(const std::vector<std::string>& row);
+
+  // Write buffered output to the file
+  // @returns false if this or any earlier write failed
+  bool flush();
+
+  // Flush and close; safe to call more than once
+  // @returns false if any write failed
+  bool close();
+
+  bool isOpen() const { return file_ != NULL; }
+  bool hasFailed() const { return failed_; }
+
+  // Bytes handed to the file so far (buffered bytes not included)
+  uint64_t bytesWritten() const { return bytesWritten_; }
+
+private:
+  CsvFileWriter(const CsvFileWriter&);
+  CsvFileWriter& operator=(const CsvFileWriter&);
+
+  bool needsQuoting(const char* data, size_t length) const;
+  void append(const char* data, size_t length);
+  void appendChar(char c);
+  void writeOut(const char* data, size_t length);
+
+  StringifyOptions options_;
+  FILE* file_;
+  std::vector<char> buffer_;
+  size_t used_;
+  bool rowStarted_;
+  bool failed_;
+  uint64_t bytesWritten_;
+  bool special_[256];   // bytes that force a field to be quoted
+};
+
 // Parse CSV string into rows of fields
 std::vector<std::vector<std::string>> parse(
   const std::string& input,
   const ParseOptions& options
 );
 
+// Parse CSV string into a ParsedTable. The input is moved into the
+// table and fields refer back into it, so only fields containing escape
+// sequences are ever copied (and only when value() is asked for them).
+// With options.threads != 1 large inputs are split at newlines outside
+// quotes and the slices parsed concurrently; the result is identical to
+// a single-threaded parse.
+ParsedTable parseTable(std::string input, const ParseOptions& options);
+
+// As above over an open file view, which moves into the table: fields
+// refer straight into the mapped file and it stays mapped for the
+// table's lifetime.
+ParsedTable parseTable(FileView file, const ParseOptions& options);
+
 // Parse CSV file into rows of fields
 std::vector<std::vector<std::string>> parseFile(
   const std::string& filePath,
@@ -61,6 +310,9 @@ bool writeFile(
 // Helper to read file contents
 std::string readFileContents(const std::string& filePath);
 
+// As above, but reports whether the file could be opened at all
+bool readFileContents(const std::string& filePath, std::string& content);
+
 } // namespace csvparser
 
 #endif // CSV_PARSER_H
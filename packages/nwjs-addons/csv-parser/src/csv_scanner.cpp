@@ -0,0 +1,280 @@
+#include "csv_scanner.h"
+#include <atomic>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+  #define CSV_SCANNER_X86 1
+  #include <emmintrin.h>
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+  #else
+    #include <cpuid.h>
+  #endif
+#endif
+
+// MSVC compiles any intrinsic unconditionally; GCC/Clang need the ISA
+// enabled per function since the rest of the addon targets baseline x86
+#if defined(CSV_SCANNER_X86) && !defined(_MSC_VER)
+  #define CSV_TARGET_SSE2 __attribute__((target("sse2")))
+  #define CSV_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+  #define CSV_TARGET_SSE2
+  #define CSV_TARGET_AVX2
+#endif
+
+namespace csvparser {
+
+// chars layout shared by all kernels: delimiter, CR, LF, quote, escape
+typedef void (*ClassifyFn)(const char* block, const char* chars, BlockMasks& out);
+
+static void classifyScalar(const char* block, const char* chars, BlockMasks& out) {
+  uint64_t unquoted = 0;
+  uint64_t quoted = 0;
+
+  for (int i = 0; i < 64; i++) {
+    char c = block[i];
+    uint64_t bit = static_cast<uint64_t>(1) << i;
+    if (c == chars[0] || c == chars[1] || c == chars[2]) {
+      unquoted |= bit;
+    }
+    if (c == chars[3] || c == chars[4]) {
+      quoted |= bit;
+    }
+  }
+
+  out.unquoted = unquoted;
+  out.quoted = quoted;
+}
+
+#ifdef CSV_SCANNER_X86
+
+CSV_TARGET_SSE2
+static void classifySse2(const char* block, const char* chars, BlockMasks& out) {
+  const __m128i delimiter = _mm_set1_epi8(chars[0]);
+  const __m128i cr = _mm_set1_epi8(chars[1]);
+  const __m128i lf = _mm_set1_epi8(chars[2]);
+  const __m128i quote = _mm_set1_epi8(chars[3]);
+  const __m128i escape = _mm_set1_epi8(chars[4]);
+
+  uint64_t unquoted = 0;
+  uint64_t quoted = 0;
+
+  for (int i = 0; i < 4; i++) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+
+    __m128i ends = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, delimiter), _mm_cmpeq_epi8(v, cr)),
+      _mm_cmpeq_epi8(v, lf));
+    __m128i quotes = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, escape));
+
+    unquoted |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(ends))) << (i * 16);
+    quoted |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(quotes))) << (i * 16);
+  }
+
+  out.unquoted = unquoted;
+  out.quoted = quoted;
+}
+
+CSV_TARGET_AVX2
+static void classifyAvx2(const char* block, const char* chars, BlockMasks& out) {
+  const __m256i delimiter = _mm256_set1_epi8(chars[0]);
+  const __m256i cr = _mm256_set1_epi8(chars[1]);
+  const __m256i lf = _mm256_set1_epi8(chars[2]);
+  const __m256i quote = _mm256_set1_epi8(chars[3]);
+  const __m256i escape = _mm256_set1_epi8(chars[4]);
+
+  uint64_t unquoted = 0;
+  uint64_t quoted = 0;
+
+  for (int i = 0; i < 2; i++) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i * 32));
+
+    __m256i ends = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, delimiter), _mm256_cmpeq_epi8(v, cr)),
+      _mm256_cmpeq_epi8(v, lf));
+    __m256i quotes = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, escape));
+
+    unquoted |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ends))) << (i * 32);
+    quoted |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(quotes))) << (i * 32);
+  }
+
+  out.unquoted = unquoted;
+  out.quoted = quoted;
+}
+
+static void cpuid(int info[4], int leaf, int subleaf) {
+#ifdef _MSC_VER
+  __cpuidex(info, leaf, subleaf);
+#else
+  unsigned int a, b, c, d;
+  __cpuid_count(leaf, subleaf, a, b, c, d);
+  info[0] = static_cast<int>(a);
+  info[1] = static_cast<int>(b);
+  info[2] = static_cast<int>(c);
+  info[3] = static_cast<int>(d);
+#endif
+}
+
+// XCR0 tells whether the OS saves YMM state (XP does not)
+static uint64_t readXcr0() {
+#ifdef _MSC_VER
+  return _xgetbv(0);
+#else
+  unsigned int eax, edx;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+#endif // CSV_SCANNER_X86
+
+static unsigned lowestBit(uint64_t mask) {
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return static_cast<unsigned>(index);
+#elif defined(_MSC_VER)
+  unsigned long index;
+  uint32_t low = static_cast<uint32_t>(mask);
+  if (low != 0) {
+    _BitScanForward(&index, low);
+    return static_cast<unsigned>(index);
+  }
+  _BitScanForward(&index, static_cast<uint32_t>(mask >> 32));
+  return static_cast<unsigned>(index) + 32;
+#else
+  return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+// -1 until detected / unless forced. Parsers on worker threads read
+// these while another thread may be detecting or forcing; detection
+// always finds the same answer, so racing to store it is harmless.
+static std::atomic<int> detectedLevel(-1);
+static std::atomic<int> forcedLevel(-1);
+
+ScanLevel detectScanLevel() {
+  int detected = detectedLevel.load();
+  if (detected >= 0) {
+    return static_cast<ScanLevel>(detected);
+  }
+
+  ScanLevel level = SCAN_SCALAR;
+
+#ifdef CSV_SCANNER_X86
+  int info[4];
+  cpuid(info, 0, 0);
+  int maxLeaf = info[0];
+
+  cpuid(info, 1, 0);
+  bool hasSse2 = (info[3] & (1 << 26)) != 0;
+  bool hasOsxsave = (info[2] & (1 << 27)) != 0;
+  bool hasAvx = (info[2] & (1 << 28)) != 0;
+
+  if (hasSse2) {
+    level = SCAN_SSE2;
+  }
+
+  if (hasOsxsave && hasAvx && maxLeaf >= 7 && (readXcr0() & 0x6) == 0x6) {
+    cpuid(info, 7, 0);
+    bool hasAvx2 = (info[1] & (1 << 5)) != 0;
+    if (hasAvx2) {
+      level = SCAN_AVX2;
+    }
+  }
+#endif
+
+  detectedLevel.store(level);
+  return level;
+}
+
+ScanLevel activeScanLevel() {
+  int forced = forcedLevel.load();
+  return forced >= 0 ? static_cast<ScanLevel>(forced) : detectScanLevel();
+}
+
+void setScanLevel(ScanLevel level) {
+  ScanLevel best = detectScanLevel();
+  forcedLevel.store(level > best ? best : level);
+}
+
+const char* scanLevelName(ScanLevel level) {
+  switch (level) {
+    case SCAN_BYTEWISE: return "bytewise";
+    case SCAN_SCALAR:   return "scalar";
+    case SCAN_SSE2:     return "sse2";
+    case SCAN_AVX2:     return "avx2";
+  }
+  return "unknown";
+}
+
+static ClassifyFn classifierFor(ScanLevel level) {
+#ifdef CSV_SCANNER_X86
+  if (level == SCAN_AVX2) {
+    return classifyAvx2;
+  }
+  if (level == SCAN_SSE2) {
+    return classifySse2;
+  }
+#else
+  (void)level;
+#endif
+  return classifyScalar;
+}
+
+StructuralScanner::StructuralScanner(const char* data, size_t length,
+                                     char delimiter, char quote, char escape)
+  : classify_(classifierFor(activeScanLevel()))
+  , data_(data)
+  , length_(length)
+  , blockStart_(static_cast<size_t>(-1))
+{
+  chars_[0] = delimiter;
+  chars_[1] = '\r';
+  chars_[2] = '\n';
+  chars_[3] = quote;
+  chars_[4] = escape;
+  masks_.unquoted = 0;
+  masks_.quoted = 0;
+}
+
+void StructuralScanner::loadBlock(size_t blockStart) {
+  blockStart_ = blockStart;
+
+  if (blockStart + 64 <= length_) {
+    classify_(data_ + blockStart, chars_, masks_);
+    return;
+  }
+
+  // Tail block: classify a padded copy; bits past length_ are ignored
+  // by next()
+  char tail[64];
+  size_t remaining = length_ - blockStart;
+  memcpy(tail, data_ + blockStart, remaining);
+  memset(tail + remaining, 0, 64 - remaining);
+  classify_(tail, chars_, masks_);
+}
+
+size_t StructuralScanner::next(size_t pos, bool quoted) {
+  while (pos < length_) {
+    size_t blockStart = pos & ~static_cast<size_t>(63);
+    if (blockStart != blockStart_) {
+      loadBlock(blockStart);
+    }
+
+    uint64_t mask = quoted ? masks_.quoted : masks_.unquoted;
+    mask &= ~static_cast<uint64_t>(0) << (pos - blockStart);
+
+    if (mask != 0) {
+      size_t found = blockStart + lowestBit(mask);
+      return found < length_ ? found : length_;
+    }
+
+    pos = blockStart + 64;
+  }
+
+  return length_;
+}
+
+} // namespace csvparser
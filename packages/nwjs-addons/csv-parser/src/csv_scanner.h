@@ -0,0 +1,65 @@
+#ifndef CSV_SCANNER_H
+#define CSV_SCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace csvparser {
+
+// Structural-character search strategy, best first from the bottom.
+// SCAN_BYTEWISE disables the scanner entirely (the state machine sees
+// every byte) and exists so benchmarks can compare against it.
+enum ScanLevel {
+  SCAN_BYTEWISE,
+  SCAN_SCALAR,
+  SCAN_SSE2,
+  SCAN_AVX2
+};
+
+// Best level supported by this CPU/OS (checked once via CPUID)
+ScanLevel detectScanLevel();
+
+// Level currently used by the parser (defaults to detectScanLevel())
+ScanLevel activeScanLevel();
+
+// Force a level; anything above detectScanLevel() is clamped
+void setScanLevel(ScanLevel level);
+
+const char* scanLevelName(ScanLevel level);
+
+// Per-64-byte-block bitmasks: bit n set means block[n] is structural
+struct BlockMasks {
+  uint64_t unquoted;  // delimiter, CR, LF — ends an unquoted field
+  uint64_t quoted;    // quote, escape — interrupts a quoted field
+};
+
+// Finds the next structural character for the current parser state.
+// Masks are computed a 64-byte block at a time (16 or 32 bytes per SIMD
+// compare) and cached, so consecutive short fields share one block scan.
+class StructuralScanner {
+public:
+  StructuralScanner(const char* data, size_t length,
+                    char delimiter, char quote, char escape);
+
+  // Offset of the first byte at or after pos that ends an unquoted field,
+  // or length if there is none
+  size_t nextUnquoted(size_t pos) { return next(pos, false); }
+
+  // Offset of the first quote/escape byte at or after pos, or length
+  size_t nextQuoted(size_t pos) { return next(pos, true); }
+
+private:
+  size_t next(size_t pos, bool quoted);
+  void loadBlock(size_t blockStart);
+
+  void (*classify_)(const char* block, const char* chars, BlockMasks& out);
+  const char* data_;
+  size_t length_;
+  char chars_[5];
+  size_t blockStart_;
+  BlockMasks masks_;
+};
+
+} // namespace csvparser
+
+#endif // CSV_SCANNER_H
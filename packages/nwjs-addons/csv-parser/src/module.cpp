@@ -1,9 +1,165 @@
 #include "addon_api.h"
-#include <fstream>
 #include "csv_parser.h"
+#include "csv_columns.h"
+#include <stdexcept>
+#include <utility>
 
 using namespace csvparser;
 
+// Incremental file reader handed to JS by csvOpenReader
+class CsvReaderWrap : public ADDON_OBJECT_WRAP {
+public:
+  static void Init(ADDON_INIT_PARAMS);
+  static ADDON_OBJECT_TYPE Create(CsvFileReader* reader);
+  static ADDON_METHOD(Next);
+  static ADDON_METHOD(Close);
+  static ADDON_GETTER(GetDone);
+
+  static ADDON_PERSISTENT_FUNCTION constructor;
+
+  CsvFileReader* reader_;
+
+private:
+  CsvReaderWrap() : reader_(NULL) {}
+  ~CsvReaderWrap() {
+    if (reader_) {
+      delete reader_;
+      reader_ = NULL;
+    }
+  }
+};
+
+ADDON_PERSISTENT_FUNCTION CsvReaderWrap::constructor;
+
+// Parsed table handed to JS by the async parsers. Rows are converted a
+// batch per next() call, so the caller can spread the JS-side work (and
+// the garbage it creates) across ticks.
+class CsvTableWrap : public ADDON_OBJECT_WRAP {
+public:
+  static void Init(ADDON_INIT_PARAMS);
+  static ADDON_OBJECT_TYPE Create(ParsedTable* table);
+  static ADDON_METHOD(Next);
+  static ADDON_GETTER(GetDone);
+  static ADDON_GETTER(GetRowCount);
+
+  static ADDON_PERSISTENT_FUNCTION constructor;
+
+  ParsedTable* table_;
+  size_t cursor_;
+  size_t rowCount_;
+
+private:
+  CsvTableWrap() : table_(NULL), cursor_(0), rowCount_(0) {}
+  ~CsvTableWrap() {
+    if (table_) {
+      delete table_;
+      table_ = NULL;
+    }
+  }
+};
+
+ADDON_PERSISTENT_FUNCTION CsvTableWrap::constructor;
+
+// Buffered file writer handed to JS by csvOpenWriter. Rows are encoded
+// straight from the JS strings into the writer's buffer. The writer is
+// closed (and flushed) at the latest when the handle is collected.
+class CsvWriterWrap : public ADDON_OBJECT_WRAP {
+public:
+  static void Init(ADDON_INIT_PARAMS);
+  static ADDON_OBJECT_TYPE Create(CsvFileWriter* writer);
+  static ADDON_METHOD(WriteRows);
+  static ADDON_METHOD(Flush);
+  static ADDON_METHOD(Close);
+  static ADDON_GETTER(GetBytesWritten);
+
+  static ADDON_PERSISTENT_FUNCTION constructor;
+
+  CsvFileWriter* writer_;
+
+private:
+  CsvWriterWrap() : writer_(NULL) {}
+  ~CsvWriterWrap() {
+    if (writer_) {
+      delete writer_;
+      writer_ = NULL;
+    }
+  }
+};
+
+ADDON_PERSISTENT_FUNCTION CsvWriterWrap::constructor;
+
+// Rows returned per next() call when no batch size is given
+static const uint32_t DEFAULT_READER_BATCH = 1000;
+
+// { name } or { index }
+static ColumnRef extractColumnRef(ADDON_OBJECT_TYPE obj) {
+  ColumnRef ref;
+
+  if (ADDON_HAS(obj, "name")) {
+    ADDON_VALUE val = ADDON_GET(obj, "name");
+    if (ADDON_IS_STRING(val)) {
+      ADDON_UTF8(name, val);
+      ref.name = std::string(ADDON_UTF8_VALUE(name), ADDON_UTF8_LENGTH(name));
+    }
+  }
+  if (ADDON_HAS(obj, "index")) {
+    ADDON_VALUE val = ADDON_GET(obj, "index");
+    if (ADDON_IS_NUMBER(val)) {
+      ref.index = ADDON_TO_UINT32(val);
+    }
+  }
+
+  return ref;
+}
+
+// { name | index, op: 'equals' | 'in' | 'range', values, min, max }
+static RowFilter extractRowFilter(ADDON_OBJECT_TYPE obj) {
+  RowFilter filter;
+  filter.column = extractColumnRef(obj);
+
+  if (ADDON_HAS(obj, "op")) {
+    ADDON_VALUE val = ADDON_GET(obj, "op");
+    if (ADDON_IS_STRING(val)) {
+      ADDON_UTF8(op, val);
+      std::string name(ADDON_UTF8_VALUE(op));
+      if (name == "in") {
+        filter.op = FILTER_IN;
+      } else if (name == "range") {
+        filter.op = FILTER_RANGE;
+      }
+    }
+  }
+
+  if (ADDON_HAS(obj, "values")) {
+    ADDON_VALUE val = ADDON_GET(obj, "values");
+    if (ADDON_IS_ARRAY(val)) {
+      ADDON_ARRAY_TYPE values = ADDON_CAST_ARRAY(val);
+      for (uint32_t i = 0; i < ADDON_LENGTH(values); i++) {
+        ADDON_VALUE entry = ADDON_GET_INDEX(values, i);
+        if (ADDON_IS_STRING(entry)) {
+          ADDON_UTF8(str, entry);
+          filter.values.push_back(std::string(ADDON_UTF8_VALUE(str), ADDON_UTF8_LENGTH(str)));
+        }
+      }
+    }
+  }
+
+  if (ADDON_HAS(obj, "min")) {
+    ADDON_VALUE val = ADDON_GET(obj, "min");
+    if (ADDON_IS_NUMBER(val)) {
+      filter.min = ADDON_TO_DOUBLE(val);
+    }
+  }
+  if (ADDON_HAS(obj, "max")) {
+    ADDON_VALUE val = ADDON_GET(obj, "max");
+    if (ADDON_IS_NUMBER(val)) {
+      filter.max = ADDON_TO_DOUBLE(val);
+    }
+  }
+
+  return filter;
+}
+
 static ParseOptions extractParseOptions(ADDON_OBJECT_TYPE optObj) {
   ParseOptions opts;
 
@@ -51,6 +207,47 @@ static ParseOptions extractParseOptions(ADDON_OBJECT_TYPE optObj) {
     }
   }
 
+  if (ADDON_HAS(optObj, "threads")) {
+    ADDON_VALUE val = ADDON_GET(optObj, "threads");
+    if (ADDON_IS_NUMBER(val)) {
+      opts.threads = ADDON_TO_UINT32(val);
+    }
+  }
+
+  if (ADDON_HAS(optObj, "headers")) {
+    ADDON_VALUE val = ADDON_GET(optObj, "headers");
+    if (ADDON_IS_BOOLEAN(val)) {
+      opts.headerRow = ADDON_BOOL_VALUE(val);
+    }
+  }
+
+  // select: [{ name | index }]
+  if (ADDON_HAS(optObj, "select")) {
+    ADDON_VALUE val = ADDON_GET(optObj, "select");
+    if (ADDON_IS_ARRAY(val)) {
+      ADDON_ARRAY_TYPE select = ADDON_CAST_ARRAY(val);
+      for (uint32_t i = 0; i < ADDON_LENGTH(select); i++) {
+        ADDON_VALUE entry = ADDON_GET_INDEX(select, i);
+        if (ADDON_IS_OBJECT(entry)) {
+          opts.select.push_back(extractColumnRef(ADDON_AS_OBJECT(entry)));
+        }
+      }
+    }
+  }
+
+  if (ADDON_HAS(optObj, "filters")) {
+    ADDON_VALUE val = ADDON_GET(optObj, "filters");
+    if (ADDON_IS_ARRAY(val)) {
+      ADDON_ARRAY_TYPE filters = ADDON_CAST_ARRAY(val);
+      for (uint32_t i = 0; i < ADDON_LENGTH(filters); i++) {
+        ADDON_VALUE entry = ADDON_GET_INDEX(filters, i);
+        if (ADDON_IS_OBJECT(entry)) {
+          opts.filters.push_back(extractRowFilter(ADDON_AS_OBJECT(entry)));
+        }
+      }
+    }
+  }
+
   return opts;
 }
 
@@ -112,6 +309,127 @@ static ADDON_ARRAY_TYPE rowsToJsArray(const std::vector<std::vector<std::string>
   return result;
 }
 
+static ColumnarOptions extractColumnarOptions(ADDON_OBJECT_TYPE optObj) {
+  ColumnarOptions opts;
+
+  if (ADDON_HAS(optObj, "headers")) {
+    ADDON_VALUE val = ADDON_GET(optObj, "headers");
+    if (ADDON_IS_BOOLEAN(val)) {
+      opts.headers = ADDON_BOOL_VALUE(val);
+    }
+  }
+
+  if (ADDON_HAS(optObj, "inferRows")) {
+    ADDON_VALUE val = ADDON_GET(optObj, "inferRows");
+    if (ADDON_IS_NUMBER(val)) {
+      opts.inferRows = ADDON_TO_UINT32(val);
+    }
+  }
+
+  // schema: [{ name | index, type }]; unknown type names are left as auto
+  if (ADDON_HAS(optObj, "schema")) {
+    ADDON_VALUE val = ADDON_GET(optObj, "schema");
+    if (ADDON_IS_ARRAY(val)) {
+      ADDON_ARRAY_TYPE schema = ADDON_CAST_ARRAY(val);
+      for (uint32_t i = 0; i < ADDON_LENGTH(schema); i++) {
+        ADDON_VALUE entryVal = ADDON_GET_INDEX(schema, i);
+        if (!ADDON_IS_OBJECT(entryVal)) {
+          continue;
+        }
+
+        ADDON_OBJECT_TYPE entry = ADDON_AS_OBJECT(entryVal);
+        ColumnSpec spec;
+
+        if (ADDON_HAS(entry, "name")) {
+          ADDON_VALUE nameVal = ADDON_GET(entry, "name");
+          if (ADDON_IS_STRING(nameVal)) {
+            ADDON_UTF8(name, nameVal);
+            spec.name = std::string(ADDON_UTF8_VALUE(name));
+          }
+        }
+        if (ADDON_HAS(entry, "index")) {
+          ADDON_VALUE indexVal = ADDON_GET(entry, "index");
+          if (ADDON_IS_NUMBER(indexVal)) {
+            spec.index = ADDON_TO_UINT32(indexVal);
+          }
+        }
+        if (ADDON_HAS(entry, "type")) {
+          ADDON_VALUE typeVal = ADDON_GET(entry, "type");
+          if (ADDON_IS_STRING(typeVal)) {
+            ADDON_UTF8(type, typeVal);
+            columnTypeFromName(std::string(ADDON_UTF8_VALUE(type)), spec.type);
+          }
+        }
+
+        opts.schema.push_back(spec);
+      }
+    }
+  }
+
+  return opts;
+}
+
+// { rowCount, columns: [{ name, type, values, dictionary? }] } where
+// values is an Int32Array, a Float64Array (numbers, dates as epoch ms)
+// or, for strings, a Uint32Array of indices into dictionary
+static ADDON_OBJECT_TYPE columnsToJs(const ColumnarTable& table) {
+  ADDON_OBJECT_TYPE result = ADDON_OBJECT();
+  ADDON_ARRAY_TYPE columns = ADDON_ARRAY(table.columns.size());
+
+  for (size_t i = 0; i < table.columns.size(); i++) {
+    const ColumnData& column = table.columns[i];
+    ADDON_OBJECT_TYPE jsColumn = ADDON_OBJECT();
+    ADDON_SET(jsColumn, "name", ADDON_STRING(column.name));
+    ADDON_SET(jsColumn, "type", ADDON_STRING(columnTypeName(column.type)));
+
+    if (column.type == COLUMN_INT32) {
+      ADDON_SET(jsColumn, "values", ADDON_INT32_ARRAY(column.ints.data(), column.ints.size()));
+    } else if (column.type == COLUMN_FLOAT64 || column.type == COLUMN_DATE) {
+      ADDON_SET(jsColumn, "values", ADDON_FLOAT64_ARRAY(column.numbers.data(), column.numbers.size()));
+    } else {
+      ADDON_SET(jsColumn, "values", ADDON_UINT32_ARRAY(column.indices.data(), column.indices.size()));
+
+      ADDON_ARRAY_TYPE dictionary = ADDON_ARRAY(column.dictionary.size());
+      for (size_t j = 0; j < column.dictionary.size(); j++) {
+        const std::string& value = column.dictionary[j];
+        ADDON_SET_INDEX(dictionary, j, ADDON_STRING_LEN(value.data(), value.length()));
+      }
+      ADDON_SET(jsColumn, "dictionary", dictionary);
+    }
+
+    ADDON_SET_INDEX(columns, i, jsColumn);
+  }
+
+  ADDON_SET(result, "rowCount", ADDON_NUMBER(table.rowCount));
+  ADDON_SET(result, "columns", columns);
+  return result;
+}
+
+// JS strings are created straight from the spans; only fields holding
+// escape sequences are decoded into a temporary first
+static ADDON_ARRAY_TYPE rowsToJsArray(const ParsedTable& table, size_t firstRow, size_t rowCount) {
+  ADDON_ARRAY_TYPE result = ADDON_ARRAY(rowCount);
+
+  for (size_t i = 0; i < rowCount; i++) {
+    size_t row = firstRow + i;
+    size_t width = table.rowWidth(row);
+    ADDON_ARRAY_TYPE jsRow = ADDON_ARRAY(width);
+
+    for (size_t j = 0; j < width; j++) {
+      const FieldSpan& span = table.field(row, j);
+      if (span.needsUnescape) {
+        ADDON_SET_INDEX(jsRow, j, ADDON_STRING(table.value(span)));
+      } else {
+        ADDON_SET_INDEX(jsRow, j, ADDON_STRING_LEN(table.data(span), span.length));
+      }
+    }
+
+    ADDON_SET_INDEX(result, i, jsRow);
+  }
+
+  return result;
+}
+
 static std::vector<std::vector<std::string>> jsArrayToRows(ADDON_ARRAY_TYPE arr) {
   std::vector<std::vector<std::string>> rows;
 
@@ -152,8 +470,9 @@ ADDON_METHOD(Parse) {
     opts = extractParseOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
   }
 
-  std::vector<std::vector<std::string>> rows = parse(std::string(ADDON_UTF8_VALUE(content)), opts);
-  ADDON_RETURN(rowsToJsArray(rows));
+  ParsedTable table = parseTable(
+    std::string(ADDON_UTF8_VALUE(content), ADDON_UTF8_LENGTH(content)), opts);
+  ADDON_RETURN(rowsToJsArray(table, 0, table.rowCount()));
 }
 
 ADDON_METHOD(ParseFile) {
@@ -170,19 +489,111 @@ ADDON_METHOD(ParseFile) {
     opts = extractParseOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
   }
 
-  std::string content = readFileContents(std::string(ADDON_UTF8_VALUE(filePath)));
-  if (content.empty()) {
-    std::string path(ADDON_UTF8_VALUE(filePath));
-    std::ifstream testFile(path.c_str());
-    if (!testFile.is_open()) {
-      ADDON_THROW_ERROR("Could not open file");
-      ADDON_VOID_RETURN();
-    }
-    testFile.close();
+  // Every row ends up in the returned array anyway, so spans into the
+  // mapped file beat a std::string per field
+  FileView file;
+  if (!file.open(std::string(ADDON_UTF8_VALUE(filePath)))) {
+    ADDON_THROW_ERROR("Could not open file");
+    ADDON_VOID_RETURN();
   }
 
-  std::vector<std::vector<std::string>> rows = parse(content, opts);
-  ADDON_RETURN(rowsToJsArray(rows));
+  ParsedTable table = parseTable(std::move(file), opts);
+  ADDON_RETURN(rowsToJsArray(table, 0, table.rowCount()));
+}
+
+ADDON_METHOD(ParseColumns) {
+  ADDON_ENV;
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_STRING(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("First argument must be a string");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(content, ADDON_ARG(0));
+  ParseOptions opts;
+  ColumnarOptions columnOpts;
+
+  if (ADDON_ARG_COUNT() >= 2 && ADDON_IS_OBJECT(ADDON_ARG(1))) {
+    opts = extractParseOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
+    columnOpts = extractColumnarOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
+  }
+
+  ParsedTable table = parseTable(
+    std::string(ADDON_UTF8_VALUE(content), ADDON_UTF8_LENGTH(content)), opts);
+  ADDON_RETURN(columnsToJs(buildColumns(table, columnOpts)));
+}
+
+ADDON_METHOD(ParseFileColumns) {
+  ADDON_ENV;
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_STRING(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("First argument must be a file path string");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(filePath, ADDON_ARG(0));
+  ParseOptions opts;
+  ColumnarOptions columnOpts;
+
+  if (ADDON_ARG_COUNT() >= 2 && ADDON_IS_OBJECT(ADDON_ARG(1))) {
+    opts = extractParseOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
+    columnOpts = extractColumnarOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
+  }
+
+  FileView file;
+  if (!file.open(std::string(ADDON_UTF8_VALUE(filePath)))) {
+    ADDON_THROW_ERROR("Could not open file");
+    ADDON_VOID_RETURN();
+  }
+
+  ParsedTable table = parseTable(std::move(file), opts);
+  ADDON_RETURN(columnsToJs(buildColumns(table, columnOpts)));
+}
+
+ADDON_METHOD(OpenReader) {
+  ADDON_ENV;
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_STRING(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("First argument must be a file path string");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(filePath, ADDON_ARG(0));
+  ParseOptions opts;
+
+  if (ADDON_ARG_COUNT() >= 2 && ADDON_IS_OBJECT(ADDON_ARG(1))) {
+    opts = extractParseOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
+  }
+
+  CsvFileReader* reader = new CsvFileReader(opts);
+  if (!reader->open(std::string(ADDON_UTF8_VALUE(filePath)))) {
+    delete reader;
+    ADDON_THROW_ERROR("Could not open file");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_RETURN(CsvReaderWrap::Create(reader));
+}
+
+ADDON_METHOD(OpenWriter) {
+  ADDON_ENV;
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_STRING(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("First argument must be a file path string");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(filePath, ADDON_ARG(0));
+  StringifyOptions opts;
+
+  if (ADDON_ARG_COUNT() >= 2 && ADDON_IS_OBJECT(ADDON_ARG(1))) {
+    opts = extractStringifyOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
+  }
+
+  CsvFileWriter* writer = new CsvFileWriter(opts);
+  if (!writer->open(std::string(ADDON_UTF8_VALUE(filePath)))) {
+    delete writer;
+    ADDON_THROW_ERROR("Could not open file");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_RETURN(CsvWriterWrap::Create(writer));
 }
 
 ADDON_METHOD(Stringify) {
@@ -219,9 +630,481 @@ ADDON_METHOD(WriteFile) {
   ADDON_RETURN(ADDON_BOOL(success));
 }
 
+// ============================================
+// Async variants
+// ============================================
+
+// Reads and parses on the thread pool; the callback gets a CsvTable
+class ParseFileWorker : public ADDON_ASYNC_WORKER {
+public:
+  ParseFileWorker(ADDON_FUNCTION_TYPE callback, const std::string& filePath, const ParseOptions& options)
+    : ADDON_ASYNC_WORKER(callback), filePath_(filePath), options_(options), table_(NULL) {}
+
+  ~ParseFileWorker() {
+    delete table_;
+  }
+
+  void Execute() {
+    try {
+      FileView file;
+      if (!file.open(filePath_)) {
+        SetError("Could not open file");
+        return;
+      }
+      table_ = new ParsedTable(parseTable(std::move(file), options_));
+    } catch (const std::exception& e) {
+      SetError(e.what());
+    }
+  }
+
+  ADDON_VALUE OnResult() {
+    ParsedTable* table = table_;
+    table_ = NULL;
+    return CsvTableWrap::Create(table);
+  }
+
+private:
+  std::string filePath_;
+  ParseOptions options_;
+  ParsedTable* table_;
+};
+
+// Reads, parses and builds typed columns on the thread pool; only the
+// typed array copies happen on the JS thread
+class ParseColumnsWorker : public ADDON_ASYNC_WORKER {
+public:
+  ParseColumnsWorker(ADDON_FUNCTION_TYPE callback, const std::string& filePath,
+                     const ParseOptions& options, const ColumnarOptions& columnOptions)
+    : ADDON_ASYNC_WORKER(callback), filePath_(filePath), options_(options), columnOptions_(columnOptions) {}
+
+  void Execute() {
+    try {
+      FileView file;
+      if (!file.open(filePath_)) {
+        SetError("Could not open file");
+        return;
+      }
+      ParsedTable table = parseTable(std::move(file), options_);
+      result_ = buildColumns(table, columnOptions_);
+    } catch (const std::exception& e) {
+      SetError(e.what());
+    }
+  }
+
+  ADDON_VALUE OnResult() {
+    return columnsToJs(result_);
+  }
+
+private:
+  std::string filePath_;
+  ParseOptions options_;
+  ColumnarOptions columnOptions_;
+  ColumnarTable result_;
+};
+
+// Serializes rows (already copied out of JS) on the thread pool and either
+// returns the CSV string or writes it to filePath
+class StringifyWorker : public ADDON_ASYNC_WORKER {
+public:
+  StringifyWorker(ADDON_FUNCTION_TYPE callback, const std::string& filePath,
+                  std::vector<std::vector<std::string>>& rows, const StringifyOptions& options)
+    : ADDON_ASYNC_WORKER(callback), filePath_(filePath), options_(options), written_(false) {
+    rows_.swap(rows);
+  }
+
+  void Execute() {
+    try {
+      result_ = stringify(rows_, options_);
+      std::vector<std::vector<std::string>>().swap(rows_);
+
+      if (!filePath_.empty()) {
+        written_ = writeFile(filePath_, result_);
+        std::string().swap(result_);
+      }
+    } catch (const std::exception& e) {
+      SetError(e.what());
+    }
+  }
+
+  ADDON_VALUE OnResult() {
+    if (!filePath_.empty()) {
+      return ADDON_BOOL(written_);
+    }
+    return ADDON_STRING_LEN(result_.data(), result_.length());
+  }
+
+private:
+  std::string filePath_;
+  std::vector<std::vector<std::string>> rows_;
+  StringifyOptions options_;
+  std::string result_;
+  bool written_;
+};
+
+ADDON_METHOD(ParseFileAsync) {
+  ADDON_ENV;
+  if (ADDON_ARG_COUNT() < 3 || !ADDON_IS_STRING(ADDON_ARG(0)) || !ADDON_IS_FUNCTION(ADDON_ARG(2))) {
+    ADDON_THROW_TYPE_ERROR("Arguments must be (filePath, options, callback)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(filePath, ADDON_ARG(0));
+  ParseOptions opts;
+
+  if (ADDON_IS_OBJECT(ADDON_ARG(1))) {
+    opts = extractParseOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
+  }
+
+  ParseFileWorker* worker = new ParseFileWorker(
+    ADDON_AS_FUNCTION(ADDON_ARG(2)), std::string(ADDON_UTF8_VALUE(filePath)), opts);
+  ADDON_QUEUE_WORKER(worker);
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(ParseFileColumnsAsync) {
+  ADDON_ENV;
+  if (ADDON_ARG_COUNT() < 3 || !ADDON_IS_STRING(ADDON_ARG(0)) || !ADDON_IS_FUNCTION(ADDON_ARG(2))) {
+    ADDON_THROW_TYPE_ERROR("Arguments must be (filePath, options, callback)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(filePath, ADDON_ARG(0));
+  ParseOptions opts;
+  ColumnarOptions columnOpts;
+
+  if (ADDON_IS_OBJECT(ADDON_ARG(1))) {
+    opts = extractParseOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
+    columnOpts = extractColumnarOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
+  }
+
+  ParseColumnsWorker* worker = new ParseColumnsWorker(
+    ADDON_AS_FUNCTION(ADDON_ARG(2)), std::string(ADDON_UTF8_VALUE(filePath)), opts, columnOpts);
+  ADDON_QUEUE_WORKER(worker);
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(StringifyAsync) {
+  ADDON_ENV;
+  if (ADDON_ARG_COUNT() < 3 || !ADDON_IS_ARRAY(ADDON_ARG(0)) || !ADDON_IS_FUNCTION(ADDON_ARG(2))) {
+    ADDON_THROW_TYPE_ERROR("Arguments must be (rows, options, callback)");
+    ADDON_VOID_RETURN();
+  }
+
+  StringifyOptions opts;
+  if (ADDON_IS_OBJECT(ADDON_ARG(1))) {
+    opts = extractStringifyOptions(ADDON_AS_OBJECT(ADDON_ARG(1)));
+  }
+
+  // JS values can only be read here; the serialization itself is deferred
+  std::vector<std::vector<std::string>> rows = jsArrayToRows(ADDON_CAST_ARRAY(ADDON_ARG(0)));
+
+  StringifyWorker* worker = new StringifyWorker(
+    ADDON_AS_FUNCTION(ADDON_ARG(2)), std::string(), rows, opts);
+  ADDON_QUEUE_WORKER(worker);
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(WriteFileAsync) {
+  ADDON_ENV;
+  if (ADDON_ARG_COUNT() < 4 || !ADDON_IS_STRING(ADDON_ARG(0)) || !ADDON_IS_ARRAY(ADDON_ARG(1)) ||
+      !ADDON_IS_FUNCTION(ADDON_ARG(3))) {
+    ADDON_THROW_TYPE_ERROR("Arguments must be (filePath, rows, options, callback)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(filePath, ADDON_ARG(0));
+  if (ADDON_UTF8_LENGTH(filePath) == 0) {
+    ADDON_THROW_TYPE_ERROR("filePath must not be empty");
+    ADDON_VOID_RETURN();
+  }
+
+  StringifyOptions opts;
+  if (ADDON_IS_OBJECT(ADDON_ARG(2))) {
+    opts = extractStringifyOptions(ADDON_AS_OBJECT(ADDON_ARG(2)));
+  }
+
+  std::vector<std::vector<std::string>> rows = jsArrayToRows(ADDON_CAST_ARRAY(ADDON_ARG(1)));
+
+  StringifyWorker* worker = new StringifyWorker(
+    ADDON_AS_FUNCTION(ADDON_ARG(3)), std::string(ADDON_UTF8_VALUE(filePath)), rows, opts);
+  ADDON_QUEUE_WORKER(worker);
+  ADDON_VOID_RETURN();
+}
+
+// ============================================
+// CsvReader Implementation
+// ============================================
+
+void CsvReaderWrap::Init(ADDON_INIT_PARAMS) {
+  ADDON_HANDLE_SCOPE();
+
+  auto tpl = ADDON_NEW_CTOR_TEMPLATE();
+  ADDON_SET_CLASS_NAME(tpl, "CsvReader");
+  ADDON_SET_INTERNAL_FIELD_COUNT(tpl, 1);
+
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "next", Next);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "close", Close);
+
+  ADDON_SET_ACCESSOR(tpl, "done", GetDone);
+
+  ADDON_PERSISTENT_RESET(constructor, ADDON_GET_CTOR_FUNCTION(tpl));
+}
+
+ADDON_OBJECT_TYPE CsvReaderWrap::Create(CsvFileReader* reader) {
+  ADDON_ESCAPABLE_SCOPE();
+
+  auto cons = ADDON_PERSISTENT_GET(constructor);
+  ADDON_OBJECT_TYPE instance = ADDON_NEW_INSTANCE(cons);
+
+  CsvReaderWrap* wrap = new CsvReaderWrap();
+  wrap->reader_ = reader;
+  wrap->Wrap(instance);
+
+  return ADDON_ESCAPE(instance);
+}
+
+ADDON_METHOD(CsvReaderWrap::Next) {
+  ADDON_ENV;
+  CsvReaderWrap* wrap = ADDON_UNWRAP(CsvReaderWrap, ADDON_HOLDER());
+
+  if (!wrap->reader_) {
+    ADDON_THROW_ERROR("Reader has been closed");
+    ADDON_VOID_RETURN();
+  }
+
+  uint32_t batchSize = DEFAULT_READER_BATCH;
+  if (ADDON_ARG_COUNT() >= 1 && ADDON_IS_NUMBER(ADDON_ARG(0))) {
+    batchSize = ADDON_TO_UINT32(ADDON_ARG(0));
+  }
+  if (batchSize == 0) {
+    batchSize = DEFAULT_READER_BATCH;
+  }
+
+  std::vector<std::vector<std::string>> rows;
+  wrap->reader_->next(rows, batchSize);
+  ADDON_RETURN(rowsToJsArray(rows));
+}
+
+ADDON_METHOD(CsvReaderWrap::Close) {
+  ADDON_ENV;
+  CsvReaderWrap* wrap = ADDON_UNWRAP(CsvReaderWrap, ADDON_HOLDER());
+
+  if (wrap->reader_) {
+    delete wrap->reader_;
+    wrap->reader_ = NULL;
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_GETTER(CsvReaderWrap::GetDone) {
+  ADDON_ENV;
+  CsvReaderWrap* wrap = ADDON_UNWRAP(CsvReaderWrap, ADDON_HOLDER());
+  bool done = !wrap->reader_ || wrap->reader_->isDone();
+  ADDON_RETURN(ADDON_BOOLEAN(done));
+}
+
+// ============================================
+// CsvTable Implementation
+// ============================================
+
+void CsvTableWrap::Init(ADDON_INIT_PARAMS) {
+  ADDON_HANDLE_SCOPE();
+
+  auto tpl = ADDON_NEW_CTOR_TEMPLATE();
+  ADDON_SET_CLASS_NAME(tpl, "CsvTable");
+  ADDON_SET_INTERNAL_FIELD_COUNT(tpl, 1);
+
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "next", Next);
+
+  ADDON_SET_ACCESSOR(tpl, "done", GetDone);
+  ADDON_SET_ACCESSOR(tpl, "rowCount", GetRowCount);
+
+  ADDON_PERSISTENT_RESET(constructor, ADDON_GET_CTOR_FUNCTION(tpl));
+}
+
+ADDON_OBJECT_TYPE CsvTableWrap::Create(ParsedTable* table) {
+  ADDON_ESCAPABLE_SCOPE();
+
+  auto cons = ADDON_PERSISTENT_GET(constructor);
+  ADDON_OBJECT_TYPE instance = ADDON_NEW_INSTANCE(cons);
+
+  CsvTableWrap* wrap = new CsvTableWrap();
+  wrap->rowCount_ = table->rowCount();
+  if (wrap->rowCount_ > 0) {
+    wrap->table_ = table;
+  } else {
+    delete table;
+  }
+  wrap->Wrap(instance);
+
+  return ADDON_ESCAPE(instance);
+}
+
+ADDON_METHOD(CsvTableWrap::Next) {
+  ADDON_ENV;
+  CsvTableWrap* wrap = ADDON_UNWRAP(CsvTableWrap, ADDON_HOLDER());
+
+  if (!wrap->table_) {
+    ADDON_RETURN(ADDON_ARRAY_EMPTY());
+  }
+
+  uint32_t batchSize = DEFAULT_READER_BATCH;
+  if (ADDON_ARG_COUNT() >= 1 && ADDON_IS_NUMBER(ADDON_ARG(0))) {
+    batchSize = ADDON_TO_UINT32(ADDON_ARG(0));
+  }
+  if (batchSize == 0) {
+    batchSize = DEFAULT_READER_BATCH;
+  }
+
+  size_t count = wrap->rowCount_ - wrap->cursor_;
+  if (count > batchSize) {
+    count = batchSize;
+  }
+
+  ADDON_ARRAY_TYPE rows = rowsToJsArray(*wrap->table_, wrap->cursor_, count);
+  wrap->cursor_ += count;
+
+  // Release the buffer as soon as the last row has been handed out
+  if (wrap->cursor_ == wrap->rowCount_) {
+    delete wrap->table_;
+    wrap->table_ = NULL;
+  }
+
+  ADDON_RETURN(rows);
+}
+
+ADDON_GETTER(CsvTableWrap::GetDone) {
+  ADDON_ENV;
+  CsvTableWrap* wrap = ADDON_UNWRAP(CsvTableWrap, ADDON_HOLDER());
+  ADDON_RETURN(ADDON_BOOLEAN(wrap->table_ == NULL));
+}
+
+ADDON_GETTER(CsvTableWrap::GetRowCount) {
+  ADDON_ENV;
+  CsvTableWrap* wrap = ADDON_UNWRAP(CsvTableWrap, ADDON_HOLDER());
+  ADDON_RETURN(ADDON_NUMBER(wrap->rowCount_));
+}
+
+// ============================================
+// CsvWriter Implementation
+// ============================================
+
+void CsvWriterWrap::Init(ADDON_INIT_PARAMS) {
+  ADDON_HANDLE_SCOPE();
+
+  auto tpl = ADDON_NEW_CTOR_TEMPLATE();
+  ADDON_SET_CLASS_NAME(tpl, "CsvWriter");
+  ADDON_SET_INTERNAL_FIELD_COUNT(tpl, 1);
+
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "writeRows", WriteRows);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "flush", Flush);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "close", Close);
+
+  ADDON_SET_ACCESSOR(tpl, "bytesWritten", GetBytesWritten);
+
+  ADDON_PERSISTENT_RESET(constructor, ADDON_GET_CTOR_FUNCTION(tpl));
+}
+
+ADDON_OBJECT_TYPE CsvWriterWrap::Create(CsvFileWriter* writer) {
+  ADDON_ESCAPABLE_SCOPE();
+
+  auto cons = ADDON_PERSISTENT_GET(constructor);
+  ADDON_OBJECT_TYPE instance = ADDON_NEW_INSTANCE(cons);
+
+  CsvWriterWrap* wrap = new CsvWriterWrap();
+  wrap->writer_ = writer;
+  wrap->Wrap(instance);
+
+  return ADDON_ESCAPE(instance);
+}
+
+// writeRows(rows): rows is an array of arrays of strings; other cell
+// values are written as empty fields, as in csvStringify
+ADDON_METHOD(CsvWriterWrap::WriteRows) {
+  ADDON_ENV;
+  CsvWriterWrap* wrap = ADDON_UNWRAP(CsvWriterWrap, ADDON_HOLDER());
+
+  if (!wrap->writer_->isOpen()) {
+    ADDON_THROW_ERROR("Writer has been closed");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_ARRAY(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("First argument must be an array");
+    ADDON_VOID_RETURN();
+  }
+
+  CsvFileWriter* writer = wrap->writer_;
+  ADDON_ARRAY_TYPE rows = ADDON_CAST_ARRAY(ADDON_ARG(0));
+
+  for (uint32_t i = 0; i < ADDON_LENGTH(rows); i++) {
+    ADDON_VALUE rowVal = ADDON_GET_INDEX(rows, i);
+
+    if (ADDON_IS_ARRAY(rowVal)) {
+      ADDON_ARRAY_TYPE jsRow = ADDON_CAST_ARRAY(rowVal);
+      for (uint32_t j = 0; j < ADDON_LENGTH(jsRow); j++) {
+        ADDON_VALUE cellVal = ADDON_GET_INDEX(jsRow, j);
+        if (ADDON_IS_STRING(cellVal)) {
+          ADDON_UTF8(str, cellVal);
+          writer->writeField(ADDON_UTF8_VALUE(str), ADDON_UTF8_LENGTH(str));
+        } else {
+          writer->writeField("", 0);
+        }
+      }
+    }
+
+    writer->endRow();
+  }
+
+  if (writer->hasFailed()) {
+    ADDON_THROW_ERROR("Could not write file");
+    ADDON_VOID_RETURN();
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(CsvWriterWrap::Flush) {
+  ADDON_ENV;
+  CsvWriterWrap* wrap = ADDON_UNWRAP(CsvWriterWrap, ADDON_HOLDER());
+
+  if (!wrap->writer_->isOpen()) {
+    ADDON_THROW_ERROR("Writer has been closed");
+    ADDON_VOID_RETURN();
+  }
+  if (!wrap->writer_->flush()) {
+    ADDON_THROW_ERROR("Could not write file");
+    ADDON_VOID_RETURN();
+  }
+  ADDON_VOID_RETURN();
+}
+
+// @returns true if every write succeeded; closing again is a no-op
+ADDON_METHOD(CsvWriterWrap::Close) {
+  ADDON_ENV;
+  CsvWriterWrap* wrap = ADDON_UNWRAP(CsvWriterWrap, ADDON_HOLDER());
+  ADDON_RETURN(ADDON_BOOLEAN(wrap->writer_->close()));
+}
+
+ADDON_GETTER(CsvWriterWrap::GetBytesWritten) {
+  ADDON_ENV;
+  CsvWriterWrap* wrap = ADDON_UNWRAP(CsvWriterWrap, ADDON_HOLDER());
+  ADDON_RETURN(ADDON_NUMBER(static_cast<double>(wrap->writer_->bytesWritten())));
+}
+
 void InitCsvParser(ADDON_INIT_PARAMS) {
+  CsvReaderWrap::Init(exports);
+  CsvTableWrap::Init(exports);
+  CsvWriterWrap::Init(exports);
+
   ADDON_EXPORT_FUNCTION(exports, "csvParse", Parse);
   ADDON_EXPORT_FUNCTION(exports, "csvParseFile", ParseFile);
+  ADDON_EXPORT_FUNCTION(exports, "csvParseColumns", ParseColumns);
+  ADDON_EXPORT_FUNCTION(exports, "csvParseFileColumns", ParseFileColumns);
+  ADDON_EXPORT_FUNCTION(exports, "csvOpenReader", OpenReader);
+  ADDON_EXPORT_FUNCTION(exports, "csvOpenWriter", OpenWriter);
   ADDON_EXPORT_FUNCTION(exports, "csvStringify", Stringify);
   ADDON_EXPORT_FUNCTION(exports, "csvWriteFile", WriteFile);
+  ADDON_EXPORT_FUNCTION(exports, "csvParseFileAsync", ParseFileAsync);
+  ADDON_EXPORT_FUNCTION(exports, "csvParseFileColumnsAsync", ParseFileColumnsAsync);
+  ADDON_EXPORT_FUNCTION(exports, "csvStringifyAsync", StringifyAsync);
+  ADDON_EXPORT_FUNCTION(exports, "csvWriteFileAsync", WriteFileAsync);
 }
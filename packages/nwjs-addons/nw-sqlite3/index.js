@@ -12,6 +12,29 @@
 'use strict'
 
 var native = null
+var DEFAULT_BATCH_SIZE = 256
+
+// Pages copied per step by Database#backup
+var DEFAULT_BACKUP_PAGES = 100
+
+// Rows inserted per transaction by Database#importCsv
+var DEFAULT_IMPORT_BATCH = 10000
+
+/**
+ * Named option sets for new Database(path, { preset }); explicit options
+ * win over the preset's
+ */
+var PRESETS = {
+  // WAL (readers never block the writer), fsync only at checkpoints,
+  // 64 MB page cache, 256 MB memory map, temp tables in memory
+  performance: {
+    journalMode: 'wal',
+    synchronous: 'normal',
+    cacheSize: -65536,
+    mmapSize: 268435456,
+    tempStore: 'memory'
+  }
+}
 var loadError = null
 
 try {
@@ -36,11 +59,46 @@ function getLoadError() {
   return loadError
 }
 
+/**
+ * Call a native async method and wrap its (err, result) callback
+ * @param {Object} target - Native object
+ * @param {string} method - Method name
+ * @param {Array} args - Arguments before the callback
+ * @returns {Promise}
+ */
+function callAsync(target, method, args) {
+  return new Promise(function(resolve, reject) {
+    target[method].apply(target, args.concat(function(err, result) {
+      if (err) {
+        reject(err)
+        return
+      }
+      resolve(result)
+    }))
+  })
+}
+
 /**
  * Database class
  * @param {string} path - Path to database file (or ':memory:' for in-memory)
  * @param {Object} [options] - Options
  * @param {boolean} [options.readonly=false] - Open in read-only mode
+ * @param {number} [options.statementCacheSize=64] - Compiled statements kept
+ *   for reuse by prepare()/query() with the same SQL text (0 disables)
+ * @param {number} [options.asyncReaders=4] - Read-only connections opened
+ *   on demand for async reads (file databases only)
+ * @param {string} [options.preset] - 'performance' (see PRESETS)
+ * @param {string} [options.journalMode] - 'delete', 'truncate', 'persist',
+ *   'memory', 'wal' or 'off'
+ * @param {string|number} [options.synchronous] - 'off', 'normal', 'full'
+ *   or 'extra'
+ * @param {number} [options.cacheSize] - PRAGMA cache_size (pages, or KiB
+ *   if negative)
+ * @param {number} [options.mmapSize] - PRAGMA mmap_size in bytes
+ * @param {string|number} [options.tempStore] - 'default', 'file' or 'memory'
+ * @param {number} [options.pageSize] - PRAGMA page_size (new databases)
+ * @param {number} [options.walAutocheckpoint] - WAL pages before an
+ *   automatic checkpoint (0 turns them off)
  */
 function Database(path, options) {
   if (!native || !native.Database) {
@@ -48,6 +106,25 @@ function Database(path, options) {
   }
 
   options = options || {}
+  if (options.preset !== undefined) {
+    var preset = PRESETS[options.preset]
+    if (!preset || !PRESETS.hasOwnProperty(options.preset)) {
+      throw new TypeError('Unknown preset: ' + options.preset)
+    }
+
+    var merged = {}
+    var key
+    for (key in preset) {
+      merged[key] = preset[key]
+    }
+    for (key in options) {
+      if (options[key] !== undefined) {
+        merged[key] = options[key]
+      }
+    }
+    options = merged
+  }
+
   this._native = new native.Database(path, options)
 }
 
@@ -88,16 +165,442 @@ Object.defineProperty(Database.prototype, 'inTransaction', {
  */
 Database.prototype.exec = function(sql) {
   this._native.exec(sql)
+  flushProfile(this)
   return this
 }
 
 /**
- * Prepare a SQL statement
+ * Prepare a SQL statement. An idle compiled statement for the same SQL is
+ * reused from the statement cache; it returns to the cache when the
+ * Statement is finalized (or garbage collected).
  * @param {string} sql - SQL statement
  * @returns {Statement}
  */
 Database.prototype.prepare = function(sql) {
-  return new Statement(this._native.prepare(sql))
+  return new Statement(this._native.prepare(sql), this)
+}
+
+/**
+ * Run SQL through the statement cache without an explicit prepare step
+ * @param {string} sql - SQL statement
+ * @param {...*} params - Bind parameters, as for Statement#run (values in
+ *   order or one object of named parameters)
+ * @returns {Array<Object>|{changes: number, lastInsertRowid: number}}
+ *   All rows for statements that return rows, otherwise the run() result
+ */
+Database.prototype.query = function(sql) {
+  var result = this._native.query.apply(this._native, arguments)
+  flushProfile(this)
+  return result
+}
+
+/**
+ * Execute SQL on a worker thread. A script whose every statement is a
+ * read runs on one of the read connections; anything else goes through
+ * the async writer connection, after the writes queued before it.
+ * @param {string} sql - SQL statement(s)
+ * @returns {Promise<undefined>}
+ */
+Database.prototype.execAsync = function(sql) {
+  return callAsync(this._native, 'execAsync', [sql])
+}
+
+/**
+ * query() on a worker thread. A statement SQLite reports as read-only
+ * (SELECT, WITH ... SELECT, VALUES, EXPLAIN) runs on one of the read
+ * connections, concurrently with the others; anything else waits for the
+ * writes queued before it.
+ *
+ * Async calls use their own connections to the same file: they do not see
+ * this connection's open transaction or temp tables, reads are not ordered
+ * against pending writes, and in-memory databases are not supported.
+ * @param {string} sql - SQL statement
+ * @param {...*} params - Bind parameters, as for Statement#run (values in
+ *   order or one object of named parameters)
+ * @returns {Promise<Array<Object>|{changes: number, lastInsertRowid: number}>}
+ */
+Database.prototype.queryAsync = function(sql) {
+  return callAsync(this._native, 'queryAsync', [sql, Array.prototype.slice.call(arguments, 1)])
+}
+
+/**
+ * Open one BLOB cell for incremental I/O (sqlite3_blob_open). Reads and
+ * writes go between the database and your Buffers without loading the
+ * whole value; the size is fixed, so write zeroblob(n) first to make room.
+ * @param {string} table
+ * @param {string} column
+ * @param {number} rowid
+ * @param {Object} [options]
+ * @param {boolean} [options.writable=false]
+ * @param {string} [options.database='main'] - Attached database name
+ * @returns {BlobHandle}
+ */
+Database.prototype.openBlob = function(table, column, rowid, options) {
+  options = options || {}
+  return new BlobHandle(this._native.openBlob(table, column, rowid, !!options.writable,
+    options.database || 'main'))
+}
+
+/**
+ * Start an online backup that the caller steps by hand
+ * @param {string|Database} destination - File path or open Database; its
+ *   main database is overwritten
+ * @param {Object} [options]
+ * @param {string} [options.schema='main'] - Attached database to copy
+ * @returns {BackupHandle}
+ */
+Database.prototype.openBackup = function(destination, options) {
+  options = options || {}
+  var target = destination instanceof Database ? destination._native : destination
+  return new BackupHandle(this._native.openBackup(target, options.schema || 'main'))
+}
+
+/**
+ * Copy the database while it stays in use: options.pagesPerStep pages
+ * per step, yielding to the event loop in between so writers are only
+ * held up for one step at a time. Writes through this connection are
+ * carried into the copy; writes from other connections (including the
+ * async pool) restart it.
+ * @param {string|Database} destination - File path or open Database
+ * @param {Object} [options]
+ * @param {number} [options.pagesPerStep=100] - Negative copies everything
+ *   in one step
+ * @param {string} [options.schema='main']
+ * @param {Function} [options.progress] - Called after each step with
+ *   { totalPages, remainingPages }
+ * @returns {Promise<{totalPages: number}>}
+ */
+Database.prototype.backup = function(destination, options) {
+  options = options || {}
+  var pages = options.pagesPerStep !== undefined ? options.pagesPerStep : DEFAULT_BACKUP_PAGES
+  var progress = options.progress
+  var handle
+
+  try {
+    handle = this.openBackup(destination, options)
+  } catch (err) {
+    return Promise.reject(err)
+  }
+
+  return new Promise(function(resolve, reject) {
+    function next() {
+      var done
+      try {
+        done = handle.step(pages)
+        if (!done && progress) {
+          progress({ totalPages: handle.pageCount, remainingPages: handle.remaining })
+        }
+      } catch (err) {
+        handle.close()
+        reject(err)
+        return
+      }
+
+      if (done) {
+        resolve({ totalPages: handle.pageCount })
+      } else {
+        setImmediate(next)
+      }
+    }
+    next()
+  })
+}
+
+/**
+ * Load a CSV file into a table without passing rows through JS: the file
+ * is parsed and inserted on the async pool's writer connection, one
+ * transaction per batch, queued in order with the other async writes.
+ * By default the table is created if missing, with columns named from
+ * the header row and typed INTEGER, REAL or TEXT from the first
+ * inferRows rows. Fields insert as text converted by the column's
+ * affinity; empty and missing fields insert NULL. A failing row rejects
+ * with "Row N: ..." (N counts CSV records from 1, header and blank lines
+ * included); its batch is rolled back, earlier batches stay. File
+ * databases only.
+ * @param {string} path - CSV file
+ * @param {string} table - Table to insert into
+ * @param {Object} [options]
+ * @param {string} [options.delimiter=',']
+ * @param {string} [options.quote='"']
+ * @param {string} [options.escape='"']
+ * @param {boolean} [options.trim=false]
+ * @param {boolean} [options.skipEmptyLines=true]
+ * @param {boolean} [options.header=true] - First row names the columns;
+ *   without it rows insert by position (columns c1, c2, ... if created)
+ * @param {Array<string>} [options.columns] - Column names, overriding
+ *   the header
+ * @param {boolean} [options.create=true] - CREATE TABLE IF NOT EXISTS
+ * @param {number} [options.inferRows=1000] - Rows sampled for column types
+ * @param {boolean} [options.emptyAsNull=true] - Empty fields insert NULL
+ *   instead of ''
+ * @param {number} [options.batchSize=10000] - Rows per transaction
+ * @param {Function} [options.progress] - Called after each batch with
+ *   { rows, bytesRead, totalBytes }
+ * @returns {Promise<{rows: number, columns: Array<string>}>}
+ */
+Database.prototype.importCsv = function(path, table, options) {
+  options = options || {}
+  var rows = options.batchSize !== undefined ? options.batchSize : DEFAULT_IMPORT_BATCH
+  var progress = options.progress
+  var handle
+
+  try {
+    handle = this._native.importCsv(path, table, options)
+  } catch (err) {
+    return Promise.reject(err)
+  }
+
+  return new Promise(function(resolve, reject) {
+    function next() {
+      handle.step(rows, function(err, state) {
+        if (err) {
+          reject(err)
+          return
+        }
+        try {
+          if (progress) {
+            progress({ rows: state.rows, bytesRead: state.bytesRead, totalBytes: state.totalBytes })
+          }
+        } catch (progressErr) {
+          reject(progressErr)
+          return
+        }
+
+        if (state.done) {
+          resolve({ rows: state.rows, columns: state.columns })
+        } else {
+          next()
+        }
+      })
+    }
+    next()
+  })
+}
+
+/**
+ * Image of the database in one Buffer (sqlite3_serialize): the file
+ * contents of a disk database, or a single copy of an in-memory one
+ * @param {string} [schema='main'] - Attached database to serialize
+ * @returns {Buffer}
+ */
+Database.prototype.serialize = function(schema) {
+  return this._native.serialize(schema || 'main')
+}
+
+/**
+ * Replace the database with a copy of a serialize() image
+ * (sqlite3_deserialize). The connection then works on that in-memory
+ * copy; the file it was opened on is left alone and async queries keep
+ * reading the file.
+ * @param {Buffer} buffer
+ * @param {Object} [options]
+ * @param {string} [options.schema='main']
+ * @param {boolean} [options.readonly=false]
+ * @returns {Database} this for chaining
+ */
+Database.prototype.deserialize = function(buffer, options) {
+  options = options || {}
+  this._native.deserialize(buffer, options.schema || 'main', !!options.readonly)
+  return this
+}
+
+/**
+ * Checkpoint the write-ahead log (WAL mode)
+ * @param {string} [mode='passive'] - 'passive', 'full', 'restart' or
+ *   'truncate'
+ * @returns {{logFrames: number, checkpointedFrames: number}}
+ */
+Database.prototype.checkpoint = function(mode) {
+  return this._native.checkpoint(mode)
+}
+
+/**
+ * Checkpoint automatically once the WAL holds this many pages
+ * @param {number} pages - 0 turns automatic checkpoints off
+ * @returns {Database} this for chaining
+ */
+Database.prototype.walAutocheckpoint = function(pages) {
+  this._native.walAutocheckpoint(pages)
+  return this
+}
+
+/**
+ * Register a JS function callable from SQL on this connection. Arguments
+ * arrive as numbers, strings, Buffers or null; the return value converts
+ * like a bound parameter. A thrown error fails the statement with its
+ * message. JS functions only run on this connection: an async query
+ * calling one fails with "name() is a JS function and cannot run in
+ * async queries".
+ * @param {string} name
+ * @param {Object} [options]
+ * @param {boolean} [options.deterministic=false] - Same result for the same
+ *   arguments, so SQLite may use it in indexes and evaluate it once
+ * @param {boolean} [options.varargs=false] - Any number of arguments
+ *   instead of fn.length
+ * @param {Function} fn
+ * @returns {Database} this for chaining
+ */
+Database.prototype.function = function(name, options, fn) {
+  if (typeof options === 'function') {
+    fn = options
+    options = {}
+  }
+  options = options || {}
+  if (typeof fn !== 'function') {
+    throw new TypeError('Expected a function')
+  }
+
+  this._native['function'](name, fn, options.varargs ? -1 : fn.length, !!options.deterministic)
+  return this
+}
+
+/**
+ * Register an aggregate function. step(total, ...args) runs for each row
+ * and returns the new total (or updates it in place and returns nothing);
+ * result(total) turns the final total into the SQL value. Like
+ * function(), it cannot be used by async queries.
+ * @param {string} name
+ * @param {Object} options
+ * @param {*|Function} [options.start=null] - Starting total, or a function
+ *   returning one (use a function for objects and arrays, which would
+ *   otherwise be shared between groups)
+ * @param {Function} options.step
+ * @param {Function} [options.result] - Defaults to the total itself
+ * @param {boolean} [options.deterministic=false]
+ * @param {boolean} [options.varargs=false] - Any number of arguments
+ *   instead of step.length - 1
+ * @returns {Database} this for chaining
+ */
+Database.prototype.aggregate = function(name, options) {
+  if (!options || typeof options.step !== 'function') {
+    throw new TypeError('Expected options.step to be a function')
+  }
+  if (options.result !== undefined && typeof options.result !== 'function') {
+    throw new TypeError('Expected options.result to be a function')
+  }
+
+  var start = options.start === undefined ? null : options.start
+  var arity = options.varargs ? -1 : Math.max(options.step.length - 1, 0)
+  this._native.aggregate(name, start, options.step, options.result || null, arity,
+    !!options.deterministic)
+  return this
+}
+
+/**
+ * Register a C function as an SQL scalar function, called straight from
+ * the query without entering JS. The address comes from tinycc
+ * (getSymbol()) or a loaded DLL. All arguments share one type, e.g.
+ * double f(double, double); a NULL argument gives NULL without a call.
+ * The code must stay loaded (tinycc compiler not released, DLL not
+ * unloaded) until the database is closed. Async queries can call it too,
+ * from worker threads, so it must be thread-safe.
+ * @param {string} name
+ * @param {number} address - Function pointer
+ * @param {Object} signature
+ * @param {string} [signature.returns='double'] - 'int32', 'int64' or 'double'
+ * @param {string[]} [signature.args=[]] - Up to 4 argument types, all the same
+ * @param {boolean} [signature.deterministic=false]
+ * @returns {Database} this for chaining
+ */
+Database.prototype.nativeFunction = function(name, address, signature) {
+  signature = signature || {}
+  if (typeof address !== 'number' || !address) {
+    throw new TypeError('Expected a function address')
+  }
+
+  this._native.nativeFunction(name, address, signature.returns || 'double', signature.args || [],
+    !!signature.deterministic)
+  return this
+}
+
+/**
+ * Report each finished statement of this connection to fn(sql, time),
+ * time in milliseconds as measured by SQLite (sqlite3_trace_v2; coarse on
+ * Windows). Reports are queued natively and delivered when the call that
+ * ran the statement returns; statements run by fn itself are not
+ * reported, and at most 1024 are queued between deliveries. The async
+ * pool's connections are not profiled.
+ * @param {Function|null} fn - null turns profiling off
+ * @returns {Database} this for chaining
+ */
+Database.prototype.profile = function(fn) {
+  if (fn !== null && typeof fn !== 'function') {
+    throw new TypeError('Expected a function or null')
+  }
+
+  this._native.setProfiling(!!fn)
+  this._profile = fn
+  return this
+}
+
+/**
+ * Time each step of this connection's statements for Statement#stats
+ * (totalTime, maxStepTime). Off by default; costs two clock reads a step.
+ * @param {boolean} [enabled=true]
+ * @returns {Database} this for chaining
+ */
+Database.prototype.setStatementTiming = function(enabled) {
+  this._native.setStatementTiming(enabled === undefined ? true : !!enabled)
+  return this
+}
+
+/**
+ * Abort any single step (or exec()) running longer than ms with
+ * "Query timed out". Needs an addon built with NW_SQLITE3_PROGRESS=ON
+ * (SQLite's progress callback); other builds throw for ms > 0.
+ * @param {number} ms - 0 turns the limit off
+ * @returns {Database} this for chaining
+ */
+Database.prototype.setQueryTimeout = function(ms) {
+  this._native.setQueryTimeout(ms)
+  return this
+}
+
+/**
+ * Hand statements recorded since the last call to the profile() hook
+ * @param {Database} db
+ */
+function flushProfile(db) {
+  if (!db || !db._profile || db._inProfile) {
+    return
+  }
+
+  var entries = db._native.takeProfile().entries
+  if (entries.length === 0) {
+    return
+  }
+
+  db._inProfile = true
+  try {
+    for (var i = 0; i < entries.length && db._profile; i++) {
+      db._profile(entries[i].sql, entries[i].time)
+    }
+  } finally {
+    db._inProfile = false
+    // Whatever the hook ran itself
+    if (db._native.open) {
+      db._native.takeProfile()
+    }
+  }
+}
+
+/**
+ * Statement cache counters
+ * @returns {{size: number, capacity: number, hits: number, misses: number}}
+ */
+Database.prototype.cacheStats = function() {
+  return this._native.cacheStats()
+}
+
+/**
+ * Change the statement cache capacity; shrinking evicts the least
+ * recently used statements
+ * @param {number} size - Statements to keep (0 disables the cache)
+ * @returns {Database} this for chaining
+ */
+Database.prototype.setCacheSize = function(size) {
+  this._native.setCacheSize(size)
+  return this
 }
 
 /**
@@ -111,40 +614,69 @@ Database.prototype.pragma = function(pragma, options) {
   var stmt = this.prepare('PRAGMA ' + pragma)
   options = options || {}
 
-  if (options.simple) {
-    var row = stmt.get()
-    if (row) {
-      // Return first column value
-      var keys = Object.keys(row)
-      return keys.length > 0 ? row[keys[0]] : undefined
+  try {
+    if (options.simple) {
+      var row = stmt.get()
+      if (row) {
+        // Return first column value
+        var keys = Object.keys(row)
+        return keys.length > 0 ? row[keys[0]] : undefined
+      }
+      return undefined
     }
-    return undefined
-  }
 
-  return stmt.all()
+    return stmt.all()
+  } finally {
+    // Hand the statement back to the cache now rather than at GC
+    stmt.finalize()
+  }
 }
 
 /**
- * Create a transaction wrapper function
- * @param {Function} fn - Function to wrap in transaction
- * @returns {Function} Wrapped function that runs in transaction
+ * Wrap fn so each call runs in begin()/commit(), rolling back if it throws
+ * @param {Object} nativeDb
+ * @param {Function} fn
+ * @param {string} mode
+ * @returns {Function}
  */
-Database.prototype.transaction = function(fn) {
-  var db = this
-
+function transactionFunction(nativeDb, fn, mode) {
   return function transactionWrapper() {
-    var args = arguments
+    nativeDb.begin(mode)
 
-    db.exec('BEGIN TRANSACTION')
+    var result
     try {
-      var result = fn.apply(null, args)
-      db.exec('COMMIT')
-      return result
+      result = fn.apply(this, arguments)
+      nativeDb.commit()
     } catch (err) {
-      db.exec('ROLLBACK')
+      if (nativeDb.open) {
+        nativeDb.rollback()
+      }
       throw err
     }
+    return result
+  }
+}
+
+/**
+ * Create a transaction wrapper function. Calling it inside another
+ * transaction makes a savepoint, so wrappers nest. BEGIN/COMMIT/ROLLBACK
+ * and the savepoint statements are prepared once per connection.
+ *
+ * The wrapper begins with BEGIN DEFERRED; wrapper.immediate and
+ * wrapper.exclusive use BEGIN IMMEDIATE / BEGIN EXCLUSIVE instead.
+ * @param {Function} fn - Function to wrap in transaction
+ * @returns {Function} Wrapped function that runs in transaction
+ */
+Database.prototype.transaction = function(fn) {
+  if (typeof fn !== 'function') {
+    throw new TypeError('Expected a function')
   }
+
+  var wrapper = transactionFunction(this._native, fn, 'deferred')
+  wrapper.deferred = wrapper
+  wrapper.immediate = transactionFunction(this._native, fn, 'immediate')
+  wrapper.exclusive = transactionFunction(this._native, fn, 'exclusive')
+  return wrapper
 }
 
 /**
@@ -156,9 +688,16 @@ Database.prototype.close = function() {
 
 /**
  * Statement class
+ *
+ * run(), get(), all(), iterate() and the async variants take their bind
+ * parameters as values in parameter order, or as one object of named
+ * parameters keyed without the @/:/$ prefix (stmt.run({ id: 1 })). Other
+ * values given with the object fill the unnamed (?) parameters in order;
+ * parameters left out bind NULL.
  */
-function Statement(nativeStatement) {
+function Statement(nativeStatement, db) {
   this._native = nativeStatement
+  this._db = db
 }
 
 /**
@@ -187,25 +726,143 @@ Object.defineProperty(Statement.prototype, 'reader', {
  * @returns {{changes: number, lastInsertRowid: number}}
  */
 Statement.prototype.run = function() {
-  return this._native.run.apply(this._native, arguments)
+  var result = this._native.run.apply(this._native, arguments)
+  flushProfile(this._db)
+  return result
+}
+
+/**
+ * Run the statement once per row inside one transaction (a savepoint if
+ * one is already open); any failure rolls the whole batch back
+ * @param {Array<Array|Object>} rows - Positional (array) or named (object,
+ *   keyed without the @/:/$ prefix) parameters for each run
+ * @returns {{rows: number, changes: number, lastInsertRowid: number}}
+ */
+Statement.prototype.runBatch = function(rows) {
+  var result = this._native.runBatch(rows)
+  flushProfile(this._db)
+  return result
+}
+
+/**
+ * runBatch() over column data: run r binds element r of every column.
+ * Typed arrays are read in place (Float32Array/Float64Array NaN binds
+ * NULL); plain arrays take any value run() accepts.
+ * @param {Object|Array} columns - Columns keyed by parameter name, or an
+ *   array of columns in parameter order, all the same length
+ * @returns {{rows: number, changes: number, lastInsertRowid: number}}
+ */
+Statement.prototype.runColumns = function(columns) {
+  var result = this._native.runColumns(columns)
+  flushProfile(this._db)
+  return result
+}
+
+/**
+ * Return rows as arrays of column values instead of objects
+ * (get() and all())
+ * @param {boolean} [toggle=true]
+ * @returns {Statement} this for chaining
+ */
+Statement.prototype.raw = function(toggle) {
+  this._native.raw(toggle === undefined ? true : !!toggle)
+  return this
+}
+
+/**
+ * Make all() return the result column by column:
+ * { rowCount, columns: [{ name, type, values, nulls }] }.
+ * INTEGER/REAL columns ('integer', 'real') come as a Float64Array with NaN
+ * for NULL, as do columns with no value but NULL ('null'); BLOB columns
+ * ('blob') as an Array of Buffers and anything else ('text') as an Array
+ * of strings. nulls is a Uint8Array bitmap: row r is
+ * NULL when nulls[r >> 3] & (1 << (r & 7)). iterate() throws while this
+ * is on.
+ * @param {boolean} [toggle=true]
+ * @returns {Statement} this for chaining
+ */
+Statement.prototype.columns = function(toggle) {
+  this._native.columnar(toggle === undefined ? true : !!toggle)
+  return this
 }
 
 /**
  * Get first row
  * @param {...*} params - Bind parameters
- * @returns {Object|undefined}
+ * @returns {Object|Array|undefined}
  */
 Statement.prototype.get = function() {
-  return this._native.get.apply(this._native, arguments)
+  var row = this._native.get.apply(this._native, arguments)
+  flushProfile(this._db)
+  return row
 }
 
 /**
  * Get all rows
  * @param {...*} params - Bind parameters
- * @returns {Array<Object>}
+ * @returns {Array<Object>|Array<Array>|{rowCount: number, columns: Array}}
+ *   Objects by default, arrays after raw(), columns after columns()
  */
 Statement.prototype.all = function() {
-  return this._native.all.apply(this._native, arguments)
+  var rows = this._native.all.apply(this._native, arguments)
+  flushProfile(this._db)
+  return rows
+}
+
+/**
+ * run() on a worker thread (see Database#queryAsync)
+ * @param {...*} params - Bind parameters
+ * @returns {Promise<{changes: number, lastInsertRowid: number}>}
+ */
+Statement.prototype.runAsync = function() {
+  return callAsync(this._native, 'async', ['run', Array.prototype.slice.call(arguments)])
+}
+
+/**
+ * get() on a worker thread (see Database#queryAsync)
+ * @param {...*} params - Bind parameters
+ * @returns {Promise<Object|Array|undefined>}
+ */
+Statement.prototype.getAsync = function() {
+  return callAsync(this._native, 'async', ['get', Array.prototype.slice.call(arguments)])
+}
+
+/**
+ * all() on a worker thread (see Database#queryAsync); honours raw() and
+ * columns()
+ * @param {...*} params - Bind parameters
+ * @returns {Promise<Array<Object>|Array<Array>|{rowCount: number, columns: Array}>}
+ */
+Statement.prototype.allAsync = function() {
+  return callAsync(this._native, 'async', ['all', Array.prototype.slice.call(arguments)])
+}
+
+/**
+ * Rows fetched per native call by iterate()
+ * @param {number} size - Rows per batch (default 256)
+ * @returns {Statement} this for chaining
+ */
+Statement.prototype.batchSize = function(size) {
+  if (typeof size !== 'number' || size < 1) {
+    throw new TypeError('batchSize must be a positive number')
+  }
+  this._batchSize = Math.floor(size)
+  return this
+}
+
+/**
+ * Step through the rows lazily. Rows are fetched batchSize() at a time, so
+ * memory stays flat however large the result; returning early from a
+ * for...of loop (or calling iterator.return()) stops the query. Running
+ * the statement again before the iterator is done makes its next() throw.
+ * Rows come as objects, or arrays with raw(); a statement in columns()
+ * mode throws a TypeError.
+ * @param {...*} params - Bind parameters
+ * @returns {RowIterator}
+ */
+Statement.prototype.iterate = function() {
+  var pass = this._native.iterate.apply(this._native, arguments)
+  return new RowIterator(this._native, pass, this._batchSize || DEFAULT_BATCH_SIZE, this._db)
 }
 
 /**
@@ -214,19 +871,236 @@ Statement.prototype.all = function() {
  */
 Statement.prototype.reset = function() {
   this._native.reset()
+  flushProfile(this._db)
+  return this
+}
+
+/**
+ * Execution counters since the statement was prepared. totalTime and
+ * maxStepTime (ms) stay 0 unless Database#setStatementTiming is on.
+ * @returns {{executions: number, rows: number, totalTime: number,
+ *   maxStepTime: number, fullscanSteps: number, sorts: number,
+ *   autoindexes: number, vmSteps: number}}
+ */
+Statement.prototype.stats = function() {
+  return this._native.stats()
+}
+
+/**
+ * How SQLite runs the statement. Bind parameters count as NULL.
+ * @param {boolean} [queryPlan=true] - EXPLAIN QUERY PLAN rows
+ *   ({ id, parent, notused, detail }); false gives the EXPLAIN bytecode
+ * @returns {Array<Object>}
+ */
+Statement.prototype.explain = function(queryPlan) {
+  return this._native.explain(queryPlan === undefined ? true : !!queryPlan)
+}
+
+/**
+ * Iterator over one pass of a statement (see Statement#iterate)
+ * @param {Object} nativeStatement
+ * @param {number} pass - Pass number from the native iterate()
+ * @param {number} batchSize
+ * @param {Database} db - For profile() reports
+ */
+function RowIterator(nativeStatement, pass, batchSize, db) {
+  this._native = nativeStatement
+  this._db = db
+  this._pass = pass
+  this._batchSize = batchSize
+  this._rows = []
+  this._index = 0
+  this._done = false
+}
+
+/**
+ * @returns {{value: (Object|Array|undefined), done: boolean}}
+ */
+RowIterator.prototype.next = function() {
+  if (this._index >= this._rows.length) {
+    if (this._done) {
+      return { value: undefined, done: true }
+    }
+
+    this._rows = this._native.iterateNext(this._pass, this._batchSize)
+    this._index = 0
+    // A short batch means the native side has finished and reset
+    if (this._rows.length < this._batchSize) {
+      this._done = true
+      flushProfile(this._db)
+    }
+    if (this._rows.length === 0) {
+      return { value: undefined, done: true }
+    }
+  }
+
+  return { value: this._rows[this._index++], done: false }
+}
+
+/**
+ * Stop early and reset the statement
+ * @returns {{value: undefined, done: boolean}}
+ */
+RowIterator.prototype.return = function() {
+  if (!this._done) {
+    this._done = true
+    this._native.iterateEnd(this._pass)
+    flushProfile(this._db)
+  }
+  this._rows = []
+  this._index = 0
+  return { value: undefined, done: true }
+}
+
+if (typeof Symbol === 'function' && Symbol.iterator) {
+  RowIterator.prototype[Symbol.iterator] = function() {
+    return this
+  }
+}
+
+/**
+ * Incremental I/O handle from Database#openBlob
+ * @param {Object} nativeBlob
+ */
+function BlobHandle(nativeBlob) {
+  this._native = nativeBlob
+}
+
+/**
+ * Size in bytes (null once closed)
+ * @returns {number|null}
+ */
+Object.defineProperty(BlobHandle.prototype, 'size', {
+  get: function() {
+    return this._native.size
+  }
+})
+
+/**
+ * @returns {boolean}
+ */
+Object.defineProperty(BlobHandle.prototype, 'open', {
+  get: function() {
+    return this._native.open
+  }
+})
+
+/**
+ * Read bytes into a new Buffer
+ * @param {number} [offset=0]
+ * @param {number} [length] - Defaults to the rest of the blob
+ * @returns {Buffer}
+ */
+BlobHandle.prototype.read = function(offset, length) {
+  return this._native.read(offset, length)
+}
+
+/**
+ * Fill an existing Buffer, for streaming without allocating
+ * @param {Buffer} buffer
+ * @param {number} [offset=0] - Position in the blob
+ * @returns {number} Bytes read (fewer than buffer.length at the end)
+ */
+BlobHandle.prototype.readInto = function(buffer, offset) {
+  return this._native.readInto(buffer, offset)
+}
+
+/**
+ * Overwrite bytes in place (writable handles only)
+ * @param {Buffer} buffer
+ * @param {number} [offset=0]
+ * @returns {BlobHandle} this for chaining
+ */
+BlobHandle.prototype.write = function(buffer, offset) {
+  this._native.write(buffer, offset)
+  return this
+}
+
+/**
+ * Move to the same column of another row
+ * @param {number} rowid
+ * @returns {BlobHandle} this for chaining
+ */
+BlobHandle.prototype.reopen = function(rowid) {
+  this._native.reopen(rowid)
   return this
 }
 
 /**
- * Finalize statement (release resources)
+ * Close the handle (also done by Database#close)
+ */
+BlobHandle.prototype.close = function() {
+  this._native.close()
+}
+
+/**
+ * Online backup from Database#openBackup
+ * @param {Object} nativeBackup
+ */
+function BackupHandle(nativeBackup) {
+  this._native = nativeBackup
+}
+
+/**
+ * Pages left to copy, as of the last step (-1 before the first)
+ * @returns {number}
+ */
+Object.defineProperty(BackupHandle.prototype, 'remaining', {
+  get: function() {
+    return this._native.remaining
+  }
+})
+
+/**
+ * Pages in the source, as of the last step (-1 before the first)
+ * @returns {number}
+ */
+Object.defineProperty(BackupHandle.prototype, 'pageCount', {
+  get: function() {
+    return this._native.pageCount
+  }
+})
+
+/**
+ * @returns {boolean}
+ */
+Object.defineProperty(BackupHandle.prototype, 'open', {
+  get: function() {
+    return this._native.open
+  }
+})
+
+/**
+ * Copy up to pages pages. A busy or locked database is not an error; the
+ * step just copies nothing.
+ * @param {number} [pages=-1] - Negative copies the rest
+ * @returns {boolean} true once the copy is complete (the handle closes)
+ */
+BackupHandle.prototype.step = function(pages) {
+  return this._native.step(pages === undefined ? -1 : pages)
+}
+
+/**
+ * Stop the backup (also done by Database#close on either end)
+ */
+BackupHandle.prototype.close = function() {
+  this._native.close()
+}
+
+/**
+ * Finalize statement (release resources). The compiled statement goes back
+ * to the database's statement cache.
  */
 Statement.prototype.finalize = function() {
   this._native.finalize()
+  flushProfile(this._db)
 }
 
 // Exports
 module.exports = Database
 module.exports.Database = Database
 module.exports.Statement = Statement
+module.exports.BlobHandle = BlobHandle
+module.exports.BackupHandle = BackupHandle
 module.exports.isAvailable = isAvailable
 module.exports.getLoadError = getLoadError
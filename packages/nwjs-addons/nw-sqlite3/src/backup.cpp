@@ -0,0 +1,108 @@
+#include "backup.h"
+#include "database.h"
+#include <stdexcept>
+
+namespace nw_sqlite3 {
+
+Backup::Backup(Database* source, Database* destination, const std::string& schema)
+  : source_(source)
+  , destination_(destination)
+  , backup_(NULL)
+  , remaining_(-1)
+  , pageCount_(-1)
+{
+  start(schema);
+}
+
+Backup::Backup(Database* source, const std::string& path, const std::string& schema)
+  : source_(source)
+  , destination_(NULL)
+  , backup_(NULL)
+  , remaining_(-1)
+  , pageCount_(-1)
+{
+  if (!source_ || !source_->isOpen()) {
+    throw std::runtime_error("Database is closed");
+  }
+
+  ownedDestination_.reset(new Database(path, false, 0));
+  destination_ = ownedDestination_.get();
+  start(schema);
+}
+
+Backup::~Backup() {
+  close();
+}
+
+void Backup::start(const std::string& schema) {
+  if (!source_ || !source_->isOpen() || !destination_ || !destination_->isOpen()) {
+    throw std::runtime_error("Database is closed");
+  }
+
+  // Errors are reported on the destination connection
+  backup_ = sqlite3_backup_init(destination_->handle(), "main", source_->handle(), schema.c_str());
+  if (!backup_) {
+    throw std::runtime_error("Failed to start backup: " + destination_->getError());
+  }
+
+  source_->attach(this);
+  if (!ownedDestination_) {
+    destination_->attach(this);
+  }
+}
+
+bool Backup::step(int pages) {
+  if (!backup_) {
+    throw std::runtime_error("Backup has been closed");
+  }
+
+  int rc = sqlite3_backup_step(backup_, pages);
+  remaining_ = sqlite3_backup_remaining(backup_);
+  pageCount_ = sqlite3_backup_pagecount(backup_);
+
+  if (rc == SQLITE_DONE) {
+    close();
+    return true;
+  }
+  if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+    return false;
+  }
+
+  // Anything else is fatal: finish() releases the handle and sets the
+  // destination's error
+  sqlite3_backup_finish(backup_);
+  backup_ = NULL;
+  std::string error = destination_->getError();
+  close();
+  throw std::runtime_error("Backup failed: " + error);
+}
+
+int Backup::remaining() const {
+  return remaining_;
+}
+
+int Backup::pageCount() const {
+  return pageCount_;
+}
+
+void Backup::close() {
+  if (backup_) {
+    sqlite3_backup_finish(backup_);
+    backup_ = NULL;
+  }
+  if (source_) {
+    source_->detach(this);
+    source_ = NULL;
+  }
+  if (destination_ && !ownedDestination_) {
+    destination_->detach(this);
+  }
+  destination_ = NULL;
+  ownedDestination_.reset();
+}
+
+void Backup::detachDatabase() {
+  close();
+}
+
+} // namespace nw_sqlite3
@@ -0,0 +1,81 @@
+#ifndef NW_SQLITE3_BACKUP_H
+#define NW_SQLITE3_BACKUP_H
+
+#include <memory>
+#include <string>
+#include "sqlite3.h"
+
+namespace nw_sqlite3 {
+
+class Database;
+
+/**
+ * Online backup of one database into another (sqlite3_backup_*). The
+ * copy runs in steps of a few pages; the source is only locked while a
+ * step runs, so writers get in between steps. Writes made through the
+ * source connection are carried into the copy; writes from any other
+ * connection restart it.
+ */
+class Backup {
+public:
+  /**
+   * Copy schema of source over the main database of destination
+   * @param schema Attached database name ("main", "temp", ...)
+   */
+  Backup(Database* source, Database* destination, const std::string& schema = "main");
+
+  /**
+   * Copy into the database file at path, creating it if needed
+   */
+  Backup(Database* source, const std::string& path, const std::string& schema = "main");
+  ~Backup();
+
+  // Prevent copying
+  Backup(const Backup&);
+  Backup& operator=(const Backup&);
+
+  /**
+   * Check if the backup is still running
+   */
+  bool isOpen() const { return backup_ != NULL; }
+
+  /**
+   * Copy up to pages pages (negative: all that are left). Busy or locked
+   * databases are not an error; the step copies nothing and can be
+   * retried.
+   * @returns true once every page has been copied (the backup is then
+   *   finished and closed)
+   */
+  bool step(int pages);
+
+  /**
+   * Pages still to copy and the source's total, as of the last step()
+   */
+  int remaining() const;
+  int pageCount() const;
+
+  /**
+   * Stop and release the backup (pages already copied stay)
+   */
+  void close();
+
+  /**
+   * Called by Database::close() on either end: stop the backup and
+   * forget both databases
+   */
+  void detachDatabase();
+
+private:
+  void start(const std::string& schema);
+
+  Database* source_;
+  Database* destination_;
+  std::unique_ptr<Database> ownedDestination_;  // when copying to a path
+  sqlite3_backup* backup_;
+  int remaining_;
+  int pageCount_;
+};
+
+} // namespace nw_sqlite3
+
+#endif // NW_SQLITE3_BACKUP_H
@@ -0,0 +1,89 @@
+#include "blob.h"
+#include "database.h"
+#include <stdexcept>
+
+namespace nw_sqlite3 {
+
+Blob::Blob(Database* db, const std::string& table, const std::string& column, int64_t rowid,
+           bool writable, const std::string& schema)
+  : db_(db)
+  , blob_(NULL)
+  , writable_(writable)
+{
+  if (!db_ || !db_->isOpen()) {
+    throw std::runtime_error("Database is closed");
+  }
+
+  int rc = sqlite3_blob_open(db_->handle(), schema.c_str(), table.c_str(), column.c_str(),
+                             rowid, writable ? 1 : 0, &blob_);
+
+  if (rc != SQLITE_OK) {
+    std::string error = db_->getError();
+    sqlite3_blob_close(blob_);
+    blob_ = NULL;
+    throw std::runtime_error("Failed to open blob: " + error);
+  }
+
+  db_->attach(this);
+}
+
+Blob::~Blob() {
+  close();
+}
+
+void Blob::checkOpen() const {
+  if (!blob_) {
+    throw std::runtime_error("Blob has been closed");
+  }
+}
+
+int Blob::size() const {
+  checkOpen();
+  return sqlite3_blob_bytes(blob_);
+}
+
+void Blob::read(void* buffer, int length, int offset) const {
+  checkOpen();
+  if (sqlite3_blob_read(blob_, buffer, length, offset) != SQLITE_OK) {
+    throw std::runtime_error(db_->getError());
+  }
+}
+
+void Blob::write(const void* data, int length, int offset) {
+  checkOpen();
+  if (!writable_) {
+    throw std::runtime_error("Blob was opened read-only");
+  }
+  if (sqlite3_blob_write(blob_, data, length, offset) != SQLITE_OK) {
+    throw std::runtime_error(db_->getError());
+  }
+}
+
+void Blob::reopen(int64_t rowid) {
+  checkOpen();
+  // On failure the handle is aborted; keep it so close() still releases it
+  if (sqlite3_blob_reopen(blob_, rowid) != SQLITE_OK) {
+    throw std::runtime_error(db_->getError());
+  }
+}
+
+void Blob::close() {
+  if (blob_) {
+    sqlite3_blob_close(blob_);
+    blob_ = NULL;
+  }
+  if (db_) {
+    db_->detach(this);
+    db_ = NULL;
+  }
+}
+
+void Blob::detachDatabase() {
+  if (blob_) {
+    sqlite3_blob_close(blob_);
+    blob_ = NULL;
+  }
+  db_ = NULL;
+}
+
+} // namespace nw_sqlite3
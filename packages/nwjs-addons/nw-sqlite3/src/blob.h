@@ -0,0 +1,78 @@
+#ifndef NW_SQLITE3_BLOB_H
+#define NW_SQLITE3_BLOB_H
+
+#include <string>
+#include "sqlite3.h"
+
+namespace nw_sqlite3 {
+
+class Database;
+
+/**
+ * Incremental I/O on one BLOB cell (sqlite3_blob_*). Reads and writes go
+ * straight between the caller's memory and the database pages, so large
+ * values never have to be loaded whole.
+ */
+class Blob {
+public:
+  /**
+   * Open table.column at rowid
+   * @param writable Open for writing as well as reading
+   * @param schema Attached database name ("main", "temp", ...)
+   */
+  Blob(Database* db, const std::string& table, const std::string& column, int64_t rowid,
+       bool writable, const std::string& schema = "main");
+  ~Blob();
+
+  // Prevent copying
+  Blob(const Blob&);
+  Blob& operator=(const Blob&);
+
+  /**
+   * Check if the handle is open
+   */
+  bool isOpen() const { return blob_ != NULL; }
+
+  bool isWritable() const { return writable_; }
+
+  /**
+   * Size of the BLOB in bytes. Writes cannot change it.
+   */
+  int size() const;
+
+  /**
+   * Copy length bytes starting at offset into buffer
+   */
+  void read(void* buffer, int length, int offset) const;
+
+  /**
+   * Overwrite length bytes starting at offset
+   */
+  void write(const void* data, int length, int offset);
+
+  /**
+   * Move to the same column of another row
+   */
+  void reopen(int64_t rowid);
+
+  /**
+   * Close the handle
+   */
+  void close();
+
+  /**
+   * Called by Database::close(): close and forget the database
+   */
+  void detachDatabase();
+
+private:
+  Database* db_;
+  sqlite3_blob* blob_;
+  bool writable_;
+
+  void checkOpen() const;
+};
+
+} // namespace nw_sqlite3
+
+#endif // NW_SQLITE3_BLOB_H
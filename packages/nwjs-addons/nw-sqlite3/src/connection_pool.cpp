@@ -0,0 +1,159 @@
+#include "connection_pool.h"
+#include <stdexcept>
+
+namespace nw_sqlite3 {
+
+ConnectionPool::ConnectionPool(const std::string& path, bool readonly, size_t maxReaders,
+                               const DatabaseTuning& tuning)
+  : path_(path)
+  , readonly_(readonly)
+  , maxReaders_(maxReaders > 0 ? maxReaders : 1)
+  , tuning_(tuning)
+  , closed_(false)
+  , openReaders_(0)
+  , writer_(NULL)
+{
+}
+
+ConnectionPool::~ConnectionPool() {
+  close();
+}
+
+Database* ConnectionPool::open(bool readonly) {
+  Database* db = new Database(path_, readonly);
+  try {
+    db->configure(tuning_);
+  } catch (...) {
+    delete db;
+    throw;
+  }
+  return db;
+}
+
+void ConnectionPool::destroy(Database* db) {
+  {
+    std::lock_guard<std::mutex> lock(setupMutex_);
+    applied_.erase(db);
+  }
+  delete db;
+}
+
+void ConnectionPool::addSetup(const ConnectionSetup& setup) {
+  std::lock_guard<std::mutex> lock(setupMutex_);
+  setups_.push_back(setup);
+}
+
+void ConnectionPool::applySetups(Database* db) {
+  std::lock_guard<std::mutex> lock(setupMutex_);
+  size_t& applied = applied_[db];
+  while (applied < setups_.size()) {
+    setups_[applied](*db);
+    applied++;
+  }
+}
+
+Database* ConnectionPool::acquireReader() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  Database* db = NULL;
+
+  for (;;) {
+    if (closed_) {
+      throw std::runtime_error("Database is closed");
+    }
+    if (!idleReaders_.empty()) {
+      db = idleReaders_.back();
+      idleReaders_.pop_back();
+      break;
+    }
+    if (openReaders_ < maxReaders_) {
+      // Count it before opening (outside the lock) so no one else overshoots
+      openReaders_++;
+      break;
+    }
+    readerFree_.wait(lock);
+  }
+  lock.unlock();
+
+  try {
+    if (!db) {
+      db = open(true);
+    }
+    applySetups(db);
+  } catch (...) {
+    if (db) {
+      // Open but not set up: idle again, and retried on its next use
+      releaseReader(db);
+    } else {
+      lock.lock();
+      openReaders_--;
+      readerFree_.notify_one();
+    }
+    throw;
+  }
+  return db;
+}
+
+void ConnectionPool::releaseReader(Database* db) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  if (closed_) {
+    openReaders_--;
+    lock.unlock();
+    destroy(db);
+    return;
+  }
+
+  idleReaders_.push_back(db);
+  readerFree_.notify_one();
+}
+
+Database* ConnectionPool::acquireWriter() {
+  writerMutex_.lock();
+
+  try {
+    if (closed_) {
+      throw std::runtime_error("Database is closed");
+    }
+    if (!writer_) {
+      writer_ = open(readonly_);
+    }
+    applySetups(writer_);
+  } catch (...) {
+    writerMutex_.unlock();
+    throw;
+  }
+
+  return writer_;
+}
+
+void ConnectionPool::releaseWriter() {
+  if (closed_) {
+    destroy(writer_);
+    writer_ = NULL;
+  }
+  writerMutex_.unlock();
+}
+
+void ConnectionPool::close() {
+  std::vector<Database*> idle;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    idle.swap(idleReaders_);
+    openReaders_ -= idle.size();
+    readerFree_.notify_all();
+  }
+
+  for (size_t i = 0; i < idle.size(); i++) {
+    destroy(idle[i]);
+  }
+
+  // Waits for a running write to finish
+  std::lock_guard<std::mutex> lock(writerMutex_);
+  if (writer_) {
+    destroy(writer_);
+    writer_ = NULL;
+  }
+}
+
+} // namespace nw_sqlite3
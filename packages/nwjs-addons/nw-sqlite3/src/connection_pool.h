@@ -0,0 +1,121 @@
+#ifndef NW_SQLITE3_CONNECTION_POOL_H
+#define NW_SQLITE3_CONNECTION_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "database.h"
+
+namespace nw_sqlite3 {
+
+// Default number of read connections used by async queries
+const size_t DEFAULT_ASYNC_READERS = 4;
+
+// Per-connection setup, e.g. registering an SQL function. Runs on the
+// thread that acquires the connection and may throw.
+typedef std::function<void(Database&)> ConnectionSetup;
+
+/**
+ * Extra connections to one database file for async queries: up to
+ * maxReaders read-only connections, each used by one thread at a time,
+ * and a single writer connection. Connections are opened on first use,
+ * on whichever thread needs them, and get the same tuning pragmas as the
+ * main connection plus every setup added so far.
+ */
+class ConnectionPool {
+public:
+  ConnectionPool(const std::string& path, bool readonly, size_t maxReaders = DEFAULT_ASYNC_READERS,
+                 const DatabaseTuning& tuning = DatabaseTuning());
+  ~ConnectionPool();
+
+  /**
+   * Take a read connection, waiting while all are busy
+   */
+  Database* acquireReader();
+  void releaseReader(Database* db);
+
+  /**
+   * Take the writer connection, waiting while it is busy
+   */
+  Database* acquireWriter();
+  void releaseWriter();
+
+  /**
+   * Run setup on every connection: those already open the next time they
+   * are acquired, later ones when they open
+   */
+  void addSetup(const ConnectionSetup& setup);
+
+  /**
+   * Refuse further acquisitions and close idle connections; busy ones
+   * close when released
+   */
+  void close();
+
+private:
+  ConnectionPool(const ConnectionPool&);
+  ConnectionPool& operator=(const ConnectionPool&);
+
+  Database* open(bool readonly);
+  void destroy(Database* db);
+
+  // Run the setups db has not had yet
+  void applySetups(Database* db);
+
+  std::string path_;
+  bool readonly_;
+  size_t maxReaders_;
+  DatabaseTuning tuning_;
+  std::atomic<bool> closed_;
+
+  std::mutex mutex_;
+  std::condition_variable readerFree_;
+  std::vector<Database*> idleReaders_;
+  size_t openReaders_;
+
+  std::mutex writerMutex_;
+  Database* writer_;
+
+  std::mutex setupMutex_;
+  std::vector<ConnectionSetup> setups_;
+  std::map<Database*, size_t> applied_;  // setups run per open connection
+};
+
+/**
+ * Holds a pool connection for the scope, reader or writer
+ */
+class PoolLease {
+public:
+  PoolLease(ConnectionPool& pool, bool write)
+    : pool_(pool)
+    , write_(write)
+    , db_(write ? pool.acquireWriter() : pool.acquireReader())
+  {
+  }
+
+  ~PoolLease() {
+    if (write_) {
+      pool_.releaseWriter();
+    } else {
+      pool_.releaseReader(db_);
+    }
+  }
+
+  Database* get() const { return db_; }
+
+private:
+  PoolLease(const PoolLease&);
+  PoolLease& operator=(const PoolLease&);
+
+  ConnectionPool& pool_;
+  bool write_;
+  Database* db_;
+};
+
+} // namespace nw_sqlite3
+
+#endif // NW_SQLITE3_CONNECTION_POOL_H
@@ -0,0 +1,188 @@
+#include "csv_import.h"
+#include "csv_columns.h"
+#include "csv_table.h"
+#include "database.h"
+#include "statement.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace nw_sqlite3 {
+
+namespace {
+
+// Rows taken from the reader per refill during a batch
+const size_t CSV_IMPORT_READ_ROWS = 256;
+
+// Affinity for one column of the sampled rows: INTEGER or REAL when every
+// non-empty field is a number of that kind, otherwise TEXT. Numbers with
+// a leading zero ("007") are codes, not numbers, and keep the column TEXT.
+const char* inferAffinity(const std::vector<std::vector<std::string>>& rows, size_t column) {
+  bool integer = true;
+  bool seen = false;
+  for (size_t r = 0; r < rows.size(); r++) {
+    if (column >= rows[r].size() || rows[r][column].empty()) {
+      continue;
+    }
+    const std::string& field = rows[r][column];
+    double number;
+    if (!csvparser::parseFloat64(field.data(), field.size(), number)) {
+      return "TEXT";
+    }
+    size_t digit = field[0] == '-' || field[0] == '+' ? 1 : 0;
+    if (field.size() > digit + 1 && field[digit] == '0' && field[digit + 1] != '.') {
+      return "TEXT";
+    }
+    if (field.find_first_of(".eE") != std::string::npos) {
+      integer = false;
+    }
+    seen = true;
+  }
+  if (!seen) {
+    return "TEXT";
+  }
+  return integer ? "INTEGER" : "REAL";
+}
+
+} // namespace
+
+CsvImport::CsvImport(const std::string& path, const std::string& table,
+                     const CsvImportOptions& options)
+  : table_(table)
+  , options_(options)
+  , reader_(options.parse)
+  , next_(0)
+  , rowsImported_(0)
+  , started_(false)
+  , done_(false)
+  , failed_(false)
+{
+  if (!reader_.open(path)) {
+    throw std::runtime_error("Cannot open CSV file: " + path);
+  }
+}
+
+void CsvImport::start(Database* db) {
+  std::vector<std::string> header;
+  if (options_.header && reader_.next(rows_, 1, &records_) > 0) {
+    header.swap(rows_[0]);
+    rows_.clear();
+    records_.clear();
+  }
+  if (!options_.columns.empty()) {
+    header = options_.columns;
+  }
+
+  // The sample stays queued and is inserted first
+  if (options_.create) {
+    reader_.next(rows_, std::max<size_t>(options_.inferRows, 1), &records_);
+  }
+
+  size_t width = header.size();
+  if (width == 0 && !rows_.empty()) {
+    width = rows_[0].size();
+  } else if (width == 0) {
+    reader_.next(rows_, 1, &records_);
+    width = rows_.empty() ? 0 : rows_[0].size();
+  }
+  if (width == 0) {
+    // Nothing to import, and nothing to make a table from
+    done_ = true;
+    return;
+  }
+
+  columns_ = csvColumnNames(header, width);
+  std::string names;
+  for (size_t c = 0; c < width; c++) {
+    names += (c > 0 ? ", " : "") + quoteIdentifier(columns_[c]);
+  }
+
+  if (options_.create) {
+    std::string sql = "CREATE TABLE IF NOT EXISTS " + quoteIdentifier(table_) + " (";
+    for (size_t c = 0; c < width; c++) {
+      sql += (c > 0 ? ", " : "") + quoteIdentifier(columns_[c]) + " " + inferAffinity(rows_, c);
+    }
+    db->exec(sql + ")");
+  }
+
+  insertSql_ = "INSERT INTO " + quoteIdentifier(table_);
+  if (!header.empty() || options_.create) {
+    insertSql_ += " (" + names + ")";
+  }
+  insertSql_ += " VALUES (?";
+  for (size_t c = 1; c < width; c++) {
+    insertSql_ += ", ?";
+  }
+  insertSql_ += ")";
+}
+
+bool CsvImport::nextRow() {
+  if (next_ < rows_.size()) {
+    return true;
+  }
+  rows_.clear();
+  records_.clear();
+  next_ = 0;
+  return reader_.next(rows_, CSV_IMPORT_READ_ROWS, &records_) > 0;
+}
+
+bool CsvImport::step(Database* db, size_t rows) {
+  if (failed_) {
+    throw std::runtime_error("CSV import has already failed");
+  }
+  if (done_) {
+    return true;
+  }
+  if (!started_) {
+    started_ = true;
+    try {
+      start(db);
+    } catch (...) {
+      failed_ = true;
+      throw;
+    }
+    if (done_) {
+      return true;
+    }
+  }
+
+  // Prepared once per connection and kept by its statement cache
+  Statement insert(db, insertSql_);
+  int width = static_cast<int>(columns_.size());
+  size_t count = 0;
+  uint64_t record = 0;   // of the row being inserted, for the error
+
+  db->begin(TRANSACTION_IMMEDIATE);
+  try {
+    while (count < rows && nextRow()) {
+      const std::vector<std::string>& row = rows_[next_];
+      record = records_[next_];
+      for (int c = 0; c < width; c++) {
+        if (static_cast<size_t>(c) >= row.size() || (options_.emptyAsNull && row[c].empty())) {
+          insert.bindNull(c + 1);
+        } else {
+          insert.bindText(c + 1, row[c]);
+        }
+      }
+      insert.step();
+      insert.reset();
+      next_++;
+      count++;
+      record = 0;
+    }
+    db->commit();
+  } catch (const std::exception& e) {
+    failed_ = true;
+    insert.reset();
+    db->rollback();
+    if (record == 0) {
+      throw;
+    }
+    throw std::runtime_error("Row " + std::to_string(record) + ": " + e.what());
+  }
+
+  rowsImported_ += count;
+  done_ = next_ == rows_.size() && reader_.isDone();
+  return done_;
+}
+
+} // namespace nw_sqlite3
@@ -0,0 +1,109 @@
+#ifndef NW_SQLITE3_CSV_IMPORT_H
+#define NW_SQLITE3_CSV_IMPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "csv_parser.h"
+
+namespace nw_sqlite3 {
+
+class Database;
+
+// Rows inserted per transaction by db.importCsv() unless batchSize is given
+const size_t DEFAULT_IMPORT_BATCH = 10000;
+
+// Rows sampled to infer column affinities when the table is created
+const size_t DEFAULT_IMPORT_INFER_ROWS = 1000;
+
+struct CsvImportOptions {
+  csvparser::ParseOptions parse;
+  bool header;                       // first row names the columns
+  bool create;                       // CREATE TABLE IF NOT EXISTS before inserting
+  bool emptyAsNull;                  // empty fields insert NULL instead of ''
+  size_t inferRows;                  // rows sampled for column affinities
+  std::vector<std::string> columns;  // column names, overriding the header
+
+  CsvImportOptions()
+    : header(true)
+    , create(true)
+    , emptyAsNull(true)
+    , inferRows(DEFAULT_IMPORT_INFER_ROWS)
+  {}
+};
+
+/**
+ * Bulk load of a CSV file into a table. The file streams through
+ * csvparser::CsvFileReader and every field is bound straight into one
+ * cached INSERT statement; each step() inserts a batch of rows in its own
+ * IMMEDIATE transaction, so a failed batch leaves the rows of earlier
+ * batches in place.
+ *
+ * With create the table is made if it does not exist, with columns named
+ * as the csv table names them (csvColumnNames) and typed INTEGER, REAL
+ * or TEXT from the first inferRows rows. Fields are bound as text and
+ * converted by the column's affinity; missing fields insert NULL.
+ * Without a header or columns and without create, rows insert by
+ * position into the table's own columns.
+ *
+ * step() must always be given the same connection, and only from one
+ * thread at a time.
+ */
+class CsvImport {
+public:
+  /**
+   * Open path for import into table
+   * @throws std::runtime_error if the file cannot be opened
+   */
+  CsvImport(const std::string& path, const std::string& table,
+            const CsvImportOptions& options = CsvImportOptions());
+
+  // Prevent copying
+  CsvImport(const CsvImport&);
+  CsvImport& operator=(const CsvImport&);
+
+  /**
+   * Insert up to rows rows in one transaction, creating the table on
+   * the first call
+   * @returns true once the whole file has been imported
+   * @throws std::runtime_error ("Row N: ...", N the failing row's CSV
+   *   record in the file, header and blank lines included) after rolling
+   *   the batch back. The rows of that batch have been read past, so the
+   *   import is failed from then on and every later step() throws.
+   */
+  bool step(Database* db, size_t rows);
+
+  bool isDone() const { return done_; }
+
+  // Rows inserted by the batches committed so far
+  uint64_t rowsImported() const { return rowsImported_; }
+
+  // File bytes parsed so far and the file's size, for progress
+  uint64_t bytesRead() const { return reader_.bytesRead(); }
+  uint64_t totalBytes() const { return reader_.fileSize(); }
+
+  // Column names inserted into (empty before the first step)
+  const std::vector<std::string>& columns() const { return columns_; }
+
+private:
+  void start(Database* db);
+  bool nextRow();
+
+  std::string table_;
+  CsvImportOptions options_;
+  csvparser::CsvFileReader reader_;
+  std::vector<std::vector<std::string>> rows_;
+  std::vector<uint64_t> records_;    // CSV record number of each of rows_
+  size_t next_;
+  std::vector<std::string> columns_;
+  std::string insertSql_;
+  uint64_t rowsImported_;
+  bool started_;
+  bool done_;
+  bool failed_;
+};
+
+} // namespace nw_sqlite3
+
+#endif // NW_SQLITE3_CSV_IMPORT_H
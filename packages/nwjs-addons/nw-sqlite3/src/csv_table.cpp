@@ -0,0 +1,873 @@
+#include "csv_table.h"
+#include "csv_parser.h"
+#include "file_view.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace nw_sqlite3 {
+
+namespace {
+
+using csvparser::ColumnRef;
+using csvparser::CsvFileReader;
+using csvparser::ParseOptions;
+
+// Rows taken from the reader per refill
+const size_t CSV_SCAN_BATCH = 256;
+
+// Planner row estimate without an index: one row per this many bytes
+const double CSV_BYTES_PER_ROW = 64;
+
+// Sidecar index layout: magic, then file size, fingerprint, row count,
+// stride and entry count as uint64, then the entries (native byte order)
+const char CSV_INDEX_MAGIC[8] = { 'N', 'W', 'C', 'S', 'V', 'I', 'X', '1' };
+const size_t CSV_INDEX_FIELDS = 5;
+const size_t CSV_INDEX_HEADER = sizeof(CSV_INDEX_MAGIC) + CSV_INDEX_FIELDS * sizeof(uint64_t);
+
+// Bytes hashed from each end of the CSV to notice that it changed
+const size_t CSV_FINGERPRINT_BYTES = 4096;
+
+// xBestIndex idxNum bits; xFilter gets the values in this order
+const int ROWID_EQ = 1;
+const int ROWID_LOWER = 2;
+const int ROWID_UPPER = 4;
+
+struct CsvTable : sqlite3_vtab {
+  std::string path;
+  ParseOptions options;
+  bool header;
+  bool numeric;
+  size_t columnCount;
+
+  // offsets[k] is where data row k * CSV_INDEX_STRIDE + 1 starts
+  bool indexed;
+  std::vector<uint64_t> offsets;
+  int64_t rowCount;
+  double rowEstimate;
+
+  CsvTable()
+    : sqlite3_vtab()
+    , header(true)
+    , numeric(false)
+    , columnCount(0)
+    , indexed(false)
+    , rowCount(-1)
+    , rowEstimate(0) {}
+};
+
+struct CsvCursor : sqlite3_vtab_cursor {
+  std::unique_ptr<CsvFileReader> reader;
+  std::vector<std::vector<std::string>> rows;
+  size_t current;
+
+  // Field of the (projected) row that holds each column, -1 if not read
+  std::vector<int> slots;
+
+  int64_t rowid;
+  int64_t last;
+  bool eof;
+
+  CsvCursor() : sqlite3_vtab_cursor(), current(0), rowid(0), last(0), eof(true) {}
+};
+
+std::string lowerCase(std::string text) {
+  for (size_t i = 0; i < text.size(); i++) {
+    text[i] = static_cast<char>(tolower(static_cast<unsigned char>(text[i])));
+  }
+  return text;
+}
+
+std::string trimText(const std::string& text) {
+  size_t start = text.find_first_not_of(" \t\r\n");
+  if (start == std::string::npos) {
+    return std::string();
+  }
+  return text.substr(start, text.find_last_not_of(" \t\r\n") - start + 1);
+}
+
+// Remove SQL quoting ('x', "x", `x` or [x]) from a module argument
+std::string dequote(const std::string& text) {
+  if (text.size() < 2) {
+    return text;
+  }
+
+  char open = text[0];
+  char close = open == '[' ? ']' : open;
+  if ((open != '\'' && open != '"' && open != '`' && open != '[') || text[text.size() - 1] != close) {
+    return text;
+  }
+
+  std::string result;
+  size_t end = text.size() - 1;
+  for (size_t i = 1; i < end; i++) {
+    result += text[i];
+    if (text[i] == close && close != ']' && i + 1 < end && text[i + 1] == close) {
+      i++;
+    }
+  }
+  return result;
+}
+
+bool parseFlag(const std::string& name, const std::string& value) {
+  std::string flag = lowerCase(value);
+  if (flag == "yes" || flag == "true" || flag == "on" || flag == "1") {
+    return true;
+  }
+  if (flag == "no" || flag == "false" || flag == "off" || flag == "0") {
+    return false;
+  }
+  throw std::runtime_error("csv: " + name + " must be yes or no");
+}
+
+char parseChar(const std::string& name, const std::string& value) {
+  if (value == "\\t" || lowerCase(value) == "tab") {
+    return '\t';
+  }
+  if (value.size() != 1) {
+    throw std::runtime_error("csv: " + name + " must be a single character");
+  }
+  return value[0];
+}
+
+void hashBytes(uint64_t& hash, const char* data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+}
+
+// FNV-1a over both ends of the file and the settings rows depend on
+uint64_t fingerprint(const FileView& file, const CsvTable& table) {
+  uint64_t hash = 14695981039346656037ULL;
+  size_t head = std::min(file.size(), CSV_FINGERPRINT_BYTES);
+  hashBytes(hash, file.data(), head);
+  if (file.size() > head) {
+    size_t tail = std::min(file.size() - head, CSV_FINGERPRINT_BYTES);
+    hashBytes(hash, file.data() + file.size() - tail, tail);
+  }
+
+  const ParseOptions& options = table.options;
+  char settings[] = {
+    options.delimiter, options.quote, options.escape,
+    static_cast<char>(options.trim), static_cast<char>(options.skipEmptyLines),
+    static_cast<char>(table.header)
+  };
+  hashBytes(hash, settings, sizeof(settings));
+  return hash;
+}
+
+// Find where every CSV_INDEX_STRIDE-th data row starts. Rows end where
+// CsvStreamParser ends them: at CR, LF or CRLF outside quotes (a quote
+// only opens a field at its start), after a leading BOM, skipping rows
+// with no text when skipEmptyLines is set. No field is copied.
+void scanRows(const char* data, size_t size, CsvTable& table) {
+  enum State { FIELD_START, UNQUOTED, QUOTED, QUOTE_IN_QUOTED, ESCAPE_IN_QUOTED };
+
+  const ParseOptions& options = table.options;
+  State state = FIELD_START;
+  size_t i = 0;
+  if (size >= 3 && data[0] == '\xEF' && data[1] == '\xBB' && data[2] == '\xBF') {
+    i = 3;
+  }
+
+  size_t rowStart = i;
+  bool fieldHasText = false;   // current field has any character
+  bool rowStarted = false;     // an earlier field of the row has ended
+  bool rowHasContent = false;  // some field has text once trimmed
+  int64_t rows = table.header ? -1 : 0;
+
+  table.offsets.clear();
+
+  auto text = [&](char c) {
+    fieldHasText = true;
+    if (!options.trim || (c != ' ' && c != '\t')) {
+      rowHasContent = true;
+    }
+  };
+
+  while (i < size) {
+    char c = data[i];
+    bool lineEnd = false;
+
+    switch (state) {
+      case FIELD_START:
+        if (c == options.quote) {
+          state = QUOTED;
+        } else if (c == options.delimiter) {
+          rowStarted = true;
+        } else if (c == '\r' || c == '\n') {
+          lineEnd = true;
+        } else {
+          text(c);
+          state = UNQUOTED;
+        }
+        break;
+
+      case UNQUOTED:
+        if (c == options.delimiter) {
+          rowStarted = true;
+          fieldHasText = false;
+          state = FIELD_START;
+        } else if (c == '\r' || c == '\n') {
+          lineEnd = true;
+        } else {
+          text(c);
+        }
+        break;
+
+      case QUOTED:
+        if (c == options.escape && options.escape != options.quote) {
+          state = ESCAPE_IN_QUOTED;
+        } else if (c == options.quote) {
+          state = QUOTE_IN_QUOTED;
+        } else {
+          text(c);
+        }
+        break;
+
+      case ESCAPE_IN_QUOTED:
+        state = QUOTED;
+        text(c == options.quote ? c : options.escape);
+        if (c != options.quote) {
+          // Not an escape sequence; c is ordinary quoted content
+          continue;
+        }
+        break;
+
+      case QUOTE_IN_QUOTED:
+        if (c == options.quote) {
+          text(c);
+          state = QUOTED;
+        } else if (c == options.delimiter) {
+          rowStarted = true;
+          fieldHasText = false;
+          state = FIELD_START;
+        } else if (c == '\r' || c == '\n') {
+          lineEnd = true;
+        } else {
+          text(c);
+          state = UNQUOTED;
+        }
+        break;
+    }
+
+    i++;
+    if (!lineEnd) {
+      continue;
+    }
+    if (c == '\r' && i < size && data[i] == '\n') {
+      i++;
+    }
+
+    if (rowHasContent || !options.skipEmptyLines) {
+      if (rows >= 0 && rows % static_cast<int64_t>(CSV_INDEX_STRIDE) == 0) {
+        table.offsets.push_back(rowStart);
+      }
+      rows++;
+    }
+    rowStart = i;
+    fieldHasText = false;
+    rowStarted = false;
+    rowHasContent = false;
+    state = FIELD_START;
+  }
+
+  // An unterminated last row, as CsvStreamParser::finish() sees it
+  if (state == ESCAPE_IN_QUOTED) {
+    text(options.escape);
+  }
+  if ((fieldHasText || rowStarted) && (rowHasContent || !options.skipEmptyLines)) {
+    if (rows >= 0 && rows % static_cast<int64_t>(CSV_INDEX_STRIDE) == 0) {
+      table.offsets.push_back(rowStart);
+    }
+    rows++;
+  }
+
+  table.rowCount = std::max<int64_t>(rows, 0);
+}
+
+bool loadIndex(CsvTable& table, const std::string& path, uint64_t size, uint64_t hash) {
+  FileView index;
+  if (!index.open(path) || index.size() < CSV_INDEX_HEADER ||
+      memcmp(index.data(), CSV_INDEX_MAGIC, sizeof(CSV_INDEX_MAGIC)) != 0) {
+    return false;
+  }
+
+  uint64_t fields[CSV_INDEX_FIELDS];
+  memcpy(fields, index.data() + sizeof(CSV_INDEX_MAGIC), sizeof(fields));
+  if (fields[0] != size || fields[1] != hash || fields[3] != CSV_INDEX_STRIDE ||
+      index.size() != CSV_INDEX_HEADER + fields[4] * sizeof(uint64_t)) {
+    return false;
+  }
+
+  table.rowCount = static_cast<int64_t>(fields[2]);
+  table.offsets.resize(static_cast<size_t>(fields[4]));
+  if (!table.offsets.empty()) {
+    memcpy(&table.offsets[0], index.data() + CSV_INDEX_HEADER, table.offsets.size() * sizeof(uint64_t));
+  }
+  return true;
+}
+
+// Best effort: without the file the index is rebuilt on the next connect
+void saveIndex(const CsvTable& table, const std::string& path, uint64_t size, uint64_t hash) {
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    return;
+  }
+
+  uint64_t fields[CSV_INDEX_FIELDS] = {
+    size, hash, static_cast<uint64_t>(table.rowCount), CSV_INDEX_STRIDE, table.offsets.size()
+  };
+  bool written = fwrite(CSV_INDEX_MAGIC, 1, sizeof(CSV_INDEX_MAGIC), file) == sizeof(CSV_INDEX_MAGIC) &&
+                 fwrite(fields, sizeof(uint64_t), CSV_INDEX_FIELDS, file) == CSV_INDEX_FIELDS &&
+                 (table.offsets.empty() ||
+                  fwrite(&table.offsets[0], sizeof(uint64_t), table.offsets.size(), file) == table.offsets.size());
+  if (fclose(file) != 0 || !written) {
+    remove(path.c_str());
+  }
+}
+
+// Fill table from the module arguments (argv[3] on) and the file
+// @returns the CREATE TABLE statement for sqlite3_declare_vtab()
+std::string openTable(CsvTable& table, int argc, const char* const* argv) {
+  size_t columns = 0;
+  std::string indexPath;
+  bool escapeSet = false;
+
+  for (int i = 3; i < argc; i++) {
+    std::string arg = trimText(argv[i]);
+    size_t equals = arg.find('=');
+    if (equals == std::string::npos) {
+      if (!table.path.empty()) {
+        throw std::runtime_error("csv: unexpected argument " + arg);
+      }
+      table.path = dequote(arg);
+      continue;
+    }
+
+    std::string name = lowerCase(trimText(arg.substr(0, equals)));
+    std::string value = dequote(trimText(arg.substr(equals + 1)));
+
+    if (name == "path" || name == "filename") {
+      table.path = value;
+    } else if (name == "header") {
+      table.header = parseFlag(name, value);
+    } else if (name == "columns") {
+      long count = strtol(value.c_str(), NULL, 10);
+      if (count < 1) {
+        throw std::runtime_error("csv: columns must be a positive number");
+      }
+      columns = static_cast<size_t>(count);
+    } else if (name == "delimiter") {
+      table.options.delimiter = parseChar(name, value);
+    } else if (name == "quote") {
+      table.options.quote = parseChar(name, value);
+    } else if (name == "escape") {
+      table.options.escape = parseChar(name, value);
+      escapeSet = true;
+    } else if (name == "trim") {
+      table.options.trim = parseFlag(name, value);
+    } else if (name == "affinity") {
+      std::string affinity = lowerCase(value);
+      if (affinity != "text" && affinity != "numeric") {
+        throw std::runtime_error("csv: affinity must be text or numeric");
+      }
+      table.numeric = affinity == "numeric";
+    } else if (name == "index") {
+      // A path, or yes for one next to the CSV
+      std::string flag = lowerCase(value);
+      if (flag == "yes" || flag == "true" || flag == "on" || flag == "1") {
+        table.indexed = true;
+      } else if (flag != "no" && flag != "false" && flag != "off" && flag != "0") {
+        indexPath = value;
+        table.indexed = true;
+      }
+    } else {
+      throw std::runtime_error("csv: unknown option " + name);
+    }
+  }
+
+  if (table.path.empty()) {
+    throw std::runtime_error("csv: no file given");
+  }
+  if (!escapeSet) {
+    table.options.escape = table.options.quote;
+  }
+  if (table.indexed && indexPath.empty()) {
+    indexPath = table.path + ".idx";
+  }
+
+  // Column names from the first row
+  std::vector<std::string> first;
+  {
+    CsvFileReader reader(table.options);
+    if (!reader.open(table.path)) {
+      throw std::runtime_error("csv: cannot open " + table.path);
+    }
+    std::vector<std::vector<std::string>> rows;
+    if (reader.next(rows, 1) > 0) {
+      first.swap(rows[0]);
+    }
+  }
+
+  table.columnCount = columns > 0 ? columns : first.size();
+  if (table.columnCount == 0) {
+    throw std::runtime_error("csv: " + table.path + " has no columns");
+  }
+
+  std::vector<std::string> names = csvColumnNames(table.header ? first : std::vector<std::string>(), table.columnCount);
+  std::string sql = "CREATE TABLE x(";
+  for (size_t c = 0; c < names.size(); c++) {
+    sql += (c > 0 ? ", " : "") + quoteIdentifier(names[c]) + (table.numeric ? " NUMERIC" : " TEXT");
+  }
+  sql += ")";
+
+  FileView file;
+  if (table.indexed) {
+    if (!file.open(table.path)) {
+      throw std::runtime_error("csv: cannot open " + table.path);
+    }
+    uint64_t size = file.size();
+    uint64_t hash = fingerprint(file, table);
+    if (!loadIndex(table, indexPath, size, hash)) {
+      scanRows(file.data(), file.size(), table);
+      saveIndex(table, indexPath, size, hash);
+    }
+    table.rowEstimate = static_cast<double>(std::max<int64_t>(table.rowCount, 1));
+  } else if (file.open(table.path, false)) {
+    table.rowEstimate = std::max(1.0, std::floor(file.size() / CSV_BYTES_PER_ROW));
+  } else {
+    table.rowEstimate = 1e6;
+  }
+
+  return sql;
+}
+
+int csvConnect(sqlite3* db, void*, int argc, const char* const* argv, sqlite3_vtab** out, char** error) {
+  try {
+    std::unique_ptr<CsvTable> table(new CsvTable());
+    std::string schema = openTable(*table, argc, argv);
+
+    int rc = sqlite3_declare_vtab(db, schema.c_str());
+    if (rc != SQLITE_OK) {
+      *error = sqlite3_mprintf("%s", sqlite3_errmsg(db));
+      return rc;
+    }
+
+    *out = table.release();
+    return SQLITE_OK;
+  } catch (const std::exception& e) {
+    *error = sqlite3_mprintf("%s", e.what());
+    return SQLITE_ERROR;
+  }
+}
+
+int csvDisconnect(sqlite3_vtab* vtab) {
+  delete static_cast<CsvTable*>(vtab);
+  return SQLITE_OK;
+}
+
+// Only the rowid is indexable: EQ, or a lower and/or upper bound. Bounds
+// are not omitted, so xFilter may widen them (fractional values, text)
+// and SQLite still checks every row. colUsed becomes idxStr, the list of
+// columns to parse, unless every column is used.
+int csvBestIndex(sqlite3_vtab* vtab, sqlite3_index_info* info) {
+  CsvTable* table = static_cast<CsvTable*>(vtab);
+
+  int eq = -1;
+  int lower = -1;
+  int upper = -1;
+  for (int i = 0; i < info->nConstraint; i++) {
+    const sqlite3_index_info::sqlite3_index_constraint& constraint = info->aConstraint[i];
+    if (!constraint.usable || constraint.iColumn != -1) {
+      continue;
+    }
+    switch (constraint.op) {
+      case SQLITE_INDEX_CONSTRAINT_EQ:
+        eq = eq < 0 ? i : eq;
+        break;
+      case SQLITE_INDEX_CONSTRAINT_GT:
+      case SQLITE_INDEX_CONSTRAINT_GE:
+        lower = lower < 0 ? i : lower;
+        break;
+      case SQLITE_INDEX_CONSTRAINT_LT:
+      case SQLITE_INDEX_CONSTRAINT_LE:
+        upper = upper < 0 ? i : upper;
+        break;
+    }
+  }
+
+  double rows = table->rowEstimate;
+  int args = 0;
+  info->idxNum = 0;
+
+  if (eq >= 0) {
+    info->idxNum = ROWID_EQ;
+    info->aConstraintUsage[eq].argvIndex = ++args;
+    info->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+    info->estimatedRows = 1;
+    info->estimatedCost = table->indexed ? static_cast<double>(CSV_INDEX_STRIDE) : rows / 2;
+  } else {
+    double matches = rows;
+    if (lower >= 0) {
+      info->idxNum |= ROWID_LOWER;
+      info->aConstraintUsage[lower].argvIndex = ++args;
+      matches /= 2;
+    }
+    if (upper >= 0) {
+      info->idxNum |= ROWID_UPPER;
+      info->aConstraintUsage[upper].argvIndex = ++args;
+      matches /= 2;
+    }
+    info->estimatedRows = static_cast<sqlite3_int64>(std::max(matches, 1.0));
+    // Without an index a scan reads from the top, stopping at the upper bound
+    info->estimatedCost = table->indexed ? matches : (upper >= 0 ? rows / 2 : rows);
+  }
+
+  if (info->nOrderBy == 1 && info->aOrderBy[0].iColumn == -1 && !info->aOrderBy[0].desc) {
+    info->orderByConsumed = 1;
+  }
+
+  std::string used;
+  bool all = true;
+  for (size_t c = 0; c < table->columnCount; c++) {
+    sqlite3_uint64 bit = static_cast<sqlite3_uint64>(1) << (c < 63 ? c : 63);
+    if (info->colUsed & bit) {
+      used += (used.empty() ? "" : ",") + std::to_string(c);
+    } else {
+      all = false;
+    }
+  }
+  if (!all) {
+    // count(*) and the like still need a row per row; parse one column
+    info->idxStr = sqlite3_mprintf("%s", used.empty() ? "0" : used.c_str());
+    info->needToFreeIdxStr = 1;
+  }
+
+  return SQLITE_OK;
+}
+
+int csvOpen(sqlite3_vtab*, sqlite3_vtab_cursor** out) {
+  try {
+    *out = new CsvCursor();
+    return SQLITE_OK;
+  } catch (const std::exception&) {
+    return SQLITE_NOMEM;
+  }
+}
+
+int csvClose(sqlite3_vtab_cursor* cursor) {
+  delete static_cast<CsvCursor*>(cursor);
+  return SQLITE_OK;
+}
+
+// Move to the next row of the file
+// @returns false at the end
+bool readRow(CsvCursor* cursor) {
+  if (cursor->current + 1 < cursor->rows.size()) {
+    cursor->current++;
+    return true;
+  }
+  cursor->rows.clear();
+  cursor->current = 0;
+  return cursor->reader->next(cursor->rows, CSV_SCAN_BATCH) > 0;
+}
+
+// Next row, or eof past the last rowid wanted. The file is let go at
+// the end rather than when the cursor closes.
+void advance(CsvCursor* cursor) {
+  if (cursor->rowid >= cursor->last || !readRow(cursor)) {
+    cursor->eof = true;
+    cursor->reader.reset();
+    cursor->rows.clear();
+    return;
+  }
+  cursor->rowid++;
+}
+
+// Narrow [first, last] by a rowid bound. Integers are exact; other
+// numbers are rounded inwards, anything else leaves the range alone.
+void applyBound(sqlite3_value* value, bool lower, bool upper, int64_t& first, int64_t& last) {
+  int type = sqlite3_value_numeric_type(value);
+  int64_t low;
+  int64_t high;
+
+  if (type == SQLITE_INTEGER) {
+    low = high = sqlite3_value_int64(value);
+  } else if (type == SQLITE_FLOAT) {
+    double bound = std::max(-1.0, std::min(sqlite3_value_double(value), 9e18));
+    low = static_cast<int64_t>(std::ceil(bound));
+    high = static_cast<int64_t>(std::floor(bound));
+  } else {
+    return;
+  }
+
+  if (lower) {
+    first = std::max(first, low);
+  }
+  if (upper) {
+    last = std::min(last, high);
+  }
+}
+
+int csvFilter(sqlite3_vtab_cursor* base, int idxNum, const char* idxStr, int argc, sqlite3_value** argv) {
+  CsvCursor* cursor = static_cast<CsvCursor*>(base);
+  CsvTable* table = static_cast<CsvTable*>(base->pVtab);
+
+  int64_t first = 1;
+  int64_t last = INT64_MAX;
+  int arg = 0;
+  if ((idxNum & ROWID_EQ) && arg < argc) {
+    applyBound(argv[arg++], true, true, first, last);
+  }
+  if ((idxNum & ROWID_LOWER) && arg < argc) {
+    applyBound(argv[arg++], true, false, first, last);
+  }
+  if ((idxNum & ROWID_UPPER) && arg < argc) {
+    applyBound(argv[arg++], false, true, first, last);
+  }
+  first = std::max<int64_t>(first, 1);
+  if (table->rowCount >= 0) {
+    last = std::min(last, table->rowCount);
+  }
+
+  cursor->reader.reset();
+  cursor->rows.clear();
+  cursor->current = 0;
+  cursor->rowid = 0;
+  cursor->last = last;
+  cursor->eof = true;
+  if (first > last) {
+    return SQLITE_OK;
+  }
+
+  try {
+    // Parse only the columns in idxStr, in that order
+    ParseOptions options = table->options;
+    cursor->slots.assign(table->columnCount, -1);
+    if (idxStr) {
+      const char* p = idxStr;
+      while (*p) {
+        char* end;
+        size_t column = static_cast<size_t>(strtoul(p, &end, 10));
+        if (end == p) {
+          break;
+        }
+        if (column < table->columnCount) {
+          cursor->slots[column] = static_cast<int>(options.select.size());
+          ColumnRef ref;
+          ref.index = column;
+          options.select.push_back(ref);
+        }
+        p = *end == ',' ? end + 1 : end;
+      }
+    } else {
+      for (size_t c = 0; c < table->columnCount; c++) {
+        cursor->slots[c] = static_cast<int>(c);
+      }
+    }
+
+    // Seek to the indexed row at or before first
+    uint64_t offset = 0;
+    bool skipHeader = table->header;
+    if (table->indexed) {
+      size_t entry = static_cast<size_t>((first - 1) / static_cast<int64_t>(CSV_INDEX_STRIDE));
+      if (entry < table->offsets.size()) {
+        offset = table->offsets[entry];
+        cursor->rowid = static_cast<int64_t>(entry * CSV_INDEX_STRIDE);
+        skipHeader = false;
+      }
+    }
+
+    cursor->reader.reset(new CsvFileReader(options));
+    if (!cursor->reader->open(table->path, offset)) {
+      cursor->reader.reset();
+      sqlite3_free(table->zErrMsg);
+      table->zErrMsg = sqlite3_mprintf("csv: cannot open %s", table->path.c_str());
+      return SQLITE_ERROR;
+    }
+
+    cursor->eof = false;
+    if (skipHeader && !readRow(cursor)) {
+      cursor->eof = true;
+      cursor->reader.reset();
+      return SQLITE_OK;
+    }
+    do {
+      advance(cursor);
+    } while (!cursor->eof && cursor->rowid < first);
+  } catch (const std::exception& e) {
+    cursor->eof = true;
+    cursor->reader.reset();
+    sqlite3_free(table->zErrMsg);
+    table->zErrMsg = sqlite3_mprintf("%s", e.what());
+    return SQLITE_ERROR;
+  }
+  return SQLITE_OK;
+}
+
+int csvNext(sqlite3_vtab_cursor* base) {
+  CsvCursor* cursor = static_cast<CsvCursor*>(base);
+  try {
+    advance(cursor);
+  } catch (const std::exception&) {
+    cursor->eof = true;
+    cursor->reader.reset();
+    return SQLITE_NOMEM;
+  }
+  return SQLITE_OK;
+}
+
+int csvEof(sqlite3_vtab_cursor* base) {
+  return static_cast<CsvCursor*>(base)->eof;
+}
+
+// Set field as INTEGER or REAL if all of it reads as a decimal number
+// @returns false for anything else
+bool setNumber(sqlite3_context* ctx, const std::string& field) {
+  const char* text = field.c_str();
+  size_t length = field.size();
+  size_t i = (text[0] == '+' || text[0] == '-') ? 1 : 0;
+  size_t digits = 0;
+  bool integral = true;
+
+  while (i < length && isdigit(static_cast<unsigned char>(text[i]))) {
+    i++;
+    digits++;
+  }
+  if (i < length && text[i] == '.') {
+    integral = false;
+    i++;
+    while (i < length && isdigit(static_cast<unsigned char>(text[i]))) {
+      i++;
+      digits++;
+    }
+  }
+  if (digits == 0) {
+    return false;
+  }
+  if (i < length && (text[i] == 'e' || text[i] == 'E')) {
+    integral = false;
+    i++;
+    if (i < length && (text[i] == '+' || text[i] == '-')) {
+      i++;
+    }
+    size_t exponent = 0;
+    while (i < length && isdigit(static_cast<unsigned char>(text[i]))) {
+      i++;
+      exponent++;
+    }
+    if (exponent == 0) {
+      return false;
+    }
+  }
+  if (i != length) {
+    return false;
+  }
+
+  // Up to 18 digits always fit an int64
+  if (integral && digits <= 18) {
+    sqlite3_result_int64(ctx, strtoll(text, NULL, 10));
+  } else {
+    sqlite3_result_double(ctx, strtod(text, NULL));
+  }
+  return true;
+}
+
+int csvColumn(sqlite3_vtab_cursor* base, sqlite3_context* ctx, int column) {
+  CsvCursor* cursor = static_cast<CsvCursor*>(base);
+  CsvTable* table = static_cast<CsvTable*>(base->pVtab);
+  const std::vector<std::string>& row = cursor->rows[cursor->current];
+  int slot = column < static_cast<int>(cursor->slots.size()) ? cursor->slots[column] : -1;
+
+  if (slot < 0 || static_cast<size_t>(slot) >= row.size() || row[slot].empty()) {
+    if (table->numeric) {
+      sqlite3_result_null(ctx);
+    } else {
+      sqlite3_result_text(ctx, "", 0, SQLITE_STATIC);
+    }
+    return SQLITE_OK;
+  }
+
+  const std::string& field = row[slot];
+  if (table->numeric && setNumber(ctx, field)) {
+    return SQLITE_OK;
+  }
+  sqlite3_result_text(ctx, field.data(), static_cast<int>(field.size()), SQLITE_TRANSIENT);
+  return SQLITE_OK;
+}
+
+int csvRowid(sqlite3_vtab_cursor* base, sqlite3_int64* rowid) {
+  *rowid = static_cast<CsvCursor*>(base)->rowid;
+  return SQLITE_OK;
+}
+
+sqlite3_module makeCsvModule() {
+  sqlite3_module module;
+  memset(&module, 0, sizeof(module));
+  module.iVersion = 1;
+  module.xCreate = csvConnect;
+  module.xConnect = csvConnect;
+  module.xBestIndex = csvBestIndex;
+  module.xDisconnect = csvDisconnect;
+  module.xDestroy = csvDisconnect;
+  module.xOpen = csvOpen;
+  module.xClose = csvClose;
+  module.xFilter = csvFilter;
+  module.xNext = csvNext;
+  module.xEof = csvEof;
+  module.xColumn = csvColumn;
+  module.xRowid = csvRowid;
+  return module;
+}
+
+// Built at load time; SQLite keeps a pointer to it for each connection
+const sqlite3_module CSV_MODULE = makeCsvModule();
+
+} // namespace
+
+void registerCsvModule(sqlite3* db) {
+  sqlite3_create_module_v2(db, "csv", &CSV_MODULE, NULL, NULL);
+}
+
+std::string quoteIdentifier(const std::string& name) {
+  std::string result = "\"";
+  for (size_t i = 0; i < name.size(); i++) {
+    result += name[i];
+    if (name[i] == '"') {
+      result += '"';
+    }
+  }
+  return result + "\"";
+}
+
+std::vector<std::string> csvColumnNames(const std::vector<std::string>& header, size_t count) {
+  std::vector<std::string> names;
+  std::vector<std::string> folded;
+  for (size_t c = 0; c < count; c++) {
+    std::string name = c < header.size() ? trimText(header[c]) : std::string();
+    if (name.empty()) {
+      name = "c" + std::to_string(c + 1);
+    }
+
+    // Column names must be unique, ignoring case
+    std::string unique = name;
+    for (int n = 2; std::find(folded.begin(), folded.end(), lowerCase(unique)) != folded.end(); n++) {
+      unique = name + "_" + std::to_string(n);
+    }
+    folded.push_back(lowerCase(unique));
+    names.push_back(unique);
+  }
+  return names;
+}
+
+} // namespace nw_sqlite3
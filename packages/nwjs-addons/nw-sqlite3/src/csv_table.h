@@ -0,0 +1,52 @@
+#ifndef NW_SQLITE3_CSV_TABLE_H
+#define NW_SQLITE3_CSV_TABLE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "sqlite3.h"
+
+namespace nw_sqlite3 {
+
+// Data rows between entries of a csv table's row-offset index
+const size_t CSV_INDEX_STRIDE = 32;
+
+/**
+ * Register the "csv" virtual table module on a connection, for querying
+ * a CSV file in place:
+ *
+ *   CREATE VIRTUAL TABLE sales USING csv('sales.csv', delimiter=';', index=yes)
+ *
+ * The first argument is the file path; the rest are option=value pairs:
+ *   header=yes|no      first row names the columns (default yes); without
+ *                      it columns are c1, c2, ...
+ *   columns=N          column count (default: width of the first row)
+ *   delimiter, quote, escape   single characters ('\t' for tab)
+ *   trim=yes|no        strip spaces and tabs around fields
+ *   affinity=text|numeric  numeric returns fields that read as numbers
+ *                      as INTEGER/REAL and empty fields as NULL
+ *   index=yes|no|path  keep a row-offset index (default no)
+ *
+ * Every scan streams the file through csvparser::CsvFileReader and only
+ * copies the columns the query uses. rowid is the data row number from
+ * 1; missing fields read as empty. With index the start offset of every
+ * CSV_INDEX_STRIDE-th row is found once and saved next to the CSV
+ * (path + ".idx", or the given path), so rowid lookups and ranges seek
+ * instead of parsing from the top. An index whose CSV has changed is
+ * rebuilt.
+ */
+void registerCsvModule(sqlite3* db);
+
+// Double-quote an SQL identifier, doubling embedded quotes
+std::string quoteIdentifier(const std::string& name);
+
+/**
+ * Column names for a CSV of count columns, shared by the csv table and
+ * db.importCsv(): header fields trimmed, c1, c2, ... for blank or
+ * missing ones, and "_2", "_3", ... added to repeats (ignoring case).
+ */
+std::vector<std::string> csvColumnNames(const std::vector<std::string>& header, size_t count);
+
+} // namespace nw_sqlite3
+
+#endif // NW_SQLITE3_CSV_TABLE_H
@@ -1,18 +1,39 @@
 #include "database.h"
+#include "statement.h"
+#include "blob.h"
+#include "backup.h"
+#include "csv_table.h"
+#include <cstdint>
+#include <cstring>
 #include <stdexcept>
+#include <vector>
 
 namespace nw_sqlite3 {
 
-Database::Database(const std::string& path, bool readonly)
+Database::Database(const std::string& path, bool readonly, size_t cacheSize)
   : path_(path)
   , db_(NULL)
+  , cacheSize_(cacheSize)
+  , cacheHits_(0)
+  , cacheMisses_(0)
+  , statementTiming_(false)
+  , profiling_(false)
+  , profileDropped_(0)
+  , queryTimeout_(0)
+  , deadline_(std::chrono::steady_clock::time_point::max())
+  , timedOut_(false)
 {
-  int flags = SQLITE_OPEN_CREATE;
+  for (int i = 0; i < CONTROL_COUNT; i++) {
+    controls_[i] = NULL;
+  }
+
+  // sqlite rejects READONLY together with CREATE
+  int flags;
 
   if (readonly) {
-    flags |= SQLITE_OPEN_READONLY;
+    flags = SQLITE_OPEN_READONLY;
   } else {
-    flags |= SQLITE_OPEN_READWRITE;
+    flags = SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE;
   }
 
   int rc = sqlite3_open_v2(path.c_str(), &db_, flags, NULL);
@@ -31,6 +52,9 @@ Database::Database(const std::string& path, bool readonly)
 
   // Set busy timeout (5 seconds)
   sqlite3_busy_timeout(db_, 5000);
+
+  // CREATE VIRTUAL TABLE ... USING csv(path, ...)
+  registerCsvModule(db_);
 }
 
 Database::~Database() {
@@ -41,6 +65,17 @@ Database::Database(const Database& other) {
   // Copy not allowed
   path_ = other.path_;
   db_ = NULL;
+  cacheSize_ = other.cacheSize_;
+  cacheHits_ = 0;
+  cacheMisses_ = 0;
+  statementTiming_ = false;
+  profiling_ = false;
+  profileDropped_ = 0;
+  queryTimeout_ = 0;
+  timedOut_ = false;
+  for (int i = 0; i < CONTROL_COUNT; i++) {
+    controls_[i] = NULL;
+  }
 }
 
 Database& Database::operator=(const Database& other) {
@@ -63,10 +98,12 @@ void Database::exec(const std::string& sql) {
   }
 
   char* errMsg = NULL;
+  startStep();
   int rc = sqlite3_exec(db_, sql.c_str(), NULL, NULL, &errMsg);
+  endStep();
 
   if (rc != SQLITE_OK) {
-    std::string error = errMsg ? errMsg : "Unknown error";
+    std::string error = timedOut_ ? stepError() : errMsg ? errMsg : "Unknown error";
     if (errMsg) {
       sqlite3_free(errMsg);
     }
@@ -75,12 +112,370 @@ void Database::exec(const std::string& sql) {
 }
 
 void Database::close() {
+  // Statements unregister themselves as they go, so work from a copy
+  std::vector<Statement*> live(statements_.begin(), statements_.end());
+  statements_.clear();
+  for (size_t i = 0; i < live.size(); i++) {
+    live[i]->detachDatabase();
+  }
+
+  std::vector<Blob*> blobs(blobs_.begin(), blobs_.end());
+  blobs_.clear();
+  for (size_t i = 0; i < blobs.size(); i++) {
+    blobs[i]->detachDatabase();
+  }
+
+  std::vector<Backup*> backups(backups_.begin(), backups_.end());
+  backups_.clear();
+  for (size_t i = 0; i < backups.size(); i++) {
+    backups[i]->detachDatabase();
+  }
+
+  evictTo(0);
+  finalizeControls();
+  transactions_.clear();
+
   if (db_) {
     sqlite3_close_v2(db_);
     db_ = NULL;
   }
 }
 
+void Database::setProfiling(bool enabled) {
+  if (!db_) {
+    throw std::runtime_error("Database is closed");
+  }
+
+  if (enabled) {
+    sqlite3_trace_v2(db_, SQLITE_TRACE_PROFILE, traceCallback, this);
+  } else {
+    sqlite3_trace_v2(db_, 0, NULL, NULL);
+    profile_.clear();
+    profileDropped_ = 0;
+  }
+  profiling_ = enabled;
+}
+
+int Database::traceCallback(unsigned type, void* context, void* p, void* x) {
+  Database* self = static_cast<Database*>(context);
+
+  if (type == SQLITE_TRACE_PROFILE) {
+    if (self->profile_.size() >= MAX_PROFILE_ENTRIES) {
+      self->profileDropped_++;
+      return 0;
+    }
+
+    const char* sql = sqlite3_sql(static_cast<sqlite3_stmt*>(p));
+    ProfileEntry entry;
+    entry.sql = sql ? sql : "";
+    entry.time = static_cast<double>(*static_cast<sqlite3_int64*>(x)) / 1e6;
+    self->profile_.push_back(entry);
+  }
+  return 0;
+}
+
+size_t Database::takeProfile(std::vector<ProfileEntry>& entries) {
+  entries.clear();
+  entries.swap(profile_);
+
+  size_t dropped = profileDropped_;
+  profileDropped_ = 0;
+  return dropped;
+}
+
+void Database::setQueryTimeout(int ms) {
+  if (!db_) {
+    throw std::runtime_error("Database is closed");
+  }
+
+#ifdef SQLITE_OMIT_PROGRESS_CALLBACK
+  if (ms > 0) {
+    throw std::runtime_error("Query timeouts need a build with NW_SQLITE3_PROGRESS=ON");
+  }
+#else
+  // Check the clock every 1000 virtual machine instructions
+  sqlite3_progress_handler(db_, ms > 0 ? 1000 : 0, ms > 0 ? progressCallback : NULL, this);
+#endif
+  queryTimeout_ = ms > 0 ? ms : 0;
+  timedOut_ = false;
+}
+
+int Database::progressCallback(void* context) {
+  Database* self = static_cast<Database*>(context);
+
+  if (std::chrono::steady_clock::now() >= self->deadline_) {
+    self->timedOut_ = true;
+    return 1;
+  }
+  return 0;
+}
+
+std::string Database::stepError() const {
+  if (timedOut_ && db_ && sqlite3_errcode(db_) == SQLITE_INTERRUPT) {
+    return "Query timed out after " + std::to_string(queryTimeout_) + " ms";
+  }
+  return getError();
+}
+
+unsigned char* Database::serialize(const std::string& schema, size_t* size) {
+  if (!db_) {
+    throw std::runtime_error("Database is closed");
+  }
+
+  sqlite3_int64 bytes = -1;
+  unsigned char* data = sqlite3_serialize(db_, schema.c_str(), &bytes, 0);
+
+  if (bytes < 0) {
+    throw std::runtime_error("Unknown database: " + schema);
+  }
+  if (static_cast<sqlite3_uint64>(bytes) > static_cast<sqlite3_uint64>(SIZE_MAX)) {
+    sqlite3_free(data);
+    throw std::runtime_error("Database is too large to serialize");
+  }
+  if (!data && bytes > 0) {
+    throw std::runtime_error("Out of memory");
+  }
+
+  *size = static_cast<size_t>(bytes);
+  return data;
+}
+
+void Database::deserialize(const std::string& schema, const void* data, size_t size, bool readonly) {
+  if (!db_) {
+    throw std::runtime_error("Database is closed");
+  }
+  if (inTransaction()) {
+    throw std::runtime_error("Cannot deserialize inside a transaction");
+  }
+
+  // SQLite takes ownership of the copy and grows it as the database does
+  unsigned char* copy = NULL;
+  if (size > 0) {
+    copy = static_cast<unsigned char*>(sqlite3_malloc64(size));
+    if (!copy) {
+      throw std::runtime_error("Out of memory");
+    }
+    memcpy(copy, data, size);
+  }
+
+  unsigned flags = SQLITE_DESERIALIZE_FREEONCLOSE |
+    (readonly ? SQLITE_DESERIALIZE_READONLY : SQLITE_DESERIALIZE_RESIZEABLE);
+  int rc = sqlite3_deserialize(db_, schema.c_str(), copy, static_cast<sqlite3_int64>(size),
+                               static_cast<sqlite3_int64>(size), flags);
+  if (rc != SQLITE_OK) {
+    throw std::runtime_error(getError());
+  }
+}
+
+void Database::configure(const DatabaseTuning& tuning) {
+  if (!db_) {
+    throw std::runtime_error("Database is closed");
+  }
+
+  const std::string& mode = tuning.journalMode;
+  if (!mode.empty() && mode != "delete" && mode != "truncate" && mode != "persist" &&
+      mode != "memory" && mode != "wal" && mode != "off") {
+    throw std::runtime_error("Unknown journal mode: " + mode);
+  }
+
+  bool writable = sqlite3_db_readonly(db_, "main") == 0;
+
+  if (writable && tuning.pageSize > 0) {
+    exec("PRAGMA page_size = " + std::to_string(static_cast<long long>(tuning.pageSize)));
+  }
+  if (writable && !mode.empty()) {
+    exec("PRAGMA journal_mode = " + mode);
+  }
+  if (tuning.synchronous >= 0) {
+    exec("PRAGMA synchronous = " + std::to_string(static_cast<long long>(tuning.synchronous)));
+  }
+  if (tuning.hasCacheSize()) {
+    exec("PRAGMA cache_size = " + std::to_string(static_cast<long long>(tuning.cacheSize)));
+  }
+  if (tuning.mmapSize >= 0) {
+    exec("PRAGMA mmap_size = " + std::to_string(static_cast<long long>(tuning.mmapSize)));
+  }
+  if (tuning.tempStore >= 0) {
+    exec("PRAGMA temp_store = " + std::to_string(static_cast<long long>(tuning.tempStore)));
+  }
+  if (tuning.walAutocheckpoint >= 0) {
+    setWalAutocheckpoint(tuning.walAutocheckpoint);
+  }
+}
+
+CheckpointResult Database::checkpoint(int mode) {
+  if (!db_) {
+    throw std::runtime_error("Database is closed");
+  }
+
+  CheckpointResult result;
+  int rc = sqlite3_wal_checkpoint_v2(db_, NULL, mode, &result.logFrames, &result.checkpointedFrames);
+
+  // SQLITE_BUSY: a FULL/RESTART/TRUNCATE checkpoint could not finish
+  // because of other connections; the frame counts still apply
+  if (rc != SQLITE_OK && rc != SQLITE_BUSY) {
+    throw std::runtime_error(getError());
+  }
+  return result;
+}
+
+void Database::setWalAutocheckpoint(int pages) {
+  if (!db_) {
+    throw std::runtime_error("Database is closed");
+  }
+  sqlite3_wal_autocheckpoint(db_, pages);
+}
+
+void Database::runControl(ControlStatement which) {
+  static const char* const sql[CONTROL_COUNT] = {
+    "BEGIN DEFERRED",
+    "BEGIN IMMEDIATE",
+    "BEGIN EXCLUSIVE",
+    "COMMIT",
+    "ROLLBACK",
+    "SAVEPOINT nw_sqlite3",
+    "RELEASE nw_sqlite3",
+    "ROLLBACK TO nw_sqlite3"
+  };
+
+  if (!db_) {
+    throw std::runtime_error("Database is closed");
+  }
+
+  if (!controls_[which]) {
+    if (sqlite3_prepare_v2(db_, sql[which], -1, &controls_[which], NULL) != SQLITE_OK) {
+      throw std::runtime_error(getError());
+    }
+  }
+
+  startStep();
+  int rc = sqlite3_step(controls_[which]);
+  endStep();
+  sqlite3_reset(controls_[which]);
+
+  if (rc != SQLITE_DONE) {
+    throw std::runtime_error(getError());
+  }
+}
+
+void Database::finalizeControls() {
+  for (int i = 0; i < CONTROL_COUNT; i++) {
+    if (controls_[i]) {
+      sqlite3_finalize(controls_[i]);
+      controls_[i] = NULL;
+    }
+  }
+}
+
+void Database::begin(TransactionMode mode) {
+  bool savepoint = inTransaction();
+
+  if (savepoint) {
+    runControl(CONTROL_SAVEPOINT);
+  } else if (mode == TRANSACTION_IMMEDIATE) {
+    runControl(CONTROL_BEGIN_IMMEDIATE);
+  } else if (mode == TRANSACTION_EXCLUSIVE) {
+    runControl(CONTROL_BEGIN_EXCLUSIVE);
+  } else {
+    runControl(CONTROL_BEGIN_DEFERRED);
+  }
+
+  transactions_.push_back(savepoint);
+}
+
+void Database::commit() {
+  if (transactions_.empty()) {
+    throw std::runtime_error("No transaction to commit");
+  }
+
+  // Stays open if COMMIT fails (SQLITE_BUSY), so rollback() can follow
+  runControl(transactions_.back() ? CONTROL_RELEASE : CONTROL_COMMIT);
+  transactions_.pop_back();
+}
+
+void Database::rollback() {
+  if (transactions_.empty()) {
+    throw std::runtime_error("No transaction to roll back");
+  }
+
+  bool savepoint = transactions_.back();
+  transactions_.pop_back();
+
+  // Some errors (SQLITE_FULL, SQLITE_IOERR, ...) roll back the whole
+  // transaction on their own
+  if (!inTransaction()) {
+    return;
+  }
+
+  if (savepoint) {
+    runControl(CONTROL_ROLLBACK_TO);
+    runControl(CONTROL_RELEASE);
+  } else {
+    runControl(CONTROL_ROLLBACK);
+  }
+}
+
+sqlite3_stmt* Database::acquireStatement(const std::string& sql) {
+  if (!db_) {
+    throw std::runtime_error("Database is closed");
+  }
+
+  std::unordered_map<std::string, CacheList::iterator>::iterator found = cacheIndex_.find(sql);
+  if (found != cacheIndex_.end()) {
+    sqlite3_stmt* stmt = found->second->stmt;
+    cacheList_.erase(found->second);
+    cacheIndex_.erase(found);
+    cacheHits_++;
+    return stmt;
+  }
+
+  cacheMisses_++;
+
+  sqlite3_stmt* stmt = NULL;
+  int rc = sqlite3_prepare_v2(db_, sql.c_str(), static_cast<int>(sql.length()), &stmt, NULL);
+  if (rc != SQLITE_OK) {
+    throw std::runtime_error(getError());
+  }
+  return stmt;
+}
+
+void Database::releaseStatement(const std::string& sql, sqlite3_stmt* stmt) {
+  if (!stmt) {
+    return;
+  }
+
+  if (!db_ || cacheSize_ == 0 || cacheIndex_.count(sql)) {
+    sqlite3_finalize(stmt);
+    return;
+  }
+
+  // Reset so an idle statement holds no read transaction or bound data
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  CacheEntry entry;
+  entry.sql = sql;
+  entry.stmt = stmt;
+  cacheList_.push_front(entry);
+  cacheIndex_[sql] = cacheList_.begin();
+
+  evictTo(cacheSize_);
+}
+
+void Database::setCacheSize(size_t size) {
+  cacheSize_ = size;
+  evictTo(size);
+}
+
+void Database::evictTo(size_t size) {
+  while (cacheList_.size() > size) {
+    CacheEntry& oldest = cacheList_.back();
+    sqlite3_finalize(oldest.stmt);
+    cacheIndex_.erase(oldest.sql);
+    cacheList_.pop_back();
+  }
+}
+
 std::string Database::getError() const {
   if (!db_) return "Database is closed";
   return sqlite3_errmsg(db_);
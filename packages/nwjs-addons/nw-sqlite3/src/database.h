@@ -1,11 +1,70 @@
 #ifndef NW_SQLITE3_DATABASE_H
 #define NW_SQLITE3_DATABASE_H
 
+#include <chrono>
 #include <string>
+#include <list>
+#include <set>
+#include <unordered_map>
+#include <vector>
 #include "sqlite3.h"
 
 namespace nw_sqlite3 {
 
+class Statement;
+class Blob;
+class Backup;
+
+// Default number of idle compiled statements kept per connection
+const size_t DEFAULT_STATEMENT_CACHE_SIZE = 64;
+
+// How an outermost transaction takes its locks (BEGIN DEFERRED/IMMEDIATE/
+// EXCLUSIVE); nested ones are savepoints
+enum TransactionMode {
+  TRANSACTION_DEFERRED,
+  TRANSACTION_IMMEDIATE,
+  TRANSACTION_EXCLUSIVE
+};
+
+/**
+ * Connection pragmas applied at open. Unset fields (empty, -1, 0 for
+ * cacheSize) keep SQLite's defaults; page size and journal mode are skipped on read-only
+ * connections.
+ */
+struct DatabaseTuning {
+  int pageSize;            // PRAGMA page_size (before the journal mode)
+  std::string journalMode; // delete, truncate, persist, memory, wal or off
+  int synchronous;         // 0 off, 1 normal, 2 full, 3 extra
+  int64_t cacheSize;       // PRAGMA cache_size: pages, or KiB if negative
+  int64_t mmapSize;        // PRAGMA mmap_size in bytes
+  int tempStore;           // 0 default, 1 file, 2 memory
+  int walAutocheckpoint;   // pages; 0 turns automatic checkpoints off
+
+  DatabaseTuning()
+    : pageSize(-1), synchronous(-1), cacheSize(0), mmapSize(-1), tempStore(-1), walAutocheckpoint(-1) {}
+
+  bool hasCacheSize() const { return cacheSize != 0; }
+};
+
+/**
+ * sqlite3_wal_checkpoint_v2() result
+ */
+struct CheckpointResult {
+  int logFrames;           // frames in the WAL
+  int checkpointedFrames;  // frames copied back into the database
+};
+
+// Finished statements kept for takeProfile(); later ones are dropped
+const size_t MAX_PROFILE_ENTRIES = 1024;
+
+/**
+ * One statement run recorded by the profiler
+ */
+struct ProfileEntry {
+  std::string sql;
+  double time;   // ms, as measured by SQLite (coarse on Windows)
+};
+
 /**
  * SQLite Database wrapper
  * Provides a clean C++ interface over SQLite3
@@ -16,8 +75,10 @@ public:
    * Open or create database
    * @param path Path to database file (":memory:" for in-memory)
    * @param readonly Open in read-only mode
+   * @param cacheSize Statement cache capacity (0 disables the cache)
    */
-  Database(const std::string& path, bool readonly = false);
+  Database(const std::string& path, bool readonly = false,
+           size_t cacheSize = DEFAULT_STATEMENT_CACHE_SIZE);
   ~Database();
 
   // Prevent copying
@@ -46,10 +107,163 @@ public:
   void exec(const std::string& sql);
 
   /**
-   * Close the database
+   * Apply tuning pragmas (see DatabaseTuning)
+   */
+  void configure(const DatabaseTuning& tuning);
+
+  /**
+   * Checkpoint the WAL of every attached database
+   * @param mode SQLITE_CHECKPOINT_PASSIVE, _FULL, _RESTART or _TRUNCATE
+   */
+  CheckpointResult checkpoint(int mode);
+
+  /**
+   * Checkpoint automatically once the WAL reaches pages pages (0 = never)
+   */
+  void setWalAutocheckpoint(int pages);
+
+  /**
+   * Start a transaction, or a savepoint inside an open one. Each begin()
+   * is closed by one commit() or rollback(). The BEGIN/COMMIT/SAVEPOINT
+   * statements are prepared once per connection.
+   */
+  void begin(TransactionMode mode = TRANSACTION_DEFERRED);
+
+  /**
+   * Commit the innermost begin() (RELEASE for a savepoint)
+   */
+  void commit();
+
+  /**
+   * Roll back the innermost begin(). Does nothing to a transaction SQLite
+   * has already rolled back itself.
+   */
+  void rollback();
+
+  /**
+   * Number of begin() calls not yet committed or rolled back
+   */
+  size_t transactionDepth() const { return transactions_.size(); }
+
+  /**
+   * Image of schema as one buffer (sqlite3_serialize): the database file
+   * for a disk database, the pages of an in-memory one. Free it with
+   * sqlite3_free(); NULL for an empty database.
+   */
+  unsigned char* serialize(const std::string& schema, size_t* size);
+
+  /**
+   * Replace schema with an in-memory copy of a serialize() image
+   * (sqlite3_deserialize). The connection keeps working on that copy;
+   * the file it was opened on is not touched.
+   * @param readonly Refuse writes instead of growing the copy
+   */
+  void deserialize(const std::string& schema, const void* data, size_t size, bool readonly);
+
+  /**
+   * Close the database. Live statements are finalized first.
    */
   void close();
 
+  /**
+   * Compiled statement for sql: an idle one from the statement cache
+   * (a hit) or a newly prepared one (a miss). The caller owns it until
+   * it is handed back with releaseStatement().
+   */
+  sqlite3_stmt* acquireStatement(const std::string& sql);
+
+  /**
+   * Return a statement from acquireStatement(). It is reset and kept for
+   * the next acquireStatement() of the same SQL, evicting the least
+   * recently used entry when the cache is full.
+   */
+  void releaseStatement(const std::string& sql, sqlite3_stmt* stmt);
+
+  /**
+   * Statement cache capacity; shrinking evicts the oldest entries
+   */
+  void setCacheSize(size_t size);
+  size_t cacheSize() const { return cacheSize_; }
+
+  /**
+   * Statement cache occupancy and counters
+   */
+  size_t cachedStatements() const { return cacheList_.size(); }
+  uint64_t cacheHits() const { return cacheHits_; }
+  uint64_t cacheMisses() const { return cacheMisses_; }
+
+  /**
+   * Time every sqlite3_step() of this connection's statements for
+   * Statement::stats(). Off by default: it costs two clock reads a step.
+   */
+  void setStatementTiming(bool enabled) { statementTiming_ = enabled; }
+  bool statementTiming() const { return statementTiming_; }
+
+  /**
+   * Record the SQL and run time of each finished statement
+   * (sqlite3_trace_v2 SQLITE_TRACE_PROFILE) until takeProfile() collects
+   * them. Nothing is called back: the trace fires inside sqlite3_reset()
+   * and sqlite3_finalize() too, which may run during garbage collection.
+   */
+  void setProfiling(bool enabled);
+  bool profiling() const { return profiling_; }
+
+  /**
+   * Move the recorded entries into entries
+   * @returns Entries dropped since the last call because the queue was full
+   */
+  size_t takeProfile(std::vector<ProfileEntry>& entries);
+
+  /**
+   * Interrupt a sqlite3_step() (or exec()) that runs longer than ms
+   * milliseconds; 0 turns the limit off. Needs SQLite's progress callback,
+   * which default builds omit (SQLITE_OMIT_PROGRESS_CALLBACK).
+   */
+  void setQueryTimeout(int ms);
+  int queryTimeout() const { return queryTimeout_; }
+
+  /**
+   * Called before each sqlite3_step() (and exec()) to restart the timeout
+   * clock, and endStep() straight after it. Between the two the deadline
+   * is off, so SQLite work outside a step that also calls the progress
+   * handler (prepare, blob and backup calls) is never interrupted by the
+   * deadline of a step that has already finished.
+   */
+  void startStep() {
+    if (queryTimeout_ > 0) {
+      deadline_ = std::chrono::steady_clock::now() + std::chrono::milliseconds(queryTimeout_);
+      timedOut_ = false;
+    }
+  }
+  void endStep() {
+    deadline_ = std::chrono::steady_clock::time_point::max();
+  }
+
+  /**
+   * Error message for a failed sqlite3_step(), naming the timeout if it
+   * was the cause
+   */
+  std::string stepError() const;
+
+  /**
+   * Track a live Statement so close() can finalize it
+   */
+  void attach(Statement* stmt) { statements_.insert(stmt); }
+  void detach(Statement* stmt) { statements_.erase(stmt); }
+
+  /**
+   * Track an open Blob so close() can close it
+   */
+  void attach(Blob* blob) { blobs_.insert(blob); }
+  void detach(Blob* blob) { blobs_.erase(blob); }
+
+  /**
+   * Track a running Backup (from or to this database) so close() can
+   * stop it
+   */
+  void attach(Backup* backup) { backups_.insert(backup); }
+  void detach(Backup* backup) { backups_.erase(backup); }
+
   /**
    * Get SQLite handle (for Statement class)
    */
@@ -76,8 +290,62 @@ public:
   int totalChanges() const;
 
 private:
+  struct CacheEntry {
+    std::string sql;
+    sqlite3_stmt* stmt;
+  };
+  typedef std::list<CacheEntry> CacheList;
+
+  void evictTo(size_t size);
+
+  enum ControlStatement {
+    CONTROL_BEGIN_DEFERRED,
+    CONTROL_BEGIN_IMMEDIATE,
+    CONTROL_BEGIN_EXCLUSIVE,
+    CONTROL_COMMIT,
+    CONTROL_ROLLBACK,
+    CONTROL_SAVEPOINT,
+    CONTROL_RELEASE,
+    CONTROL_ROLLBACK_TO,
+    CONTROL_COUNT
+  };
+
+  // Step one of the transaction statements, preparing it on first use
+  void runControl(ControlStatement which);
+  void finalizeControls();
+
+  static int traceCallback(unsigned type, void* context, void* p, void* x);
+  static int progressCallback(void* context);
+
   std::string path_;
   sqlite3* db_;
+
+  // Idle statements, most recently used first, plus an index by SQL
+  // text. One idle statement per SQL text; surplus ones are finalized.
+  CacheList cacheList_;
+  std::unordered_map<std::string, CacheList::iterator> cacheIndex_;
+  size_t cacheSize_;
+  uint64_t cacheHits_;
+  uint64_t cacheMisses_;
+
+  std::set<Statement*> statements_;
+  std::set<Blob*> blobs_;
+  std::set<Backup*> backups_;
+
+  sqlite3_stmt* controls_[CONTROL_COUNT];
+
+  // One entry per open begin(): true if it made a savepoint
+  std::vector<bool> transactions_;
+
+  bool statementTiming_;
+
+  bool profiling_;
+  std::vector<ProfileEntry> profile_;
+  size_t profileDropped_;
+
+  int queryTimeout_;
+  std::chrono::steady_clock::time_point deadline_;
+  bool timedOut_;
 };
 
 } // namespace nw_sqlite3
@@ -1,11 +1,38 @@
 #include "addon_api.h"
 #include "database.h"
 #include "statement.h"
+#include "blob.h"
+#include "backup.h"
+#include "result_set.h"
+#include "connection_pool.h"
+#include "native_function.h"
+#include "csv_import.h"
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
 
 using namespace nw_sqlite3;
 
 // Forward declarations
 class StatementWrap;
+class PoolWorker;
+
+// Pool connections plus the queue that keeps writes to one at a time,
+// in submission order, without parking thread-pool threads on the writer
+// lock. Shared by a DatabaseWrap, its statements and in-flight workers.
+struct AsyncContext {
+  AsyncContext(const std::string& path, bool readonly, size_t readers, const DatabaseTuning& tuning)
+    : pool(path, readonly, readers, tuning), writing(false) {}
+
+  ConnectionPool pool;
+  std::deque<PoolWorker*> pendingWrites;  // JS thread only
+  bool writing;
+};
+
+typedef std::shared_ptr<AsyncContext> AsyncContextPtr;
 
 // Database wrapper
 class DatabaseWrap : public ADDON_OBJECT_WRAP {
@@ -14,17 +41,47 @@ public:
   static ADDON_METHOD(New);
   static ADDON_METHOD(Exec);
   static ADDON_METHOD(Prepare);
+  static ADDON_METHOD(Query);
+  static ADDON_METHOD(SetCacheSize);
+  static ADDON_METHOD(CacheStats);
+  static ADDON_METHOD(SetStatementTiming);
+  static ADDON_METHOD(SetProfiling);
+  static ADDON_METHOD(TakeProfile);
+  static ADDON_METHOD(SetQueryTimeout);
+  static ADDON_METHOD(ExecAsync);
+  static ADDON_METHOD(QueryAsync);
+  static ADDON_METHOD(OpenBlob);
+  static ADDON_METHOD(OpenBackup);
+  static ADDON_METHOD(ImportCsv);
+  static ADDON_METHOD(Serialize);
+  static ADDON_METHOD(Deserialize);
+  static ADDON_METHOD(Begin);
+  static ADDON_METHOD(Commit);
+  static ADDON_METHOD(Rollback);
+  static ADDON_METHOD(Checkpoint);
+  static ADDON_METHOD(WalAutocheckpoint);
+  static ADDON_METHOD(Function);
+  static ADDON_METHOD(Aggregate);
+  static ADDON_METHOD(NativeFunction);
   static ADDON_METHOD(Close);
   static ADDON_GETTER(GetOpen);
   static ADDON_GETTER(GetPath);
   static ADDON_GETTER(GetInTransaction);
 
+  static ADDON_PERSISTENT_TEMPLATE constructorTemplate;
   static ADDON_PERSISTENT_FUNCTION constructor;
 
   Database* db_;
 
+  // Connections for the *Async methods; NULL for in-memory databases
+  AsyncContextPtr async_;
+
+  // JS user-defined functions currently running; close() is refused
+  // while one is on the stack
+  int callbackDepth_;
+
 private:
-  DatabaseWrap() : db_(NULL) {}
+  DatabaseWrap() : db_(NULL), callbackDepth_(0) {}
   ~DatabaseWrap() {
     if (db_) {
       delete db_;
@@ -33,18 +90,29 @@ private:
   }
 };
 
+ADDON_PERSISTENT_TEMPLATE DatabaseWrap::constructorTemplate;
 ADDON_PERSISTENT_FUNCTION DatabaseWrap::constructor;
 
 // Statement wrapper
 class StatementWrap : public ADDON_OBJECT_WRAP {
 public:
   static void Init(ADDON_INIT_PARAMS);
-  static ADDON_OBJECT_TYPE Create(Statement* stmt);
+  static ADDON_OBJECT_TYPE Create(Statement* stmt, const AsyncContextPtr& async);
   static ADDON_METHOD(Run);
+  static ADDON_METHOD(RunBatch);
+  static ADDON_METHOD(RunColumns);
   static ADDON_METHOD(Get);
   static ADDON_METHOD(All);
   static ADDON_METHOD(Reset);
   static ADDON_METHOD(Finalize);
+  static ADDON_METHOD(Raw);
+  static ADDON_METHOD(Columnar);
+  static ADDON_METHOD(Async);
+  static ADDON_METHOD(Iterate);
+  static ADDON_METHOD(IterateNext);
+  static ADDON_METHOD(IterateEnd);
+  static ADDON_METHOD(Stats);
+  static ADDON_METHOD(Explain);
   static ADDON_GETTER(GetSource);
   static ADDON_GETTER(GetReader);
 
@@ -53,8 +121,56 @@ public:
 
   Statement* stmt_;
 
+  // Bind JS value to statement parameter
+  static void bindValue(Statement* stmt, int index, ADDON_VALUE val);
+
+  // Result column names as JS property keys, one per column
+  static void columnKeys(Statement* stmt, std::vector<ADDON_VALUE>& keys);
+
+  // JS value of one column of the current row
+  static ADDON_VALUE cellValue(Statement* stmt, int index);
+
+  // Convert row to JS object. Keys come from columnKeys() and are set in
+  // the same order on every row, so all rows share one hidden class.
+  static ADDON_OBJECT_TYPE rowToObject(Statement* stmt, const std::vector<ADDON_VALUE>& keys);
+
+  // Convert row to JS array of values (raw mode)
+  static ADDON_ARRAY_TYPE rowToArray(Statement* stmt, int columnCount);
+
+  // { changes, lastInsertRowid } for a statement that has just run
+  static ADDON_OBJECT_TYPE runResult(int changes, int64_t lastInsertRowid);
+
+  // Hand count arguments, value(i) giving argument i, to bind(index, value):
+  // in parameter order, or when one is a plain object, that object by
+  // parameter name and the others in order to the unnamed (?) parameters
+  template <typename Value, typename Bind>
+  void bindArguments(int count, Value value, Bind bind);
+
+  // bindArguments() for SQL run without a Statement object (db.query()),
+  // looking the parameter names up on each call
+  template <typename Value, typename Bind>
+  static void bindQueryArguments(Statement* stmt, int count, Value value, Bind bind);
+
+  // Position of the one plain object among count arguments, or -1
+  template <typename Value>
+  static int parameterObject(int count, Value value);
+
+  // Named parameter indexes of stmt with their names (no prefix), and the
+  // indexes of unnamed parameters
+  static void parameterSlots(Statement* stmt, std::vector<int>& named, std::vector<std::string>& names,
+                             std::vector<int>& unnamed);
+
+  // Bind count arguments around argument object: named[i] gets
+  // namedValue(i), the others fill the unnamed parameters in order, and
+  // unnamed parameters left over get none
+  template <typename Value, typename NamedValue, typename Bind, typename None>
+  static void bindAroundObject(int count, int object, Value value, const std::vector<int>& named,
+                               NamedValue namedValue, const std::vector<int>& unnamed, Bind bind, None none);
+
 private:
-  StatementWrap() : stmt_(NULL) {}
+  StatementWrap()
+    : stmt_(NULL), keysVersion_(0), paramsResolved_(false), raw_(false), columnar_(false),
+      iteration_(0), iterating_(false) {}
   ~StatementWrap() {
     if (stmt_) {
       delete stmt_;
@@ -62,16 +178,119 @@ private:
     }
   }
 
-  // Bind JS value to statement parameter
-  static void bindValue(Statement* stmt, int index, ADDON_VALUE val);
+  // columnKeys() for stmt_, built once and kept in keys_ until the
+  // statement's columns change
+  void cachedKeys(std::vector<ADDON_VALUE>& keys);
+
+  ADDON_PERSISTENT_ARRAY keys_;
+  unsigned keysVersion_;
+
+  // Parameter slots for object binding, resolved once by resolveParams():
+  // named parameter indexes with their keys (no prefix) in paramKeys_,
+  // and the indexes of unnamed parameters
+  void resolveParams();
+
+  std::vector<int> namedParams_;
+  std::vector<int> unnamedParams_;
+  ADDON_PERSISTENT_ARRAY paramKeys_;
+  bool paramsResolved_;
+
+  // Result shape for get()/all(): rows as arrays instead of objects, or
+  // (all() only) one array per column
+  bool raw_;
+  bool columnar_;
 
-  // Convert row to JS object
-  static ADDON_OBJECT_TYPE rowToObject(Statement* stmt);
+  // iterate() numbers each pass so an iterator notices when run()/get()/
+  // all()/reset() took the statement over; iterating_ is cleared by those
+  // and once the rows run out
+  unsigned iteration_;
+  bool iterating_;
+
+  AsyncContextPtr async_;
 };
 
 ADDON_PERSISTENT_TEMPLATE StatementWrap::constructorTemplate;
 ADDON_PERSISTENT_FUNCTION StatementWrap::constructor;
 
+// Blob wrapper
+class BlobWrap : public ADDON_OBJECT_WRAP {
+public:
+  static void Init(ADDON_INIT_PARAMS);
+  static ADDON_OBJECT_TYPE Create(Blob* blob);
+  static ADDON_METHOD(Read);
+  static ADDON_METHOD(ReadInto);
+  static ADDON_METHOD(Write);
+  static ADDON_METHOD(Reopen);
+  static ADDON_METHOD(Close);
+  static ADDON_GETTER(GetSize);
+  static ADDON_GETTER(GetOpen);
+
+  static ADDON_PERSISTENT_FUNCTION constructor;
+
+  Blob* blob_;
+
+private:
+  BlobWrap() : blob_(NULL) {}
+  ~BlobWrap() {
+    if (blob_) {
+      delete blob_;
+      blob_ = NULL;
+    }
+  }
+
+  // blob_ is open and [offset, offset + length) lies inside it; throws
+  // otherwise
+  void checkRange(double offset, double length);
+};
+
+ADDON_PERSISTENT_FUNCTION BlobWrap::constructor;
+
+// Backup wrapper
+class BackupWrap : public ADDON_OBJECT_WRAP {
+public:
+  static void Init(ADDON_INIT_PARAMS);
+  static ADDON_OBJECT_TYPE Create(Backup* backup);
+  static ADDON_METHOD(Step);
+  static ADDON_METHOD(Close);
+  static ADDON_GETTER(GetRemaining);
+  static ADDON_GETTER(GetPageCount);
+  static ADDON_GETTER(GetOpen);
+
+  static ADDON_PERSISTENT_FUNCTION constructor;
+
+  Backup* backup_;
+
+private:
+  BackupWrap() : backup_(NULL) {}
+  ~BackupWrap() {
+    if (backup_) {
+      delete backup_;
+      backup_ = NULL;
+    }
+  }
+};
+
+ADDON_PERSISTENT_FUNCTION BackupWrap::constructor;
+
+// CSV import wrapper: each step() runs one batch on the pool's writer
+class ImportWrap : public ADDON_OBJECT_WRAP {
+public:
+  static void Init(ADDON_INIT_PARAMS);
+  static ADDON_OBJECT_TYPE Create(CsvImport* import, const AsyncContextPtr& async);
+  static ADDON_METHOD(Step);
+
+  static ADDON_PERSISTENT_FUNCTION constructor;
+
+  // Shared with the step in flight, which may outlive this wrapper
+  std::shared_ptr<CsvImport> import_;
+  AsyncContextPtr async_;
+
+private:
+  ImportWrap() {}
+};
+
+ADDON_PERSISTENT_FUNCTION ImportWrap::constructor;
+
 // ============================================
 // Database Implementation
 // ============================================
@@ -86,6 +305,28 @@ void DatabaseWrap::Init(ADDON_INIT_PARAMS) {
   // Methods
   ADDON_SET_PROTOTYPE_METHOD(tpl, "exec", Exec);
   ADDON_SET_PROTOTYPE_METHOD(tpl, "prepare", Prepare);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "query", Query);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "setCacheSize", SetCacheSize);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "cacheStats", CacheStats);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "setStatementTiming", SetStatementTiming);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "setProfiling", SetProfiling);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "takeProfile", TakeProfile);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "setQueryTimeout", SetQueryTimeout);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "execAsync", ExecAsync);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "queryAsync", QueryAsync);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "openBlob", OpenBlob);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "openBackup", OpenBackup);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "importCsv", ImportCsv);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "serialize", Serialize);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "deserialize", Deserialize);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "begin", Begin);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "commit", Commit);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "rollback", Rollback);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "checkpoint", Checkpoint);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "walAutocheckpoint", WalAutocheckpoint);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "function", Function);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "aggregate", Aggregate);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "nativeFunction", NativeFunction);
   ADDON_SET_PROTOTYPE_METHOD(tpl, "close", Close);
 
   // Accessors
@@ -93,10 +334,90 @@ void DatabaseWrap::Init(ADDON_INIT_PARAMS) {
   ADDON_SET_ACCESSOR(tpl, "path", GetPath);
   ADDON_SET_ACCESSOR(tpl, "inTransaction", GetInTransaction);
 
+  ADDON_PERSISTENT_RESET(constructorTemplate, tpl);
   ADDON_PERSISTENT_RESET(constructor, ADDON_GET_CTOR_FUNCTION(tpl));
   ADDON_SET(exports, "Database", ADDON_GET_CTOR_FUNCTION(tpl));
 }
 
+namespace {
+
+// Index of a lower-case name in a NULL-terminated list, or -1
+int nameIndex(const char* const* names, const std::string& name) {
+  for (int i = 0; names[i]; i++) {
+    if (name == names[i]) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// A pragma level given as a name from names or as its number
+int readLevel(ADDON_VALUE val, const char* const* names, const char* option) {
+  if (ADDON_IS_NUMBER(val)) {
+    return ADDON_TO_INT32(val);
+  }
+
+  ADDON_UTF8(str, val);
+  std::string name = ADDON_UTF8_VALUE(str);
+  for (size_t i = 0; i < name.size(); i++) {
+    name[i] = static_cast<char>(tolower(static_cast<unsigned char>(name[i])));
+  }
+
+  int level = nameIndex(names, name);
+  if (level < 0) {
+    throw std::runtime_error(std::string("Unknown ") + option + ": " + name);
+  }
+  return level;
+}
+
+// journalMode, synchronous, cacheSize, mmapSize, tempStore, pageSize and
+// walAutocheckpoint options
+void readTuning(ADDON_OBJECT_TYPE opts, DatabaseTuning& tuning) {
+  static const char* const synchronousNames[] = { "off", "normal", "full", "extra", NULL };
+  static const char* const tempStoreNames[] = { "default", "file", "memory", NULL };
+
+  ADDON_VALUE val = ADDON_GET(opts, "journalMode");
+  if (ADDON_IS_STRING(val)) {
+    ADDON_UTF8(mode, val);
+    tuning.journalMode = ADDON_UTF8_VALUE(mode);
+    for (size_t i = 0; i < tuning.journalMode.size(); i++) {
+      tuning.journalMode[i] = static_cast<char>(tolower(static_cast<unsigned char>(tuning.journalMode[i])));
+    }
+  }
+
+  val = ADDON_GET(opts, "synchronous");
+  if (ADDON_IS_STRING(val) || ADDON_IS_NUMBER(val)) {
+    tuning.synchronous = readLevel(val, synchronousNames, "synchronous");
+  }
+
+  val = ADDON_GET(opts, "tempStore");
+  if (ADDON_IS_STRING(val) || ADDON_IS_NUMBER(val)) {
+    tuning.tempStore = readLevel(val, tempStoreNames, "tempStore");
+  }
+
+  val = ADDON_GET(opts, "cacheSize");
+  if (ADDON_IS_NUMBER(val)) {
+    tuning.cacheSize = static_cast<int64_t>(ADDON_TO_DOUBLE(val));
+  }
+
+  val = ADDON_GET(opts, "mmapSize");
+  if (ADDON_IS_NUMBER(val)) {
+    tuning.mmapSize = static_cast<int64_t>(ADDON_TO_DOUBLE(val));
+  }
+
+  val = ADDON_GET(opts, "pageSize");
+  if (ADDON_IS_NUMBER(val)) {
+    tuning.pageSize = ADDON_TO_INT32(val);
+  }
+
+  val = ADDON_GET(opts, "walAutocheckpoint");
+  if (ADDON_IS_NUMBER(val)) {
+    tuning.walAutocheckpoint = ADDON_TO_INT32(val);
+  }
+}
+
+} // namespace
+
 ADDON_METHOD(DatabaseWrap::New) {
   ADDON_ENV;
   if (!ADDON_IS_CONSTRUCT_CALL()) {
@@ -111,18 +432,48 @@ ADDON_METHOD(DatabaseWrap::New) {
 
   ADDON_UTF8(path, ADDON_ARG(0));
   bool readonly = false;
+  size_t cacheSize = DEFAULT_STATEMENT_CACHE_SIZE;
+  size_t asyncReaders = DEFAULT_ASYNC_READERS;
+  bool hasOptions = ADDON_ARG_COUNT() >= 2 && ADDON_IS_OBJECT(ADDON_ARG(1));
 
-  if (ADDON_ARG_COUNT() >= 2 && ADDON_IS_OBJECT(ADDON_ARG(1))) {
+  if (hasOptions) {
     ADDON_OBJECT_TYPE opts = ADDON_AS_OBJECT(ADDON_ARG(1));
     ADDON_VALUE roVal = ADDON_GET(opts, "readonly");
     if (ADDON_IS_BOOLEAN(roVal)) {
       readonly = ADDON_BOOL_VALUE(roVal);
     }
+    ADDON_VALUE cacheVal = ADDON_GET(opts, "statementCacheSize");
+    if (ADDON_IS_NUMBER(cacheVal)) {
+      cacheSize = ADDON_TO_UINT32(cacheVal);
+    }
+    ADDON_VALUE readersVal = ADDON_GET(opts, "asyncReaders");
+    if (ADDON_IS_NUMBER(readersVal)) {
+      asyncReaders = ADDON_TO_UINT32(readersVal);
+    }
   }
 
   try {
+    DatabaseTuning tuning;
+    if (hasOptions) {
+      readTuning(ADDON_AS_OBJECT(ADDON_ARG(1)), tuning);
+    }
+
+    Database* db = new Database(ADDON_UTF8_VALUE(path), readonly, cacheSize);
+    try {
+      db->configure(tuning);
+    } catch (...) {
+      delete db;
+      throw;
+    }
+
     DatabaseWrap* wrap = new DatabaseWrap();
-    wrap->db_ = new Database(ADDON_UTF8_VALUE(path), readonly);
+    wrap->db_ = db;
+
+    // Other connections cannot see an in-memory database
+    std::string file = ADDON_UTF8_VALUE(path);
+    if (!file.empty() && file != ":memory:") {
+      wrap->async_ = std::make_shared<AsyncContext>(file, readonly, asyncReaders, tuning);
+    }
     wrap->Wrap(ADDON_THIS());
     ADDON_RETURN(ADDON_THIS());
   } catch (const std::exception& e) {
@@ -174,7 +525,7 @@ ADDON_METHOD(DatabaseWrap::Prepare) {
 
   try {
     Statement* stmt = new Statement(wrap->db_, ADDON_UTF8_VALUE(sql));
-    ADDON_OBJECT_TYPE stmtObj = StatementWrap::Create(stmt);
+    ADDON_OBJECT_TYPE stmtObj = StatementWrap::Create(stmt, wrap->async_);
     ADDON_RETURN(stmtObj);
   } catch (const std::exception& e) {
     ADDON_THROW_ERROR(e.what());
@@ -182,283 +533,2839 @@ ADDON_METHOD(DatabaseWrap::Prepare) {
   ADDON_VOID_RETURN();
 }
 
-ADDON_METHOD(DatabaseWrap::Close) {
+ADDON_METHOD(DatabaseWrap::Query) {
   ADDON_ENV;
   DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
 
-  if (wrap->db_) {
-    wrap->db_->close();
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
   }
-  ADDON_VOID_RETURN();
-}
-
-ADDON_GETTER(DatabaseWrap::GetOpen) {
-  ADDON_ENV;
-  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
-  bool isOpen = wrap->db_ && wrap->db_->isOpen();
-  ADDON_RETURN(ADDON_BOOLEAN(isOpen));
-}
 
-ADDON_GETTER(DatabaseWrap::GetPath) {
-  ADDON_ENV;
-  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
-  if (wrap->db_) {
-    ADDON_RETURN(ADDON_STRING(wrap->db_->path().c_str()));
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_STRING(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("SQL must be a string");
+    ADDON_VOID_RETURN();
   }
-  ADDON_RETURN_NULL();
-}
-
-ADDON_GETTER(DatabaseWrap::GetInTransaction) {
-  ADDON_ENV;
-  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
-  bool inTx = wrap->db_ && wrap->db_->inTransaction();
-  ADDON_RETURN(ADDON_BOOLEAN(inTx));
-}
-
-// ============================================
-// Statement Implementation
-// ============================================
-
-void StatementWrap::Init(ADDON_INIT_PARAMS) {
-  ADDON_HANDLE_SCOPE();
-
-  auto tpl = ADDON_NEW_CTOR_TEMPLATE();
-  ADDON_SET_CLASS_NAME(tpl, "Statement");
-  ADDON_SET_INTERNAL_FIELD_COUNT(tpl, 1);
-
-  ADDON_SET_PROTOTYPE_METHOD(tpl, "run", Run);
-  ADDON_SET_PROTOTYPE_METHOD(tpl, "get", Get);
-  ADDON_SET_PROTOTYPE_METHOD(tpl, "all", All);
-  ADDON_SET_PROTOTYPE_METHOD(tpl, "reset", Reset);
-  ADDON_SET_PROTOTYPE_METHOD(tpl, "finalize", Finalize);
-
-  ADDON_SET_ACCESSOR(tpl, "source", GetSource);
-  ADDON_SET_ACCESSOR(tpl, "reader", GetReader);
-
-  ADDON_PERSISTENT_RESET(constructorTemplate, tpl);
-  ADDON_PERSISTENT_RESET(constructor, ADDON_GET_CTOR_FUNCTION(tpl));
-}
-
-ADDON_OBJECT_TYPE StatementWrap::Create(Statement* stmt) {
-  ADDON_ESCAPABLE_SCOPE();
 
-  auto cons = ADDON_PERSISTENT_GET(constructor);
-  ADDON_OBJECT_TYPE instance = ADDON_NEW_INSTANCE(cons);
+  ADDON_UTF8(sql, ADDON_ARG(0));
 
-  StatementWrap* wrap = new StatementWrap();
-  wrap->stmt_ = stmt;
-  wrap->Wrap(instance);
+  try {
+    // Borrows the cached statement for this SQL; it goes back to the
+    // cache when stmt leaves scope
+    Statement stmt(wrap->db_, ADDON_UTF8_VALUE(sql));
 
-  return ADDON_ESCAPE(instance);
-}
+    StatementWrap::bindQueryArguments(&stmt, ADDON_ARG_COUNT() - 1,
+                                      [&](int i) { return ADDON_ARG(i + 1); },
+                                      [&](int index, ADDON_VALUE val) { StatementWrap::bindValue(&stmt, index, val); });
 
-void StatementWrap::bindValue(Statement* stmt, int index, ADDON_VALUE val) {
-  if (ADDON_IS_NULL(val) || ADDON_IS_UNDEFINED(val)) {
-    stmt->bindNull(index);
-  }
-  else if (ADDON_IS_BOOLEAN(val)) {
-    stmt->bindInt(index, ADDON_BOOL_VALUE(val) ? 1 : 0);
-  }
-  else if (ADDON_IS_INT32(val)) {
-    stmt->bindInt(index, ADDON_TO_INT32(val));
-  }
-  else if (ADDON_IS_NUMBER(val)) {
-    double num = ADDON_TO_DOUBLE(val);
-    // Check if it's an integer that fits in int64
-    if (num == static_cast<double>(static_cast<int64_t>(num))) {
-      stmt->bindInt64(index, static_cast<int64_t>(num));
-    } else {
-      stmt->bindDouble(index, num);
+    if (!stmt.isReader()) {
+      stmt.step();
+      ADDON_RETURN(StatementWrap::runResult(stmt.changes(), stmt.lastInsertRowid()));
     }
-  }
-  else if (ADDON_IS_STRING(val)) {
-    ADDON_UTF8(str, val);
-    stmt->bindText(index, ADDON_UTF8_VALUE(str));
-  }
-  else if (ADDON_BUFFER_IS(val)) {
-    ADDON_OBJECT_TYPE buf = ADDON_AS_OBJECT(val);
-    stmt->bindBlob(index, ADDON_BUFFER_DATA(buf), ADDON_BUFFER_LENGTH(buf));
-  }
-  else {
-    stmt->bindNull(index);
-  }
-}
-
-ADDON_OBJECT_TYPE StatementWrap::rowToObject(Statement* stmt) {
-  ADDON_ESCAPABLE_SCOPE();
-
-  ADDON_OBJECT_TYPE row = ADDON_OBJECT();
-  int colCount = stmt->columnCount();
-
-  for (int i = 0; i < colCount; i++) {
-    std::string name = stmt->columnName(i);
-    int type = stmt->columnType(i);
-    ADDON_VALUE value;
-
-    switch (type) {
-      case SQLITE_INTEGER:
-        value = ADDON_NUMBER(stmt->getInt64(i));
-        break;
-
-      case SQLITE_FLOAT:
-        value = ADDON_NUMBER(stmt->getDouble(i));
-        break;
 
-      case SQLITE_TEXT:
-        value = ADDON_STRING(stmt->getText(i).c_str());
-        break;
+    ADDON_ARRAY_TYPE rows = ADDON_ARRAY_EMPTY();
+    uint32_t index = 0;
+    std::vector<ADDON_VALUE> keys;
 
-      case SQLITE_BLOB: {
-        int size;
-        const void* data = stmt->getBlob(i, &size);
-        value = ADDON_COPY_BUFFER(static_cast<const char*>(data), size);
-        break;
+    while (stmt.step()) {
+      // After the first step: a schema change re-prepares in step()
+      if (index == 0) {
+        StatementWrap::columnKeys(&stmt, keys);
       }
-
-      case SQLITE_NULL:
-      default:
-        value = ADDON_NULL();
-        break;
+      ADDON_SET_INDEX(rows, index++, StatementWrap::rowToObject(&stmt, keys));
     }
 
-    ADDON_SET(row, name.c_str(), value);
+    ADDON_RETURN(rows);
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
   }
-
-  return ADDON_ESCAPE(row);
+  ADDON_VOID_RETURN();
 }
 
-ADDON_METHOD(StatementWrap::Run) {
+// begin(mode): mode is 'deferred' (default), 'immediate' or 'exclusive';
+// inside an open transaction it makes a savepoint instead
+ADDON_METHOD(DatabaseWrap::Begin) {
   ADDON_ENV;
-  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
 
-  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
-    ADDON_THROW_ERROR("Statement has been finalized");
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
     ADDON_VOID_RETURN();
   }
 
-  try {
-    wrap->stmt_->reset();
-    wrap->stmt_->clearBindings();
-
-    // Bind parameters
-    for (int i = 0; i < ADDON_ARG_COUNT(); i++) {
-      bindValue(wrap->stmt_, i + 1, ADDON_ARG(i));
+  TransactionMode mode = TRANSACTION_DEFERRED;
+  if (ADDON_ARG_COUNT() >= 1 && ADDON_IS_STRING(ADDON_ARG(0))) {
+    ADDON_UTF8(modeName, ADDON_ARG(0));
+    std::string name = ADDON_UTF8_VALUE(modeName);
+    if (name == "immediate") {
+      mode = TRANSACTION_IMMEDIATE;
+    } else if (name == "exclusive") {
+      mode = TRANSACTION_EXCLUSIVE;
+    } else if (name != "deferred") {
+      ADDON_THROW_TYPE_ERROR("Transaction mode must be 'deferred', 'immediate' or 'exclusive'");
+      ADDON_VOID_RETURN();
     }
+  }
 
-    // Execute
-    wrap->stmt_->step();
-
-    // Return result object
-    ADDON_OBJECT_TYPE result = ADDON_OBJECT();
-    ADDON_SET(result, "changes", ADDON_INTEGER(wrap->stmt_->changes()));
-    ADDON_SET(result, "lastInsertRowid",
-              ADDON_NUMBER(wrap->stmt_->lastInsertRowid()));
-
-    ADDON_RETURN(result);
+  try {
+    wrap->db_->begin(mode);
   } catch (const std::exception& e) {
     ADDON_THROW_ERROR(e.what());
   }
   ADDON_VOID_RETURN();
 }
 
-ADDON_METHOD(StatementWrap::Get) {
+ADDON_METHOD(DatabaseWrap::Commit) {
   ADDON_ENV;
-  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
 
-  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
-    ADDON_THROW_ERROR("Statement has been finalized");
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
     ADDON_VOID_RETURN();
   }
 
   try {
-    wrap->stmt_->reset();
-    wrap->stmt_->clearBindings();
-
-    // Bind parameters
-    for (int i = 0; i < ADDON_ARG_COUNT(); i++) {
-      bindValue(wrap->stmt_, i + 1, ADDON_ARG(i));
-    }
-
-    // Get first row
-    if (wrap->stmt_->step()) {
-      ADDON_RETURN(rowToObject(wrap->stmt_));
-    }
-    ADDON_RETURN_UNDEFINED();
+    wrap->db_->commit();
   } catch (const std::exception& e) {
     ADDON_THROW_ERROR(e.what());
   }
   ADDON_VOID_RETURN();
 }
 
-ADDON_METHOD(StatementWrap::All) {
+ADDON_METHOD(DatabaseWrap::Rollback) {
   ADDON_ENV;
-  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
 
-  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
-    ADDON_THROW_ERROR("Statement has been finalized");
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
     ADDON_VOID_RETURN();
   }
 
   try {
-    wrap->stmt_->reset();
-    wrap->stmt_->clearBindings();
+    wrap->db_->rollback();
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
 
-    // Bind parameters
-    for (int i = 0; i < ADDON_ARG_COUNT(); i++) {
-      bindValue(wrap->stmt_, i + 1, ADDON_ARG(i));
-    }
+// checkpoint(mode): mode is 'passive' (default), 'full', 'restart' or
+// 'truncate'; returns { logFrames, checkpointedFrames }
+ADDON_METHOD(DatabaseWrap::Checkpoint) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+  static const char* const modeNames[] = { "passive", "full", "restart", "truncate", NULL };
 
-    // Get all rows
-    ADDON_ARRAY_TYPE rows = ADDON_ARRAY_EMPTY();
-    uint32_t index = 0;
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
 
-    while (wrap->stmt_->step()) {
-      ADDON_SET_INDEX(rows, index++, rowToObject(wrap->stmt_));
+  int mode = SQLITE_CHECKPOINT_PASSIVE;
+  if (ADDON_ARG_COUNT() >= 1 && ADDON_IS_STRING(ADDON_ARG(0))) {
+    ADDON_UTF8(modeName, ADDON_ARG(0));
+    int index = nameIndex(modeNames, ADDON_UTF8_VALUE(modeName));
+    if (index < 0) {
+      ADDON_THROW_TYPE_ERROR("Checkpoint mode must be 'passive', 'full', 'restart' or 'truncate'");
+      ADDON_VOID_RETURN();
     }
+    // SQLITE_CHECKPOINT_PASSIVE .. _TRUNCATE are 0 .. 3
+    mode = index;
+  }
 
-    ADDON_RETURN(rows);
+  try {
+    CheckpointResult result = wrap->db_->checkpoint(mode);
+
+    ADDON_OBJECT_TYPE object = ADDON_OBJECT();
+    ADDON_SET(object, "logFrames", ADDON_INTEGER(result.logFrames));
+    ADDON_SET(object, "checkpointedFrames", ADDON_INTEGER(result.checkpointedFrames));
+    ADDON_RETURN(object);
   } catch (const std::exception& e) {
     ADDON_THROW_ERROR(e.what());
   }
   ADDON_VOID_RETURN();
 }
 
-ADDON_METHOD(StatementWrap::Reset) {
+// walAutocheckpoint(pages)
+ADDON_METHOD(DatabaseWrap::WalAutocheckpoint) {
   ADDON_ENV;
-  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
 
-  if (wrap->stmt_ && wrap->stmt_->isValid()) {
-    wrap->stmt_->reset();
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_NUMBER(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("Expected a page count");
+    ADDON_VOID_RETURN();
+  }
+
+  try {
+    wrap->db_->setWalAutocheckpoint(ADDON_TO_INT32(ADDON_ARG(0)));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
   }
   ADDON_VOID_RETURN();
 }
 
-ADDON_METHOD(StatementWrap::Finalize) {
+ADDON_METHOD(DatabaseWrap::SetCacheSize) {
   ADDON_ENV;
-  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
 
-  if (wrap->stmt_) {
-    wrap->stmt_->finalize();
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_NUMBER(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("Cache size must be a number");
+    ADDON_VOID_RETURN();
+  }
+
+  if (wrap->db_) {
+    wrap->db_->setCacheSize(ADDON_TO_UINT32(ADDON_ARG(0)));
   }
   ADDON_VOID_RETURN();
 }
 
-ADDON_GETTER(StatementWrap::GetSource) {
+ADDON_METHOD(DatabaseWrap::CacheStats) {
   ADDON_ENV;
-  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
 
-  if (wrap->stmt_) {
-    ADDON_RETURN(ADDON_STRING(wrap->stmt_->source().c_str()));
+  ADDON_OBJECT_TYPE stats = ADDON_OBJECT();
+  Database* db = wrap->db_;
+  ADDON_SET(stats, "size", ADDON_NUMBER(db ? db->cachedStatements() : 0));
+  ADDON_SET(stats, "capacity", ADDON_NUMBER(db ? db->cacheSize() : 0));
+  ADDON_SET(stats, "hits", ADDON_NUMBER(db ? db->cacheHits() : 0));
+  ADDON_SET(stats, "misses", ADDON_NUMBER(db ? db->cacheMisses() : 0));
+  ADDON_RETURN(stats);
+}
+
+// setStatementTiming(enabled)
+ADDON_METHOD(DatabaseWrap::SetStatementTiming) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (wrap->db_) {
+    wrap->db_->setStatementTiming(ADDON_ARG_COUNT() >= 1 && ADDON_TO_BOOL(ADDON_ARG(0)));
+  }
+  ADDON_VOID_RETURN();
+}
+
+// setProfiling(enabled)
+ADDON_METHOD(DatabaseWrap::SetProfiling) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+
+  try {
+    wrap->db_->setProfiling(ADDON_ARG_COUNT() >= 1 && ADDON_TO_BOOL(ADDON_ARG(0)));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+// takeProfile(): { entries: [{ sql, time }], dropped }
+ADDON_METHOD(DatabaseWrap::TakeProfile) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  std::vector<ProfileEntry> entries;
+  size_t dropped = wrap->db_ ? wrap->db_->takeProfile(entries) : 0;
+
+  ADDON_ARRAY_TYPE list = ADDON_ARRAY(entries.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    ADDON_OBJECT_TYPE entry = ADDON_OBJECT();
+    ADDON_SET(entry, "sql", ADDON_STRING_LEN(entries[i].sql.data(), entries[i].sql.length()));
+    ADDON_SET(entry, "time", ADDON_NUMBER(entries[i].time));
+    ADDON_SET_INDEX(list, i, entry);
+  }
+
+  ADDON_OBJECT_TYPE result = ADDON_OBJECT();
+  ADDON_SET(result, "entries", list);
+  ADDON_SET(result, "dropped", ADDON_NUMBER(static_cast<double>(dropped)));
+  ADDON_RETURN(result);
+}
+
+// setQueryTimeout(ms)
+ADDON_METHOD(DatabaseWrap::SetQueryTimeout) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_NUMBER(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("Timeout must be a number");
+    ADDON_VOID_RETURN();
+  }
+
+  try {
+    wrap->db_->setQueryTimeout(ADDON_TO_INT32(ADDON_ARG(0)));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(DatabaseWrap::Close) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  // The statement calling the function is still stepping
+  if (wrap->callbackDepth_ > 0) {
+    ADDON_THROW_ERROR("Cannot close the database from inside a user-defined function");
+    ADDON_VOID_RETURN();
+  }
+
+  if (wrap->db_) {
+    wrap->db_->close();
+  }
+  // Queued async work fails from here on; waits for a running write
+  if (wrap->async_) {
+    wrap->async_->pool.close();
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_GETTER(DatabaseWrap::GetOpen) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+  bool isOpen = wrap->db_ && wrap->db_->isOpen();
+  ADDON_RETURN(ADDON_BOOLEAN(isOpen));
+}
+
+ADDON_GETTER(DatabaseWrap::GetPath) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+  if (wrap->db_) {
+    ADDON_RETURN(ADDON_STRING(wrap->db_->path().c_str()));
   }
   ADDON_RETURN_NULL();
 }
 
-ADDON_GETTER(StatementWrap::GetReader) {
+ADDON_GETTER(DatabaseWrap::GetInTransaction) {
   ADDON_ENV;
-  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+  bool inTx = wrap->db_ && wrap->db_->inTransaction();
+  ADDON_RETURN(ADDON_BOOLEAN(inTx));
+}
 
-  bool isReader = wrap->stmt_ && wrap->stmt_->isReader();
-  ADDON_RETURN(ADDON_BOOLEAN(isReader));
+// ============================================
+// Statement Implementation
+// ============================================
+
+void StatementWrap::Init(ADDON_INIT_PARAMS) {
+  ADDON_HANDLE_SCOPE();
+
+  auto tpl = ADDON_NEW_CTOR_TEMPLATE();
+  ADDON_SET_CLASS_NAME(tpl, "Statement");
+  ADDON_SET_INTERNAL_FIELD_COUNT(tpl, 1);
+
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "run", Run);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "runBatch", RunBatch);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "runColumns", RunColumns);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "get", Get);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "all", All);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "reset", Reset);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "finalize", Finalize);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "raw", Raw);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "columnar", Columnar);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "async", Async);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "iterate", Iterate);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "iterateNext", IterateNext);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "iterateEnd", IterateEnd);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "stats", Stats);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "explain", Explain);
+
+  ADDON_SET_ACCESSOR(tpl, "source", GetSource);
+  ADDON_SET_ACCESSOR(tpl, "reader", GetReader);
+
+  ADDON_PERSISTENT_RESET(constructorTemplate, tpl);
+  ADDON_PERSISTENT_RESET(constructor, ADDON_GET_CTOR_FUNCTION(tpl));
+}
+
+ADDON_OBJECT_TYPE StatementWrap::Create(Statement* stmt, const AsyncContextPtr& async) {
+  ADDON_ESCAPABLE_SCOPE();
+
+  auto cons = ADDON_PERSISTENT_GET(constructor);
+  ADDON_OBJECT_TYPE instance = ADDON_NEW_INSTANCE(cons);
+
+  StatementWrap* wrap = new StatementWrap();
+  wrap->stmt_ = stmt;
+  wrap->async_ = async;
+  wrap->Wrap(instance);
+
+  return ADDON_ESCAPE(instance);
+}
+
+// A JS number that is a whole int64 value. The range check comes first:
+// casting NaN, an infinity or anything outside [-2^63, 2^63) to int64_t
+// is undefined behaviour.
+static bool isInt64(double num) {
+  return std::isfinite(num) && num >= -9223372036854775808.0 && num < 9223372036854775808.0 &&
+         num == static_cast<double>(static_cast<int64_t>(num));
+}
+
+void StatementWrap::bindValue(Statement* stmt, int index, ADDON_VALUE val) {
+  if (ADDON_IS_NULL(val) || ADDON_IS_UNDEFINED(val)) {
+    stmt->bindNull(index);
+  }
+  else if (ADDON_IS_BOOLEAN(val)) {
+    stmt->bindInt(index, ADDON_BOOL_VALUE(val) ? 1 : 0);
+  }
+  else if (ADDON_IS_INT32(val)) {
+    stmt->bindInt(index, ADDON_TO_INT32(val));
+  }
+  else if (ADDON_IS_NUMBER(val)) {
+    double num = ADDON_TO_DOUBLE(val);
+    if (isInt64(num)) {
+      stmt->bindInt64(index, static_cast<int64_t>(num));
+    } else {
+      stmt->bindDouble(index, num);
+    }
+  }
+  else if (ADDON_IS_STRING(val)) {
+    ADDON_UTF8(str, val);
+    stmt->bindText(index, ADDON_UTF8_VALUE(str));
+  }
+  else if (ADDON_BUFFER_IS(val)) {
+    ADDON_OBJECT_TYPE buf = ADDON_AS_OBJECT(val);
+    stmt->bindBlob(index, ADDON_BUFFER_DATA(buf), ADDON_BUFFER_LENGTH(buf));
+  }
+  else {
+    stmt->bindNull(index);
+  }
+}
+
+void StatementWrap::columnKeys(Statement* stmt, std::vector<ADDON_VALUE>& keys) {
+  const std::vector<ColumnInfo>& columns = stmt->columns();
+
+  keys.clear();
+  for (size_t i = 0; i < columns.size(); i++) {
+    keys.push_back(ADDON_KEY_LEN(columns[i].name.data(), columns[i].name.length()));
+  }
+}
+
+void StatementWrap::cachedKeys(std::vector<ADDON_VALUE>& keys) {
+  size_t count = stmt_->columns().size();
+
+  if (!ADDON_PERSISTENT_IS_EMPTY(keys_) && keysVersion_ == stmt_->columnsVersion()) {
+    ADDON_ARRAY_TYPE cached = ADDON_PERSISTENT_GET(keys_);
+    keys.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      keys[i] = ADDON_GET_INDEX(cached, i);
+    }
+    return;
+  }
+
+  columnKeys(stmt_, keys);
+
+  ADDON_ARRAY_TYPE cached = ADDON_ARRAY(count);
+  for (size_t i = 0; i < count; i++) {
+    ADDON_SET_INDEX(cached, i, keys[i]);
+  }
+  ADDON_PERSISTENT_RESET(keys_, cached);
+  keysVersion_ = stmt_->columnsVersion();
+}
+
+void StatementWrap::parameterSlots(Statement* stmt, std::vector<int>& named, std::vector<std::string>& names,
+                                   std::vector<int>& unnamed) {
+  int count = stmt->parameterCount();
+  for (int i = 1; i <= count; i++) {
+    std::string name = stmt->parameterName(i);
+    if (name.empty()) {
+      unnamed.push_back(i);
+    } else {
+      named.push_back(i);
+      names.push_back(name);
+    }
+  }
+}
+
+void StatementWrap::resolveParams() {
+  if (paramsResolved_) {
+    return;
+  }
+
+  std::vector<std::string> names;
+  parameterSlots(stmt_, namedParams_, names, unnamedParams_);
+
+  ADDON_ARRAY_TYPE keys = ADDON_ARRAY(names.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    ADDON_SET_INDEX(keys, i, ADDON_KEY_LEN(names[i].data(), names[i].length()));
+  }
+  ADDON_PERSISTENT_RESET(paramKeys_, keys);
+  paramsResolved_ = true;
+}
+
+// Objects other than arrays and Buffers carry named parameters
+static bool isParameterObject(ADDON_VALUE val) {
+  return ADDON_IS_OBJECT(val) && !ADDON_IS_ARRAY(val) && !ADDON_BUFFER_IS(val);
+}
+
+template <typename Value>
+int StatementWrap::parameterObject(int count, Value value) {
+  int object = -1;
+  for (int i = 0; i < count; i++) {
+    if (isParameterObject(value(i))) {
+      if (object >= 0) {
+        throw std::runtime_error("Only one object of named parameters can be given");
+      }
+      object = i;
+    }
+  }
+  return object;
+}
+
+template <typename Value, typename NamedValue, typename Bind, typename None>
+void StatementWrap::bindAroundObject(int count, int object, Value value, const std::vector<int>& named,
+                                     NamedValue namedValue, const std::vector<int>& unnamed, Bind bind,
+                                     None none) {
+  for (size_t i = 0; i < named.size(); i++) {
+    bind(named[i], namedValue(i));
+  }
+
+  size_t next = 0;
+  for (int i = 0; i < count; i++) {
+    if (i == object) {
+      continue;
+    }
+    if (next == unnamed.size()) {
+      throw std::runtime_error("Too many parameter values");
+    }
+    bind(unnamed[next++], value(i));
+  }
+  for (; next < unnamed.size(); next++) {
+    bind(unnamed[next], none);
+  }
+}
+
+template <typename Value, typename Bind>
+void StatementWrap::bindArguments(int count, Value value, Bind bind) {
+  int object = parameterObject(count, value);
+  if (object < 0) {
+    for (int i = 0; i < count; i++) {
+      bind(i + 1, value(i));
+    }
+    return;
+  }
+
+  resolveParams();
+
+  // Named parameters come from the object by their cached keys; missing
+  // properties and unnamed parameters left over bind NULL
+  ADDON_VALUE objectValue = value(object);
+  ADDON_OBJECT_TYPE params = ADDON_AS_OBJECT(objectValue);
+  ADDON_ARRAY_TYPE keys = ADDON_PERSISTENT_GET(paramKeys_);
+  bindAroundObject(count, object, value, namedParams_,
+                   [&](size_t i) { return ADDON_GET_KEY(params, ADDON_GET_INDEX(keys, i)); },
+                   unnamedParams_, bind, ADDON_UNDEFINED());
+}
+
+template <typename Value, typename Bind>
+void StatementWrap::bindQueryArguments(Statement* stmt, int count, Value value, Bind bind) {
+  int object = parameterObject(count, value);
+  if (object < 0) {
+    for (int i = 0; i < count; i++) {
+      bind(i + 1, value(i));
+    }
+    return;
+  }
+
+  std::vector<int> named;
+  std::vector<int> unnamed;
+  std::vector<std::string> names;
+  parameterSlots(stmt, named, names, unnamed);
+
+  ADDON_VALUE objectValue = value(object);
+  ADDON_OBJECT_TYPE params = ADDON_AS_OBJECT(objectValue);
+  bindAroundObject(count, object, value, named,
+                   [&](size_t i) { return ADDON_GET(params, names[i]); },
+                   unnamed, bind, ADDON_UNDEFINED());
+}
+
+ADDON_VALUE StatementWrap::cellValue(Statement* stmt, int index) {
+  switch (stmt->columnType(index)) {
+    case SQLITE_INTEGER:
+      return ADDON_NUMBER(stmt->getInt64(index));
+
+    case SQLITE_FLOAT:
+      return ADDON_NUMBER(stmt->getDouble(index));
+
+    case SQLITE_TEXT: {
+      int size;
+      const char* text = stmt->getTextData(index, &size);
+      return ADDON_STRING_LEN(text, size);
+    }
+
+    case SQLITE_BLOB: {
+      int size;
+      const void* data = stmt->getBlob(index, &size);
+      return ADDON_COPY_BUFFER(static_cast<const char*>(data), size);
+    }
+
+    case SQLITE_NULL:
+    default:
+      return ADDON_NULL();
+  }
+}
+
+ADDON_OBJECT_TYPE StatementWrap::rowToObject(Statement* stmt, const std::vector<ADDON_VALUE>& keys) {
+  ADDON_ESCAPABLE_SCOPE();
+
+  ADDON_OBJECT_TYPE row = ADDON_OBJECT();
+  int colCount = static_cast<int>(keys.size());
+
+  for (int i = 0; i < colCount; i++) {
+    ADDON_SET_KEY(row, keys[i], cellValue(stmt, i));
+  }
+
+  return ADDON_ESCAPE(row);
+}
+
+ADDON_ARRAY_TYPE StatementWrap::rowToArray(Statement* stmt, int columnCount) {
+  ADDON_ESCAPABLE_SCOPE();
+
+  ADDON_ARRAY_TYPE row = ADDON_ARRAY(columnCount);
+  for (int i = 0; i < columnCount; i++) {
+    ADDON_SET_INDEX(row, i, cellValue(stmt, i));
+  }
+
+  return ADDON_ESCAPE(row);
+}
+
+// JS value of one cell of a gathered result. Large BLOBs become external
+// Buffers over their block.
+static ADDON_VALUE resultCell(ResultColumn& column, size_t row) {
+  switch (column.classes[row]) {
+    case SQLITE_INTEGER:
+    case SQLITE_FLOAT:
+      return ADDON_NUMBER(column.numbers[row]);
+
+    case SQLITE_TEXT:
+      return ADDON_STRING_LEN(column.data(row), column.size(row));
+
+    case SQLITE_BLOB: {
+      size_t size;
+      char* block = column.takeBlock(row, &size);
+      if (block) {
+        return ADDON_NEW_BUFFER(block, size);
+      }
+      return ADDON_COPY_BUFFER(column.data(row), column.size(row));
+    }
+
+    default:
+      return ADDON_NULL();
+  }
+}
+
+// Column names of a gathered result as JS property keys
+static void resultKeys(const ResultSet& result, std::vector<ADDON_VALUE>& keys) {
+  const std::vector<ResultColumn>& columns = result.columns();
+
+  keys.clear();
+  for (size_t i = 0; i < columns.size(); i++) {
+    keys.push_back(ADDON_KEY_LEN(columns[i].name.data(), columns[i].name.length()));
+  }
+}
+
+// One row of a gathered result: an object with keys, else an array
+static ADDON_VALUE resultRow(ResultSet& result, size_t row, const std::vector<ADDON_VALUE>* keys) {
+  ADDON_ESCAPABLE_SCOPE();
+  std::vector<ResultColumn>& columns = result.columns();
+
+  if (keys) {
+    ADDON_OBJECT_TYPE object = ADDON_OBJECT();
+    for (size_t i = 0; i < columns.size(); i++) {
+      ADDON_SET_KEY(object, (*keys)[i], resultCell(columns[i], row));
+    }
+    return ADDON_ESCAPE(object);
+  }
+
+  ADDON_ARRAY_TYPE array = ADDON_ARRAY(columns.size());
+  for (size_t i = 0; i < columns.size(); i++) {
+    ADDON_SET_INDEX(array, i, resultCell(columns[i], row));
+  }
+  return ADDON_ESCAPE(array);
+}
+
+// Every row of a gathered result, as objects or (raw) arrays
+static ADDON_ARRAY_TYPE resultToRows(ResultSet& result, bool raw) {
+  std::vector<ADDON_VALUE> keys;
+  if (!raw) {
+    resultKeys(result, keys);
+  }
+
+  ADDON_ARRAY_TYPE rows = ADDON_ARRAY(result.rowCount());
+  for (size_t row = 0; row < result.rowCount(); row++) {
+    ADDON_SET_INDEX(rows, row, resultRow(result, row, raw ? NULL : &keys));
+  }
+  return rows;
+}
+
+// { rowCount, columns: [{ name, type, values, nulls }] }. Columns holding
+// only numbers are 'integer' or 'real' with values in a Float64Array
+// (NaN for NULL), as are columns holding only NULLs ('null'); only BLOBs
+// are 'blob', an Array of Buffers; anything else is 'text', an Array of
+// strings (numbers and Buffers left as they are in a mixed column). nulls
+// is a Uint8Array bitmap, bit (row & 7) of byte (row >> 3) set for NULL.
+static ADDON_OBJECT_TYPE resultToColumns(ResultSet& result) {
+  std::vector<ResultColumn>& columns = result.columns();
+  size_t rowCount = result.rowCount();
+  ADDON_ARRAY_TYPE jsColumns = ADDON_ARRAY(columns.size());
+
+  for (size_t i = 0; i < columns.size(); i++) {
+    ResultColumn& column = columns[i];
+
+    std::vector<uint8_t> nulls((rowCount + 7) / 8, 0);
+    for (size_t row = 0; row < rowCount; row++) {
+      if (column.classes[row] == SQLITE_NULL) {
+        nulls[row >> 3] |= static_cast<uint8_t>(1 << (row & 7));
+      }
+    }
+
+    ADDON_OBJECT_TYPE jsColumn = ADDON_OBJECT();
+    ADDON_SET(jsColumn, "name", ADDON_STRING_LEN(column.name.data(), column.name.length()));
+
+    if (!column.sawText && !column.sawBlob) {
+      const char* type = column.sawFloat ? "real" : column.sawInteger ? "integer" : "null";
+      ADDON_SET(jsColumn, "type", ADDON_STRING(type));
+      ADDON_SET(jsColumn, "values", ADDON_FLOAT64_ARRAY(column.numbers.data(), rowCount));
+    } else {
+      bool blobs = column.sawBlob && !column.sawText && !column.sawInteger && !column.sawFloat;
+      ADDON_SET(jsColumn, "type", ADDON_STRING(blobs ? "blob" : "text"));
+
+      ADDON_ARRAY_TYPE values = ADDON_ARRAY(rowCount);
+      for (size_t row = 0; row < rowCount; row++) {
+        ADDON_HANDLE_SCOPE();
+        ADDON_SET_INDEX(values, row, resultCell(column, row));
+      }
+      ADDON_SET(jsColumn, "values", values);
+    }
+
+    ADDON_SET(jsColumn, "nulls", ADDON_UINT8_ARRAY(nulls.data(), nulls.size()));
+    ADDON_SET_INDEX(jsColumns, i, jsColumn);
+  }
+
+  ADDON_OBJECT_TYPE object = ADDON_OBJECT();
+  ADDON_SET(object, "rowCount", ADDON_NUMBER(rowCount));
+  ADDON_SET(object, "columns", jsColumns);
+  return object;
+}
+
+ADDON_OBJECT_TYPE StatementWrap::runResult(int changes, int64_t lastInsertRowid) {
+  ADDON_ESCAPABLE_SCOPE();
+
+  ADDON_OBJECT_TYPE result = ADDON_OBJECT();
+  ADDON_SET(result, "changes", ADDON_INTEGER(changes));
+  ADDON_SET(result, "lastInsertRowid", ADDON_NUMBER(lastInsertRowid));
+
+  return ADDON_ESCAPE(result);
+}
+
+ADDON_METHOD(StatementWrap::Run) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
+    ADDON_THROW_ERROR("Statement has been finalized");
+    ADDON_VOID_RETURN();
+  }
+
+  try {
+    wrap->iterating_ = false;
+    wrap->stmt_->reset();
+    wrap->stmt_->clearBindings();
+
+    // Bind parameters
+    wrap->bindArguments(ADDON_ARG_COUNT(),
+                        [&](int i) { return ADDON_ARG(i); },
+                        [&](int index, ADDON_VALUE val) { bindValue(wrap->stmt_, index, val); });
+
+    // Execute
+    wrap->stmt_->step();
+
+    ADDON_RETURN(runResult(wrap->stmt_->changes(), wrap->stmt_->lastInsertRowid()));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+namespace {
+
+// Wraps a bulk call in Database::begin()/commit() (a savepoint when a
+// transaction is already open). Rolls back unless commit() is reached.
+class BatchTransaction {
+public:
+  explicit BatchTransaction(Database* db)
+    : db_(db)
+    , active_(false)
+  {
+    db_->begin();
+    active_ = true;
+  }
+
+  ~BatchTransaction() {
+    if (!active_) {
+      return;
+    }
+    try {
+      db_->rollback();
+    } catch (...) {
+    }
+  }
+
+  void commit() {
+    db_->commit();
+    active_ = false;
+  }
+
+private:
+  Database* db_;
+  bool active_;
+};
+
+// One runColumns() input: a typed array read in place, or a plain Array
+struct BatchColumn {
+  int param;
+  int type;           // ADDON_TYPEDARRAY_*, or -1 for a plain Array
+  const void* data;
+  ADDON_ARRAY_TYPE array;
+};
+
+void bindElement(Statement* stmt, const BatchColumn& column, size_t row) {
+  switch (column.type) {
+    case ADDON_TYPEDARRAY_INT8:
+      stmt->bindInt(column.param, static_cast<const int8_t*>(column.data)[row]);
+      break;
+    case ADDON_TYPEDARRAY_UINT8:
+    case ADDON_TYPEDARRAY_UINT8_CLAMPED:
+      stmt->bindInt(column.param, static_cast<const uint8_t*>(column.data)[row]);
+      break;
+    case ADDON_TYPEDARRAY_INT16:
+      stmt->bindInt(column.param, static_cast<const int16_t*>(column.data)[row]);
+      break;
+    case ADDON_TYPEDARRAY_UINT16:
+      stmt->bindInt(column.param, static_cast<const uint16_t*>(column.data)[row]);
+      break;
+    case ADDON_TYPEDARRAY_INT32:
+      stmt->bindInt(column.param, static_cast<const int32_t*>(column.data)[row]);
+      break;
+    case ADDON_TYPEDARRAY_UINT32:
+      stmt->bindInt64(column.param, static_cast<const uint32_t*>(column.data)[row]);
+      break;
+    case ADDON_TYPEDARRAY_FLOAT32:
+    case ADDON_TYPEDARRAY_FLOAT64: {
+      double value = column.type == ADDON_TYPEDARRAY_FLOAT32
+        ? static_cast<const float*>(column.data)[row]
+        : static_cast<const double*>(column.data)[row];
+      // NaN is NULL, as in columns() results
+      if (std::isnan(value)) {
+        stmt->bindNull(column.param);
+      } else {
+        stmt->bindDouble(column.param, value);
+      }
+      break;
+    }
+    default:
+      StatementWrap::bindValue(stmt, column.param, ADDON_GET_INDEX(column.array, static_cast<uint32_t>(row)));
+      break;
+  }
+}
+
+std::string rowError(size_t row, const char* message) {
+  return "Row " + std::to_string(static_cast<unsigned long long>(row)) + ": " + message;
+}
+
+} // namespace
+
+// runBatch(rows): run once per row inside one transaction. A row is an
+// array (positional parameters) or an object (named parameters).
+ADDON_METHOD(StatementWrap::RunBatch) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
+    ADDON_THROW_ERROR("Statement has been finalized");
+    ADDON_VOID_RETURN();
+  }
+  if (wrap->stmt_->isReader()) {
+    ADDON_THROW_TYPE_ERROR("runBatch() is only for statements that return no rows");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_ARRAY(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("Expected an array of rows");
+    ADDON_VOID_RETURN();
+  }
+
+  Statement* stmt = wrap->stmt_;
+  ADDON_ARRAY_TYPE rows = ADDON_AS_ARRAY(ADDON_ARG(0));
+  uint32_t rowCount = ADDON_LENGTH(rows);
+  uint32_t row = 0;
+  double changes = 0;
+
+  try {
+    wrap->iterating_ = false;
+    stmt->reset();
+    stmt->clearBindings();
+
+    int paramCount = stmt->parameterCount();
+
+    BatchTransaction transaction(stmt->database());
+
+    for (; row < rowCount; row++) {
+      ADDON_HANDLE_SCOPE();
+      ADDON_VALUE value = ADDON_GET_INDEX(rows, row);
+
+      if (ADDON_IS_ARRAY(value)) {
+        ADDON_ARRAY_TYPE values = ADDON_AS_ARRAY(value);
+        uint32_t count = ADDON_LENGTH(values);
+        if (count < static_cast<uint32_t>(paramCount)) {
+          stmt->clearBindings();
+        }
+        for (uint32_t i = 0; i < count; i++) {
+          bindValue(stmt, i + 1, ADDON_GET_INDEX(values, i));
+        }
+      }
+      else if (isParameterObject(value)) {
+        wrap->bindArguments(1,
+                            [&](int) { return value; },
+                            [&](int index, ADDON_VALUE val) { bindValue(stmt, index, val); });
+      }
+      else {
+        throw std::runtime_error("Expected an array or object");
+      }
+
+      stmt->step();
+      stmt->reset();
+      changes += stmt->changes();
+    }
+
+    transaction.commit();
+
+    ADDON_OBJECT_TYPE result = ADDON_OBJECT();
+    ADDON_SET(result, "rows", ADDON_NUMBER(rowCount));
+    ADDON_SET(result, "changes", ADDON_NUMBER(changes));
+    ADDON_SET(result, "lastInsertRowid", ADDON_NUMBER(stmt->lastInsertRowid()));
+    ADDON_RETURN(result);
+  } catch (const std::exception& e) {
+    stmt->reset();
+    if (row < rowCount) {
+      ADDON_THROW_ERROR(rowError(row, e.what()).c_str());
+    } else {
+      ADDON_THROW_ERROR(e.what());
+    }
+  }
+  ADDON_VOID_RETURN();
+}
+
+// runColumns(columns): run once per row inside one transaction, binding
+// row r from element r of each column. columns is an object keyed by
+// parameter name or an array in parameter order; typed arrays are read
+// in place, plain arrays go through bindValue().
+ADDON_METHOD(StatementWrap::RunColumns) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
+    ADDON_THROW_ERROR("Statement has been finalized");
+    ADDON_VOID_RETURN();
+  }
+  if (wrap->stmt_->isReader()) {
+    ADDON_THROW_TYPE_ERROR("runColumns() is only for statements that return no rows");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_OBJECT(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("Expected an object or array of columns");
+    ADDON_VOID_RETURN();
+  }
+
+  Statement* stmt = wrap->stmt_;
+  std::vector<BatchColumn> columns;
+  size_t rowCount = 0;
+  size_t row = 0;
+  double changes = 0;
+
+  try {
+    wrap->iterating_ = false;
+    stmt->reset();
+    stmt->clearBindings();
+
+    int paramCount = stmt->parameterCount();
+    bool positional = ADDON_IS_ARRAY(ADDON_ARG(0));
+    ADDON_OBJECT_TYPE input = ADDON_AS_OBJECT(ADDON_ARG(0));
+
+    for (int i = 0; i < paramCount; i++) {
+      std::string name = stmt->parameterName(i + 1);
+      ADDON_VALUE value;
+
+      if (positional) {
+        ADDON_ARRAY_TYPE list = ADDON_AS_ARRAY(ADDON_ARG(0));
+        if (static_cast<uint32_t>(i) >= ADDON_LENGTH(list)) {
+          break;
+        }
+        value = ADDON_GET_INDEX(list, static_cast<uint32_t>(i));
+      } else {
+        if (name.empty()) {
+          throw std::runtime_error("Columns by name need named parameters");
+        }
+        value = ADDON_GET(input, name.c_str());
+        if (ADDON_IS_UNDEFINED(value)) {
+          throw std::runtime_error("Missing column for parameter " + name);
+        }
+      }
+
+      BatchColumn column;
+      column.param = i + 1;
+      column.data = NULL;
+      size_t length;
+
+      if (ADDON_IS_TYPEDARRAY(value)) {
+        column.type = ADDON_GET_TYPEDARRAY_TYPE(value);
+        column.data = ADDON_GET_TYPEDARRAY_DATA(value);
+        length = ADDON_GET_TYPEDARRAY_LENGTH(value);
+
+        if (column.type != ADDON_TYPEDARRAY_INT8 && column.type != ADDON_TYPEDARRAY_UINT8 &&
+            column.type != ADDON_TYPEDARRAY_UINT8_CLAMPED && column.type != ADDON_TYPEDARRAY_INT16 &&
+            column.type != ADDON_TYPEDARRAY_UINT16 && column.type != ADDON_TYPEDARRAY_INT32 &&
+            column.type != ADDON_TYPEDARRAY_UINT32 && column.type != ADDON_TYPEDARRAY_FLOAT32 &&
+            column.type != ADDON_TYPEDARRAY_FLOAT64) {
+          throw std::runtime_error("Unsupported typed array for parameter " + std::to_string(static_cast<long long>(i + 1)));
+        }
+      }
+      else if (ADDON_IS_ARRAY(value)) {
+        column.type = -1;
+        column.array = ADDON_AS_ARRAY(value);
+        length = ADDON_LENGTH(column.array);
+      }
+      else {
+        throw std::runtime_error("Column for parameter " + std::to_string(static_cast<long long>(i + 1)) +
+                                 " must be an array or typed array");
+      }
+
+      if (columns.empty()) {
+        rowCount = length;
+      } else if (length != rowCount) {
+        throw std::runtime_error("Columns must all have the same length");
+      }
+      columns.push_back(column);
+    }
+
+    if (columns.empty()) {
+      throw std::runtime_error("No columns to bind");
+    }
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+    ADDON_VOID_RETURN();
+  }
+
+  try {
+    BatchTransaction transaction(stmt->database());
+
+    for (; row < rowCount; row++) {
+      ADDON_HANDLE_SCOPE();
+      for (size_t i = 0; i < columns.size(); i++) {
+        bindElement(stmt, columns[i], row);
+      }
+      stmt->step();
+      stmt->reset();
+      changes += stmt->changes();
+    }
+
+    transaction.commit();
+
+    ADDON_OBJECT_TYPE result = ADDON_OBJECT();
+    ADDON_SET(result, "rows", ADDON_NUMBER(static_cast<double>(rowCount)));
+    ADDON_SET(result, "changes", ADDON_NUMBER(changes));
+    ADDON_SET(result, "lastInsertRowid", ADDON_NUMBER(stmt->lastInsertRowid()));
+    ADDON_RETURN(result);
+  } catch (const std::exception& e) {
+    stmt->reset();
+    if (row < rowCount) {
+      ADDON_THROW_ERROR(rowError(row, e.what()).c_str());
+    } else {
+      ADDON_THROW_ERROR(e.what());
+    }
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(StatementWrap::Get) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
+    ADDON_THROW_ERROR("Statement has been finalized");
+    ADDON_VOID_RETURN();
+  }
+
+  try {
+    wrap->iterating_ = false;
+    wrap->stmt_->reset();
+    wrap->stmt_->clearBindings();
+
+    // Bind parameters
+    wrap->bindArguments(ADDON_ARG_COUNT(),
+                        [&](int i) { return ADDON_ARG(i); },
+                        [&](int index, ADDON_VALUE val) { bindValue(wrap->stmt_, index, val); });
+
+    // Get first row, then reset so the statement does not keep its read
+    // transaction (and in WAL mode its snapshot) open until the next call
+    if (wrap->stmt_->step()) {
+      ADDON_VALUE row;
+      if (wrap->raw_) {
+        int count = static_cast<int>(wrap->stmt_->columns().size());
+        row = rowToArray(wrap->stmt_, count);
+      } else {
+        std::vector<ADDON_VALUE> keys;
+        wrap->cachedKeys(keys);
+        row = rowToObject(wrap->stmt_, keys);
+      }
+      wrap->stmt_->reset();
+      ADDON_RETURN(row);
+    }
+    wrap->stmt_->reset();
+    ADDON_RETURN_UNDEFINED();
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(StatementWrap::All) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
+    ADDON_THROW_ERROR("Statement has been finalized");
+    ADDON_VOID_RETURN();
+  }
+
+  try {
+    wrap->iterating_ = false;
+    wrap->stmt_->reset();
+    wrap->stmt_->clearBindings();
+
+    // Bind parameters
+    wrap->bindArguments(ADDON_ARG_COUNT(),
+                        [&](int i) { return ADDON_ARG(i); },
+                        [&](int index, ADDON_VALUE val) { bindValue(wrap->stmt_, index, val); });
+
+    if (wrap->columnar_) {
+      ResultSet result;
+      result.gather(*wrap->stmt_);
+      ADDON_RETURN(resultToColumns(result));
+    }
+
+    // Get all rows
+    ADDON_ARRAY_TYPE rows = ADDON_ARRAY_EMPTY();
+    uint32_t index = 0;
+    std::vector<ADDON_VALUE> keys;
+    int count = 0;
+
+    while (wrap->stmt_->step()) {
+      // After the first step: a schema change re-prepares in step()
+      if (index == 0) {
+        if (wrap->raw_) {
+          count = static_cast<int>(wrap->stmt_->columns().size());
+        } else {
+          wrap->cachedKeys(keys);
+        }
+      }
+      if (wrap->raw_) {
+        ADDON_SET_INDEX(rows, index++, rowToArray(wrap->stmt_, count));
+      } else {
+        ADDON_SET_INDEX(rows, index++, rowToObject(wrap->stmt_, keys));
+      }
+    }
+
+    ADDON_RETURN(rows);
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(StatementWrap::Reset) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  wrap->iterating_ = false;
+  if (wrap->stmt_ && wrap->stmt_->isValid()) {
+    wrap->stmt_->reset();
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(StatementWrap::Finalize) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  wrap->iterating_ = false;
+  if (wrap->stmt_) {
+    wrap->stmt_->finalize();
+  }
+  ADDON_VOID_RETURN();
+}
+
+// iterate(...params): bind and start a pass; returns its number for
+// iterateNext()/iterateEnd()
+ADDON_METHOD(StatementWrap::Iterate) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
+    ADDON_THROW_ERROR("Statement has been finalized");
+    ADDON_VOID_RETURN();
+  }
+  if (!wrap->stmt_->isReader()) {
+    ADDON_THROW_TYPE_ERROR("iterate() is only for statements that return rows");
+    ADDON_VOID_RETURN();
+  }
+  // Columns need the whole result; batches of row objects would silently
+  // ignore the mode
+  if (wrap->columnar_) {
+    ADDON_THROW_TYPE_ERROR("iterate() cannot return columns; call columns(false) first");
+    ADDON_VOID_RETURN();
+  }
+
+  try {
+    wrap->stmt_->reset();
+    wrap->stmt_->clearBindings();
+
+    wrap->bindArguments(ADDON_ARG_COUNT(),
+                        [&](int i) { return ADDON_ARG(i); },
+                        [&](int index, ADDON_VALUE val) { bindValue(wrap->stmt_, index, val); });
+
+    wrap->iteration_++;
+    wrap->iterating_ = true;
+    ADDON_RETURN(ADDON_NUMBER(wrap->iteration_));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+// iterateNext(pass, batchSize): up to batchSize more rows (objects, or
+// arrays in raw mode). Fewer means the pass is over and the statement has
+// been reset.
+ADDON_METHOD(StatementWrap::IterateNext) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
+    ADDON_THROW_ERROR("Statement has been finalized");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 2 || !ADDON_IS_NUMBER(ADDON_ARG(0)) || !ADDON_IS_NUMBER(ADDON_ARG(1))) {
+    ADDON_THROW_TYPE_ERROR("Expected (pass, batchSize)");
+    ADDON_VOID_RETURN();
+  }
+  if (!wrap->iterating_ || ADDON_TO_UINT32(ADDON_ARG(0)) != wrap->iteration_) {
+    ADDON_THROW_ERROR("Statement was executed again during iteration");
+    ADDON_VOID_RETURN();
+  }
+
+  uint32_t batchSize = ADDON_TO_UINT32(ADDON_ARG(1));
+  if (batchSize == 0) {
+    batchSize = 1;
+  }
+
+  try {
+    ADDON_ARRAY_TYPE rows = ADDON_ARRAY_EMPTY();
+    uint32_t index = 0;
+    std::vector<ADDON_VALUE> keys;
+    int count = 0;
+
+    while (index < batchSize) {
+      if (!wrap->stmt_->step()) {
+        wrap->iterating_ = false;
+        wrap->stmt_->reset();
+        break;
+      }
+      // After the first step: a schema change re-prepares in step()
+      if (index == 0) {
+        if (wrap->raw_) {
+          count = static_cast<int>(wrap->stmt_->columns().size());
+        } else {
+          wrap->cachedKeys(keys);
+        }
+      }
+      if (wrap->raw_) {
+        ADDON_SET_INDEX(rows, index++, rowToArray(wrap->stmt_, count));
+      } else {
+        ADDON_SET_INDEX(rows, index++, rowToObject(wrap->stmt_, keys));
+      }
+    }
+
+    ADDON_RETURN(rows);
+  } catch (const std::exception& e) {
+    wrap->iterating_ = false;
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+// iterateEnd(pass): stop a pass early (break out of a loop)
+ADDON_METHOD(StatementWrap::IterateEnd) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (ADDON_ARG_COUNT() < 1 || ADDON_TO_UINT32(ADDON_ARG(0)) != wrap->iteration_ || !wrap->iterating_) {
+    ADDON_VOID_RETURN();
+  }
+
+  wrap->iterating_ = false;
+  if (wrap->stmt_ && wrap->stmt_->isValid()) {
+    wrap->stmt_->reset();
+  }
+  ADDON_VOID_RETURN();
+}
+
+// raw(toggle) / columnar(toggle): the two modes exclude each other
+ADDON_METHOD(StatementWrap::Raw) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  bool enable = ADDON_ARG_COUNT() < 1 || ADDON_TO_BOOL(ADDON_ARG(0));
+  if (enable && !(wrap->stmt_ && wrap->stmt_->isReader())) {
+    ADDON_THROW_TYPE_ERROR("raw() is only for statements that return rows");
+    ADDON_VOID_RETURN();
+  }
+
+  wrap->raw_ = enable;
+  if (enable) {
+    wrap->columnar_ = false;
+  }
+  ADDON_RETURN(ADDON_HOLDER());
+}
+
+ADDON_METHOD(StatementWrap::Columnar) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  bool enable = ADDON_ARG_COUNT() < 1 || ADDON_TO_BOOL(ADDON_ARG(0));
+  if (enable && !(wrap->stmt_ && wrap->stmt_->isReader())) {
+    ADDON_THROW_TYPE_ERROR("columns() is only for statements that return rows");
+    ADDON_VOID_RETURN();
+  }
+
+  wrap->columnar_ = enable;
+  if (enable) {
+    wrap->raw_ = false;
+  }
+  ADDON_RETURN(ADDON_HOLDER());
+}
+
+ADDON_GETTER(StatementWrap::GetSource) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (wrap->stmt_) {
+    ADDON_RETURN(ADDON_STRING(wrap->stmt_->source().c_str()));
+  }
+  ADDON_RETURN_NULL();
+}
+
+ADDON_GETTER(StatementWrap::GetReader) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  bool isReader = wrap->stmt_ && wrap->stmt_->isReader();
+  ADDON_RETURN(ADDON_BOOLEAN(isReader));
+}
+
+// stats(): execution counters of this statement
+ADDON_METHOD(StatementWrap::Stats) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (!wrap->stmt_) {
+    ADDON_THROW_ERROR("Statement has been finalized");
+    ADDON_VOID_RETURN();
+  }
+
+  StatementStats stats = wrap->stmt_->stats();
+
+  ADDON_OBJECT_TYPE result = ADDON_OBJECT();
+  ADDON_SET(result, "executions", ADDON_NUMBER(static_cast<double>(stats.executions)));
+  ADDON_SET(result, "rows", ADDON_NUMBER(static_cast<double>(stats.rows)));
+  ADDON_SET(result, "totalTime", ADDON_NUMBER(stats.totalTime));
+  ADDON_SET(result, "maxStepTime", ADDON_NUMBER(stats.maxStepTime));
+  ADDON_SET(result, "fullscanSteps", ADDON_INTEGER(stats.fullscanSteps));
+  ADDON_SET(result, "sorts", ADDON_INTEGER(stats.sorts));
+  ADDON_SET(result, "autoindexes", ADDON_INTEGER(stats.autoindexes));
+  ADDON_SET(result, "vmSteps", ADDON_INTEGER(stats.vmSteps));
+  ADDON_RETURN(result);
+}
+
+// explain(queryPlan): rows of EXPLAIN QUERY PLAN (default) or, with
+// false, the EXPLAIN bytecode listing. Parameters count as NULL.
+ADDON_METHOD(StatementWrap::Explain) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
+    ADDON_THROW_ERROR("Statement has been finalized");
+    ADDON_VOID_RETURN();
+  }
+
+  bool queryPlan = ADDON_ARG_COUNT() < 1 || ADDON_IS_UNDEFINED(ADDON_ARG(0)) || ADDON_TO_BOOL(ADDON_ARG(0));
+  std::string sql = (queryPlan ? "EXPLAIN QUERY PLAN " : "EXPLAIN ") + wrap->stmt_->source();
+
+  // Prepared and finalized here rather than through a Statement, which
+  // would take a slot in the statement cache and count as a hit or miss
+  sqlite3* handle = wrap->stmt_->database()->handle();
+  sqlite3_stmt* explain = NULL;
+  if (sqlite3_prepare_v2(handle, sql.c_str(), -1, &explain, NULL) != SQLITE_OK) {
+    ADDON_THROW_ERROR(sqlite3_errmsg(handle));
+    ADDON_VOID_RETURN();
+  }
+
+  // EXPLAIN and EXPLAIN QUERY PLAN rows hold only integers, text and NULL
+  ADDON_ARRAY_TYPE rows = ADDON_ARRAY_EMPTY();
+  uint32_t index = 0;
+  int columns = sqlite3_column_count(explain);
+  int rc;
+
+  while ((rc = sqlite3_step(explain)) == SQLITE_ROW) {
+    ADDON_OBJECT_TYPE row = ADDON_OBJECT();
+    for (int i = 0; i < columns; i++) {
+      ADDON_VALUE value = ADDON_NULL();
+      if (sqlite3_column_type(explain, i) == SQLITE_INTEGER) {
+        value = ADDON_NUMBER(static_cast<double>(sqlite3_column_int64(explain, i)));
+      } else if (sqlite3_column_type(explain, i) == SQLITE_TEXT) {
+        value = ADDON_STRING_LEN(reinterpret_cast<const char*>(sqlite3_column_text(explain, i)),
+                                 sqlite3_column_bytes(explain, i));
+      }
+      ADDON_SET(row, sqlite3_column_name(explain, i), value);
+    }
+    ADDON_SET_INDEX(rows, index++, row);
+  }
+
+  if (rc != SQLITE_DONE) {
+    std::string error = sqlite3_errmsg(handle);
+    sqlite3_finalize(explain);
+    ADDON_THROW_ERROR(error.c_str());
+    ADDON_VOID_RETURN();
+  }
+  sqlite3_finalize(explain);
+  ADDON_RETURN(rows);
+}
+
+// ============================================
+// Blob Implementation
+// ============================================
+
+// openBlob(table, column, rowid, writable, schema)
+ADDON_METHOD(DatabaseWrap::OpenBlob) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 3 || !ADDON_IS_STRING(ADDON_ARG(0)) || !ADDON_IS_STRING(ADDON_ARG(1)) ||
+      !ADDON_IS_NUMBER(ADDON_ARG(2))) {
+    ADDON_THROW_TYPE_ERROR("Expected (table, column, rowid)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(table, ADDON_ARG(0));
+  ADDON_UTF8(column, ADDON_ARG(1));
+  int64_t rowid = static_cast<int64_t>(ADDON_TO_DOUBLE(ADDON_ARG(2)));
+  bool writable = ADDON_ARG_COUNT() >= 4 && ADDON_TO_BOOL(ADDON_ARG(3));
+  std::string schema = "main";
+  if (ADDON_ARG_COUNT() >= 5 && ADDON_IS_STRING(ADDON_ARG(4))) {
+    ADDON_UTF8(name, ADDON_ARG(4));
+    schema = ADDON_UTF8_VALUE(name);
+  }
+
+  try {
+    Blob* blob = new Blob(wrap->db_, ADDON_UTF8_VALUE(table), ADDON_UTF8_VALUE(column), rowid, writable, schema);
+    ADDON_RETURN(BlobWrap::Create(blob));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+void BlobWrap::Init(ADDON_INIT_PARAMS) {
+  ADDON_HANDLE_SCOPE();
+
+  auto tpl = ADDON_NEW_CTOR_TEMPLATE();
+  ADDON_SET_CLASS_NAME(tpl, "Blob");
+  ADDON_SET_INTERNAL_FIELD_COUNT(tpl, 1);
+
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "read", Read);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "readInto", ReadInto);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "write", Write);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "reopen", Reopen);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "close", Close);
+
+  ADDON_SET_ACCESSOR(tpl, "size", GetSize);
+  ADDON_SET_ACCESSOR(tpl, "open", GetOpen);
+
+  ADDON_PERSISTENT_RESET(constructor, ADDON_GET_CTOR_FUNCTION(tpl));
+}
+
+ADDON_OBJECT_TYPE BlobWrap::Create(Blob* blob) {
+  ADDON_ESCAPABLE_SCOPE();
+
+  auto cons = ADDON_PERSISTENT_GET(constructor);
+  ADDON_OBJECT_TYPE instance = ADDON_NEW_INSTANCE(cons);
+
+  BlobWrap* wrap = new BlobWrap();
+  wrap->blob_ = blob;
+  wrap->Wrap(instance);
+
+  return ADDON_ESCAPE(instance);
+}
+
+void BlobWrap::checkRange(double offset, double length) {
+  if (!blob_ || !blob_->isOpen()) {
+    throw std::runtime_error("Blob has been closed");
+  }
+  if (offset < 0 || length < 0 || offset + length > blob_->size()) {
+    throw std::runtime_error("Range is outside the blob");
+  }
+}
+
+// read(offset, length): the bytes as a new Buffer, read straight into it
+ADDON_METHOD(BlobWrap::Read) {
+  ADDON_ENV;
+  BlobWrap* wrap = ADDON_UNWRAP(BlobWrap, ADDON_HOLDER());
+
+  try {
+    if (!wrap->blob_ || !wrap->blob_->isOpen()) {
+      throw std::runtime_error("Blob has been closed");
+    }
+
+    double offset = ADDON_ARG_COUNT() >= 1 && ADDON_IS_NUMBER(ADDON_ARG(0)) ? ADDON_TO_DOUBLE(ADDON_ARG(0)) : 0;
+    double length = ADDON_ARG_COUNT() >= 2 && ADDON_IS_NUMBER(ADDON_ARG(1))
+      ? ADDON_TO_DOUBLE(ADDON_ARG(1))
+      : wrap->blob_->size() - offset;
+    wrap->checkRange(offset, length);
+
+    if (length == 0) {
+      ADDON_RETURN(ADDON_COPY_BUFFER("", 0));
+    }
+
+    char* data = static_cast<char*>(malloc(static_cast<size_t>(length)));
+    if (!data) {
+      throw std::runtime_error("Out of memory");
+    }
+    try {
+      wrap->blob_->read(data, static_cast<int>(length), static_cast<int>(offset));
+    } catch (...) {
+      free(data);
+      throw;
+    }
+    ADDON_RETURN(ADDON_NEW_BUFFER(data, static_cast<size_t>(length)));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+// readInto(buffer, offset): fill buffer from offset on (fewer bytes at the
+// end of the blob); returns the count
+ADDON_METHOD(BlobWrap::ReadInto) {
+  ADDON_ENV;
+  BlobWrap* wrap = ADDON_UNWRAP(BlobWrap, ADDON_HOLDER());
+
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_BUFFER_IS(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("Expected a Buffer");
+    ADDON_VOID_RETURN();
+  }
+
+  try {
+    if (!wrap->blob_ || !wrap->blob_->isOpen()) {
+      throw std::runtime_error("Blob has been closed");
+    }
+
+    ADDON_OBJECT_TYPE buf = ADDON_AS_OBJECT(ADDON_ARG(0));
+    double offset = ADDON_ARG_COUNT() >= 2 && ADDON_IS_NUMBER(ADDON_ARG(1)) ? ADDON_TO_DOUBLE(ADDON_ARG(1)) : 0;
+    double length = static_cast<double>(ADDON_BUFFER_LENGTH(buf));
+    if (offset >= 0 && offset + length > wrap->blob_->size()) {
+      length = wrap->blob_->size() - offset;
+    }
+    wrap->checkRange(offset, length);
+
+    if (length > 0) {
+      wrap->blob_->read(ADDON_BUFFER_DATA(buf), static_cast<int>(length), static_cast<int>(offset));
+    }
+    ADDON_RETURN(ADDON_NUMBER(length));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+// write(buffer, offset): overwrite in place; the blob's size is fixed
+ADDON_METHOD(BlobWrap::Write) {
+  ADDON_ENV;
+  BlobWrap* wrap = ADDON_UNWRAP(BlobWrap, ADDON_HOLDER());
+
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_BUFFER_IS(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("Expected a Buffer");
+    ADDON_VOID_RETURN();
+  }
+
+  try {
+    ADDON_OBJECT_TYPE buf = ADDON_AS_OBJECT(ADDON_ARG(0));
+    double offset = ADDON_ARG_COUNT() >= 2 && ADDON_IS_NUMBER(ADDON_ARG(1)) ? ADDON_TO_DOUBLE(ADDON_ARG(1)) : 0;
+    double length = static_cast<double>(ADDON_BUFFER_LENGTH(buf));
+    wrap->checkRange(offset, length);
+
+    if (length > 0) {
+      wrap->blob_->write(ADDON_BUFFER_DATA(buf), static_cast<int>(length), static_cast<int>(offset));
+    }
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(BlobWrap::Reopen) {
+  ADDON_ENV;
+  BlobWrap* wrap = ADDON_UNWRAP(BlobWrap, ADDON_HOLDER());
+
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_IS_NUMBER(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("Expected a rowid");
+    ADDON_VOID_RETURN();
+  }
+
+  try {
+    if (!wrap->blob_) {
+      throw std::runtime_error("Blob has been closed");
+    }
+    wrap->blob_->reopen(static_cast<int64_t>(ADDON_TO_DOUBLE(ADDON_ARG(0))));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(BlobWrap::Close) {
+  ADDON_ENV;
+  BlobWrap* wrap = ADDON_UNWRAP(BlobWrap, ADDON_HOLDER());
+
+  if (wrap->blob_) {
+    wrap->blob_->close();
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_GETTER(BlobWrap::GetSize) {
+  ADDON_ENV;
+  BlobWrap* wrap = ADDON_UNWRAP(BlobWrap, ADDON_HOLDER());
+
+  if (wrap->blob_ && wrap->blob_->isOpen()) {
+    ADDON_RETURN(ADDON_NUMBER(wrap->blob_->size()));
+  }
+  ADDON_RETURN_NULL();
+}
+
+ADDON_GETTER(BlobWrap::GetOpen) {
+  ADDON_ENV;
+  BlobWrap* wrap = ADDON_UNWRAP(BlobWrap, ADDON_HOLDER());
+
+  ADDON_RETURN(ADDON_BOOLEAN(wrap->blob_ && wrap->blob_->isOpen()));
+}
+
+// ============================================
+// Backup Implementation
+// ============================================
+
+// openBackup(destination, schema): destination is a file path or another
+// native Database
+ADDON_METHOD(DatabaseWrap::OpenBackup) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 1) {
+    ADDON_THROW_TYPE_ERROR("Expected (destination)");
+    ADDON_VOID_RETURN();
+  }
+
+  std::string schema = "main";
+  if (ADDON_ARG_COUNT() >= 2 && ADDON_IS_STRING(ADDON_ARG(1))) {
+    ADDON_UTF8(name, ADDON_ARG(1));
+    schema = ADDON_UTF8_VALUE(name);
+  }
+
+  Database* destination = NULL;
+  if (!ADDON_IS_STRING(ADDON_ARG(0))) {
+    DatabaseWrap* target = NULL;
+    if (ADDON_HAS_INSTANCE(constructorTemplate, ADDON_ARG(0))) {
+      target = ADDON_UNWRAP(DatabaseWrap, ADDON_AS_OBJECT(ADDON_ARG(0)));
+    }
+    if (!target) {
+      ADDON_THROW_TYPE_ERROR("Backup destination must be a path or a Database");
+      ADDON_VOID_RETURN();
+    }
+    destination = target->db_;
+  }
+
+  try {
+    Backup* backup;
+    if (destination) {
+      backup = new Backup(wrap->db_, destination, schema);
+    } else {
+      ADDON_UTF8(path, ADDON_ARG(0));
+      backup = new Backup(wrap->db_, std::string(ADDON_UTF8_VALUE(path)), schema);
+    }
+    ADDON_RETURN(BackupWrap::Create(backup));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+static void freeSerialized(char* data, void*) {
+  sqlite3_free(data);
+}
+
+// serialize(schema): the database image in a Buffer over SQLite's own
+// allocation (no second copy)
+ADDON_METHOD(DatabaseWrap::Serialize) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+
+  std::string schema = "main";
+  if (ADDON_ARG_COUNT() >= 1 && ADDON_IS_STRING(ADDON_ARG(0))) {
+    ADDON_UTF8(name, ADDON_ARG(0));
+    schema = ADDON_UTF8_VALUE(name);
+  }
+
+  try {
+    size_t size = 0;
+    unsigned char* data = wrap->db_->serialize(schema, &size);
+    if (!data) {
+      ADDON_RETURN(ADDON_COPY_BUFFER("", 0));
+    }
+    ADDON_RETURN(ADDON_NEW_BUFFER_FREE(reinterpret_cast<char*>(data), size, freeSerialized));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+// deserialize(buffer, schema, readonly)
+ADDON_METHOD(DatabaseWrap::Deserialize) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 1 || !ADDON_BUFFER_IS(ADDON_ARG(0))) {
+    ADDON_THROW_TYPE_ERROR("Expected (buffer)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_OBJECT_TYPE buffer = ADDON_AS_OBJECT(ADDON_ARG(0));
+  std::string schema = "main";
+  if (ADDON_ARG_COUNT() >= 2 && ADDON_IS_STRING(ADDON_ARG(1))) {
+    ADDON_UTF8(name, ADDON_ARG(1));
+    schema = ADDON_UTF8_VALUE(name);
+  }
+  bool readonly = ADDON_ARG_COUNT() >= 3 && ADDON_TO_BOOL(ADDON_ARG(2));
+
+  try {
+    wrap->db_->deserialize(schema, ADDON_BUFFER_DATA(buffer), ADDON_BUFFER_LENGTH(buffer), readonly);
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+void BackupWrap::Init(ADDON_INIT_PARAMS) {
+  ADDON_HANDLE_SCOPE();
+
+  auto tpl = ADDON_NEW_CTOR_TEMPLATE();
+  ADDON_SET_CLASS_NAME(tpl, "Backup");
+  ADDON_SET_INTERNAL_FIELD_COUNT(tpl, 1);
+
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "step", Step);
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "close", Close);
+
+  ADDON_SET_ACCESSOR(tpl, "remaining", GetRemaining);
+  ADDON_SET_ACCESSOR(tpl, "pageCount", GetPageCount);
+  ADDON_SET_ACCESSOR(tpl, "open", GetOpen);
+
+  ADDON_PERSISTENT_RESET(constructor, ADDON_GET_CTOR_FUNCTION(tpl));
+}
+
+ADDON_OBJECT_TYPE BackupWrap::Create(Backup* backup) {
+  ADDON_ESCAPABLE_SCOPE();
+
+  auto cons = ADDON_PERSISTENT_GET(constructor);
+  ADDON_OBJECT_TYPE instance = ADDON_NEW_INSTANCE(cons);
+
+  BackupWrap* wrap = new BackupWrap();
+  wrap->backup_ = backup;
+  wrap->Wrap(instance);
+
+  return ADDON_ESCAPE(instance);
+}
+
+// step(pages): true once the copy is complete; pages < 0 copies the rest
+ADDON_METHOD(BackupWrap::Step) {
+  ADDON_ENV;
+  BackupWrap* wrap = ADDON_UNWRAP(BackupWrap, ADDON_HOLDER());
+
+  if (!wrap->backup_ || !wrap->backup_->isOpen()) {
+    ADDON_THROW_ERROR("Backup has been closed");
+    ADDON_VOID_RETURN();
+  }
+
+  int pages = ADDON_ARG_COUNT() >= 1 && ADDON_IS_NUMBER(ADDON_ARG(0)) ? ADDON_TO_INT32(ADDON_ARG(0)) : -1;
+
+  try {
+    ADDON_RETURN(ADDON_BOOLEAN(wrap->backup_->step(pages)));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_METHOD(BackupWrap::Close) {
+  ADDON_ENV;
+  BackupWrap* wrap = ADDON_UNWRAP(BackupWrap, ADDON_HOLDER());
+
+  if (wrap->backup_) {
+    wrap->backup_->close();
+  }
+  ADDON_VOID_RETURN();
+}
+
+ADDON_GETTER(BackupWrap::GetRemaining) {
+  ADDON_ENV;
+  BackupWrap* wrap = ADDON_UNWRAP(BackupWrap, ADDON_HOLDER());
+
+  ADDON_RETURN(ADDON_INTEGER(wrap->backup_ ? wrap->backup_->remaining() : -1));
+}
+
+ADDON_GETTER(BackupWrap::GetPageCount) {
+  ADDON_ENV;
+  BackupWrap* wrap = ADDON_UNWRAP(BackupWrap, ADDON_HOLDER());
+
+  ADDON_RETURN(ADDON_INTEGER(wrap->backup_ ? wrap->backup_->pageCount() : -1));
+}
+
+ADDON_GETTER(BackupWrap::GetOpen) {
+  ADDON_ENV;
+  BackupWrap* wrap = ADDON_UNWRAP(BackupWrap, ADDON_HOLDER());
+
+  ADDON_RETURN(ADDON_BOOLEAN(wrap->backup_ && wrap->backup_->isOpen()));
+}
+
+// ============================================
+// Function Implementation
+// ============================================
+
+// A JS function registered with function() or aggregate(); owned by
+// SQLite, deleted through destroyFunction() when the function is replaced
+// or the connection closes (both on the JS thread)
+struct FunctionData {
+  explicit FunctionData(DatabaseWrap* owner) : wrap(owner) {}
+  ~FunctionData() {
+    ADDON_PERSISTENT_CLEAR(fn);
+    ADDON_PERSISTENT_CLEAR(start);
+    ADDON_PERSISTENT_CLEAR(startValue);
+    ADDON_PERSISTENT_CLEAR(result);
+  }
+
+  DatabaseWrap* wrap;
+  ADDON_PERSISTENT_FUNCTION fn;        // the function, or step() of an aggregate
+  ADDON_PERSISTENT_FUNCTION start;     // aggregate start() ...
+  ADDON_PERSISTENT_ARRAY startValue;   // ... or [start value]
+  ADDON_PERSISTENT_FUNCTION result;    // aggregate result(), optional
+};
+
+// Running total of one aggregate group, kept in SQLite's aggregate context
+struct AggregateState {
+  ~AggregateState() { ADDON_PERSISTENT_CLEAR(accumulator); }
+
+  ADDON_PERSISTENT_ARRAY accumulator;  // [value]
+};
+
+static void destroyFunction(void* data) {
+  delete static_cast<FunctionData*>(data);
+}
+
+// JS value of an SQL function argument
+static ADDON_VALUE argumentValue(sqlite3_value* value) {
+  switch (sqlite3_value_type(value)) {
+    case SQLITE_INTEGER:
+      return ADDON_NUMBER(sqlite3_value_int64(value));
+
+    case SQLITE_FLOAT:
+      return ADDON_NUMBER(sqlite3_value_double(value));
+
+    case SQLITE_TEXT: {
+      const char* text = reinterpret_cast<const char*>(sqlite3_value_text(value));
+      return ADDON_STRING_LEN(text, sqlite3_value_bytes(value));
+    }
+
+    case SQLITE_BLOB: {
+      const void* data = sqlite3_value_blob(value);
+      return ADDON_COPY_BUFFER(static_cast<const char*>(data), sqlite3_value_bytes(value));
+    }
+
+    case SQLITE_NULL:
+    default:
+      return ADDON_NULL();
+  }
+}
+
+// Set the SQL result from a JS value, converting like bindValue()
+static void setResult(sqlite3_context* ctx, ADDON_VALUE val) {
+  if (ADDON_IS_NULL(val) || ADDON_IS_UNDEFINED(val)) {
+    sqlite3_result_null(ctx);
+  }
+  else if (ADDON_IS_BOOLEAN(val)) {
+    sqlite3_result_int(ctx, ADDON_BOOL_VALUE(val) ? 1 : 0);
+  }
+  else if (ADDON_IS_INT32(val)) {
+    sqlite3_result_int(ctx, ADDON_TO_INT32(val));
+  }
+  else if (ADDON_IS_NUMBER(val)) {
+    double num = ADDON_TO_DOUBLE(val);
+    if (isInt64(num)) {
+      sqlite3_result_int64(ctx, static_cast<int64_t>(num));
+    } else {
+      sqlite3_result_double(ctx, num);
+    }
+  }
+  else if (ADDON_IS_STRING(val)) {
+    ADDON_UTF8(str, val);
+    sqlite3_result_text(ctx, ADDON_UTF8_VALUE(str), static_cast<int>(ADDON_UTF8_LENGTH(str)), SQLITE_TRANSIENT);
+  }
+  else if (ADDON_BUFFER_IS(val)) {
+    ADDON_OBJECT_TYPE buf = ADDON_AS_OBJECT(val);
+    sqlite3_result_blob(ctx, ADDON_BUFFER_DATA(buf), static_cast<int>(ADDON_BUFFER_LENGTH(buf)), SQLITE_TRANSIENT);
+  }
+  else {
+    sqlite3_result_null(ctx);
+  }
+}
+
+// Call fn(first?, ...argv); an exception becomes the SQL error of ctx
+static bool callFunction(sqlite3_context* ctx, FunctionData& data, ADDON_FUNCTION_TYPE fn,
+                         ADDON_VALUE* first, int argc, sqlite3_value** argv, ADDON_VALUE& result) {
+  std::vector<ADDON_VALUE> args;
+  args.reserve(argc + 1);
+  if (first) {
+    args.push_back(*first);
+  }
+  for (int i = 0; i < argc; i++) {
+    args.push_back(argumentValue(argv[i]));
+  }
+
+  std::string error;
+  data.wrap->callbackDepth_++;
+  bool ok = ADDON_CALL_FUNCTION(fn, args.size(), args.data(), result, error);
+  data.wrap->callbackDepth_--;
+
+  if (!ok) {
+    sqlite3_result_error(ctx, error.c_str(), -1);
+  }
+  return ok;
+}
+
+static void scalarFunction(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+  ADDON_HANDLE_SCOPE();
+  FunctionData& data = *static_cast<FunctionData*>(sqlite3_user_data(ctx));
+
+  ADDON_VALUE result;
+  if (callFunction(ctx, data, ADDON_PERSISTENT_GET(data.fn), NULL, argc, argv, result)) {
+    setResult(ctx, result);
+  }
+}
+
+// Accumulator of a new group: start() or the start value
+static AggregateState* startAggregate(sqlite3_context* ctx, FunctionData& data) {
+  ADDON_VALUE value;
+  if (!ADDON_PERSISTENT_IS_EMPTY(data.start)) {
+    if (!callFunction(ctx, data, ADDON_PERSISTENT_GET(data.start), NULL, 0, NULL, value)) {
+      return NULL;
+    }
+  } else {
+    ADDON_ARRAY_TYPE start = ADDON_PERSISTENT_GET(data.startValue);
+    value = ADDON_GET_INDEX(start, 0);
+  }
+
+  AggregateState* state = new AggregateState();
+  ADDON_ARRAY_TYPE holder = ADDON_ARRAY(1);
+  ADDON_SET_INDEX(holder, 0, value);
+  ADDON_PERSISTENT_RESET(state->accumulator, holder);
+  return state;
+}
+
+static void aggregateStep(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+  ADDON_HANDLE_SCOPE();
+  FunctionData& data = *static_cast<FunctionData*>(sqlite3_user_data(ctx));
+
+  AggregateState** slot = static_cast<AggregateState**>(sqlite3_aggregate_context(ctx, sizeof(AggregateState*)));
+  if (!slot) {
+    sqlite3_result_error_nomem(ctx);
+    return;
+  }
+  if (!*slot) {
+    *slot = startAggregate(ctx, data);
+    if (!*slot) {
+      return;
+    }
+  }
+
+  ADDON_ARRAY_TYPE holder = ADDON_PERSISTENT_GET((*slot)->accumulator);
+  ADDON_VALUE accumulator = ADDON_GET_INDEX(holder, 0);
+  ADDON_VALUE next;
+  if (!callFunction(ctx, data, ADDON_PERSISTENT_GET(data.fn), &accumulator, argc, argv, next)) {
+    return;
+  }
+
+  // step() may update the accumulator in place and return nothing
+  if (!ADDON_IS_UNDEFINED(next)) {
+    ADDON_SET_INDEX(holder, 0, next);
+  }
+}
+
+// Also called after a failed step, to clean up
+static void aggregateFinal(sqlite3_context* ctx) {
+  ADDON_HANDLE_SCOPE();
+  FunctionData& data = *static_cast<FunctionData*>(sqlite3_user_data(ctx));
+
+  // No rows: the group never started
+  AggregateState** slot = static_cast<AggregateState**>(sqlite3_aggregate_context(ctx, 0));
+  std::unique_ptr<AggregateState> state(slot ? *slot : startAggregate(ctx, data));
+  if (!state) {
+    return;
+  }
+
+  ADDON_ARRAY_TYPE holder = ADDON_PERSISTENT_GET(state->accumulator);
+  ADDON_VALUE accumulator = ADDON_GET_INDEX(holder, 0);
+
+  if (ADDON_PERSISTENT_IS_EMPTY(data.result)) {
+    setResult(ctx, accumulator);
+    return;
+  }
+
+  ADDON_VALUE result;
+  if (callFunction(ctx, data, ADDON_PERSISTENT_GET(data.result), &accumulator, 0, NULL, result)) {
+    setResult(ctx, result);
+  }
+}
+
+// Stand-in for a JS function on the async pool connections: their
+// worker threads cannot call into JS, so a query using it fails with this
+// rather than "no such function". The user data is the message.
+static void syncOnlyStep(sqlite3_context* ctx, int, sqlite3_value**) {
+  sqlite3_result_error(ctx, static_cast<std::string*>(sqlite3_user_data(ctx))->c_str(), -1);
+}
+
+static void syncOnlyFinal(sqlite3_context* ctx) {
+  syncOnlyStep(ctx, 0, NULL);
+}
+
+static void destroyMessage(void* message) {
+  delete static_cast<std::string*>(message);
+}
+
+static void createSyncOnlyFunction(Database& db, const std::string& name, int arity, int flags,
+                                   bool aggregate) {
+  std::string* message = new std::string(name + "() is a JS function and cannot run in async queries");
+  int rc = aggregate
+    ? sqlite3_create_function_v2(db.handle(), name.c_str(), arity, flags, message,
+                                 NULL, syncOnlyStep, syncOnlyFinal, destroyMessage)
+    : sqlite3_create_function_v2(db.handle(), name.c_str(), arity, flags, message,
+                                 syncOnlyStep, NULL, NULL, destroyMessage);
+  if (rc != SQLITE_OK) {
+    throw std::runtime_error(db.getError());
+  }
+}
+
+// Register data's callbacks as name; SQLite owns data from here on. The
+// async connections get the stand-in above under the same name.
+static void createFunction(DatabaseWrap* wrap, const char* name, int arity, bool deterministic,
+                           FunctionData* data, bool aggregate) {
+  int flags = SQLITE_UTF8 | (deterministic ? SQLITE_DETERMINISTIC : 0);
+  int rc = aggregate
+    ? sqlite3_create_function_v2(wrap->db_->handle(), name, arity, flags, data,
+                                 NULL, aggregateStep, aggregateFinal, destroyFunction)
+    : sqlite3_create_function_v2(wrap->db_->handle(), name, arity, flags, data,
+                                 scalarFunction, NULL, NULL, destroyFunction);
+  if (rc != SQLITE_OK) {
+    throw std::runtime_error(wrap->db_->getError());
+  }
+
+  if (wrap->async_) {
+    std::string functionName = name;
+    wrap->async_->pool.addSetup([functionName, arity, flags, aggregate](Database& db) {
+      createSyncOnlyFunction(db, functionName, arity, flags, aggregate);
+    });
+  }
+}
+
+// function(name, fn, arity, deterministic): arity -1 takes any number
+// of arguments
+ADDON_METHOD(DatabaseWrap::Function) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 3 || !ADDON_IS_STRING(ADDON_ARG(0)) || !ADDON_IS_FUNCTION(ADDON_ARG(1)) ||
+      !ADDON_IS_NUMBER(ADDON_ARG(2))) {
+    ADDON_THROW_TYPE_ERROR("Expected (name, function, arity)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(name, ADDON_ARG(0));
+  int arity = ADDON_TO_INT32(ADDON_ARG(2));
+  bool deterministic = ADDON_ARG_COUNT() >= 4 && ADDON_TO_BOOL(ADDON_ARG(3));
+
+  FunctionData* data = new FunctionData(wrap);
+  ADDON_PERSISTENT_RESET(data->fn, ADDON_AS_FUNCTION(ADDON_ARG(1)));
+
+  try {
+    createFunction(wrap, ADDON_UTF8_VALUE(name), arity, deterministic, data, false);
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+// aggregate(name, start, step, result, arity, deterministic): start is
+// a value or a function returning one; result may be null
+ADDON_METHOD(DatabaseWrap::Aggregate) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 5 || !ADDON_IS_STRING(ADDON_ARG(0)) || !ADDON_IS_FUNCTION(ADDON_ARG(2)) ||
+      !ADDON_IS_NUMBER(ADDON_ARG(4))) {
+    ADDON_THROW_TYPE_ERROR("Expected (name, start, step, result, arity)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(name, ADDON_ARG(0));
+  int arity = ADDON_TO_INT32(ADDON_ARG(4));
+  bool deterministic = ADDON_ARG_COUNT() >= 6 && ADDON_TO_BOOL(ADDON_ARG(5));
+
+  FunctionData* data = new FunctionData(wrap);
+  ADDON_PERSISTENT_RESET(data->fn, ADDON_AS_FUNCTION(ADDON_ARG(2)));
+  if (ADDON_IS_FUNCTION(ADDON_ARG(1))) {
+    ADDON_PERSISTENT_RESET(data->start, ADDON_AS_FUNCTION(ADDON_ARG(1)));
+  } else {
+    ADDON_ARRAY_TYPE holder = ADDON_ARRAY(1);
+    ADDON_SET_INDEX(holder, 0, ADDON_ARG(1));
+    ADDON_PERSISTENT_RESET(data->startValue, holder);
+  }
+  if (ADDON_IS_FUNCTION(ADDON_ARG(3))) {
+    ADDON_PERSISTENT_RESET(data->result, ADDON_AS_FUNCTION(ADDON_ARG(3)));
+  }
+
+  try {
+    createFunction(wrap, ADDON_UTF8_VALUE(name), arity, deterministic, data, true);
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+// nativeFunction(name, address, returns, args, deterministic): address of
+// a C function, e.g. from tinycc getSymbol(); returns and each of args
+// are 'int32', 'int64' or 'double', and all args must share one type
+ADDON_METHOD(DatabaseWrap::NativeFunction) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+  static const char* const typeNames[] = { "int32", "int64", "double", NULL };
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 4 || !ADDON_IS_STRING(ADDON_ARG(0)) || !ADDON_IS_NUMBER(ADDON_ARG(1)) ||
+      !ADDON_IS_STRING(ADDON_ARG(2)) || !ADDON_IS_ARRAY(ADDON_ARG(3))) {
+    ADDON_THROW_TYPE_ERROR("Expected (name, address, returns, args)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(name, ADDON_ARG(0));
+  ADDON_UTF8(returns, ADDON_ARG(2));
+  ADDON_ARRAY_TYPE args = ADDON_AS_ARRAY(ADDON_ARG(3));
+  bool deterministic = ADDON_ARG_COUNT() >= 5 && ADDON_TO_BOOL(ADDON_ARG(4));
+
+  nw_sqlite3::NativeFunction fn;
+  fn.address = reinterpret_cast<void*>(static_cast<uintptr_t>(ADDON_TO_DOUBLE(ADDON_ARG(1))));
+  fn.argCount = static_cast<int>(ADDON_LENGTH(args));
+
+  int returnType = nameIndex(typeNames, ADDON_UTF8_VALUE(returns));
+  if (returnType < 0) {
+    ADDON_THROW_TYPE_ERROR("Return type must be 'int32', 'int64' or 'double'");
+    ADDON_VOID_RETURN();
+  }
+  fn.returns = static_cast<NativeType>(returnType);
+
+  for (int i = 0; i < fn.argCount; i++) {
+    ADDON_VALUE arg = ADDON_GET_INDEX(args, i);
+    int argType = -1;
+    if (ADDON_IS_STRING(arg)) {
+      ADDON_UTF8(argName, arg);
+      argType = nameIndex(typeNames, ADDON_UTF8_VALUE(argName));
+    }
+    if (argType < 0) {
+      ADDON_THROW_TYPE_ERROR("Argument types must be 'int32', 'int64' or 'double'");
+      ADDON_VOID_RETURN();
+    }
+    if (i > 0 && argType != fn.args) {
+      ADDON_THROW_TYPE_ERROR("All arguments of a native function must have the same type");
+      ADDON_VOID_RETURN();
+    }
+    fn.args = static_cast<NativeType>(argType);
+  }
+
+  try {
+    createNativeFunction(*wrap->db_, ADDON_UTF8_VALUE(name), fn, deterministic);
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+    ADDON_VOID_RETURN();
+  }
+
+  // Plain C, so it runs on the async connections' worker threads too
+  if (wrap->async_) {
+    std::string functionName = ADDON_UTF8_VALUE(name);
+    wrap->async_->pool.addSetup([functionName, fn, deterministic](Database& db) {
+      createNativeFunction(db, functionName, fn, deterministic);
+    });
+  }
+  ADDON_VOID_RETURN();
+}
+
+// ============================================
+// Async Implementation
+// ============================================
+
+enum AsyncOp {
+  ASYNC_EXEC,   // exec(): no result
+  ASYNC_QUERY,  // query(): all rows, or the run result if there are none
+  ASYNC_RUN,
+  ASYNC_GET,
+  ASYNC_ALL
+};
+
+enum ResultShape {
+  SHAPE_OBJECTS,
+  SHAPE_ARRAYS,
+  SHAPE_COLUMNS
+};
+
+static void writeFinished(AsyncContext& context);
+
+// Work on one of an AsyncContext's pool connections. Writes are queued
+// through queueQuery() and release the write queue when destroyed.
+class PoolWorker : public ADDON_ASYNC_WORKER {
+public:
+  PoolWorker(ADDON_FUNCTION_TYPE callback, const AsyncContextPtr& context, bool write)
+    : ADDON_ASYNC_WORKER(callback)
+    , context_(context)
+    , write_(write) {}
+
+  // Workers are destroyed on the JS thread once their callback has run
+  ~PoolWorker() {
+    if (write_) {
+      writeFinished(*context_);
+    }
+  }
+
+  bool isWrite() const { return write_; }
+  AsyncContext& context() { return *context_; }
+
+protected:
+  AsyncContextPtr context_;
+  bool write_;
+};
+
+// Runs one statement (or exec() script) on a pool connection. Rows are
+// gathered into a ResultSet on the worker thread; only the conversion to
+// JS values happens on the JS thread.
+class QueryWorker : public PoolWorker {
+public:
+  QueryWorker(ADDON_FUNCTION_TYPE callback, const AsyncContextPtr& context, AsyncOp op,
+              const std::string& sql, bool write, ResultShape shape)
+    : PoolWorker(callback, context, write)
+    , paramObject(-1)
+    , op_(op)
+    , sql_(sql)
+    , shape_(shape)
+    , ran_(false) {}
+
+  // Values for parameters 1..n, or for queryAsync() with an object of
+  // named parameters, its arguments in order with the object (at
+  // paramObject) captured by property name in namedParams
+  std::vector<BoundValue> params;
+  int paramObject;
+  std::map<std::string, BoundValue> namedParams;
+
+  void Execute() {
+    try {
+      PoolLease lease(context_->pool, write_);
+
+      if (op_ == ASYNC_EXEC) {
+        lease.get()->exec(sql_);
+        return;
+      }
+
+      Statement stmt(lease.get(), sql_);
+      if (paramObject < 0) {
+        bindValues(stmt, params);
+      } else {
+        bindNamedParams(stmt);
+      }
+
+      if (op_ == ASYNC_RUN || (op_ == ASYNC_QUERY && !stmt.isReader())) {
+        stmt.step();
+        result_.changes = stmt.changes();
+        result_.lastInsertRowid = stmt.lastInsertRowid();
+        ran_ = true;
+        return;
+      }
+
+      result_.gather(stmt, op_ == ASYNC_GET ? 1 : 0);
+    } catch (const std::exception& e) {
+      SetError(e.what());
+    }
+  }
+
+  ADDON_VALUE OnResult() {
+    if (op_ == ASYNC_EXEC) {
+      return ADDON_UNDEFINED();
+    }
+    if (ran_) {
+      return StatementWrap::runResult(result_.changes, result_.lastInsertRowid);
+    }
+
+    if (op_ == ASYNC_GET) {
+      if (result_.rowCount() == 0) {
+        return ADDON_UNDEFINED();
+      }
+      std::vector<ADDON_VALUE> keys;
+      resultKeys(result_, keys);
+      return resultRow(result_, 0, shape_ == SHAPE_ARRAYS ? NULL : &keys);
+    }
+
+    if (shape_ == SHAPE_COLUMNS) {
+      return resultToColumns(result_);
+    }
+    return resultToRows(result_, shape_ == SHAPE_ARRAYS);
+  }
+
+private:
+  // Bind params as bindArguments() would, the object's values by the
+  // statement's parameter names
+  void bindNamedParams(Statement& stmt) {
+    std::vector<int> named;
+    std::vector<int> unnamed;
+    std::vector<std::string> names;
+    StatementWrap::parameterSlots(&stmt, named, names, unnamed);
+
+    BoundValue none;
+    StatementWrap::bindAroundObject(
+      static_cast<int>(params.size()), paramObject,
+      [&](int i) -> const BoundValue& { return params[i]; }, named,
+      [&](size_t i) -> const BoundValue& {
+        std::map<std::string, BoundValue>::const_iterator found = namedParams.find(names[i]);
+        return found == namedParams.end() ? none : found->second;
+      },
+      unnamed, [&](int index, const BoundValue& value) { bindValue(stmt, index, value); }, none);
+  }
+
+  AsyncOp op_;
+  std::string sql_;
+  ResultShape shape_;
+  ResultSet result_;
+  bool ran_;
+};
+
+// Reads go straight to the thread pool; a write waits for the one before
+static void queueQuery(PoolWorker* worker) {
+  AsyncContext& context = worker->context();
+
+  if (worker->isWrite()) {
+    if (context.writing) {
+      context.pendingWrites.push_back(worker);
+      return;
+    }
+    context.writing = true;
+  }
+  ADDON_QUEUE_WORKER(worker);
+}
+
+static void writeFinished(AsyncContext& context) {
+  if (context.pendingWrites.empty()) {
+    context.writing = false;
+    return;
+  }
+
+  PoolWorker* next = context.pendingWrites.front();
+  context.pendingWrites.pop_front();
+  ADDON_QUEUE_WORKER(next);
+}
+
+// Copy a JS value into a BoundValue, converting as bindValue() does
+static void captureValue(ADDON_VALUE val, BoundValue& out) {
+  if (ADDON_IS_BOOLEAN(val)) {
+    out.type = SQLITE_INTEGER;
+    out.integer = ADDON_BOOL_VALUE(val) ? 1 : 0;
+  }
+  else if (ADDON_IS_INT32(val)) {
+    out.type = SQLITE_INTEGER;
+    out.integer = ADDON_TO_INT32(val);
+  }
+  else if (ADDON_IS_NUMBER(val)) {
+    double num = ADDON_TO_DOUBLE(val);
+    if (isInt64(num)) {
+      out.type = SQLITE_INTEGER;
+      out.integer = static_cast<int64_t>(num);
+    } else {
+      out.type = SQLITE_FLOAT;
+      out.number = num;
+    }
+  }
+  else if (ADDON_IS_STRING(val)) {
+    ADDON_UTF8(str, val);
+    out.type = SQLITE_TEXT;
+    out.bytes.assign(ADDON_UTF8_VALUE(str), ADDON_UTF8_LENGTH(str));
+  }
+  else if (ADDON_BUFFER_IS(val)) {
+    ADDON_OBJECT_TYPE buf = ADDON_AS_OBJECT(val);
+    out.type = SQLITE_BLOB;
+    out.bytes.assign(ADDON_BUFFER_DATA(buf), ADDON_BUFFER_LENGTH(buf));
+  }
+  else {
+    out.type = SQLITE_NULL;
+  }
+}
+
+// Copy queryAsync() arguments for its worker: values in order, and the
+// position of an object of named parameters. The parameter names are only
+// known once the worker prepares the SQL, so the object is captured whole,
+// property by property.
+static void captureParams(ADDON_VALUE list, std::vector<BoundValue>& params, int& object,
+                          std::map<std::string, BoundValue>& named) {
+  object = -1;
+  if (!ADDON_IS_ARRAY(list)) {
+    return;
+  }
+
+  ADDON_ARRAY_TYPE array = ADDON_AS_ARRAY(list);
+  int count = static_cast<int>(ADDON_LENGTH(array));
+  object = StatementWrap::parameterObject(count, [&](int i) { return ADDON_GET_INDEX(array, i); });
+
+  params.resize(count);
+  for (int i = 0; i < count; i++) {
+    if (i != object) {
+      captureValue(ADDON_GET_INDEX(array, i), params[i]);
+    }
+  }
+  if (object < 0) {
+    return;
+  }
+
+  ADDON_VALUE objectValue = ADDON_GET_INDEX(array, object);
+  ADDON_OBJECT_TYPE values = ADDON_AS_OBJECT(objectValue);
+  ADDON_ARRAY_TYPE keys = ADDON_PROPERTY_NAMES(values);
+  for (uint32_t i = 0; i < ADDON_LENGTH(keys); i++) {
+    ADDON_VALUE key = ADDON_GET_INDEX(keys, i);
+    ADDON_UTF8(name, key);
+    std::string text(ADDON_UTF8_VALUE(name), ADDON_UTF8_LENGTH(name));
+    captureValue(ADDON_GET_KEY(values, key), named[text]);
+  }
+}
+
+// Whether a statement may run on one of the pool's read connections:
+// SQLite calls it read-only and it returns rows. Statements without
+// result columns (BEGIN, COMMIT, ATTACH...) count as writes although
+// SQLite calls them read-only; on a pooled reader they would leave their
+// transaction or attachment behind for the next query there.
+static bool runsAsRead(bool readonly, bool returnsRows) {
+  return readonly && returnsRows;
+}
+
+// True when the first statement of sql (with all, every statement) only
+// reads, as runsAsRead() judges it: prepared on the main connection,
+// outside its statement cache, and finalized straight away. Anything else
+// is queued as a write, so it stays ordered after earlier writes and
+// never hits a read-only connection; that includes SQL that does not
+// prepare yet because a write still queued has to create its table.
+static bool isReadQuery(Database& db, const std::string& sql, bool all) {
+  const char* tail = sql.c_str();
+  const char* end = tail + sql.size();
+  bool found = false;
+
+  while (tail < end) {
+    sqlite3_stmt* stmt = NULL;
+    const char* next = NULL;
+    int rc = sqlite3_prepare_v2(db.handle(), tail, static_cast<int>(end - tail), &stmt, &next);
+    if (rc != SQLITE_OK) {
+      sqlite3_finalize(stmt);
+      return false;
+    }
+    if (stmt == NULL) {
+      // An empty statement, whitespace or a comment: nothing to judge
+      if (next <= tail) {
+        break;
+      }
+      tail = next;
+      continue;
+    }
+
+    bool reads = runsAsRead(sqlite3_stmt_readonly(stmt) != 0, sqlite3_column_count(stmt) > 0);
+    sqlite3_finalize(stmt);
+    if (!reads) {
+      return false;
+    }
+    found = true;
+    if (!all) {
+      break;
+    }
+    tail = next;
+  }
+  return found;
+}
+
+// execAsync(sql, callback)
+ADDON_METHOD(DatabaseWrap::ExecAsync) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+  if (!wrap->async_) {
+    ADDON_THROW_ERROR("Async queries need a database file");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 2 || !ADDON_IS_STRING(ADDON_ARG(0)) || !ADDON_IS_FUNCTION(ADDON_ARG(1))) {
+    ADDON_THROW_TYPE_ERROR("Expected (sql, callback)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(sql, ADDON_ARG(0));
+  std::string text = ADDON_UTF8_VALUE(sql);
+
+  queueQuery(new QueryWorker(ADDON_AS_FUNCTION(ADDON_ARG(1)), wrap->async_, ASYNC_EXEC,
+                             text, !isReadQuery(*wrap->db_, text, true), SHAPE_OBJECTS));
+  ADDON_VOID_RETURN();
+}
+
+// queryAsync(sql, params, callback)
+ADDON_METHOD(DatabaseWrap::QueryAsync) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+  if (!wrap->async_) {
+    ADDON_THROW_ERROR("Async queries need a database file");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 3 || !ADDON_IS_STRING(ADDON_ARG(0)) || !ADDON_IS_FUNCTION(ADDON_ARG(2))) {
+    ADDON_THROW_TYPE_ERROR("Expected (sql, params, callback)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(sql, ADDON_ARG(0));
+  std::string text = ADDON_UTF8_VALUE(sql);
+
+  std::vector<BoundValue> params;
+  std::map<std::string, BoundValue> named;
+  int object;
+  try {
+    captureParams(ADDON_ARG(1), params, object, named);
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+    ADDON_VOID_RETURN();
+  }
+
+  QueryWorker* worker = new QueryWorker(ADDON_AS_FUNCTION(ADDON_ARG(2)), wrap->async_, ASYNC_QUERY,
+                                        text, !isReadQuery(*wrap->db_, text, false), SHAPE_OBJECTS);
+  worker->params.swap(params);
+  worker->paramObject = object;
+  worker->namedParams.swap(named);
+  queueQuery(worker);
+  ADDON_VOID_RETURN();
+}
+
+// async(op, params, callback): op is 'run', 'get' or 'all'. The
+// statement's SQL is prepared again on a pool connection (through that
+// connection's statement cache); raw()/columns() shape the result.
+ADDON_METHOD(StatementWrap::Async) {
+  ADDON_ENV;
+  StatementWrap* wrap = ADDON_UNWRAP(StatementWrap, ADDON_HOLDER());
+
+  if (!wrap->stmt_ || !wrap->stmt_->isValid()) {
+    ADDON_THROW_ERROR("Statement has been finalized");
+    ADDON_VOID_RETURN();
+  }
+  if (!wrap->async_) {
+    ADDON_THROW_ERROR("Async queries need a database file");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 3 || !ADDON_IS_STRING(ADDON_ARG(0)) || !ADDON_IS_FUNCTION(ADDON_ARG(2))) {
+    ADDON_THROW_TYPE_ERROR("Expected (op, params, callback)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(opName, ADDON_ARG(0));
+  std::string name = ADDON_UTF8_VALUE(opName);
+  AsyncOp op;
+  if (name == "run") {
+    op = ASYNC_RUN;
+  } else if (name == "get") {
+    op = ASYNC_GET;
+  } else if (name == "all") {
+    op = ASYNC_ALL;
+  } else {
+    ADDON_THROW_TYPE_ERROR("Unknown async operation");
+    ADDON_VOID_RETURN();
+  }
+
+  ResultShape shape = SHAPE_OBJECTS;
+  if (wrap->raw_) {
+    shape = SHAPE_ARRAYS;
+  } else if (wrap->columnar_ && op == ASYNC_ALL) {
+    shape = SHAPE_COLUMNS;
+  }
+
+  // Bound the same way as run()/get()/all(); the worker binds params[i]
+  // to parameter i + 1
+  std::vector<BoundValue> params;
+  if (ADDON_IS_ARRAY(ADDON_ARG(1))) {
+    ADDON_ARRAY_TYPE list = ADDON_AS_ARRAY(ADDON_ARG(1));
+    try {
+      wrap->bindArguments(static_cast<int>(ADDON_LENGTH(list)),
+                          [&](int i) { return ADDON_GET_INDEX(list, i); },
+                          [&](int index, ADDON_VALUE val) {
+                            if (params.size() < static_cast<size_t>(index)) {
+                              params.resize(index);
+                            }
+                            captureValue(val, params[index - 1]);
+                          });
+    } catch (const std::exception& e) {
+      ADDON_THROW_ERROR(e.what());
+      ADDON_VOID_RETURN();
+    }
+  }
+
+  QueryWorker* worker = new QueryWorker(ADDON_AS_FUNCTION(ADDON_ARG(2)), wrap->async_, op,
+                                        wrap->stmt_->source(),
+                                        !runsAsRead(wrap->stmt_->isReadonly(), wrap->stmt_->isReader()), shape);
+  worker->params.swap(params);
+  queueQuery(worker);
+  ADDON_VOID_RETURN();
+}
+
+// ============================================
+// CSV Import Implementation
+// ============================================
+
+// One import batch, queued as a write so it runs on the writer connection
+// in order with the other writes
+class ImportWorker : public PoolWorker {
+public:
+  ImportWorker(ADDON_FUNCTION_TYPE callback, const AsyncContextPtr& context,
+               const std::shared_ptr<CsvImport>& import, size_t rows)
+    : PoolWorker(callback, context, true)
+    , import_(import)
+    , rows_(rows) {}
+
+  void Execute() {
+    try {
+      PoolLease lease(context_->pool, true);
+      import_->step(lease.get(), rows_);
+    } catch (const std::exception& e) {
+      SetError(e.what());
+    }
+  }
+
+  // { rows, bytesRead, totalBytes, done, columns }
+  ADDON_VALUE OnResult() {
+    const std::vector<std::string>& names = import_->columns();
+    ADDON_ARRAY_TYPE columns = ADDON_ARRAY(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+      ADDON_SET_INDEX(columns, static_cast<uint32_t>(i), ADDON_STRING_LEN(names[i].data(), names[i].size()));
+    }
+
+    ADDON_OBJECT_TYPE state = ADDON_OBJECT();
+    ADDON_SET(state, "rows", ADDON_NUMBER(import_->rowsImported()));
+    ADDON_SET(state, "bytesRead", ADDON_NUMBER(import_->bytesRead()));
+    ADDON_SET(state, "totalBytes", ADDON_NUMBER(import_->totalBytes()));
+    ADDON_SET(state, "done", ADDON_BOOLEAN(import_->isDone()));
+    ADDON_SET(state, "columns", columns);
+    return state;
+  }
+
+private:
+  std::shared_ptr<CsvImport> import_;
+  size_t rows_;
+};
+
+// Parse options (delimiter, quote, escape, trim, skipEmptyLines) as the
+// csv-parser addon reads them, plus header, columns, create, emptyAsNull
+// and inferRows
+static void readImportOptions(ADDON_OBJECT_TYPE opts, CsvImportOptions& options) {
+  static const char* const charNames[] = { "delimiter", "quote", "escape" };
+  char* chars[] = { &options.parse.delimiter, &options.parse.quote, &options.parse.escape };
+  for (int i = 0; i < 3; i++) {
+    ADDON_VALUE val = ADDON_GET(opts, charNames[i]);
+    if (ADDON_IS_STRING(val)) {
+      ADDON_UTF8(str, val);
+      if (ADDON_UTF8_LENGTH(str) > 0) {
+        *chars[i] = ADDON_UTF8_VALUE(str)[0];
+      }
+    }
+  }
+
+  ADDON_VALUE val = ADDON_GET(opts, "trim");
+  if (ADDON_IS_BOOLEAN(val)) {
+    options.parse.trim = ADDON_BOOL_VALUE(val);
+  }
+  val = ADDON_GET(opts, "skipEmptyLines");
+  if (ADDON_IS_BOOLEAN(val)) {
+    options.parse.skipEmptyLines = ADDON_BOOL_VALUE(val);
+  }
+  val = ADDON_GET(opts, "header");
+  if (ADDON_IS_BOOLEAN(val)) {
+    options.header = ADDON_BOOL_VALUE(val);
+  }
+  val = ADDON_GET(opts, "create");
+  if (ADDON_IS_BOOLEAN(val)) {
+    options.create = ADDON_BOOL_VALUE(val);
+  }
+  val = ADDON_GET(opts, "emptyAsNull");
+  if (ADDON_IS_BOOLEAN(val)) {
+    options.emptyAsNull = ADDON_BOOL_VALUE(val);
+  }
+  val = ADDON_GET(opts, "inferRows");
+  if (ADDON_IS_NUMBER(val) && ADDON_TO_DOUBLE(val) >= 1) {
+    options.inferRows = static_cast<size_t>(ADDON_TO_DOUBLE(val));
+  }
+
+  val = ADDON_GET(opts, "columns");
+  if (ADDON_IS_ARRAY(val)) {
+    ADDON_ARRAY_TYPE list = ADDON_AS_ARRAY(val);
+    for (uint32_t i = 0; i < ADDON_LENGTH(list); i++) {
+      ADDON_UTF8(name, ADDON_GET_INDEX(list, i));
+      options.columns.push_back(ADDON_UTF8_VALUE(name));
+    }
+  }
+}
+
+// importCsv(path, table, options): the returned handle's step(rows,
+// callback) imports the next batch
+ADDON_METHOD(DatabaseWrap::ImportCsv) {
+  ADDON_ENV;
+  DatabaseWrap* wrap = ADDON_UNWRAP(DatabaseWrap, ADDON_HOLDER());
+
+  if (!wrap->db_ || !wrap->db_->isOpen()) {
+    ADDON_THROW_ERROR("Database is closed");
+    ADDON_VOID_RETURN();
+  }
+  if (!wrap->async_) {
+    ADDON_THROW_ERROR("CSV import needs a database file");
+    ADDON_VOID_RETURN();
+  }
+  if (ADDON_ARG_COUNT() < 2 || !ADDON_IS_STRING(ADDON_ARG(0)) || !ADDON_IS_STRING(ADDON_ARG(1))) {
+    ADDON_THROW_TYPE_ERROR("Expected (path, table, options)");
+    ADDON_VOID_RETURN();
+  }
+
+  ADDON_UTF8(path, ADDON_ARG(0));
+  ADDON_UTF8(table, ADDON_ARG(1));
+  CsvImportOptions options;
+  if (ADDON_ARG_COUNT() >= 3 && ADDON_IS_OBJECT(ADDON_ARG(2))) {
+    readImportOptions(ADDON_AS_OBJECT(ADDON_ARG(2)), options);
+  }
+
+  try {
+    CsvImport* import = new CsvImport(ADDON_UTF8_VALUE(path), ADDON_UTF8_VALUE(table), options);
+    ADDON_RETURN(ImportWrap::Create(import, wrap->async_));
+  } catch (const std::exception& e) {
+    ADDON_THROW_ERROR(e.what());
+  }
+  ADDON_VOID_RETURN();
+}
+
+void ImportWrap::Init(ADDON_INIT_PARAMS) {
+  ADDON_HANDLE_SCOPE();
+
+  auto tpl = ADDON_NEW_CTOR_TEMPLATE();
+  ADDON_SET_CLASS_NAME(tpl, "CsvImport");
+  ADDON_SET_INTERNAL_FIELD_COUNT(tpl, 1);
+
+  ADDON_SET_PROTOTYPE_METHOD(tpl, "step", Step);
+
+  ADDON_PERSISTENT_RESET(constructor, ADDON_GET_CTOR_FUNCTION(tpl));
+}
+
+ADDON_OBJECT_TYPE ImportWrap::Create(CsvImport* import, const AsyncContextPtr& async) {
+  ADDON_ESCAPABLE_SCOPE();
+
+  auto cons = ADDON_PERSISTENT_GET(constructor);
+  ADDON_OBJECT_TYPE instance = ADDON_NEW_INSTANCE(cons);
+
+  ImportWrap* wrap = new ImportWrap();
+  wrap->import_.reset(import);
+  wrap->async_ = async;
+  wrap->Wrap(instance);
+
+  return ADDON_ESCAPE(instance);
+}
+
+// step(rows, callback): insert up to rows rows in one transaction
+ADDON_METHOD(ImportWrap::Step) {
+  ADDON_ENV;
+  ImportWrap* wrap = ADDON_UNWRAP(ImportWrap, ADDON_HOLDER());
+
+  if (ADDON_ARG_COUNT() < 2 || !ADDON_IS_FUNCTION(ADDON_ARG(1))) {
+    ADDON_THROW_TYPE_ERROR("Expected (rows, callback)");
+    ADDON_VOID_RETURN();
+  }
+
+  size_t rows = DEFAULT_IMPORT_BATCH;
+  if (ADDON_IS_NUMBER(ADDON_ARG(0)) && ADDON_TO_DOUBLE(ADDON_ARG(0)) >= 1) {
+    rows = static_cast<size_t>(ADDON_TO_DOUBLE(ADDON_ARG(0)));
+  }
+
+  queueQuery(new ImportWorker(ADDON_AS_FUNCTION(ADDON_ARG(1)), wrap->async_, wrap->import_, rows));
+  ADDON_VOID_RETURN();
 }
 
 // ============================================
@@ -470,6 +3377,9 @@ void InitSQLite3(ADDON_INIT_PARAMS) {
 
   DatabaseWrap::Init(sqlite3);
   StatementWrap::Init(sqlite3);
+  BlobWrap::Init(sqlite3);
+  BackupWrap::Init(sqlite3);
+  ImportWrap::Init(sqlite3);
 
   ADDON_SET(exports, "sqlite3", sqlite3);
 }
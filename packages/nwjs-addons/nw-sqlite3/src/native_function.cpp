@@ -0,0 +1,128 @@
+#include "native_function.h"
+#include "database.h"
+#include <stdexcept>
+
+namespace nw_sqlite3 {
+
+namespace {
+
+template<typename T> T argValue(sqlite3_value* value);
+
+template<> int32_t argValue<int32_t>(sqlite3_value* value) {
+  return sqlite3_value_int(value);
+}
+
+template<> int64_t argValue<int64_t>(sqlite3_value* value) {
+  return sqlite3_value_int64(value);
+}
+
+template<> double argValue<double>(sqlite3_value* value) {
+  return sqlite3_value_double(value);
+}
+
+void setResult(sqlite3_context* ctx, int32_t value) {
+  sqlite3_result_int(ctx, value);
+}
+
+void setResult(sqlite3_context* ctx, int64_t value) {
+  sqlite3_result_int64(ctx, value);
+}
+
+void setResult(sqlite3_context* ctx, double value) {
+  sqlite3_result_double(ctx, value);
+}
+
+template<typename R, typename A>
+void callTyped(const NativeFunction& fn, sqlite3_context* ctx, sqlite3_value** argv) {
+  R result = R();
+
+  switch (fn.argCount) {
+    case 0:
+      result = reinterpret_cast<R (*)()>(fn.address)();
+      break;
+    case 1:
+      result = reinterpret_cast<R (*)(A)>(fn.address)(argValue<A>(argv[0]));
+      break;
+    case 2:
+      result = reinterpret_cast<R (*)(A, A)>(fn.address)(argValue<A>(argv[0]), argValue<A>(argv[1]));
+      break;
+    case 3:
+      result = reinterpret_cast<R (*)(A, A, A)>(fn.address)(
+        argValue<A>(argv[0]), argValue<A>(argv[1]), argValue<A>(argv[2]));
+      break;
+    case 4:
+      result = reinterpret_cast<R (*)(A, A, A, A)>(fn.address)(
+        argValue<A>(argv[0]), argValue<A>(argv[1]), argValue<A>(argv[2]), argValue<A>(argv[3]));
+      break;
+  }
+
+  setResult(ctx, result);
+}
+
+template<typename R>
+void callReturning(const NativeFunction& fn, sqlite3_context* ctx, sqlite3_value** argv) {
+  switch (fn.args) {
+    case NATIVE_INT32:
+      callTyped<R, int32_t>(fn, ctx, argv);
+      break;
+    case NATIVE_INT64:
+      callTyped<R, int64_t>(fn, ctx, argv);
+      break;
+    case NATIVE_DOUBLE:
+      callTyped<R, double>(fn, ctx, argv);
+      break;
+  }
+}
+
+void invoke(sqlite3_context* ctx, int argc, sqlite3_value** argv) {
+  const NativeFunction& fn = *static_cast<const NativeFunction*>(sqlite3_user_data(ctx));
+
+  for (int i = 0; i < argc; i++) {
+    if (sqlite3_value_type(argv[i]) == SQLITE_NULL) {
+      sqlite3_result_null(ctx);
+      return;
+    }
+  }
+
+  switch (fn.returns) {
+    case NATIVE_INT32:
+      callReturning<int32_t>(fn, ctx, argv);
+      break;
+    case NATIVE_INT64:
+      callReturning<int64_t>(fn, ctx, argv);
+      break;
+    case NATIVE_DOUBLE:
+      callReturning<double>(fn, ctx, argv);
+      break;
+  }
+}
+
+void destroy(void* data) {
+  delete static_cast<NativeFunction*>(data);
+}
+
+} // namespace
+
+void createNativeFunction(Database& db, const std::string& name, const NativeFunction& fn, bool deterministic) {
+  if (!db.isOpen()) {
+    throw std::runtime_error("Database is closed");
+  }
+  if (!fn.address) {
+    throw std::runtime_error("Function address is NULL");
+  }
+  if (fn.argCount < 0 || fn.argCount > MAX_NATIVE_FUNCTION_ARGS) {
+    throw std::runtime_error("Native functions take 0 to 4 arguments");
+  }
+
+  int flags = SQLITE_UTF8 | (deterministic ? SQLITE_DETERMINISTIC : 0);
+  NativeFunction* data = new NativeFunction(fn);
+
+  // SQLite calls destroy() itself if registration fails
+  int rc = sqlite3_create_function_v2(db.handle(), name.c_str(), fn.argCount, flags, data,
+                                      invoke, NULL, NULL, destroy);
+  if (rc != SQLITE_OK) {
+    throw std::runtime_error(db.getError());
+  }
+}
+
+} // namespace nw_sqlite3
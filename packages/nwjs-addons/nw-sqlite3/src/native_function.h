@@ -0,0 +1,48 @@
+#ifndef NW_SQLITE3_NATIVE_FUNCTION_H
+#define NW_SQLITE3_NATIVE_FUNCTION_H
+
+#include <string>
+#include "sqlite3.h"
+
+namespace nw_sqlite3 {
+
+class Database;
+
+// Most arguments a native function can take
+const int MAX_NATIVE_FUNCTION_ARGS = 4;
+
+/**
+ * C types a native function can take and return
+ */
+enum NativeType {
+  NATIVE_INT32,
+  NATIVE_INT64,
+  NATIVE_DOUBLE
+};
+
+/**
+ * A plain C function used as an SQL scalar function, e.g. one compiled
+ * with tinycc (getSymbol()) or loaded from a DLL. All arguments share one
+ * type: double f(double, double), int64_t f(int64_t), ... The function is
+ * called straight from sqlite3_step() with the row's values converted to
+ * that type; a NULL argument makes the result NULL without calling it.
+ */
+struct NativeFunction {
+  void* address;
+  NativeType returns;
+  NativeType args;
+  int argCount;    // 0 .. MAX_NATIVE_FUNCTION_ARGS
+
+  NativeFunction() : address(NULL), returns(NATIVE_DOUBLE), args(NATIVE_DOUBLE), argCount(0) {}
+};
+
+/**
+ * Register fn as SQL function name on db
+ * @param deterministic Same result for the same arguments (lets SQLite
+ *   use it in indexes and factor it out of loops)
+ */
+void createNativeFunction(Database& db, const std::string& name, const NativeFunction& fn, bool deterministic);
+
+} // namespace nw_sqlite3
+
+#endif // NW_SQLITE3_NATIVE_FUNCTION_H
@@ -0,0 +1,157 @@
+#include "result_set.h"
+#include "statement.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace nw_sqlite3 {
+
+void bindValue(Statement& stmt, int index, const BoundValue& value) {
+  switch (value.type) {
+    case SQLITE_INTEGER:
+      stmt.bindInt64(index, value.integer);
+      break;
+    case SQLITE_FLOAT:
+      stmt.bindDouble(index, value.number);
+      break;
+    case SQLITE_TEXT:
+      stmt.bindText(index, value.bytes);
+      break;
+    case SQLITE_BLOB:
+      stmt.bindBlob(index, value.bytes.data(), value.bytes.size());
+      break;
+    default:
+      stmt.bindNull(index);
+      break;
+  }
+}
+
+void bindValues(Statement& stmt, const std::vector<BoundValue>& values) {
+  for (size_t i = 0; i < values.size(); i++) {
+    bindValue(stmt, static_cast<int>(i) + 1, values[i]);
+  }
+}
+
+void ResultColumn::freeBlocks() {
+  for (size_t i = 0; i < blocks.size(); i++) {
+    free(blocks[i]);
+  }
+  blocks.clear();
+  blockSizes.clear();
+}
+
+ResultSet::ResultSet()
+  : changes(0)
+  , lastInsertRowid(0)
+  , rowCount_(0)
+{
+}
+
+ResultSet::~ResultSet() {
+  for (size_t i = 0; i < columns_.size(); i++) {
+    columns_[i].freeBlocks();
+  }
+}
+
+void ResultSet::setNames(Statement& stmt) {
+  const std::vector<ColumnInfo>& info = stmt.columns();
+  columns_.resize(info.size());
+  for (size_t i = 0; i < info.size(); i++) {
+    columns_[i].name = info[i].name;
+  }
+}
+
+bool ResultSet::gather(Statement& stmt, size_t maxRows) {
+  size_t added = 0;
+
+  while (maxRows == 0 || added < maxRows) {
+    if (!stmt.step()) {
+      if (rowCount_ == 0) {
+        setNames(stmt);
+      }
+      return false;
+    }
+
+    // After the first step: a schema change re-prepares in step()
+    if (rowCount_ == 0) {
+      setNames(stmt);
+    }
+
+    for (size_t i = 0; i < columns_.size(); i++) {
+      ResultColumn& column = columns_[i];
+      int index = static_cast<int>(i);
+      int type = stmt.columnType(index);
+      double number = NAN;
+      int size;
+
+      column.offsets.push_back(column.bytes.size());
+
+      switch (type) {
+        case SQLITE_INTEGER:
+          number = static_cast<double>(stmt.getInt64(index));
+          column.sawInteger = true;
+          break;
+
+        case SQLITE_FLOAT:
+          number = stmt.getDouble(index);
+          column.sawFloat = true;
+          break;
+
+        case SQLITE_TEXT: {
+          const char* text = stmt.getTextData(index, &size);
+          column.bytes.append(text, size);
+          column.sawText = true;
+          break;
+        }
+
+        case SQLITE_BLOB: {
+          const void* data = stmt.getBlob(index, &size);
+          column.sawBlob = true;
+
+          if (static_cast<size_t>(size) >= EXTERNAL_BLOB_MIN) {
+            char* block = static_cast<char*>(malloc(size));
+            if (!block) {
+              throw std::bad_alloc();
+            }
+            memcpy(block, data, size);
+            column.blocks.resize(rowCount_ + 1, NULL);
+            column.blockSizes.resize(rowCount_ + 1, 0);
+            column.blocks[rowCount_] = block;
+            column.blockSizes[rowCount_] = size;
+          } else {
+            column.bytes.append(static_cast<const char*>(data), size);
+          }
+          break;
+        }
+
+        default:
+          type = SQLITE_NULL;
+          break;
+      }
+
+      column.classes.push_back(static_cast<uint8_t>(type));
+      column.numbers.push_back(number);
+    }
+
+    rowCount_++;
+    added++;
+  }
+
+  return true;
+}
+
+void ResultSet::clear() {
+  for (size_t i = 0; i < columns_.size(); i++) {
+    ResultColumn& column = columns_[i];
+    column.classes.clear();
+    column.numbers.clear();
+    column.bytes.clear();
+    column.offsets.clear();
+    column.freeBlocks();
+    column.sawInteger = column.sawFloat = column.sawText = column.sawBlob = false;
+  }
+  rowCount_ = 0;
+}
+
+} // namespace nw_sqlite3
@@ -0,0 +1,128 @@
+#ifndef NW_SQLITE3_RESULT_SET_H
+#define NW_SQLITE3_RESULT_SET_H
+
+#include <string>
+#include <vector>
+#include "sqlite3.h"
+
+namespace nw_sqlite3 {
+
+class Statement;
+
+// BLOB cells from this size up get their own block, handed to JS as an
+// external Buffer instead of being copied a second time
+const size_t EXTERNAL_BLOB_MIN = 16 * 1024;
+
+/**
+ * Bind parameter captured on the JS thread so it can be bound on another
+ */
+struct BoundValue {
+  int type;          // SQLITE_INTEGER, SQLITE_FLOAT, SQLITE_TEXT, SQLITE_BLOB or SQLITE_NULL
+  int64_t integer;
+  double number;
+  std::string bytes;
+
+  BoundValue() : type(SQLITE_NULL), integer(0), number(0) {}
+};
+
+/**
+ * Bind one value to parameter index
+ */
+void bindValue(Statement& stmt, int index, const BoundValue& value);
+
+/**
+ * Bind values to parameters 1..n
+ */
+void bindValues(Statement& stmt, const std::vector<BoundValue>& values);
+
+/**
+ * One result column, cell by cell
+ */
+struct ResultColumn {
+  std::string name;
+  std::vector<uint8_t> classes;  // storage class of each row
+  std::vector<double> numbers;   // INTEGER/FLOAT cells, NaN otherwise
+  std::string bytes;             // TEXT/BLOB cells back to back
+  std::vector<size_t> offsets;   // start of each row's cell in bytes
+  std::vector<char*> blocks;     // large BLOB cells (malloc()ed), NULL for the rest
+  std::vector<size_t> blockSizes;
+  bool sawInteger;
+  bool sawFloat;
+  bool sawText;
+  bool sawBlob;
+
+  ResultColumn() : sawInteger(false), sawFloat(false), sawText(false), sawBlob(false) {}
+
+  /**
+   * TEXT/BLOB bytes of a row's cell
+   */
+  const char* data(size_t row) const { return bytes.data() + offsets[row]; }
+  size_t size(size_t row) const {
+    size_t end = row + 1 < offsets.size() ? offsets[row + 1] : bytes.size();
+    return end - offsets[row];
+  }
+
+  /**
+   * Give up a large BLOB cell's block (the caller frees it); NULL if the
+   * cell is in bytes
+   */
+  char* takeBlock(size_t row, size_t* size) {
+    if (row >= blocks.size() || !blocks[row]) {
+      return NULL;
+    }
+    char* block = blocks[row];
+    blocks[row] = NULL;
+    *size = blockSizes[row];
+    return block;
+  }
+
+  /**
+   * Free the blocks nobody took
+   */
+  void freeBlocks();
+};
+
+/**
+ * Rows stepped out of a statement into per-column buffers without
+ * touching V8, so it can be filled on a worker thread and converted to
+ * JS values later
+ */
+class ResultSet {
+public:
+  ResultSet();
+  ~ResultSet();
+
+  /**
+   * Step the statement and append up to maxRows rows (0 = all)
+   * @returns false once the statement has no more rows
+   */
+  bool gather(Statement& stmt, size_t maxRows = 0);
+
+  /**
+   * Drop the rows (column names stay)
+   */
+  void clear();
+
+  size_t rowCount() const { return rowCount_; }
+  const std::vector<ResultColumn>& columns() const { return columns_; }
+  std::vector<ResultColumn>& columns() { return columns_; }
+
+  /**
+   * Filled by whoever ran a statement that returns no rows
+   */
+  int changes;
+  int64_t lastInsertRowid;
+
+private:
+  ResultSet(const ResultSet&);
+  ResultSet& operator=(const ResultSet&);
+
+  void setNames(Statement& stmt);
+
+  std::vector<ResultColumn> columns_;
+  size_t rowCount_;
+};
+
+} // namespace nw_sqlite3
+
+#endif // NW_SQLITE3_RESULT_SET_H
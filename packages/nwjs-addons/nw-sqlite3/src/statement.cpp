@@ -1,7 +1,9 @@
 #include "statement.h"
 #include "database.h"
+#include <chrono>
 #include <stdexcept>
 #include <cstring>
+#include <cctype>
 
 namespace nw_sqlite3 {
 
@@ -11,16 +13,25 @@ Statement::Statement(Database* db, const std::string& sql)
   , stmt_(NULL)
   , isReader_(false)
   , hasRun_(false)
+  , columnsVersion_(0)
+  , columnsPrepared_(-1)
+  , executions_(0)
+  , rows_(0)
+  , totalTime_(0)
+  , maxStepTime_(0)
 {
   if (!db || !db->isOpen()) {
     throw std::runtime_error("Database is closed");
   }
 
-  int rc = sqlite3_prepare_v2(db->handle(), sql.c_str(), -1, &stmt_, NULL);
+  stmt_ = db->acquireStatement(sql);
+  db->attach(this);
 
-  if (rc != SQLITE_OK) {
-    throw std::runtime_error(db->getError());
-  }
+  // A cached statement still has the counts of its previous users
+  sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+  sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_SORT, 1);
+  sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+  sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_VM_STEP, 1);
 
   // Determine if this is a reader (SELECT, PRAGMA, etc.)
   // by checking if it returns columns
@@ -29,6 +40,9 @@ Statement::Statement(Database* db, const std::string& sql)
 
 Statement::~Statement() {
   finalize();
+  if (db_) {
+    db_->detach(this);
+  }
 }
 
 Statement::Statement(const Statement& other) {
@@ -37,6 +51,12 @@ Statement::Statement(const Statement& other) {
   stmt_ = NULL;
   isReader_ = other.isReader_;
   hasRun_ = false;
+  columnsVersion_ = 0;
+  columnsPrepared_ = -1;
+  executions_ = 0;
+  rows_ = 0;
+  totalTime_ = 0;
+  maxStepTime_ = 0;
 }
 
 Statement& Statement::operator=(const Statement& other) {
@@ -47,6 +67,8 @@ Statement& Statement::operator=(const Statement& other) {
     stmt_ = NULL;
     isReader_ = other.isReader_;
     hasRun_ = false;
+    columns_.clear();
+    columnsPrepared_ = -1;
   }
   return *this;
 }
@@ -112,21 +134,66 @@ int Statement::getParameterIndex(const std::string& name) const {
   return sqlite3_bind_parameter_index(stmt_, name.c_str());
 }
 
+int Statement::parameterCount() const {
+  checkValid();
+  return sqlite3_bind_parameter_count(stmt_);
+}
+
+std::string Statement::parameterName(int index) const {
+  checkValid();
+  const char* name = sqlite3_bind_parameter_name(stmt_, index);
+  if (!name || name[0] == '?') {
+    return std::string();
+  }
+  return std::string(name + 1);
+}
+
 bool Statement::step() {
   checkValid();
   hasRun_ = true;
 
-  int rc = sqlite3_step(stmt_);
+  if (!sqlite3_stmt_busy(stmt_)) {
+    executions_++;
+  }
+  db_->startStep();
+
+  int rc;
+  if (db_->statementTiming()) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    rc = sqlite3_step(stmt_);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    totalTime_ += ms;
+    if (ms > maxStepTime_) {
+      maxStepTime_ = ms;
+    }
+  } else {
+    rc = sqlite3_step(stmt_);
+  }
+  db_->endStep();
 
   if (rc == SQLITE_ROW) {
+    rows_++;
     return true;
   } else if (rc == SQLITE_DONE) {
     return false;
   } else {
-    throw std::runtime_error(db_->getError());
+    throw std::runtime_error(db_->stepError());
   }
 }
 
+StatementStats Statement::stats() const {
+  StatementStats stats;
+  stats.executions = executions_;
+  stats.rows = rows_;
+  stats.totalTime = totalTime_;
+  stats.maxStepTime = maxStepTime_;
+  stats.fullscanSteps = stmt_ ? sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_FULLSCAN_STEP, 0) : 0;
+  stats.sorts = stmt_ ? sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_SORT, 0) : 0;
+  stats.autoindexes = stmt_ ? sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_AUTOINDEX, 0) : 0;
+  stats.vmSteps = stmt_ ? sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_VM_STEP, 0) : 0;
+  return stats;
+}
+
 void Statement::reset() {
   checkValid();
   sqlite3_reset(stmt_);
@@ -140,11 +207,17 @@ void Statement::clearBindings() {
 
 void Statement::finalize() {
   if (stmt_) {
-    sqlite3_finalize(stmt_);
+    // Back to the statement cache for the next prepare of this SQL
+    db_->releaseStatement(source_, stmt_);
     stmt_ = NULL;
   }
 }
 
+void Statement::detachDatabase() {
+  finalize();
+  db_ = NULL;
+}
+
 int Statement::columnCount() const {
   checkValid();
   return sqlite3_column_count(stmt_);
@@ -161,6 +234,53 @@ int Statement::columnType(int index) const {
   return sqlite3_column_type(stmt_, index);
 }
 
+// Affinity rules from https://sqlite.org/datatype3.html section 3.1
+static int declaredAffinity(const char* decl) {
+  if (!decl || !*decl) {
+    return SQLITE_NULL;
+  }
+
+  std::string type(decl);
+  for (size_t i = 0; i < type.size(); i++) {
+    type[i] = static_cast<char>(toupper(static_cast<unsigned char>(type[i])));
+  }
+
+  if (type.find("INT") != std::string::npos) {
+    return SQLITE_INTEGER;
+  }
+  if (type.find("CHAR") != std::string::npos || type.find("CLOB") != std::string::npos ||
+      type.find("TEXT") != std::string::npos) {
+    return SQLITE_TEXT;
+  }
+  if (type.find("BLOB") != std::string::npos) {
+    return SQLITE_BLOB;
+  }
+  if (type.find("REAL") != std::string::npos || type.find("FLOA") != std::string::npos ||
+      type.find("DOUB") != std::string::npos) {
+    return SQLITE_FLOAT;
+  }
+  return SQLITE_NULL;
+}
+
+const std::vector<ColumnInfo>& Statement::columns() {
+  checkValid();
+
+  int prepared = sqlite3_stmt_status(stmt_, SQLITE_STMTSTATUS_REPREPARE, 0);
+  if (prepared != columnsPrepared_) {
+    int count = sqlite3_column_count(stmt_);
+    columns_.resize(count);
+    for (int i = 0; i < count; i++) {
+      const char* name = sqlite3_column_name(stmt_, i);
+      columns_[i].name = name ? name : "";
+      columns_[i].type = declaredAffinity(sqlite3_column_decltype(stmt_, i));
+    }
+    columnsPrepared_ = prepared;
+    columnsVersion_++;
+  }
+
+  return columns_;
+}
+
 int Statement::getInt(int index) const {
   checkValid();
   return sqlite3_column_int(stmt_, index);
@@ -186,6 +306,13 @@ std::string Statement::getText(int index) const {
   return "";
 }
 
+const char* Statement::getTextData(int index, int* size) const {
+  checkValid();
+  const unsigned char* text = sqlite3_column_text(stmt_, index);
+  *size = sqlite3_column_bytes(stmt_, index);
+  return reinterpret_cast<const char*>(text);
+}
+
 const void* Statement::getBlob(int index, int* size) const {
   checkValid();
   *size = sqlite3_column_bytes(stmt_, index);
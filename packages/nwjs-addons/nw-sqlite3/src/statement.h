@@ -11,12 +11,29 @@ class Database;
 
 /**
  * Column information
+ * type is the declared type's affinity as SQLITE_INTEGER, SQLITE_FLOAT,
+ * SQLITE_TEXT or SQLITE_BLOB, or SQLITE_NULL for expressions and
+ * NUMERIC columns (no single storage class)
  */
 struct ColumnInfo {
   std::string name;
   int type;
 };
 
+/**
+ * Counters of one Statement since it was prepared
+ */
+struct StatementStats {
+  uint64_t executions;   // runs started (first step after prepare, reset or completion)
+  uint64_t rows;         // rows returned
+  double totalTime;      // ms spent in sqlite3_step() while statement timing is on
+  double maxStepTime;    // longest single sqlite3_step(), ms
+  int fullscanSteps;     // SQLITE_STMTSTATUS_FULLSCAN_STEP
+  int sorts;             // SQLITE_STMTSTATUS_SORT
+  int autoindexes;       // SQLITE_STMTSTATUS_AUTOINDEX
+  int vmSteps;           // SQLITE_STMTSTATUS_VM_STEP
+};
+
 /**
  * SQLite Statement wrapper
  * Represents a prepared SQL statement
@@ -40,6 +57,11 @@ public:
    */
   bool isReader() const { return isReader_; }
 
+  /**
+   * Check if statement leaves the database unchanged (sqlite3_stmt_readonly)
+   */
+  bool isReadonly() const { return stmt_ == NULL || sqlite3_stmt_readonly(stmt_) != 0; }
+
   /**
    * Get SQL source
    */
@@ -60,6 +82,16 @@ public:
    */
   int getParameterIndex(const std::string& name) const;
 
+  /**
+   * Number of parameters (the largest index)
+   */
+  int parameterCount() const;
+
+  /**
+   * Name of a parameter without its @, : or $ prefix ("" for ?)
+   */
+  std::string parameterName(int index) const;
+
   /**
    * Step to next row
    * @returns true if has row, false if done
@@ -96,6 +128,18 @@ public:
    */
   int columnType(int index) const;
 
+  /**
+   * Result column names and declared types, read once per statement and
+   * again only after SQLite re-prepares it (schema change)
+   */
+  const std::vector<ColumnInfo>& columns();
+
+  /**
+   * Bumped each time columns() is re-read, so callers can cache what
+   * they derive from it
+   */
+  unsigned columnsVersion() const { return columnsVersion_; }
+
   /**
    * Get column values (0-based index)
    */
@@ -103,6 +147,7 @@ public:
   int64_t getInt64(int index) const;
   double getDouble(int index) const;
   std::string getText(int index) const;
+  const char* getTextData(int index, int* size) const;
   const void* getBlob(int index, int* size) const;
   bool isNull(int index) const;
 
@@ -121,12 +166,36 @@ public:
    */
   bool isValid() const { return stmt_ != NULL; }
 
+  /**
+   * Execution counters; the step times are only collected while
+   * Database::statementTiming() is on
+   */
+  StatementStats stats() const;
+
+  /**
+   * Owning database (NULL once detached)
+   */
+  Database* database() const { return db_; }
+
+  /**
+   * Called by Database::close(): finalize and forget the database
+   */
+  void detachDatabase();
+
 private:
   Database* db_;
   std::string source_;
   sqlite3_stmt* stmt_;
   bool isReader_;
   bool hasRun_;
+  std::vector<ColumnInfo> columns_;
+  unsigned columnsVersion_;
+  int columnsPrepared_;  // SQLITE_STMTSTATUS_REPREPARE when columns_ was read
+
+  uint64_t executions_;
+  uint64_t rows_;
+  double totalTime_;
+  double maxStepTime_;
 
   void checkValid() const;
 };
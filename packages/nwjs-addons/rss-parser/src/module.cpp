@@ -1,5 +1,4 @@
 #include "addon_api.h"
-#include <fstream>
 #include "rss_parser.h"
 
 using namespace rssparser;
@@ -63,17 +62,13 @@ ADDON_METHOD(RssParseFile) {
   }
 
   ADDON_UTF8(filePath, ADDON_ARG(0));
-  std::string path(ADDON_UTF8_VALUE(filePath));
-
-  // Check if file exists
-  std::ifstream testFile(path.c_str());
-  if (!testFile.is_open()) {
+  std::string content;
+  if (!readFileContents(std::string(ADDON_UTF8_VALUE(filePath)), content)) {
     ADDON_THROW_ERROR("Could not open file");
     ADDON_VOID_RETURN();
   }
-  testFile.close();
 
-  Feed feed = parseFile(path);
+  Feed feed = parse(content);
   ADDON_RETURN(feedToJsObject(feed));
 }
 
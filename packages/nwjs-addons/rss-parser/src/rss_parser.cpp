@@ -1,6 +1,5 @@
 #include "rss_parser.h"
-#include <fstream>
-#include <sstream>
+#include "file_view.h"
 #include <algorithm>
 
 namespace rssparser {
@@ -308,25 +307,35 @@ static Feed parseAtom(const std::string& xml) {
 }
 
 std::string readFileContents(const std::string& filePath) {
-  std::ifstream file(filePath.c_str(), std::ios::binary);
-  if (!file.is_open()) {
-    return "";
+  std::string content;
+  readFileContents(filePath, content);
+  return content;
+}
+
+bool readFileContents(const std::string& filePath, std::string& content) {
+  content.clear();
+
+  FileView file;
+  if (!file.open(filePath)) {
+    return false;
   }
 
-  std::stringstream buffer;
-  buffer << file.rdbuf();
-  std::string content = buffer.str();
-  file.close();
+  const char* data = file.data();
+  size_t size = file.size();
 
   // Skip UTF-8 BOM if present
-  if (content.length() >= 3 &&
-      (unsigned char)content[0] == 0xEF &&
-      (unsigned char)content[1] == 0xBB &&
-      (unsigned char)content[2] == 0xBF) {
-    content = content.substr(3);
+  if (size >= 3 &&
+      (unsigned char)data[0] == 0xEF &&
+      (unsigned char)data[1] == 0xBB &&
+      (unsigned char)data[2] == 0xBF) {
+    data += 3;
+    size -= 3;
   }
 
-  return content;
+  // The parser works on std::string, so this is the one copy the file
+  // makes on its way in
+  content.assign(data, size);
+  return true;
 }
 
 Feed parse(const std::string& xml) {
@@ -38,6 +38,9 @@ Feed parseFile(const std::string& filePath);
 // Read file contents with UTF-8 BOM handling
 std::string readFileContents(const std::string& filePath);
 
+// As above, but reports whether the file could be opened at all
+bool readFileContents(const std::string& filePath, std::string& content);
+
 } // namespace rssparser
 
 #endif
@@ -8,6 +8,8 @@
 #pragma once
 
 #include <nan.h>
+#include <cstring>
+#include <string>
 
 // ─── Type aliases ───────────────────────────────────────────────────────────
 
@@ -15,6 +17,7 @@
 #define ADDON_OBJECT_TYPE     v8::Local<v8::Object>
 #define ADDON_ARRAY_TYPE      v8::Local<v8::Array>
 #define ADDON_STRING_TYPE     v8::Local<v8::String>
+#define ADDON_FUNCTION_TYPE   v8::Local<v8::Function>
 
 // ─── Method signatures & module registration ────────────────────────────────
 
@@ -51,6 +54,11 @@
 // ─── Value creation ─────────────────────────────────────────────────────────
 
 #define ADDON_STRING(str)           Nan::New(str).ToLocalChecked()
+#define ADDON_STRING_LEN(str, len)  Nan::New(str, static_cast<int>(len)).ToLocalChecked()
+// Internalized string, for property names used over and over
+#define ADDON_KEY_LEN(str, len) \
+  v8::String::NewFromUtf8(v8::Isolate::GetCurrent(), str, \
+    v8::NewStringType::kInternalized, static_cast<int>(len)).ToLocalChecked()
 #define ADDON_BOOL(val)             Nan::New(static_cast<bool>(val))
 #define ADDON_INT(val)              Nan::New(static_cast<int32_t>(val))
 #define ADDON_UINT(val)             Nan::New<v8::Integer>(static_cast<uint32_t>(val))
@@ -99,6 +107,7 @@
 #define ADDON_CAST_ARRAY(v)         v8::Local<v8::Array>::Cast(v)
 #define ADDON_AS_ARRAY(v)           (v).As<v8::Array>()
 #define ADDON_AS_OBJECT(v)          (v).As<v8::Object>()
+#define ADDON_AS_FUNCTION(v)        (v).As<v8::Function>()
 #define ADDON_CAST_EXTERNAL_PTR(v)  v8::Local<v8::External>::Cast(v)->Value()
 
 // ─── String handling ────────────────────────────────────────────────────────
@@ -110,10 +119,13 @@
 // ─── Object / Array operations ──────────────────────────────────────────────
 
 #define ADDON_SET(obj, key, val)        Nan::Set(obj, ADDON_STRING(key), val)
+#define ADDON_SET_KEY(obj, key, val)    Nan::Set(obj, key, val)
 #define ADDON_SET_INDEX(arr, i, val)    Nan::Set(arr, static_cast<uint32_t>(i), val)
 #define ADDON_GET(obj, key)             Nan::Get(obj, ADDON_STRING(key)).ToLocalChecked()
+#define ADDON_GET_KEY(obj, key)         Nan::Get(obj, key).ToLocalChecked()
 #define ADDON_GET_INDEX(arr, i)         Nan::Get(arr, static_cast<uint32_t>(i)).ToLocalChecked()
 #define ADDON_HAS(obj, key)             Nan::Has(obj, ADDON_STRING(key)).FromJust()
+#define ADDON_PROPERTY_NAMES(obj)       Nan::GetPropertyNames(obj).ToLocalChecked()
 #define ADDON_LENGTH(arr)               (arr)->Length()
 
 // ─── Error handling ─────────────────────────────────────────────────────────
@@ -133,6 +145,11 @@
 #define ADDON_BUFFER_DATA(val)      node::Buffer::Data(val)
 #define ADDON_BUFFER_LENGTH(val)    node::Buffer::Length(val)
 #define ADDON_COPY_BUFFER(data, sz) Nan::CopyBuffer(data, sz).ToLocalChecked()
+// Takes ownership of malloc()ed data; freed when the Buffer is collected
+#define ADDON_NEW_BUFFER(data, sz)  Nan::NewBuffer(data, static_cast<uint32_t>(sz)).ToLocalChecked()
+// Same, for memory released by fn(char* data, void* hint) instead of free()
+#define ADDON_NEW_BUFFER_FREE(data, sz, fn) \
+  Nan::NewBuffer(data, static_cast<uint32_t>(sz), fn, NULL).ToLocalChecked()
 
 // ─── Function export (flat addons) ──────────────────────────────────────────
 
@@ -163,8 +180,74 @@
 // Persistent handles
 #define ADDON_PERSISTENT_FUNCTION                Nan::Persistent<v8::Function>
 #define ADDON_PERSISTENT_TEMPLATE                Nan::Persistent<v8::FunctionTemplate>
+#define ADDON_PERSISTENT_ARRAY                   Nan::Persistent<v8::Array>
 #define ADDON_PERSISTENT_RESET(p, val)           (p).Reset(val)
 #define ADDON_PERSISTENT_GET(p)                  Nan::New(p)
+#define ADDON_PERSISTENT_CLEAR(p)                (p).Reset()
+#define ADDON_PERSISTENT_IS_EMPTY(p)             (p).IsEmpty()
+
+// val was created from the persistent template tpl (or a subclass)
+#define ADDON_HAS_INSTANCE(tpl, val)             Nan::New(tpl)->HasInstance(val)
+
+// ─── Calling JS ─────────────────────────────────────────────────────────────
+// Synchronous call from native code already running on the JS thread (e.g.
+// a callback invoked inside a method). A thrown exception is caught and its
+// message stored in error; the macro evaluates to false in that case.
+
+namespace addon_detail {
+
+inline bool call_function(v8::Local<v8::Function> fn, int argc, v8::Local<v8::Value>* argv,
+                          v8::Local<v8::Value>* result, std::string* error) {
+  Nan::TryCatch tryCatch;
+  Nan::MaybeLocal<v8::Value> value = Nan::Call(fn, Nan::GetCurrentContext()->Global(), argc, argv);
+  if (tryCatch.HasCaught() || value.IsEmpty()) {
+    v8::Local<v8::Value> exception = tryCatch.Exception();
+    if (exception->IsObject()) {
+      exception = Nan::Get(exception.As<v8::Object>(), Nan::New("message").ToLocalChecked())
+                    .FromMaybe(exception);
+    }
+    Nan::Utf8String message(exception);
+    *error = *message ? *message : "Unknown error";
+    return false;
+  }
+  *result = value.ToLocalChecked();
+  return true;
+}
+
+} // namespace addon_detail
+
+#define ADDON_CALL_FUNCTION(fn, argc, argv, result, error) \
+  addon_detail::call_function(fn, static_cast<int>(argc), argv, &(result), &(error))
+
+// ─── Async work ─────────────────────────────────────────────────────────────
+// Subclasses implement Execute() (libuv thread pool: no V8 access, report
+// failures with SetError) and OnResult() (JS thread). The callback gets
+// (null, OnResult()) on success or (Error) after SetError. Queued workers
+// delete themselves once the callback has run.
+
+namespace addon_detail {
+
+class AsyncWorkerBase : public Nan::AsyncWorker {
+public:
+  explicit AsyncWorkerBase(v8::Local<v8::Function> callback)
+    : Nan::AsyncWorker(new Nan::Callback(callback)) {}
+
+  virtual v8::Local<v8::Value> OnResult() { return Nan::Undefined(); }
+
+  void SetError(const std::string& message) { SetErrorMessage(message.c_str()); }
+
+protected:
+  void HandleOKCallback() {
+    Nan::HandleScope scope;
+    v8::Local<v8::Value> argv[] = { Nan::Null(), OnResult() };
+    callback->Call(2, argv);
+  }
+};
+
+} // namespace addon_detail
+
+#define ADDON_ASYNC_WORKER          addon_detail::AsyncWorkerBase
+#define ADDON_QUEUE_WORKER(worker)  Nan::AsyncQueueWorker(worker)
 
 // ─── TypedArray (legacy V8 3.x API) ────────────────────────────────────────
 
@@ -173,3 +256,48 @@
 
 #define ADDON_GET_TYPEDARRAY_DATA(obj) \
   ((obj).As<v8::Object>()->GetIndexedPropertiesExternalArrayData())
+
+#define ADDON_GET_TYPEDARRAY_LENGTH(obj) \
+  static_cast<size_t>((obj).As<v8::Object>()->GetIndexedPropertiesExternalArrayDataLength())
+
+// Element type, compared against the ADDON_TYPEDARRAY_* constants
+#define ADDON_GET_TYPEDARRAY_TYPE(obj) \
+  static_cast<int>((obj).As<v8::Object>()->GetIndexedPropertiesExternalArrayDataType())
+
+#define ADDON_TYPEDARRAY_INT8           v8::kExternalInt8Array
+#define ADDON_TYPEDARRAY_UINT8          v8::kExternalUint8Array
+#define ADDON_TYPEDARRAY_UINT8_CLAMPED  v8::kExternalUint8ClampedArray
+#define ADDON_TYPEDARRAY_INT16          v8::kExternalInt16Array
+#define ADDON_TYPEDARRAY_UINT16         v8::kExternalUint16Array
+#define ADDON_TYPEDARRAY_INT32          v8::kExternalInt32Array
+#define ADDON_TYPEDARRAY_UINT32         v8::kExternalUint32Array
+#define ADDON_TYPEDARRAY_FLOAT32        v8::kExternalFloat32Array
+#define ADDON_TYPEDARRAY_FLOAT64        v8::kExternalFloat64Array
+
+// Typed array creation: new ArrayBuffer filled from a native array
+namespace addon_detail {
+
+template<typename TArray>
+inline v8::Local<TArray> new_typed_array(const void* data, size_t length, size_t elementSize) {
+  size_t byteLength = length * elementSize;
+  v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(v8::Isolate::GetCurrent(), byteLength);
+  if (byteLength > 0) {
+#if defined(V8_MAJOR_VERSION) && V8_MAJOR_VERSION >= 8
+    memcpy(buffer->GetBackingStore()->Data(), data, byteLength);
+#else
+    memcpy(buffer->GetContents().Data(), data, byteLength);
+#endif
+  }
+  return TArray::New(buffer, 0, length);
+}
+
+} // namespace addon_detail
+
+#define ADDON_INT32_ARRAY(data, len) \
+  addon_detail::new_typed_array<v8::Int32Array>(data, len, sizeof(int32_t))
+#define ADDON_UINT32_ARRAY(data, len) \
+  addon_detail::new_typed_array<v8::Uint32Array>(data, len, sizeof(uint32_t))
+#define ADDON_UINT8_ARRAY(data, len) \
+  addon_detail::new_typed_array<v8::Uint8Array>(data, len, sizeof(uint8_t))
+#define ADDON_FLOAT64_ARRAY(data, len) \
+  addon_detail::new_typed_array<v8::Float64Array>(data, len, sizeof(double))
@@ -18,6 +18,7 @@
 #include <cstdint>
 #include <climits>
 #include <cmath>
+#include <cstring>
 
 // ─── Internal helpers ──────────────────────────────────────────────────────
 
@@ -62,6 +63,18 @@ inline void* get_typedarray_data(Napi::Value val) {
   return data;
 }
 
+inline size_t get_typedarray_length(Napi::Value val) {
+  size_t length = 0;
+  napi_get_typedarray_info(tls_env(), val, nullptr, &length, nullptr, nullptr, nullptr);
+  return length;
+}
+
+inline int get_typedarray_type(Napi::Value val) {
+  napi_typedarray_type type = napi_int8_array;
+  napi_get_typedarray_info(tls_env(), val, &type, nullptr, nullptr, nullptr, nullptr);
+  return static_cast<int>(type);
+}
+
 // ─── Constructor template builder ──────────────────────────────────────────
 // Accumulates property descriptors, then builds the class via napi_define_class.
 // Mirrors the NAN pattern: create template → add methods/accessors → GetFunction.
@@ -123,6 +136,14 @@ inline void persistent_reset(Napi::FunctionReference& ref, AddonCtorTemplate& tp
   ref = Napi::Persistent(finalize_class(tpl));
 }
 
+inline void persistent_reset(Napi::Reference<Napi::Array>& ref, Napi::Array array) {
+  ref = Napi::Persistent(array);
+}
+
+inline bool has_instance(Napi::FunctionReference& tpl, Napi::Value val) {
+  return val.IsObject() && val.As<Napi::Object>().InstanceOf(tpl.Value());
+}
+
 // ─── ObjectWrap base class ─────────────────────────────────────────────────
 // Uses low-level napi_wrap/napi_unwrap to avoid CRTP (Napi::ObjectWrap<T>
 // requires the class itself as template parameter, which doesn't fit the
@@ -149,6 +170,26 @@ private:
   }
 };
 
+// ─── Async worker base ─────────────────────────────────────────────────────
+// Same contract as the NAN backend: Execute() on the thread pool,
+// OnResult() on the JS thread, callback(null, result) or callback(Error).
+
+class AsyncWorkerBase : public Napi::AsyncWorker {
+public:
+  explicit AsyncWorkerBase(Napi::Function callback)
+    : Napi::AsyncWorker(callback) {}
+
+  virtual Napi::Value OnResult() { return Env().Undefined(); }
+
+protected:
+  void OnOK() {
+    // Result-building helpers use the ADDON_* macros, which need the TLS env
+    tls_env() = Env();
+    Napi::HandleScope scope(Env());
+    Callback().Call({ Env().Null(), OnResult() });
+  }
+};
+
 } // namespace addon_detail
 
 // ─── Type aliases ───────────────────────────────────────────────────────────
@@ -157,6 +198,7 @@ private:
 #define ADDON_OBJECT_TYPE   Napi::Object
 #define ADDON_ARRAY_TYPE    Napi::Array
 #define ADDON_STRING_TYPE   Napi::String
+#define ADDON_FUNCTION_TYPE Napi::Function
 
 // ─── Method signatures & module registration ────────────────────────────────
 
@@ -213,6 +255,9 @@ private:
 // ─── Value creation ─────────────────────────────────────────────────────────
 
 #define ADDON_STRING(str)    Napi::String::New(addon_detail::env(), str)
+#define ADDON_STRING_LEN(str, len) Napi::String::New(addon_detail::env(), str, static_cast<size_t>(len))
+// Property-name string (N-API has no portable way to ask for internalized)
+#define ADDON_KEY_LEN(str, len)    Napi::String::New(addon_detail::env(), str, static_cast<size_t>(len))
 #define ADDON_BOOL(val)      Napi::Boolean::New(addon_detail::env(), static_cast<bool>(val))
 #define ADDON_INT(val)       Napi::Number::New(addon_detail::env(), static_cast<int32_t>(val))
 #define ADDON_UINT(val)      Napi::Number::New(addon_detail::env(), static_cast<uint32_t>(val))
@@ -261,6 +306,7 @@ private:
 #define ADDON_CAST_ARRAY(v)         (v).As<Napi::Array>()
 #define ADDON_AS_ARRAY(v)           (v).As<Napi::Array>()
 #define ADDON_AS_OBJECT(v)          (v).As<Napi::Object>()
+#define ADDON_AS_FUNCTION(v)        (v).As<Napi::Function>()
 #define ADDON_CAST_EXTERNAL_PTR(v)  (v).As<Napi::External<void>>().Data()
 
 // ─── String handling ────────────────────────────────────────────────────────
@@ -272,10 +318,13 @@ private:
 // ─── Object / Array operations ──────────────────────────────────────────────
 
 #define ADDON_SET(obj, key, val)     (obj).Set(key, val)
+#define ADDON_SET_KEY(obj, key, val) (obj).Set(key, val)
 #define ADDON_SET_INDEX(arr, i, val) (arr).Set(static_cast<uint32_t>(i), val)
 #define ADDON_GET(obj, key)          (obj).Get(key)
+#define ADDON_GET_KEY(obj, key)      (obj).Get(key)
 #define ADDON_GET_INDEX(arr, i)      (arr).Get(static_cast<uint32_t>(i))
 #define ADDON_HAS(obj, key)          (obj).Has(key)
+#define ADDON_PROPERTY_NAMES(obj)    (obj).GetPropertyNames()
 #define ADDON_LENGTH(arr)            (arr).Length()
 
 // ─── Error handling ─────────────────────────────────────────────────────────
@@ -302,6 +351,14 @@ private:
 #define ADDON_BUFFER_LENGTH(val) (val).As<Napi::Buffer<char>>().Length()
 #define ADDON_COPY_BUFFER(data, sz) \
   Napi::Buffer<char>::Copy(addon_detail::env(), data, static_cast<size_t>(sz))
+// Takes ownership of malloc()ed data; freed when the Buffer is collected
+#define ADDON_NEW_BUFFER(data, sz) \
+  Napi::Buffer<char>::New(addon_detail::env(), data, static_cast<size_t>(sz), \
+                          [](Napi::Env, char* owned) { free(owned); })
+// Same, for memory released by fn(char* data, void* hint) instead of free()
+#define ADDON_NEW_BUFFER_FREE(data, sz, fn) \
+  Napi::Buffer<char>::New(addon_detail::env(), data, static_cast<size_t>(sz), \
+                          [](Napi::Env, char* owned) { fn(owned, nullptr); })
 
 // ─── Function export (flat addons) ──────────────────────────────────────────
 
@@ -343,10 +400,82 @@ private:
 // Persistent handles — both function and template map to FunctionReference
 #define ADDON_PERSISTENT_FUNCTION              Napi::FunctionReference
 #define ADDON_PERSISTENT_TEMPLATE              Napi::FunctionReference
+#define ADDON_PERSISTENT_ARRAY                 Napi::Reference<Napi::Array>
 #define ADDON_PERSISTENT_RESET(p, val)         addon_detail::persistent_reset(p, val)
 #define ADDON_PERSISTENT_GET(p)                (p).Value()
+#define ADDON_PERSISTENT_CLEAR(p)              (p).Reset()
+#define ADDON_PERSISTENT_IS_EMPTY(p)           (p).IsEmpty()
+
+// val was created from the persistent template tpl (or a subclass).
+// instanceof can be fooled through the prototype chain, so unwrapping
+// still has to allow for NULL.
+#define ADDON_HAS_INSTANCE(tpl, val)           addon_detail::has_instance(tpl, val)
+
+// ─── Calling JS ─────────────────────────────────────────────────────────────
+// Synchronous call from native code already running on the JS thread (e.g.
+// a callback invoked inside a method). A thrown exception is cleared and its
+// message stored in error; the macro evaluates to false in that case.
+
+namespace addon_detail {
+
+inline bool call_function(Napi::Function fn, size_t argc, Napi::Value* argv,
+                          Napi::Value* result, std::string* error) {
+  Napi::Env e = env();
+  std::vector<napi_value> args(argv, argv + argc);
+  Napi::Value value = fn.Call(e.Global(), args);
+  if (e.IsExceptionPending()) {
+    Napi::Error exception = e.GetAndClearPendingException();
+    *error = exception.Message();
+    return false;
+  }
+  *result = value;
+  return true;
+}
+
+} // namespace addon_detail
+
+#define ADDON_CALL_FUNCTION(fn, argc, argv, result, error) \
+  addon_detail::call_function(fn, static_cast<size_t>(argc), argv, &(result), &(error))
+
+// ─── Async work ─────────────────────────────────────────────────────────────
+
+#define ADDON_ASYNC_WORKER          addon_detail::AsyncWorkerBase
+#define ADDON_QUEUE_WORKER(worker)  (worker)->Queue()
 
 // ─── TypedArray ─────────────────────────────────────────────────────────────
 
 #define ADDON_IS_TYPEDARRAY(obj)          (obj).IsTypedArray()
 #define ADDON_GET_TYPEDARRAY_DATA(obj)    addon_detail::get_typedarray_data(obj)
+#define ADDON_GET_TYPEDARRAY_LENGTH(obj)  addon_detail::get_typedarray_length(obj)
+
+// Element type, compared against the ADDON_TYPEDARRAY_* constants
+#define ADDON_GET_TYPEDARRAY_TYPE(obj)    addon_detail::get_typedarray_type(obj)
+
+#define ADDON_TYPEDARRAY_INT8             napi_int8_array
+#define ADDON_TYPEDARRAY_UINT8            napi_uint8_array
+#define ADDON_TYPEDARRAY_UINT8_CLAMPED    napi_uint8_clamped_array
+#define ADDON_TYPEDARRAY_INT16            napi_int16_array
+#define ADDON_TYPEDARRAY_UINT16           napi_uint16_array
+#define ADDON_TYPEDARRAY_INT32            napi_int32_array
+#define ADDON_TYPEDARRAY_UINT32           napi_uint32_array
+#define ADDON_TYPEDARRAY_FLOAT32          napi_float32_array
+#define ADDON_TYPEDARRAY_FLOAT64          napi_float64_array
+
+// Typed array creation: new ArrayBuffer filled from a native array
+namespace addon_detail {
+
+template<typename T>
+inline Napi::TypedArrayOf<T> new_typed_array(const T* data, size_t length) {
+  Napi::TypedArrayOf<T> array = Napi::TypedArrayOf<T>::New(env(), length);
+  if (length > 0) {
+    memcpy(array.Data(), data, length * sizeof(T));
+  }
+  return array;
+}
+
+} // namespace addon_detail
+
+#define ADDON_INT32_ARRAY(data, len)   addon_detail::new_typed_array<int32_t>(data, len)
+#define ADDON_UINT32_ARRAY(data, len)  addon_detail::new_typed_array<uint32_t>(data, len)
+#define ADDON_UINT8_ARRAY(data, len)   addon_detail::new_typed_array<uint8_t>(data, len)
+#define ADDON_FLOAT64_ARRAY(data, len) addon_detail::new_typed_array<double>(data, len)
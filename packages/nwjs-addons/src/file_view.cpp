@@ -0,0 +1,213 @@
+#include "file_view.h"
+
+#include <cstdio>
+#include <limits>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+FileView::FileView() :
+  data_(""),
+  size_(0),
+  open_(false),
+  mapping_(NULL) {}
+
+FileView::~FileView() {
+  close();
+}
+
+FileView::FileView(FileView&& other) :
+  data_(""),
+  size_(0),
+  open_(false),
+  mapping_(NULL) {
+  moveFrom(other);
+}
+
+FileView& FileView::operator=(FileView&& other) {
+  if (this != &other) {
+    close();
+    moveFrom(other);
+  }
+  return *this;
+}
+
+void FileView::moveFrom(FileView& other) {
+  buffer_.swap(other.buffer_);
+  mapping_ = other.mapping_;
+  open_ = other.open_;
+  size_ = other.size_;
+  // Swapping a vector keeps its storage, so a heap copy's pointer stays valid
+  data_ = other.data_;
+
+  other.data_ = "";
+  other.size_ = 0;
+  other.open_ = false;
+  other.mapping_ = NULL;
+}
+
+bool FileView::open(const std::string& filePath, bool readFallback) {
+  close();
+  if (map(filePath)) {
+    return true;
+  }
+  return readFallback && read(filePath);
+}
+
+void FileView::close() {
+  if (mapping_ != NULL) {
+#ifdef _WIN32
+    UnmapViewOfFile(mapping_);
+#else
+    munmap(mapping_, size_);
+#endif
+    mapping_ = NULL;
+  }
+  std::vector<char>().swap(buffer_);
+  data_ = "";
+  size_ = 0;
+  open_ = false;
+}
+
+#ifdef _WIN32
+
+bool FileView::map(const std::string& filePath) {
+  int wideLength = MultiByteToWideChar(CP_UTF8, 0, filePath.c_str(), -1, NULL, 0);
+  if (wideLength <= 0) {
+    return false;
+  }
+  std::vector<wchar_t> widePath(wideLength);
+  MultiByteToWideChar(CP_UTF8, 0, filePath.c_str(), -1, &widePath[0], wideLength);
+
+  HANDLE file = CreateFileW(&widePath[0], GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) ||
+      static_cast<unsigned long long>(fileSize.QuadPart) > std::numeric_limits<size_t>::max()) {
+    CloseHandle(file);
+    return false;
+  }
+
+  // CreateFileMapping rejects empty files; there is nothing to map anyway
+  if (fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    open_ = true;
+    return true;
+  }
+
+  HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL) {
+    return false;
+  }
+
+  // The view keeps the mapping object alive after its handle is closed
+  void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (base == NULL) {
+    return false;
+  }
+
+  mapping_ = base;
+  data_ = static_cast<const char*>(base);
+  size_ = static_cast<size_t>(fileSize.QuadPart);
+  open_ = true;
+  return true;
+}
+
+#else
+
+bool FileView::map(const std::string& filePath) {
+  int fd = ::open(filePath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) ||
+      static_cast<unsigned long long>(info.st_size) > std::numeric_limits<size_t>::max()) {
+    ::close(fd);
+    return false;
+  }
+
+  // Empty, or a /proc-style file whose size is not known up front:
+  // nothing to map, so let read() take it
+  if (info.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  size_t length = static_cast<size_t>(info.st_size);
+  void* base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED) {
+    return false;
+  }
+  madvise(base, length, MADV_SEQUENTIAL);
+
+  mapping_ = base;
+  data_ = static_cast<const char*>(base);
+  size_ = length;
+  open_ = true;
+  return true;
+}
+
+#endif
+
+bool FileView::read(const std::string& filePath) {
+#ifdef _WIN32
+  int wideLength = MultiByteToWideChar(CP_UTF8, 0, filePath.c_str(), -1, NULL, 0);
+  if (wideLength <= 0) {
+    return false;
+  }
+  std::vector<wchar_t> widePath(wideLength);
+  MultiByteToWideChar(CP_UTF8, 0, filePath.c_str(), -1, &widePath[0], wideLength);
+  FILE* file = _wfopen(&widePath[0], L"rb");
+#else
+  FILE* file = fopen(filePath.c_str(), "rb");
+#endif
+  if (file == NULL) {
+    return false;
+  }
+
+  // Size hint only: pipes and special files report 0, so keep reading
+  // until EOF either way
+  std::vector<char> content;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    long end = ftell(file);
+    if (end > 0) {
+      content.reserve(static_cast<size_t>(end));
+    }
+    fseek(file, 0, SEEK_SET);
+  }
+
+  char block[64 * 1024];
+  size_t got;
+  while ((got = fread(block, 1, sizeof(block), file)) > 0) {
+    content.insert(content.end(), block, block + got);
+  }
+  bool failed = ferror(file) != 0;
+  fclose(file);
+  if (failed) {
+    return false;
+  }
+
+  buffer_.swap(content);
+  data_ = buffer_.empty() ? "" : &buffer_[0];
+  size_ = buffer_.size();
+  open_ = true;
+  return true;
+}
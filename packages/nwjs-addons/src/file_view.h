@@ -0,0 +1,56 @@
+/*
+ * file_view.h — Read-only view of a whole file
+ *
+ * Maps the file into memory (CreateFileMapping on Windows, mmap
+ * elsewhere) so parsers can run over its bytes without copying them.
+ * When mapping is not possible (pipes, exhausted address space on 32-bit
+ * builds) the file is read into memory in one sized read instead, unless
+ * the caller asked for a mapping only.
+ *
+ * Paths are UTF-8. The view is move-only; data() stays valid until
+ * close() or destruction. While mapped on Windows the file is opened
+ * with FILE_SHARE_READ only, so writers are kept out for its lifetime.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class FileView {
+public:
+  FileView();
+  ~FileView();
+
+  FileView(FileView&& other);
+  FileView& operator=(FileView&& other);
+
+  // Open and map (or, with readFallback, read) the file
+  // @returns false if the file cannot be opened or mapped/read
+  bool open(const std::string& filePath, bool readFallback = true);
+
+  void close();
+
+  bool isOpen() const { return open_; }
+
+  // True when data() points into a mapping rather than a heap copy
+  bool isMapped() const { return mapping_ != NULL; }
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  FileView(const FileView&);
+  FileView& operator=(const FileView&);
+
+  bool map(const std::string& filePath);
+  bool read(const std::string& filePath);
+  void moveFrom(FileView& other);
+
+  const char* data_;
+  size_t size_;
+  bool open_;
+  void* mapping_;       // base address returned by MapViewOfFile / mmap
+  std::vector<char> buffer_;
+};